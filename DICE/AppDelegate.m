@@ -12,6 +12,7 @@
 #import "GPKGGeoPackageFactory.h"
 #import "DICEConstants.h"
 #import "GeoPackageURLProtocol.h"
+#import "ReportArchiveURLProtocol.h"
 
 @interface AppDelegate ()
 
@@ -39,6 +40,7 @@
     [OfflineMapUtility generateExteriorPolygons:featuresArray];
     
     [GeoPackageURLProtocol start];
+    [ReportArchiveURLProtocol start];
     
     return YES;
 }
@@ -13,6 +13,8 @@ extern NSString * const DICE_SELECTED_CACHES;
 extern NSString * const DICE_SELECTED_CACHES_UPDATED;
 extern NSString * const DICE_ZOOM_TO_REPORTS;
 extern NSString * const DICE_TEMP_CACHE_PREFIX;
+extern NSString * const DICE_MOUNT_REPORT_ARCHIVES;
+extern NSString * const DICE_REPORT_STORAGE_BUDGET;
 extern NSInteger const DICE_CACHE_FEATURE_TILES_MAX_POINTS_PER_TILE;
 extern NSInteger const DICE_CACHE_FEATURE_TILES_MAX_FEATURES_PER_TILE;
 extern NSInteger const DICE_CACHE_FEATURES_MAX_POINTS_PER_TABLE;
@@ -13,6 +13,8 @@ NSString * const DICE_SELECTED_CACHES = @"selectedCaches";
 NSString * const DICE_SELECTED_CACHES_UPDATED = @"selectedCachesUpdated";
 NSString * const DICE_ZOOM_TO_REPORTS = @"zoomToReports";
 NSString * const DICE_TEMP_CACHE_PREFIX = @"rp-";
+NSString * const DICE_MOUNT_REPORT_ARCHIVES = @"mountReportArchives";
+NSString * const DICE_REPORT_STORAGE_BUDGET = @"reportStorageBudget";
 NSInteger const DICE_CACHE_FEATURE_TILES_MAX_POINTS_PER_TILE = 1000;
 NSInteger const DICE_CACHE_FEATURE_TILES_MAX_FEATURES_PER_TILE = 500;
 NSInteger const DICE_CACHE_FEATURES_MAX_POINTS_PER_TABLE = 1000;
@@ -14,6 +14,13 @@
 @interface DICENavigationController : UINavigationController
 
 - (void)navigateToReport:(Report *)report childResource:(NSString *)resourceName animated:(BOOL)animated;
+/**
+ Open the report with ReportAPI and call the block to show it once it is ready.  Until then, e.g., while
+ a report whose contents were evicted is unzipped again, an alert tells the user what is going on.
+ Cancelling the alert only stops waiting: the report keeps importing, but is not shown when it is
+ ready.  If the report can not be imported, the block is not called, and the user is told so instead.
+ */
+- (void)openReport:(Report *)report thenShow:(void(^)(void))showBlock;
 - (void)navigateToReportForURL:(NSURL *)target fromApp:(NSString *)bundleID;
 
 @end
@@ -90,16 +90,78 @@
 
 - (void)navigateToReport:(Report *)report childResource:(NSString *)resourceName animated:(BOOL)animated
 {
-    ReportResourceViewController *reportView = [self.storyboard instantiateViewControllerWithIdentifier:@"reportResourceViewController"];
-    reportView.report = report;
-    if (!resourceName) {
-        reportView.resource = report.url;
-    }
-    else {
-        NSURL *resource = [report.url.baseURL URLByAppendingPathComponent:resourceName];
-        reportView.resource = resource;
+    [self openReport:report thenShow:^{
+        ReportResourceViewController *reportView = [self.storyboard instantiateViewControllerWithIdentifier:@"reportResourceViewController"];
+        reportView.report = report;
+        if (!resourceName) {
+            reportView.resource = report.url;
+        }
+        else {
+            NSURL *resource = [report.url.baseURL URLByAppendingPathComponent:resourceName];
+            reportView.resource = resource;
+        }
+        [self pushViewController:reportView animated:animated];
+    }];
+}
+
+
+- (void)openReport:(Report *)report thenShow:(void(^)(void))showBlock
+{
+    __block UIAlertController *waitingAlert = nil;
+    __block BOOL presented = NO;
+    __block BOOL ended = NO;
+    __block BOOL ready = NO;
+    __block BOOL cancelled = NO;
+
+    void (^finish)(void) = ^{
+        UIAlertController *alert = waitingAlert;
+        waitingAlert = nil;
+        if (!alert) {
+            if (ready) {
+                showBlock();
+            }
+            return;
+        }
+        [alert dismissViewControllerAnimated:YES completion:^{
+            if (ready) {
+                showBlock();
+                return;
+            }
+            UIAlertController *failedAlert = [UIAlertController alertControllerWithTitle:@"Report Unavailable"
+                message:[NSString stringWithFormat:@"%@ could not be unzipped.", report.title] preferredStyle:UIAlertControllerStyleAlert];
+            [failedAlert addAction:[UIAlertAction actionWithTitle:@"OK" style:UIAlertActionStyleDefault handler:nil]];
+            [self presentViewController:failedAlert animated:YES completion:nil];
+        }];
+    };
+
+    [[ReportAPI sharedInstance] openReport:report whenReady:^(BOOL reportReady) {
+        if (cancelled) {
+            return;
+        }
+        ended = YES;
+        ready = reportReady;
+        // wait for the alert to finish appearing before dismissing it
+        if (!waitingAlert || presented) {
+            finish();
+        }
+    }];
+    if (ended) {
+        return;
     }
-    [self pushViewController:reportView animated:animated];
+
+    waitingAlert = [UIAlertController alertControllerWithTitle:@"Opening Report"
+        message:[NSString stringWithFormat:@"%@ is being unzipped, and will open when it is ready.", report.title] preferredStyle:UIAlertControllerStyleAlert];
+    [waitingAlert addAction:[UIAlertAction actionWithTitle:@"Cancel" style:UIAlertActionStyleCancel handler:^(UIAlertAction *action) {
+        // the report keeps importing, but is not shown
+        cancelled = YES;
+        waitingAlert = nil;
+    }]];
+    [self presentViewController:waitingAlert animated:YES completion:^{
+        presented = YES;
+        if (ended) {
+            finish();
+        }
+    }];
 }
 
 
@@ -0,0 +1,69 @@
+//
+//  GeoPackageTileCache.h
+//  DICE
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ Keeps the tile images GeoPackageURLProtocol serves, so a tile Leaflet asks for again,
+ e.g., after panning back, does not have to be looked up or rendered again.  Tiles are
+ kept in two tiers: an LRU in memory bounded by bytes, and files in the caches directory,
+ also bounded by bytes, that outlast the app.  A tile found on disk is moved back into
+ memory.  Empty tiles, where a GeoPackage has nothing to draw, are kept too.
+
+ A tile's key names the GeoPackage file by its path and by its inode and creation time,
+ so re-importing a GeoPackage at the same path gets new keys, and the old tiles are never
+ served; they age out of the disk tier, or go at once with removeTilesOfGeoPackageAtPath:.
+ All the methods are thread safe.
+ */
+@interface GeoPackageTileCache : NSObject
+
+@property (nonatomic, readonly) NSString *directory;
+@property (nonatomic, readonly) NSUInteger memoryLimit;
+@property (nonatomic, readonly) uint64_t diskLimit;
+
+@property (readonly) NSUInteger memoryUsage;
+@property (readonly) uint64_t diskUsage;
+
+/**
+ The cache GeoPackageURLProtocol uses, in Library/Caches/GeoPackageTiles, with 16 MB in memory and 128 MB on disk.
+ */
++ (instancetype)sharedCache;
+
+- (instancetype)initWithDirectory:(NSString *)directory memoryLimit:(NSUInteger)memoryLimit diskLimit:(uint64_t)diskLimit;
+
+/**
+ The key for a tile drawn from the given tables, in order, of the GeoPackage file at the path,
+ or nil if the file is not there.
+ */
++ (NSString *)keyForGeoPackageAtPath:(NSString *)path tables:(NSArray<NSString *> *)tables zoom:(int)zoom x:(int)x y:(int)y;
+
+/**
+ The tile's data from memory, or else from disk, or nil if it is not cached.
+ */
+- (NSData *)tileDataForKey:(NSString *)key;
+
+/**
+ Whether the tile is cached, in memory or on disk, without reading it or counting it as used.
+ */
+- (BOOL)containsTileForKey:(NSString *)key;
+
+/**
+ Cache the tile's data, which may be empty.  The disk copy is written in the background.
+ */
+- (void)setTileData:(NSData *)data forKey:(NSString *)key;
+
+/**
+ Drop every tile of the GeoPackage at the path, whatever version of the file they came from.
+ */
+- (void)removeTilesOfGeoPackageAtPath:(NSString *)path;
+
+- (void)removeAllTiles;
+
+/**
+ Block until the background disk writes and removals queued so far are done.
+ */
+- (void)flush;
+
+@end
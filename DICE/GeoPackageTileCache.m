@@ -0,0 +1,380 @@
+//
+//  GeoPackageTileCache.m
+//  DICE
+//
+
+#import "GeoPackageTileCache.h"
+
+#import <CommonCrypto/CommonDigest.h>
+#import <fts.h>
+#import <pthread.h>
+#import <stdatomic.h>
+#import <sys/stat.h>
+#import <sys/time.h>
+#import <unistd.h>
+
+// what an entry costs besides its data, so empty tiles count against the memory limit too
+static const NSUInteger kEntryOverhead = 128;
+
+static NSString *sha1Hex(NSString *string) {
+    NSData *data = [string dataUsingEncoding:NSUTF8StringEncoding];
+    unsigned char digest[CC_SHA1_DIGEST_LENGTH];
+    CC_SHA1(data.bytes, (CC_LONG)data.length, digest);
+    NSMutableString *hex = [NSMutableString stringWithCapacity:CC_SHA1_DIGEST_LENGTH * 2];
+    for (size_t i = 0; i < CC_SHA1_DIGEST_LENGTH; i++) {
+        [hex appendFormat:@"%02x", digest[i]];
+    }
+    return hex;
+}
+
+
+/**
+ A tile in the memory tier, linked into the LRU list from newest to oldest.  The entries
+ dictionary owns the entries, so the links are not retained.
+ */
+@interface GeoPackageTileCacheEntry : NSObject
+{
+@public
+    NSString *key;
+    NSData *data;
+    NSUInteger cost;
+    __unsafe_unretained GeoPackageTileCacheEntry *newer;
+    __unsafe_unretained GeoPackageTileCacheEntry *older;
+}
+
+@end
+
+@implementation GeoPackageTileCacheEntry
+
+@end
+
+
+/**
+ A tile file found when scanning the disk tier.
+ */
+@interface GeoPackageTileCacheFile : NSObject
+
+@property (nonatomic, strong) NSString *path;
+@property (nonatomic) uint64_t size;
+@property (nonatomic) struct timespec accessTime;
+
+@end
+
+@implementation GeoPackageTileCacheFile
+
+@end
+
+
+@implementation GeoPackageTileCache
+{
+    pthread_mutex_t lock;
+    NSMutableDictionary<NSString *, GeoPackageTileCacheEntry *> *entries;
+    __unsafe_unretained GeoPackageTileCacheEntry *newest;
+    __unsafe_unretained GeoPackageTileCacheEntry *oldest;
+    NSUInteger memoryBytes;
+    dispatch_queue_t diskQueue;
+    atomic_ullong diskBytes;
+}
+
++ (instancetype)sharedCache
+{
+    static GeoPackageTileCache *sharedCache;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        NSString *caches = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES).firstObject;
+        sharedCache = [[GeoPackageTileCache alloc] initWithDirectory:[caches stringByAppendingPathComponent:@"GeoPackageTiles"]
+            memoryLimit:16 << 20 diskLimit:128 << 20];
+    });
+    return sharedCache;
+}
+
+- (instancetype)initWithDirectory:(NSString *)directory memoryLimit:(NSUInteger)memoryLimit diskLimit:(uint64_t)diskLimit
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _directory = directory;
+    _memoryLimit = memoryLimit;
+    _diskLimit = diskLimit;
+    pthread_mutex_init(&lock, NULL);
+    entries = [NSMutableDictionary dictionary];
+    diskQueue = dispatch_queue_create("mil.nga.giat.dice.tilecache", DISPATCH_QUEUE_SERIAL);
+    dispatch_set_target_queue(diskQueue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0));
+
+    [[NSFileManager defaultManager] createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:nil];
+    // count what an earlier run left on disk
+    dispatch_async(diskQueue, ^{
+        [self scanDisk];
+    });
+
+    return self;
+}
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&lock);
+}
+
+- (NSUInteger)memoryUsage
+{
+    pthread_mutex_lock(&lock);
+    NSUInteger usage = memoryBytes;
+    pthread_mutex_unlock(&lock);
+    return usage;
+}
+
+- (uint64_t)diskUsage
+{
+    return atomic_load(&diskBytes);
+}
+
++ (NSString *)keyForGeoPackageAtPath:(NSString *)path tables:(NSArray<NSString *> *)tables zoom:(int)zoom x:(int)x y:(int)y
+{
+    struct stat info;
+    if (stat(path.fileSystemRepresentation, &info) != 0) {
+        return nil;
+    }
+    // a re-imported file is a new file, so its inode or creation time differs, even when its path and size do not
+    return [NSString stringWithFormat:@"%@/%llx.%llx.%lx.%lx/%@/%d/%d/%d", [self hashOfGeoPackagePath:path],
+        (unsigned long long)info.st_dev, (unsigned long long)info.st_ino, (long)info.st_birthtimespec.tv_sec, (long)info.st_birthtimespec.tv_nsec,
+        [tables componentsJoinedByString:@","], zoom, x, y];
+}
+
+/*
+ * Paths under the documents directory sometimes come with a /private prefix and sometimes without,
+ * so the path is standardized before it is hashed.
+ */
++ (NSString *)hashOfGeoPackagePath:(NSString *)path
+{
+    return sha1Hex(path.stringByStandardizingPath);
+}
+
+/*
+ * Each GeoPackage's tiles are in their own directory, so all of them can be removed at once.
+ */
+- (NSString *)fileForKey:(NSString *)key
+{
+    NSString *geoPackageHash = [key substringToIndex:[key rangeOfString:@"/"].location];
+    return [[self.directory stringByAppendingPathComponent:geoPackageHash] stringByAppendingPathComponent:sha1Hex(key)];
+}
+
+- (NSData *)tileDataForKey:(NSString *)key
+{
+    pthread_mutex_lock(&lock);
+    GeoPackageTileCacheEntry *entry = entries[key];
+    if (entry) {
+        [self unlinkEntry:entry];
+        [self linkNewestEntry:entry];
+        NSData *data = entry->data;
+        pthread_mutex_unlock(&lock);
+        return data;
+    }
+    pthread_mutex_unlock(&lock);
+
+    NSString *file = [self fileForKey:key];
+    NSData *data = [NSData dataWithContentsOfFile:file];
+    if (!data) {
+        return nil;
+    }
+    [self storeInMemory:data forKey:key];
+    // the modification time stands in for the last access when the disk tier is trimmed
+    dispatch_async(diskQueue, ^{
+        utimes(file.fileSystemRepresentation, NULL);
+    });
+    return data;
+}
+
+- (BOOL)containsTileForKey:(NSString *)key
+{
+    pthread_mutex_lock(&lock);
+    BOOL inMemory = entries[key] != nil;
+    pthread_mutex_unlock(&lock);
+    return inMemory || access([self fileForKey:key].fileSystemRepresentation, F_OK) == 0;
+}
+
+- (void)setTileData:(NSData *)data forKey:(NSString *)key
+{
+    data = [data copy] ?: [NSData data];
+    [self storeInMemory:data forKey:key];
+
+    NSString *file = [self fileForKey:key];
+    dispatch_async(diskQueue, ^{
+        mkdir(file.stringByDeletingLastPathComponent.fileSystemRepresentation, 0755);
+        struct stat info;
+        uint64_t replaced = stat(file.fileSystemRepresentation, &info) == 0 ? (uint64_t)info.st_size : 0;
+        if (![data writeToFile:file atomically:YES]) {
+            return;
+        }
+        atomic_fetch_add(&diskBytes, data.length);
+        atomic_fetch_sub(&diskBytes, replaced);
+        if (atomic_load(&diskBytes) > self.diskLimit) {
+            [self trimDisk];
+        }
+    });
+}
+
+- (void)removeTilesOfGeoPackageAtPath:(NSString *)path
+{
+    NSString *geoPackageHash = [GeoPackageTileCache hashOfGeoPackagePath:path];
+    NSString *prefix = [geoPackageHash stringByAppendingString:@"/"];
+    pthread_mutex_lock(&lock);
+    for (NSString *key in entries.allKeys) {
+        if ([key hasPrefix:prefix]) {
+            [self removeEntry:entries[key]];
+        }
+    }
+    pthread_mutex_unlock(&lock);
+
+    dispatch_async(diskQueue, ^{
+        [[NSFileManager defaultManager] removeItemAtPath:[self.directory stringByAppendingPathComponent:geoPackageHash] error:nil];
+        [self scanDisk];
+    });
+}
+
+- (void)removeAllTiles
+{
+    pthread_mutex_lock(&lock);
+    [entries removeAllObjects];
+    newest = nil;
+    oldest = nil;
+    memoryBytes = 0;
+    pthread_mutex_unlock(&lock);
+
+    dispatch_async(diskQueue, ^{
+        NSFileManager *fileManager = [NSFileManager defaultManager];
+        for (NSString *name in [fileManager contentsOfDirectoryAtPath:self.directory error:nil]) {
+            [fileManager removeItemAtPath:[self.directory stringByAppendingPathComponent:name] error:nil];
+        }
+        atomic_store(&diskBytes, 0);
+    });
+}
+
+- (void)flush
+{
+    dispatch_sync(diskQueue, ^{});
+}
+
+#pragma mark - Memory tier, called with the lock held except for storeInMemory:forKey:
+
+- (void)storeInMemory:(NSData *)data forKey:(NSString *)key
+{
+    NSUInteger cost = data.length + key.length + kEntryOverhead;
+    pthread_mutex_lock(&lock);
+    GeoPackageTileCacheEntry *existing = entries[key];
+    if (existing) {
+        [self removeEntry:existing];
+    }
+    if (cost <= self.memoryLimit) {
+        GeoPackageTileCacheEntry *entry = [[GeoPackageTileCacheEntry alloc] init];
+        entry->key = key;
+        entry->data = data;
+        entry->cost = cost;
+        entries[key] = entry;
+        [self linkNewestEntry:entry];
+        memoryBytes += cost;
+        while (memoryBytes > self.memoryLimit && oldest != entry) {
+            [self removeEntry:oldest];
+        }
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+- (void)linkNewestEntry:(GeoPackageTileCacheEntry *)entry
+{
+    entry->newer = nil;
+    entry->older = newest;
+    if (newest) {
+        newest->newer = entry;
+    }
+    newest = entry;
+    if (!oldest) {
+        oldest = entry;
+    }
+}
+
+- (void)unlinkEntry:(GeoPackageTileCacheEntry *)entry
+{
+    if (entry->newer) {
+        entry->newer->older = entry->older;
+    }
+    else {
+        newest = entry->older;
+    }
+    if (entry->older) {
+        entry->older->newer = entry->newer;
+    }
+    else {
+        oldest = entry->newer;
+    }
+    entry->newer = nil;
+    entry->older = nil;
+}
+
+- (void)removeEntry:(GeoPackageTileCacheEntry *)entry
+{
+    // hold the key, since removing the entry from the dictionary may free it
+    NSString *key = entry->key;
+    [self unlinkEntry:entry];
+    memoryBytes -= entry->cost;
+    [entries removeObjectForKey:key];
+}
+
+#pragma mark - Disk tier, called on the disk queue
+
+- (NSArray<GeoPackageTileCacheFile *> *)scanDisk
+{
+    NSMutableArray<GeoPackageTileCacheFile *> *files = [NSMutableArray array];
+    uint64_t total = 0;
+    char *roots[] = { (char *)self.directory.fileSystemRepresentation, NULL };
+    FTS *fts = fts_open(roots, FTS_PHYSICAL | FTS_NOCHDIR, NULL);
+    if (fts) {
+        FTSENT *node;
+        while ((node = fts_read(fts))) {
+            if (node->fts_info != FTS_F) {
+                continue;
+            }
+            GeoPackageTileCacheFile *file = [[GeoPackageTileCacheFile alloc] init];
+            file.path = [[NSFileManager defaultManager] stringWithFileSystemRepresentation:node->fts_path length:node->fts_pathlen];
+            file.size = (uint64_t)node->fts_statp->st_size;
+            file.accessTime = node->fts_statp->st_mtimespec;
+            [files addObject:file];
+            total += file.size;
+        }
+        fts_close(fts);
+    }
+    atomic_store(&diskBytes, total);
+    return files;
+}
+
+/*
+ * Remove the least recently used tile files until the disk tier is down to three quarters of its
+ * limit, so it is not trimmed again on the very next write.
+ */
+- (void)trimDisk
+{
+    NSArray<GeoPackageTileCacheFile *> *files = [[self scanDisk] sortedArrayUsingComparator:^NSComparisonResult(GeoPackageTileCacheFile *a, GeoPackageTileCacheFile *b) {
+        if (a.accessTime.tv_sec != b.accessTime.tv_sec) {
+            return a.accessTime.tv_sec < b.accessTime.tv_sec ? NSOrderedAscending : NSOrderedDescending;
+        }
+        if (a.accessTime.tv_nsec != b.accessTime.tv_nsec) {
+            return a.accessTime.tv_nsec < b.accessTime.tv_nsec ? NSOrderedAscending : NSOrderedDescending;
+        }
+        return NSOrderedSame;
+    }];
+    uint64_t target = self.diskLimit / 4 * 3;
+    uint64_t total = atomic_load(&diskBytes);
+    for (GeoPackageTileCacheFile *file in files) {
+        if (total <= target) {
+            break;
+        }
+        if (unlink(file.path.fileSystemRepresentation) == 0) {
+            total -= file.size;
+        }
+    }
+    atomic_store(&diskBytes, total);
+    NSLog(@"GeoPackageTileCache: trimmed tiles on disk to %llu bytes", total);
+}
+
+@end
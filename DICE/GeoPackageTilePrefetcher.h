@@ -0,0 +1,74 @@
+//
+//  GeoPackageTilePrefetcher.h
+//  DICE
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ A tile by zoom level and x and y in the web mercator tile grid.
+ */
+@interface GeoPackageTileCoordinate : NSObject
+
+@property (nonatomic, readonly) int zoom;
+@property (nonatomic, readonly) int x;
+@property (nonatomic, readonly) int y;
+
+- (instancetype)initWithZoom:(int)zoom x:(int)x y:(int)y;
+
+@end
+
+
+/**
+ Works out which tiles the map will ask for next from the ones it just asked for, so
+ GeoPackageURLProtocol can draw them into the tile cache before a pan or zoom shows them
+ blank.  Requests are recorded per layer, a GeoPackage and the tables drawn together.  A
+ layer's viewport is the bounds of its tiles requested in the last viewportWindow seconds
+ at the zoom level of its latest request, and it moves in the direction the requests have
+ recently gone past those bounds; Leaflet only asks for the tiles a pan uncovers.
+
+ A plan for a layer, best first, is the tiles ahead of the motion, the ring of tiles around
+ the viewport except behind it, and the tiles of the viewport one zoom level in, without
+ the tiles already requested, and no more than maxTilesPerPlan of them.  A layer is only
+ planned again once its viewport changes, unless the last plan was deferred.
+
+ All the methods are thread safe.
+ */
+@interface GeoPackageTilePrefetcher : NSObject
+
+/**
+ Defaults to 32.
+ */
+@property (nonatomic) NSUInteger maxTilesPerPlan;
+
+/**
+ Defaults to 2 seconds.
+ */
+@property (nonatomic) NSTimeInterval viewportWindow;
+
+/**
+ Zoom levels past this are not planned; defaults to 21.
+ */
+@property (nonatomic) int maxZoom;
+
+/**
+ Record a request for the layer's tile, returning YES if the layer was last at another zoom
+ level, when its earlier plans are no longer wanted.
+ */
+- (BOOL)recordRequestForLayer:(NSString *)layer zoom:(int)zoom x:(int)x y:(int)y;
+
+/**
+ The tiles to prefetch for the layer, or an empty array if its viewport has not changed since
+ the last plan.
+ */
+- (NSArray<GeoPackageTileCoordinate *> *)tilesToPrefetchForLayer:(NSString *)layer;
+
+/**
+ The last plan for the layer could not all be prefetched, so plan it again next time even if
+ the viewport has not changed.
+ */
+- (void)deferLayer:(NSString *)layer;
+
+- (void)removeAllLayers;
+
+@end
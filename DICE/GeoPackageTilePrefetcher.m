@@ -0,0 +1,300 @@
+//
+//  GeoPackageTilePrefetcher.m
+//  DICE
+//
+
+#import "GeoPackageTilePrefetcher.h"
+
+// requests remembered per layer, more than the tiles of a tablet screen
+enum { kRecordCapacity = 128 };
+
+// how far past the viewport's bounds requests have to go, on average, to count as motion
+static const double kMotionThreshold = 0.5;
+
+typedef struct {
+    int x;
+    int y;
+    CFAbsoluteTime time;
+} GeoPackageTileRecord;
+
+typedef struct {
+    int minX;
+    int minY;
+    int maxX;
+    int maxY;
+} GeoPackageTileBounds;
+
+static uint64_t tileIndex(int zoom, int x, int y) {
+    return ((uint64_t)zoom << 58) | ((uint64_t)x << 29) | (uint64_t)y;
+}
+
+static int direction(double motion) {
+    return motion > kMotionThreshold ? 1 : motion < -kMotionThreshold ? -1 : 0;
+}
+
+
+@implementation GeoPackageTileCoordinate
+
+- (instancetype)initWithZoom:(int)zoom x:(int)x y:(int)y
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _zoom = zoom;
+    _x = x;
+    _y = y;
+
+    return self;
+}
+
+- (BOOL)isEqual:(id)object
+{
+    if (![object isKindOfClass:[GeoPackageTileCoordinate class]]) {
+        return NO;
+    }
+    GeoPackageTileCoordinate *other = object;
+    return other.zoom == self.zoom && other.x == self.x && other.y == self.y;
+}
+
+- (NSUInteger)hash
+{
+    return (NSUInteger)tileIndex(self.zoom, self.x, self.y);
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"%d/%d/%d", self.zoom, self.x, self.y];
+}
+
+@end
+
+
+/*
+ * The latest requests of a layer, all at its zoom level, in a ring buffer.  The motion
+ * decays by half with each request past the viewport's bounds, so it follows the latest
+ * direction of a pan.
+ */
+@interface GeoPackageTilePrefetchLayer : NSObject
+{
+@public
+    GeoPackageTileRecord records[kRecordCapacity];
+    NSUInteger recordCount;
+    NSUInteger nextRecord;
+    int zoom;
+    double motionX;
+    double motionY;
+    NSUInteger generation;
+    NSUInteger plannedGeneration;
+}
+
+@end
+
+@implementation GeoPackageTilePrefetchLayer
+
+@end
+
+
+@implementation GeoPackageTilePrefetcher
+{
+    NSMutableDictionary<NSString *, GeoPackageTilePrefetchLayer *> *layers;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _maxTilesPerPlan = 32;
+    _viewportWindow = 2;
+    _maxZoom = 21;
+    layers = [NSMutableDictionary dictionary];
+
+    return self;
+}
+
+- (BOOL)recordRequestForLayer:(NSString *)name zoom:(int)zoom x:(int)x y:(int)y
+{
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    @synchronized (self) {
+        GeoPackageTilePrefetchLayer *layer = layers[name];
+        if (!layer) {
+            layer = [[GeoPackageTilePrefetchLayer alloc] init];
+            layers[name] = layer;
+        }
+
+        BOOL zoomChanged = layer->recordCount > 0 && layer->zoom != zoom;
+        GeoPackageTileBounds bounds;
+        if (layer->recordCount == 0 || zoomChanged) {
+            layer->recordCount = 0;
+            layer->nextRecord = 0;
+            layer->zoom = zoom;
+            layer->motionX = 0;
+            layer->motionY = 0;
+            layer->generation++;
+        }
+        else if ([self viewportOfLayer:layer since:now - self.viewportWindow bounds:&bounds]) {
+            BOOL moved = NO;
+            if (x > bounds.maxX || x < bounds.minX) {
+                layer->motionX = layer->motionX / 2 + (x > bounds.maxX ? 1 : -1);
+                moved = YES;
+            }
+            if (y > bounds.maxY || y < bounds.minY) {
+                layer->motionY = layer->motionY / 2 + (y > bounds.maxY ? 1 : -1);
+                moved = YES;
+            }
+            if (moved) {
+                layer->generation++;
+            }
+        }
+        else {
+            // the first request after a pause starts a new viewport, still moving the same way
+            layer->generation++;
+        }
+
+        layer->records[layer->nextRecord] = (GeoPackageTileRecord){x, y, now};
+        layer->nextRecord = (layer->nextRecord + 1) % kRecordCapacity;
+        layer->recordCount = MIN(layer->recordCount + 1, kRecordCapacity);
+
+        return zoomChanged;
+    }
+}
+
+/*
+ * The bounds of the layer's requests since the time, returning NO if there are none.
+ */
+- (BOOL)viewportOfLayer:(GeoPackageTilePrefetchLayer *)layer since:(CFAbsoluteTime)since bounds:(GeoPackageTileBounds *)bounds
+{
+    BOOL found = NO;
+    for (NSUInteger i = 0; i < layer->recordCount; i++) {
+        GeoPackageTileRecord record = layer->records[i];
+        if (record.time < since) {
+            continue;
+        }
+        if (!found) {
+            *bounds = (GeoPackageTileBounds){record.x, record.y, record.x, record.y};
+            found = YES;
+            continue;
+        }
+        bounds->minX = MIN(bounds->minX, record.x);
+        bounds->minY = MIN(bounds->minY, record.y);
+        bounds->maxX = MAX(bounds->maxX, record.x);
+        bounds->maxY = MAX(bounds->maxY, record.y);
+    }
+    return found;
+}
+
+- (NSArray<GeoPackageTileCoordinate *> *)tilesToPrefetchForLayer:(NSString *)name
+{
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    @synchronized (self) {
+        GeoPackageTilePrefetchLayer *layer = layers[name];
+        GeoPackageTileBounds bounds;
+        if (!layer || layer->plannedGeneration == layer->generation
+            || ![self viewportOfLayer:layer since:now - self.viewportWindow bounds:&bounds]) {
+            return @[];
+        }
+        layer->plannedGeneration = layer->generation;
+
+        int zoom = layer->zoom;
+        NSMutableSet<NSNumber *> *skipped = [NSMutableSet set];
+        for (NSUInteger i = 0; i < layer->recordCount; i++) {
+            [skipped addObject:@(tileIndex(zoom, layer->records[i].x, layer->records[i].y))];
+        }
+        NSMutableArray<GeoPackageTileCoordinate *> *tiles = [NSMutableArray array];
+        NSUInteger maxTiles = self.maxTilesPerPlan;
+        int maxZoom = self.maxZoom;
+        void (^plan)(int, int, int) = ^(int z, int x, int y) {
+            if (tiles.count >= maxTiles || z > maxZoom || x < 0 || y < 0 || x >= (1 << z) || y >= (1 << z)) {
+                return;
+            }
+            NSNumber *index = @(tileIndex(z, x, y));
+            if (![skipped containsObject:index]) {
+                [skipped addObject:index];
+                [tiles addObject:[[GeoPackageTileCoordinate alloc] initWithZoom:z x:x y:y]];
+            }
+        };
+
+        // ahead of the motion, two columns or rows deep
+        int directionX = direction(layer->motionX);
+        int directionY = direction(layer->motionY);
+        for (int depth = 1; depth <= 2; depth++) {
+            if (directionX != 0) {
+                int x = directionX > 0 ? bounds.maxX + depth : bounds.minX - depth;
+                for (int y = bounds.minY - 1; y <= bounds.maxY + 1; y++) {
+                    plan(zoom, x, y);
+                }
+            }
+            if (directionY != 0) {
+                int y = directionY > 0 ? bounds.maxY + depth : bounds.minY - depth;
+                for (int x = bounds.minX - 1; x <= bounds.maxX + 1; x++) {
+                    plan(zoom, x, y);
+                }
+            }
+        }
+
+        // the rest of the ring around the viewport, leaving out the side it is moving away from
+        for (int y = bounds.minY - 1; y <= bounds.maxY + 1; y++) {
+            if (directionX >= 0) {
+                plan(zoom, bounds.maxX + 1, y);
+            }
+            if (directionX <= 0) {
+                plan(zoom, bounds.minX - 1, y);
+            }
+        }
+        for (int x = bounds.minX; x <= bounds.maxX; x++) {
+            if (directionY >= 0) {
+                plan(zoom, x, bounds.maxY + 1);
+            }
+            if (directionY <= 0) {
+                plan(zoom, x, bounds.minY - 1);
+            }
+        }
+
+        // the same screen one zoom level in covers the middle of the viewport, from the center out
+        if (zoom < maxZoom) {
+            int halfWidth = (bounds.maxX - bounds.minX + 2) / 2;
+            int halfHeight = (bounds.maxY - bounds.minY + 2) / 2;
+            int centerX = bounds.minX + bounds.maxX + 1;
+            int centerY = bounds.minY + bounds.maxY + 1;
+            NSMutableArray<GeoPackageTileCoordinate *> *inner = [NSMutableArray array];
+            for (int x = centerX - halfWidth; x < centerX + halfWidth; x++) {
+                for (int y = centerY - halfHeight; y < centerY + halfHeight; y++) {
+                    [inner addObject:[[GeoPackageTileCoordinate alloc] initWithZoom:zoom + 1 x:x y:y]];
+                }
+            }
+            [inner sortWithOptions:NSSortStable usingComparator:^NSComparisonResult(GeoPackageTileCoordinate *a, GeoPackageTileCoordinate *b) {
+                double distanceA = pow(a.x + 0.5 - centerX, 2) + pow(a.y + 0.5 - centerY, 2);
+                double distanceB = pow(b.x + 0.5 - centerX, 2) + pow(b.y + 0.5 - centerY, 2);
+                return distanceA < distanceB ? NSOrderedAscending : distanceA > distanceB ? NSOrderedDescending : NSOrderedSame;
+            }];
+            for (GeoPackageTileCoordinate *tile in inner) {
+                plan(tile.zoom, tile.x, tile.y);
+            }
+        }
+
+        return tiles;
+    }
+}
+
+- (void)deferLayer:(NSString *)name
+{
+    @synchronized (self) {
+        GeoPackageTilePrefetchLayer *layer = layers[name];
+        if (layer) {
+            layer->plannedGeneration = NSUIntegerMax;
+        }
+    }
+}
+
+- (void)removeAllLayers
+{
+    @synchronized (self) {
+        [layers removeAllObjects];
+    }
+}
+
+@end
@@ -0,0 +1,165 @@
+//
+//  GeoPackageTileRenderer.h
+//  DICE
+//
+
+#import <Foundation/Foundation.h>
+
+@class GeoPackageTileRender;
+
+typedef NSData *(^GeoPackageTileRenderBlock)(GeoPackageTileRender *render);
+
+
+/**
+ One tile being drawn for one or more requests.  A long draw should check isCancelled
+ between steps and give up once it is set; what it returns then is thrown away.
+ */
+@interface GeoPackageTileRender : NSObject
+
+@property (nonatomic, readonly) NSString *key;
+
+/**
+ Set when every request waiting for the render has been cancelled.
+ */
+@property (readonly, getter=isCancelled) BOOL cancelled;
+
+@end
+
+
+/**
+ A request for a tile, answered by a render it started or joined.
+ */
+@interface GeoPackageTileRequest : NSObject
+
+@property (readonly, getter=isCancelled) BOOL cancelled;
+
+/**
+ Stop waiting for the tile; the completion will not be called.  When the render has no
+ other requests waiting, it is dropped from the queue, or cancelled if it has started.
+ Safe to call from any thread, and more than once.
+ */
+- (void)cancel;
+
+@end
+
+
+/**
+ Runs GeoPackageURLProtocol's tile renders on a bounded pool of workers instead of on the
+ URL loading thread, so the burst of tile requests Leaflet makes after a zoom draw in
+ parallel, without starting more draws than there are cores.  Requests for a tile that
+ is already queued or being drawn join that render instead of starting another, and all
+ of them get its result.  Requests the web view gives up on, e.g., for tiles panned out
+ of view, are cancelled, so the workers only draw tiles someone is waiting for.
+
+ Tiles can also be prefetched, drawn before anyone asks for them, e.g., to warm the tile
+ cache around the viewport.  Prefetches run at the lowest priority, only start while no
+ request is waiting for a worker, and are limited to maxPendingPrefetches at a time.  A
+ request for a tile being prefetched joins the prefetch, which is raised to the priority
+ of a request.
+
+ The renderer counts what it does, so the queue depth, render latency, and wasted work can
+ be watched; a summary is logged every 100 renders.  All the methods are thread safe.
+ */
+@interface GeoPackageTileRenderer : NSObject
+
+@property (nonatomic, readonly) NSUInteger maxConcurrentRenders;
+
+/**
+ Renders waiting for a worker, and renders being drawn.
+ */
+@property (readonly) NSUInteger queueDepth;
+@property (readonly) NSUInteger activeRenders;
+
+/**
+ The most renders ever waiting at once.
+ */
+@property (readonly) NSUInteger peakQueueDepth;
+
+/**
+ Renders that ran to the end, and requests that joined a render already in flight.
+ */
+@property (readonly) uint64_t renderCount;
+@property (readonly) uint64_t coalescedCount;
+
+/**
+ Renders whose result was delivered to a request, renders that ran but had no request left
+ to deliver to, and renders dropped from the queue before they started.
+ */
+@property (readonly) uint64_t deliveredCount;
+@property (readonly) uint64_t wastedCount;
+@property (readonly) uint64_t droppedCount;
+
+/**
+ Requests cancelled before they were answered.
+ */
+@property (readonly) uint64_t cancelledCount;
+
+/**
+ The most prefetches queued or being drawn at once; defaults to twice maxConcurrentRenders.
+ */
+@property (nonatomic) NSUInteger maxPendingPrefetches;
+
+/**
+ Prefetches queued or being drawn.
+ */
+@property (readonly) NSUInteger prefetchQueueDepth;
+
+/**
+ YES when no request is waiting for a worker and there is room for another prefetch.
+ */
+@property (readonly) BOOL canPrefetch;
+
+/**
+ Prefetches that ran with no request waiting for them, requests that joined a prefetch, and
+ times a prefetch got a worker while requests were waiting and went back in the queue.
+ */
+@property (readonly) uint64_t prefetchCount;
+@property (readonly) uint64_t prefetchHitCount;
+@property (readonly) uint64_t prefetchSkippedCount;
+
+/**
+ Mean seconds a render waited for a worker, and mean seconds drawing.
+ */
+@property (readonly) NSTimeInterval averageWaitTime;
+@property (readonly) NSTimeInterval averageRenderTime;
+
+/**
+ The renderer GeoPackageURLProtocol uses, with one worker per active processor.
+ */
++ (instancetype)sharedRenderer;
+
+- (instancetype)initWithMaxConcurrentRenders:(NSUInteger)maxConcurrentRenders;
+
+/**
+ Call the render block on a worker and pass its result to the completion, or, if a render with
+ the same key is already in flight, pass that render's result to the completion instead.  The
+ completion is called on the worker, unless the request is cancelled first.  The render block may
+ return nil for an empty tile; an exception it raises is logged and counts as an empty tile.
+ */
+- (GeoPackageTileRequest *)renderTileWithKey:(NSString *)key render:(GeoPackageTileRenderBlock)render completion:(void (^)(NSData *tileData))completion;
+
+/**
+ Queue the render block at the lowest priority with no request waiting for it; the block should
+ store its result, e.g., in the tile cache.  Returns NO when the prefetch has to wait until
+ canPrefetch, and YES if it was queued, or if a render with the key is already in flight.
+ */
+- (BOOL)prefetchTileWithKey:(NSString *)key render:(GeoPackageTileRenderBlock)render;
+
+/**
+ Drop the prefetches that have not started and cancel the ones being drawn, e.g., when the map
+ zooms away from the tiles they were for.  Prefetches that requests have joined are kept.
+ */
+- (void)cancelPrefetches;
+
+/**
+ Block until no render is queued or being drawn, e.g., before closing the GeoPackages the renders
+ read from.  Cancel the requests and prefetches first, or this waits for their tiles to be drawn.
+ */
+- (void)waitUntilIdle;
+
+/**
+ The counters above by name, for logging.
+ */
+- (NSDictionary<NSString *, NSNumber *> *)metrics;
+
+@end
@@ -0,0 +1,450 @@
+//
+//  GeoPackageTileRenderer.m
+//  DICE
+//
+
+#import "GeoPackageTileRenderer.h"
+
+static const uint64_t kMetricsLogInterval = 100;
+
+@interface GeoPackageTileRenderer ()
+
+- (void)cancelRequest:(GeoPackageTileRequest *)request;
+
+@end
+
+
+@interface GeoPackageTileRender ()
+
+@property (nonatomic, readwrite) NSString *key;
+@property (readwrite, getter=isCancelled) BOOL cancelled;
+@property (nonatomic) BOOL started;
+@property (nonatomic) BOOL prefetch;
+@property (nonatomic) CFAbsoluteTime queuedTime;
+@property (nonatomic, strong) NSOperation *operation;
+@property (nonatomic, strong) NSMutableArray<GeoPackageTileRequest *> *requests;
+
+@end
+
+@implementation GeoPackageTileRender
+
+@end
+
+
+@interface GeoPackageTileRequest ()
+
+@property (nonatomic, weak) GeoPackageTileRenderer *renderer;
+@property (nonatomic, weak) GeoPackageTileRender *render;
+@property (nonatomic, copy) void (^completion)(NSData *tileData);
+@property (readwrite, getter=isCancelled) BOOL cancelled;
+
+@end
+
+@implementation GeoPackageTileRequest
+
+- (void)cancel
+{
+    [self.renderer cancelRequest:self];
+}
+
+@end
+
+
+@implementation GeoPackageTileRenderer
+{
+    NSOperationQueue *queue;
+    NSMutableDictionary<NSString *, GeoPackageTileRender *> *inFlight;
+    NSUInteger waiting;
+    NSUInteger active;
+    NSUInteger peakWaiting;
+    uint64_t rendered;
+    uint64_t coalesced;
+    uint64_t delivered;
+    uint64_t wasted;
+    uint64_t dropped;
+    uint64_t cancelledRequests;
+    NSMutableSet<GeoPackageTileRender *> *prefetches;
+    NSUInteger prefetchWaiting;
+    uint64_t prefetched;
+    uint64_t prefetchHits;
+    uint64_t prefetchSkipped;
+    NSTimeInterval totalWaitTime;
+    NSTimeInterval totalRenderTime;
+}
+
++ (instancetype)sharedRenderer
+{
+    static GeoPackageTileRenderer *sharedRenderer;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        sharedRenderer = [[GeoPackageTileRenderer alloc] initWithMaxConcurrentRenders:[NSProcessInfo processInfo].activeProcessorCount];
+    });
+    return sharedRenderer;
+}
+
+- (instancetype)initWithMaxConcurrentRenders:(NSUInteger)maxConcurrentRenders
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _maxConcurrentRenders = MAX((NSUInteger)1, maxConcurrentRenders);
+    queue = [[NSOperationQueue alloc] init];
+    queue.name = @"mil.nga.giat.dice.tilerender";
+    queue.maxConcurrentOperationCount = (NSInteger)_maxConcurrentRenders;
+    queue.qualityOfService = NSQualityOfServiceUserInitiated;
+    inFlight = [NSMutableDictionary dictionary];
+    prefetches = [NSMutableSet set];
+    _maxPendingPrefetches = 2 * _maxConcurrentRenders;
+
+    return self;
+}
+
+- (NSUInteger)queueDepth
+{
+    @synchronized (self) {
+        return waiting;
+    }
+}
+
+- (NSUInteger)activeRenders
+{
+    @synchronized (self) {
+        return active;
+    }
+}
+
+- (NSUInteger)peakQueueDepth
+{
+    @synchronized (self) {
+        return peakWaiting;
+    }
+}
+
+- (uint64_t)renderCount
+{
+    @synchronized (self) {
+        return rendered;
+    }
+}
+
+- (uint64_t)coalescedCount
+{
+    @synchronized (self) {
+        return coalesced;
+    }
+}
+
+- (uint64_t)deliveredCount
+{
+    @synchronized (self) {
+        return delivered;
+    }
+}
+
+- (uint64_t)wastedCount
+{
+    @synchronized (self) {
+        return wasted;
+    }
+}
+
+- (uint64_t)droppedCount
+{
+    @synchronized (self) {
+        return dropped;
+    }
+}
+
+- (uint64_t)cancelledCount
+{
+    @synchronized (self) {
+        return cancelledRequests;
+    }
+}
+
+- (NSUInteger)prefetchQueueDepth
+{
+    @synchronized (self) {
+        return prefetches.count;
+    }
+}
+
+- (BOOL)canPrefetch
+{
+    @synchronized (self) {
+        return waiting == prefetchWaiting && prefetches.count < self.maxPendingPrefetches;
+    }
+}
+
+- (uint64_t)prefetchCount
+{
+    @synchronized (self) {
+        return prefetched;
+    }
+}
+
+- (uint64_t)prefetchHitCount
+{
+    @synchronized (self) {
+        return prefetchHits;
+    }
+}
+
+- (uint64_t)prefetchSkippedCount
+{
+    @synchronized (self) {
+        return prefetchSkipped;
+    }
+}
+
+- (NSTimeInterval)averageWaitTime
+{
+    @synchronized (self) {
+        uint64_t started = delivered + wasted + prefetched;
+        return started > 0 ? totalWaitTime / started : 0;
+    }
+}
+
+- (NSTimeInterval)averageRenderTime
+{
+    @synchronized (self) {
+        uint64_t started = delivered + wasted + prefetched;
+        return started > 0 ? totalRenderTime / started : 0;
+    }
+}
+
+- (NSDictionary<NSString *, NSNumber *> *)metrics
+{
+    @synchronized (self) {
+        return @{
+            @"queueDepth": @(waiting),
+            @"activeRenders": @(active),
+            @"peakQueueDepth": @(peakWaiting),
+            @"renderCount": @(rendered),
+            @"coalescedCount": @(coalesced),
+            @"deliveredCount": @(delivered),
+            @"wastedCount": @(wasted),
+            @"droppedCount": @(dropped),
+            @"cancelledCount": @(cancelledRequests),
+            @"prefetchQueueDepth": @(prefetches.count),
+            @"prefetchCount": @(prefetched),
+            @"prefetchHitCount": @(prefetchHits),
+            @"prefetchSkippedCount": @(prefetchSkipped),
+            @"averageWaitTime": @(self.averageWaitTime),
+            @"averageRenderTime": @(self.averageRenderTime)
+        };
+    }
+}
+
+- (GeoPackageTileRequest *)renderTileWithKey:(NSString *)key render:(GeoPackageTileRenderBlock)renderBlock completion:(void (^)(NSData *tileData))completion
+{
+    GeoPackageTileRequest *request = [[GeoPackageTileRequest alloc] init];
+    request.renderer = self;
+    request.completion = completion;
+
+    @synchronized (self) {
+        // a cancelled render may give up partway, so a new request for its tile starts over
+        GeoPackageTileRender *existing = inFlight[key];
+        if (existing && !existing.isCancelled) {
+            request.render = existing;
+            [existing.requests addObject:request];
+            coalesced++;
+            if (existing.prefetch) {
+                [self promotePrefetch:existing];
+            }
+            return request;
+        }
+
+        GeoPackageTileRender *render = [self queueRenderWithKey:key block:renderBlock priority:NSOperationQueuePriorityNormal];
+        [render.requests addObject:request];
+        request.render = render;
+    }
+
+    return request;
+}
+
+- (BOOL)prefetchTileWithKey:(NSString *)key render:(GeoPackageTileRenderBlock)renderBlock
+{
+    @synchronized (self) {
+        if (inFlight[key]) {
+            return YES;
+        }
+        if (!self.canPrefetch) {
+            return NO;
+        }
+        GeoPackageTileRender *render = [self queueRenderWithKey:key block:renderBlock priority:NSOperationQueuePriorityVeryLow];
+        render.prefetch = YES;
+        [prefetches addObject:render];
+        prefetchWaiting++;
+    }
+    return YES;
+}
+
+- (void)cancelPrefetches
+{
+    @synchronized (self) {
+        for (GeoPackageTileRender *render in prefetches) {
+            render.cancelled = YES;
+            if (!render.started) {
+                [render.operation cancel];
+                waiting--;
+                prefetchWaiting--;
+                dropped++;
+            }
+            if (inFlight[render.key] == render) {
+                [inFlight removeObjectForKey:render.key];
+            }
+        }
+        [prefetches removeAllObjects];
+    }
+}
+
+- (void)waitUntilIdle
+{
+    // a prefetch that gives way goes back in the queue, which the wait covers too
+    [queue waitUntilAllOperationsAreFinished];
+}
+
+/*
+ * Add a render with no requests yet to the queue.  Called with the lock held, which the
+ * operation waits for before it starts, so the caller can finish setting the render up.
+ */
+- (GeoPackageTileRender *)queueRenderWithKey:(NSString *)key block:(GeoPackageTileRenderBlock)renderBlock priority:(NSOperationQueuePriority)priority
+{
+    GeoPackageTileRender *render = [[GeoPackageTileRender alloc] init];
+    render.key = key;
+    render.queuedTime = CFAbsoluteTimeGetCurrent();
+    render.requests = [NSMutableArray array];
+    inFlight[key] = render;
+    waiting++;
+    peakWaiting = MAX(peakWaiting, waiting);
+    [self enqueueRender:render withBlock:renderBlock priority:priority];
+    return render;
+}
+
+- (void)enqueueRender:(GeoPackageTileRender *)render withBlock:(GeoPackageTileRenderBlock)renderBlock priority:(NSOperationQueuePriority)priority
+{
+    __weak GeoPackageTileRender *weakRender = render;
+    render.operation = [NSBlockOperation blockOperationWithBlock:^{
+        GeoPackageTileRender *strongRender = weakRender;
+        if (strongRender) {
+            [self runRender:strongRender withBlock:renderBlock];
+        }
+    }];
+    render.operation.queuePriority = priority;
+    [queue addOperation:render.operation];
+}
+
+/*
+ * A request joined the prefetch, so it is a render someone is waiting for from now on.
+ * Called with the lock held.
+ */
+- (void)promotePrefetch:(GeoPackageTileRender *)render
+{
+    render.prefetch = NO;
+    [prefetches removeObject:render];
+    prefetchHits++;
+    if (!render.started) {
+        prefetchWaiting--;
+        render.operation.queuePriority = NSOperationQueuePriorityNormal;
+    }
+}
+
+- (void)cancelRequest:(GeoPackageTileRequest *)request
+{
+    @synchronized (self) {
+        GeoPackageTileRender *render = request.render;
+        if (request.isCancelled || ![render.requests containsObject:request]) {
+            return;
+        }
+        request.cancelled = YES;
+        request.completion = nil;
+        cancelledRequests++;
+        [render.requests removeObject:request];
+        if (render.requests.count > 0) {
+            return;
+        }
+
+        render.cancelled = YES;
+        if (!render.started) {
+            [render.operation cancel];
+            waiting--;
+            dropped++;
+            if (inFlight[render.key] == render) {
+                [inFlight removeObjectForKey:render.key];
+            }
+        }
+    }
+}
+
+- (void)runRender:(GeoPackageTileRender *)render withBlock:(GeoPackageTileRenderBlock)renderBlock
+{
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    @synchronized (self) {
+        // dropped by cancelRequest: while the operation was being started
+        if (render.isCancelled) {
+            return;
+        }
+        // a prefetch gives way to requests that came in while it was queued, going to the back of the queue
+        if (render.prefetch && waiting > prefetchWaiting) {
+            prefetchSkipped++;
+            [self enqueueRender:render withBlock:renderBlock priority:NSOperationQueuePriorityVeryLow];
+            return;
+        }
+        render.started = YES;
+        waiting--;
+        if (render.prefetch) {
+            prefetchWaiting--;
+        }
+        active++;
+        totalWaitTime += startTime - render.queuedTime;
+    }
+
+    NSData *tileData = nil;
+    @try {
+        tileData = renderBlock(render);
+    }
+    @catch (NSException *exception) {
+        NSLog(@"GeoPackageTileRenderer: failed to render %@: %@", render.key, exception.reason);
+    }
+
+    NSArray<GeoPackageTileRequest *> *requests;
+    BOOL logMetrics = NO;
+    @synchronized (self) {
+        active--;
+        totalRenderTime += CFAbsoluteTimeGetCurrent() - startTime;
+        requests = [render.requests copy];
+        [render.requests removeAllObjects];
+        if (inFlight[render.key] == render) {
+            [inFlight removeObjectForKey:render.key];
+        }
+        if (requests.count > 0) {
+            delivered++;
+        }
+        else if (render.prefetch && !render.isCancelled) {
+            prefetched++;
+        }
+        else {
+            wasted++;
+        }
+        if (render.prefetch) {
+            [prefetches removeObject:render];
+        }
+        if (!render.isCancelled) {
+            rendered++;
+            logMetrics = (rendered % kMetricsLogInterval == 0);
+        }
+    }
+    for (GeoPackageTileRequest *request in requests) {
+        request.completion(tileData);
+        request.completion = nil;
+    }
+
+    if (logMetrics) {
+        NSLog(@"GeoPackageTileRenderer: %@", self.metrics);
+    }
+}
+
+@end
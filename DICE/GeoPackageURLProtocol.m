@@ -19,29 +19,40 @@
 #import "GeoPackageMapData.h"
 #import "GPKGFeatureTileTableLinker.h"
 #import "GPKGOverlayFactory.h"
+#import "GeoPackageTileCache.h"
+#import "GeoPackageRenderContextPool.h"
+#import "GeoPackageTileRenderer.h"
+#import "GeoPackageTileReader.h"
+#import "GeoPackageTilePrefetcher.h"
 
-@interface GeoPackageURLProtocol () <NSURLConnectionDelegate>
+@interface GeoPackageURLProtocol ()
 
 @property (nonatomic, strong) NSString * path;
 @property (nonatomic, strong) NSArray<NSString *> * tables;
 @property (nonatomic) int zoom;
 @property (nonatomic) int x;
 @property (nonatomic) int y;
-@property (nonatomic, strong) NSURLConnection *connection;
+@property (nonatomic, strong) NSThread * clientThread;
+@property (nonatomic, strong) NSArray<NSString *> * clientModes;
+@property (nonatomic, strong) GeoPackageTileRequest * renderRequest;
+@property (nonatomic) BOOL stopped;
 
 @end
 
 @implementation GeoPackageURLProtocol
 
-static NSString *urlProtocolHandledKey = @"GeoPackageURLProtocolHandledKey";
 static GPKGGeoPackageManager * manager;
 static GPKGGeoPackageCache *cache;
 static NSString *currentId;
 static NSMutableDictionary<NSString *, GeoPackageMapData *> *mapData;
+static GeoPackageRenderContextPool *renderContexts;
+static GeoPackageTilePrefetcher *prefetcher;
+static NSHashTable<GeoPackageTileRequest *> *renderRequests;
 
 + (void)start {
     manager = [GPKGGeoPackageFactory getManager];
     cache = [[GPKGGeoPackageCache alloc]initWithManager:manager];
+    renderRequests = [NSHashTable weakObjectsHashTable];
     [NSURLProtocol registerClass:self];
 }
 
@@ -49,9 +60,31 @@ static NSMutableDictionary<NSString *, GeoPackageMapData *> *mapData;
     [self closeCache];
     currentId = id;
     mapData = [[NSMutableDictionary alloc] init];
+    @synchronized(self){
+        renderContexts = [[GeoPackageRenderContextPool alloc] init];
+        prefetcher = [[GeoPackageTilePrefetcher alloc] init];
+    }
 }
 
 + (void) closeCache{
+    NSArray<GeoPackageTileRequest *> * requests = nil;
+    GeoPackageRenderContextPool * pool = nil;
+    @synchronized(self){
+        requests = [renderRequests allObjects];
+        [renderRequests removeAllObjects];
+        pool = renderContexts;
+        renderContexts = nil;
+        prefetcher = nil;
+    }
+    
+    // Stop the renders, and wait for the ones being drawn to give up, before closing the GeoPackages they read from
+    GeoPackageTileRenderer * renderer = [GeoPackageTileRenderer sharedRenderer];
+    for(GeoPackageTileRequest * request in requests){
+        [request cancel];
+    }
+    [renderer cancelPrefetches];
+    [renderer waitUntilIdle];
+    [pool removeAll];
     [cache closeAll];
     if(currentId != nil){
         NSString * like = [NSString stringWithFormat:@"%@%@", DICE_TEMP_CACHE_PREFIX, @"%"];
@@ -66,7 +99,7 @@ static NSMutableDictionary<NSString *, GeoPackageMapData *> *mapData;
 + (BOOL)canInitWithRequest:(NSURLRequest *)request {
     BOOL supports = NO;
     
-    if(request != nil  && ![NSURLProtocol propertyForKey:urlProtocolHandledKey inRequest:request]){
+    if(request != nil){
         NSURL * url = [request URL];
         if(url != nil && [url isFileURL]){
             supports = [GPKGGeoPackageValidate hasGeoPackageExtension:url.path];
@@ -102,10 +135,13 @@ static NSMutableDictionary<NSString *, GeoPackageMapData *> *mapData;
 }
 
 - (void)startLoading {
-    NSMutableURLRequest *newRequest = [self.request mutableCopy];
-    [NSURLProtocol setProperty:@YES forKey:urlProtocolHandledKey inRequest:newRequest];
-    
-    self.connection = [NSURLConnection connectionWithRequest:newRequest delegate:self];
+    // The cache may be closed while this request is answered, so the renders keep to the pool and prefetcher it started with
+    GeoPackageRenderContextPool * pool = nil;
+    GeoPackageTilePrefetcher * tilePrefetcher = nil;
+    @synchronized([GeoPackageURLProtocol class]){
+        pool = renderContexts;
+        tilePrefetcher = prefetcher;
+    }
     
     NSString * nameWithExtension = [self.path lastPathComponent];
     NSString * name = [nameWithExtension stringByDeletingPathExtension];
@@ -116,6 +152,39 @@ static NSMutableDictionary<NSString *, GeoPackageMapData *> *mapData;
     
     name = [GeoPackageURLProtocol reportIdPrefixWithName:name andReport:currentId andShare:shared];
     
+    NSString * importPath = [self importPathWithLocalPath:localPath andShared:shared];
+    NSString * tileKey = nil;
+    NSString * layer = nil;
+    if(name != nil){
+        tileKey = [GeoPackageTileCache keyForGeoPackageAtPath:importPath tables:self.tables zoom:self.zoom x:self.x y:self.y];
+        
+        // Track where the map is looking, dropping the prefetches of another zoom level
+        layer = [NSString stringWithFormat:@"%@/%@", name, [self.tables componentsJoinedByString:@","]];
+        if([tilePrefetcher recordRequestForLayer:layer zoom:self.zoom x:self.x y:self.y]){
+            [[GeoPackageTileRenderer sharedRenderer] cancelPrefetches];
+        }
+    }
+    
+    // Serve a cached tile, once the map click queries of its tables have been set up by a first request
+    if(tileKey != nil && [GeoPackageURLProtocol hasMapDataForGeoPackage:name andTables:self.tables]){
+        NSData * cachedData = [[GeoPackageTileCache sharedCache] tileDataForKey:tileKey];
+        if(cachedData != nil){
+            [self respondWithTileData:cachedData];
+            
+            // Keep prefetching ahead while the map is panned over cached tiles
+            if([GeoPackageTileRenderer sharedRenderer].canPrefetch && [manager exists:name]){
+                @try {
+                    GPKGGeoPackage * geoPackage = [cache getOrOpen:name];
+                    [GeoPackageURLProtocol prefetchTilesForLayer:layer fromGeoPackage:geoPackage withName:name andPath:importPath andTables:self.tables andPrefetcher:tilePrefetcher andPool:pool];
+                }
+                @catch (NSException *exception) {
+                    NSLog(@"Failed to open GeoPackage %@ to prefetch tiles", name);
+                }
+            }
+            return;
+        }
+    }
+    
     GPKGGeoPackage * geoPackage = nil;
     
     if(name != nil){
@@ -125,6 +194,7 @@ static NSMutableDictionary<NSString *, GeoPackageMapData *> *mapData;
                 geoPackage = [cache getOrOpen:name];
             }
             @catch (NSException *exception) {
+                [pool removeContextsForGeoPackage:name];
                 [cache close:name];
                 [manager delete:name andFile:NO];
                 geoPackage = nil;
@@ -133,31 +203,6 @@ static NSMutableDictionary<NSString *, GeoPackageMapData *> *mapData;
         
         if(geoPackage == nil){
             
-            NSString * importPath = self.path;
-            
-            // If a shared file, check if the file exists in this report or another
-            if(shared){
-                NSFileManager * fileManager = [NSFileManager defaultManager];
-                
-                // If the file is not in this report, search other reports
-                if(![fileManager fileExistsAtPath:importPath]){
-                    
-                    NSString * sharedSearchPath = [localPath substringFromIndex:[currentId length]];
-                    
-                    NSArray * reportDirectories = [ReportUtils getReportDirectories];
-                    for(NSString * reportDirectory in reportDirectories){
-                        
-                        NSString * sharedLocation = [NSString stringWithFormat:@"%@%@", reportDirectory, sharedSearchPath];
-                        
-                        if([fileManager fileExistsAtPath:sharedLocation]){
-                            importPath = sharedLocation;
-                            break;
-                        }
-                    }
-
-                }
-            }
-            
             [manager importGeoPackageAsLinkToPath:importPath withName:name];
             @try {
                 geoPackage = [cache getOrOpen:name];
@@ -169,121 +214,314 @@ static NSMutableDictionary<NSString *, GeoPackageMapData *> *mapData;
         }
     }
     
-    NSData *tileData = nil;
+    if(geoPackage == nil){
+        [self respondWithTileData:nil];
+        return;
+    }
     
-    if(geoPackage != nil){
-        for(NSString * table in self.tables){
+    for(NSString * table in self.tables){
+        
+        // Get or create the GeoPackage data
+        GeoPackageMapData * geoPackageData = [mapData objectForKey:name];
+        if(geoPackageData == nil){
+            geoPackageData = [[GeoPackageMapData alloc] initWithName:name];
+            [mapData setObject:geoPackageData forKey:name];
+        }
+        // Get or create the table data
+        GeoPackageTableMapData * tableData = [geoPackageData getTable:table];
+        if(tableData == nil){
+            tableData = [[GeoPackageTableMapData alloc] initWithName:table];
+            [geoPackageData addTable:tableData];
             
-            // Get or create the GeoPackage data
-            GeoPackageMapData * geoPackageData = [mapData objectForKey:name];
-            if(geoPackageData == nil){
-                geoPackageData = [[GeoPackageMapData alloc] initWithName:name];
-                [mapData setObject:geoPackageData forKey:name];
+            // First time handling this table
+            [GeoPackageURLProtocol addFeatureOverlayQueriesToTableData:tableData withGeoPackage:geoPackage];
+        }
+    }
+    
+    // Draw the tile on a render worker and respond on this loading thread, where the client expects to be called
+    self.clientThread = [NSThread currentThread];
+    NSString * currentMode = [[NSRunLoop currentRunLoop] currentMode];
+    self.clientModes = currentMode != nil && ![currentMode isEqualToString:NSDefaultRunLoopMode] ? @[NSDefaultRunLoopMode, currentMode] : @[NSDefaultRunLoopMode];
+    
+    NSString * renderKey = tileKey;
+    if(renderKey == nil){
+        renderKey = [NSString stringWithFormat:@"%@/%d/%d/%d", layer, self.zoom, self.x, self.y];
+    }
+    NSArray<NSString *> * tables = self.tables;
+    int x = self.x;
+    int y = self.y;
+    int zoom = self.zoom;
+    self.renderRequest = [[GeoPackageTileRenderer sharedRenderer] renderTileWithKey:renderKey render:^NSData *(GeoPackageTileRender *render) {
+        NSData * tileData = [GeoPackageURLProtocol tileDataFromGeoPackage:geoPackage withName:name andTables:tables andX:x andY:y andZoom:zoom andRender:render andPool:pool];
+        // A cancelled render may have stopped partway, so only a finished one is cached
+        if(tileKey != nil && !render.isCancelled){
+            [[GeoPackageTileCache sharedCache] setTileData:tileData forKey:tileKey];
+        }
+        return tileData;
+    } completion:^(NSData * tileData) {
+        [self performSelector:@selector(respondWithTileData:) onThread:self.clientThread withObject:tileData waitUntilDone:NO modes:self.clientModes];
+        if(tileKey != nil){
+            [GeoPackageURLProtocol prefetchTilesForLayer:layer fromGeoPackage:geoPackage withName:name andPath:importPath andTables:tables andPrefetcher:tilePrefetcher andPool:pool];
+        }
+    }];
+    
+    // Tracked until answered or stopped, so closing the cache can cancel it
+    @synchronized([GeoPackageURLProtocol class]){
+        [renderRequests addObject:self.renderRequest];
+    }
+}
+
+/**
+ *  Draw the tiles the map is likely to ask for next into the tile cache, at a low priority and only while
+ *  no tile request is waiting.  Each prefetch that finishes tries again, so a plan cut short by the
+ *  prefetch budget carries on as the budget frees up.
+ *
+ *  @param layer      layer of the GeoPackage and tables, as recorded with the prefetcher
+ *  @param geoPackage GeoPackage
+ *  @param name       GeoPackage name
+ *  @param path       GeoPackage file path
+ *  @param tables     table names
+ *  @param tilePrefetcher prefetcher of the cache the request was made in
+ *  @param pool       render context pool of the cache the request was made in
+ */
++(void) prefetchTilesForLayer: (NSString *) layer fromGeoPackage: (GPKGGeoPackage *) geoPackage withName: (NSString *) name andPath: (NSString *) path andTables: (NSArray<NSString *> *) tables andPrefetcher: (GeoPackageTilePrefetcher *) tilePrefetcher andPool: (GeoPackageRenderContextPool *) pool{
+    
+    GeoPackageTileRenderer * renderer = [GeoPackageTileRenderer sharedRenderer];
+    if(tilePrefetcher == nil || layer == nil || !renderer.canPrefetch){
+        return;
+    }
+    
+    GeoPackageTileCache * tileCache = [GeoPackageTileCache sharedCache];
+    for(GeoPackageTileCoordinate * tile in [tilePrefetcher tilesToPrefetchForLayer:layer]){
+        
+        NSString * tileKey = [GeoPackageTileCache keyForGeoPackageAtPath:path tables:tables zoom:tile.zoom x:tile.x y:tile.y];
+        if(tileKey == nil){
+            break;
+        }
+        if([tileCache containsTileForKey:tileKey]){
+            continue;
+        }
+        
+        BOOL queued = [renderer prefetchTileWithKey:tileKey render:^NSData *(GeoPackageTileRender *render) {
+            NSData * tileData = [GeoPackageURLProtocol tileDataFromGeoPackage:geoPackage withName:name andTables:tables andX:tile.x andY:tile.y andZoom:tile.zoom andRender:render andPool:pool];
+            if(!render.isCancelled){
+                [tileCache setTileData:tileData forKey:tileKey];
+                [GeoPackageURLProtocol prefetchTilesForLayer:layer fromGeoPackage:geoPackage withName:name andPath:path andTables:tables andPrefetcher:tilePrefetcher andPool:pool];
             }
-            // Get or create the table data
-            GeoPackageTableMapData * tableData = [geoPackageData getTable:table];
-            if(tableData == nil){
-                tableData = [[GeoPackageTableMapData alloc] initWithName:table];
-                [geoPackageData addTable:tableData];
-            }else{
-                // Feature Overlay Queries have already been added for this table
-                tableData = nil;
+            return tileData;
+        }];
+        if(!queued){
+            [tilePrefetcher deferLayer:layer];
+            break;
+        }
+    }
+}
+
+/**
+ *  Get the tile data from the first of the tables with something at the tile, using render contexts from the pool
+ *
+ *  @param geoPackage GeoPackage
+ *  @param name       GeoPackage name
+ *  @param tables     table names
+ *  @param x          x coordinate
+ *  @param y          y coordinate
+ *  @param zoom       zoom level
+ *  @param render     render the tile data is for, checked for cancellation between steps
+ *  @param pool       render context pool, or nil to create contexts for just this tile
+ *
+ *  @return tile data, or nil if none of the tables have anything at the tile or the render was cancelled
+ */
++(NSData *) tileDataFromGeoPackage: (GPKGGeoPackage *) geoPackage withName: (NSString *) name andTables: (NSArray<NSString *> *) tables andX: (int) x andY: (int) y andZoom: (int) zoom andRender: (GeoPackageTileRender *) render andPool: (GeoPackageRenderContextPool *) pool{
+    
+    NSData * tileData = nil;
+    BOOL (^cancelled)(void) = ^BOOL{
+        return render.isCancelled;
+    };
+    
+    for(NSString * table in tables){
+        
+        if(cancelled()){
+            break;
+        }
+        
+        GeoPackageRenderContext * context = nil;
+        if(pool != nil){
+            context = [pool checkOutContextForGeoPackage:geoPackage withName:name andTable:table];
+        }else{
+            context = [[GeoPackageRenderContext alloc] initWithGeoPackage:geoPackage andTable:table];
+        }
+        if(context != nil){
+            @try {
+                tileData = [context tileDataWithX:x andY:y andZoom:zoom andCancelled:cancelled];
+            }
+            @finally {
+                [pool checkInContext:context withName:name];
             }
+        }
+        
+        if(tileData != nil){
+            break;
+        }
+    }
+    
+    return tileData;
+}
+
+/**
+ *  Add the feature overlay queries that answer map clicks on a table
+ *
+ *  @param tableData  table map data
+ *  @param geoPackage GeoPackage
+ */
++(void) addFeatureOverlayQueriesToTableData: (GeoPackageTableMapData *) tableData withGeoPackage: (GPKGGeoPackage *) geoPackage{
+    
+    NSString * table = [tableData getName];
+    
+    if([geoPackage isTileTable:table]){
+        
+        GPKGTileDao * tileDao = [geoPackage getTileDaoWithTableName:table];
+        
+        // Check for linked feature tables
+        GPKGBoundedOverlay * geoPackageTileOverlay = [GPKGOverlayFactory getBoundedOverlay:tileDao];
+        GPKGFeatureTileTableLinker * linker = [[GPKGFeatureTileTableLinker alloc] initWithGeoPackage:geoPackage];
+        NSArray<GPKGFeatureDao *> * featureDaos = [linker getFeatureDaosForTileTable:tileDao.tableName];
+        for(GPKGFeatureDao * featureDao in featureDaos){
             
-            if([geoPackage isTileTable:table]){
+            // Create the feature tiles
+            GPKGFeatureTiles * featureTiles = [[GPKGFeatureTiles alloc] initWithFeatureDao:featureDao];
             
-                GPKGTileDao * tileDao = [geoPackage getTileDaoWithTableName:table];
-                
-                GPKGGeoPackageTileRetriever * retriever = [[GPKGGeoPackageTileRetriever alloc] initWithTileDao:tileDao];
-                if([retriever hasTileWithX:self.x andY:self.y andZoom:self.zoom]){
-                    GPKGGeoPackageTile * tile = [retriever getTileWithX:self.x andY:self.y andZoom:self.zoom];
-                    if(tile != nil){
-                        tileData = tile.data;
-                    }
-                }
-                
-                // If the first time handling this table
-                if(tableData != nil){
-                    // Check for linked feature tables
-                    GPKGBoundedOverlay * geoPackageTileOverlay = [GPKGOverlayFactory getBoundedOverlay:tileDao];
-                    GPKGFeatureTileTableLinker * linker = [[GPKGFeatureTileTableLinker alloc] initWithGeoPackage:geoPackage];
-                    NSArray<GPKGFeatureDao *> * featureDaos = [linker getFeatureDaosForTileTable:tileDao.tableName];
-                    for(GPKGFeatureDao * featureDao in featureDaos){
-                        
-                        // Create the feature tiles
-                        GPKGFeatureTiles * featureTiles = [[GPKGFeatureTiles alloc] initWithFeatureDao:featureDao];
-                        
-                        // Create an index manager
-                        GPKGFeatureIndexManager * indexer = [[GPKGFeatureIndexManager alloc] initWithGeoPackage:geoPackage andFeatureDao:featureDao];
-                        [featureTiles setIndexManager:indexer];
-                        
-                        // Add the feature overlay query
-                        GPKGFeatureOverlayQuery * featureOverlayQuery = [[GPKGFeatureOverlayQuery alloc] initWithBoundedOverlay:geoPackageTileOverlay andFeatureTiles:featureTiles];
-                        [tableData addFeatureOverlayQuery:featureOverlayQuery];
-                    }
-                }
-                
-            } else if([geoPackage isFeatureTable:table]){
+            // Create an index manager
+            GPKGFeatureIndexManager * indexer = [[GPKGFeatureIndexManager alloc] initWithGeoPackage:geoPackage andFeatureDao:featureDao];
+            [featureTiles setIndexManager:indexer];
+            
+            // Add the feature overlay query
+            GPKGFeatureOverlayQuery * featureOverlayQuery = [[GPKGFeatureOverlayQuery alloc] initWithBoundedOverlay:geoPackageTileOverlay andFeatureTiles:featureTiles];
+            [tableData addFeatureOverlayQuery:featureOverlayQuery];
+        }
+        
+    } else if([geoPackage isFeatureTable:table]){
+        
+        GPKGFeatureDao * featureDao = [geoPackage getFeatureDaoWithTableName:table];
+        GPKGFeatureTiles * featureTiles = [[GPKGFeatureTiles alloc] initWithFeatureDao:featureDao];
+        GPKGFeatureIndexManager * indexer = [[GPKGFeatureIndexManager alloc] initWithGeoPackage:geoPackage andFeatureDao:featureDao];
+        [featureTiles setIndexManager:indexer];
+        
+        if([featureTiles isIndexQuery]){
+            
+            GPKGFeatureOverlay * featureOverlay = [[GPKGFeatureOverlay alloc] initWithFeatureTiles:featureTiles];
+            [featureOverlay setMinZoom:[NSNumber numberWithInt:[featureDao getZoomLevel]]];
+            
+            GPKGFeatureTileTableLinker * linker = [[GPKGFeatureTileTableLinker alloc] initWithGeoPackage:geoPackage];
+            NSArray<GPKGTileDao *> * tileDaos = [linker getTileDaosForFeatureTable:featureDao.tableName];
+            [featureOverlay ignoreTileDaos:tileDaos];
+            
+            GPKGFeatureOverlayQuery * featureOverlayQuery = [[GPKGFeatureOverlayQuery alloc] initWithFeatureOverlay:featureOverlay];
+            [tableData addFeatureOverlayQuery:featureOverlayQuery];
+        }
+    }
+}
+
+/**
+ *  Get the path of the GeoPackage file for the request.  A shared GeoPackage that is not in this report is looked for in the other reports.
+ *
+ *  @param localPath request path relative to the documents directory
+ *  @param shared    true if a shared GeoPackage
+ *
+ *  @return GeoPackage file path
+ */
+-(NSString *) importPathWithLocalPath: (NSString *) localPath andShared: (BOOL) shared{
+    
+    NSString * importPath = self.path;
+    
+    // If a shared file, check if the file exists in this report or another
+    if(shared){
+        NSFileManager * fileManager = [NSFileManager defaultManager];
+        
+        // If the file is not in this report, search other reports
+        if(![fileManager fileExistsAtPath:importPath]){
+            
+            NSString * sharedSearchPath = [localPath substringFromIndex:[currentId length]];
+            
+            NSArray * reportDirectories = [ReportUtils getReportDirectories];
+            for(NSString * reportDirectory in reportDirectories){
                 
-                GPKGFeatureDao * featureDao = [geoPackage getFeatureDaoWithTableName:table];
-                GPKGFeatureTiles * featureTiles = [[GPKGFeatureTiles alloc] initWithFeatureDao:featureDao];
-                GPKGFeatureIndexManager * indexer = [[GPKGFeatureIndexManager alloc] initWithGeoPackage:geoPackage andFeatureDao:featureDao];
-                [featureTiles setIndexManager:indexer];
-                if([featureTiles isIndexQuery] && [featureTiles queryIndexedFeaturesCountWithX:self.x andY:self.y andZoom:self.zoom] > 0){
-                    tileData = [featureTiles drawTileDataWithX:self.x andY:self.y andZoom:self.zoom];
-                }
+                NSString * sharedLocation = [NSString stringWithFormat:@"%@%@", reportDirectory, sharedSearchPath];
                 
-                if(tableData != nil && [featureTiles isIndexQuery]){
-                    [featureTiles setIndexManager:indexer];
-
-                    GPKGFeatureOverlay * featureOverlay = [[GPKGFeatureOverlay alloc] initWithFeatureTiles:featureTiles];
-                    [featureOverlay setMinZoom:[NSNumber numberWithInt:[featureDao getZoomLevel]]];
-                    
-                    GPKGFeatureTileTableLinker * linker = [[GPKGFeatureTileTableLinker alloc] initWithGeoPackage:geoPackage];
-                    NSArray<GPKGTileDao *> * tileDaos = [linker getTileDaosForFeatureTable:featureDao.tableName];
-                    [featureOverlay ignoreTileDaos:tileDaos];
-                    
-                    GPKGFeatureOverlayQuery * featureOverlayQuery = [[GPKGFeatureOverlayQuery alloc] initWithFeatureOverlay:featureOverlay];
-                    [tableData addFeatureOverlayQuery:featureOverlayQuery];
+                if([fileManager fileExistsAtPath:sharedLocation]){
+                    importPath = sharedLocation;
+                    break;
                 }
             }
-         
-            if(tileData != nil){
-                break;
-            }
+            
         }
     }
     
+    return importPath;
+}
+
+/**
+ *  Check if the map data of all the tables has been created, which the first request for each table does
+ *
+ *  @param name   GeoPackage name
+ *  @param tables table names
+ *
+ *  @return true if all the tables have map data
+ */
++(BOOL) hasMapDataForGeoPackage: (NSString *) name andTables: (NSArray<NSString *> *) tables{
+    GeoPackageMapData * geoPackageData = [mapData objectForKey:name];
+    if(geoPackageData == nil){
+        return NO;
+    }
+    for(NSString * table in tables){
+        if([geoPackageData getTable:table] == nil){
+            return NO;
+        }
+    }
+    return YES;
+}
+
+/**
+ *  Answer the request with the tile, the only response it gets
+ *
+ *  @param tileData tile data, or nil when there is no tile
+ */
+-(void) respondWithTileData: (NSData *) tileData{
+    
+    // The client is done with the request once it has stopped loading or been answered
+    if(self.stopped){
+        return;
+    }
+    self.stopped = YES;
+    [self untrackRenderRequest];
+    
     NSURLResponse *response = [[NSURLResponse alloc] initWithURL:self.request.URL
-                                                        MIMEType:nil
+                                                        MIMEType:[GeoPackageTileReader mimeTypeOfTileData:tileData]
                                            expectedContentLength:tileData.length
                                                 textEncodingName:nil];
     
     [self.client URLProtocol:self didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageNotAllowed];
-    [self.client URLProtocol:self didLoadData:tileData];
+    if(tileData.length > 0){
+        [self.client URLProtocol:self didLoadData:tileData];
+    }
     [self.client URLProtocolDidFinishLoading:self];
-    
 }
 
 - (void)stopLoading {
-    [self.connection cancel];
-    self.connection = nil;
-}
-
-- (void)connection:(NSURLConnection *)connection didReceiveResponse:(NSURLResponse *)response {
-    [self.client URLProtocol:self didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageNotAllowed];
+    self.stopped = YES;
+    [self.renderRequest cancel];
+    [self untrackRenderRequest];
 }
 
-- (void)connection:(NSURLConnection *)connection didReceiveData:(NSData *)data {
-    [self.client URLProtocol:self didLoadData:data];
-}
-
-- (void)connectionDidFinishLoading:(NSURLConnection *)connection {
-    [self.client URLProtocolDidFinishLoading:self];
-}
-
-- (void)connection:(NSURLConnection *)connection didFailWithError:(NSError *)error {
-    [self.client URLProtocol:self didFailWithError:error];
+/**
+ *  Stop tracking the render request once the request has been answered or stopped
+ */
+-(void) untrackRenderRequest{
+    if(self.renderRequest != nil){
+        @synchronized([GeoPackageURLProtocol class]){
+            [renderRequests removeObject:self.renderRequest];
+        }
+        self.renderRequest = nil;
+    }
 }
 
 +(NSString *) reportIdPrefixWithReport: (NSString *) report{
@@ -0,0 +1,121 @@
+//
+//  ReportArchive.h
+//  DICE
+//
+
+#import <Foundation/Foundation.h>
+
+extern NSString * const ReportArchiveErrorDomain;
+
+/**
+ In the userInfo of a ReportArchiveErrorChecksum error, the names of the entries whose data did not match their CRC.
+ */
+extern NSString * const ReportArchiveCorruptEntriesKey;
+
+typedef NS_ENUM(NSInteger, ReportArchiveError) {
+    ReportArchiveErrorIO = 1,
+    ReportArchiveErrorFormat,
+    ReportArchiveErrorUnsupported,
+    ReportArchiveErrorUnsafePath,
+    ReportArchiveErrorCancelled,
+    ReportArchiveErrorChecksum,
+};
+
+/**
+ Update a zip CRC-32 with the given bytes, starting from 0.  Uses the ARMv8 CRC32
+ instructions when the CPU reports them at run time, and zlib's table-driven CRC otherwise.
+ */
+uint32_t ReportArchiveCRC32(uint32_t crc, const void *bytes, size_t length);
+
+/**
+ A single entry from a zip archive's central directory.
+ */
+@interface ReportArchiveEntry : NSObject
+
+@property (nonatomic, readonly) NSString *name;
+@property (nonatomic, readonly) NSUInteger index;
+@property (nonatomic, readonly) uint16_t method;
+@property (nonatomic, readonly) uint32_t crc32;
+@property (nonatomic, readonly) uint64_t compressedSize;
+@property (nonatomic, readonly) uint64_t uncompressedSize;
+@property (nonatomic, readonly) uint64_t localHeaderOffset;
+@property (nonatomic, readonly) BOOL isDirectory;
+
+@end
+
+
+/**
+ A read-only view of a zip archive.  The central directory is read once when the
+ archive is opened and kept as an array of ReportArchiveEntry objects, so callers
+ can look up, size, and extract entries in any order without walking the archive.
+ Reading is done with pread(2) against a single file descriptor, so one archive
+ can be read from many threads at once as long as each thread uses its own
+ ReportArchiveReader.
+ */
+@interface ReportArchive : NSObject
+
+@property (nonatomic, readonly) NSURL *fileURL;
+@property (nonatomic, readonly) NSArray<ReportArchiveEntry *> *entries;
+@property (nonatomic, readonly) uint64_t totalUncompressedSize;
+
++ (instancetype)archiveWithURL:(NSURL *)fileURL error:(NSError **)error;
+
+- (ReportArchiveEntry *)entryNamed:(NSString *)name;
+
+/**
+ Return the file offset of the entry's data, following its local file header.
+ */
+- (BOOL)dataOffsetForEntry:(ReportArchiveEntry *)entry offset:(uint64_t *)offset error:(NSError **)error;
+
+/**
+ Read bytes from the archive file at the given offset; safe to call concurrently.
+ */
+- (ssize_t)readBytes:(void *)buffer length:(size_t)length atOffset:(uint64_t)offset;
+
+/**
+ Return the path the entry should be extracted to under the given directory, or nil
+ if the entry name would escape the directory.
+ */
+- (NSString *)extractionPathForEntry:(ReportArchiveEntry *)entry inDirectory:(NSString *)directory;
++ (NSString *)extractionPathForName:(NSString *)name inDirectory:(NSString *)directory;
+
+- (void)close;
+
+@end
+
+
+/**
+ Streams the contents of archive entries.  A reader owns its own inflate state and
+ buffers, which are reused from entry to entry, and must only be used from one
+ thread at a time.
+ */
+@interface ReportArchiveReader : NSObject
+
+- (instancetype)initWithArchive:(ReportArchive *)archive;
+
+/**
+ Read the uncompressed contents of the entry, handing each chunk to the given block.
+ The bytes passed to the block are only valid for the duration of the call.  Return
+ NO from the block to stop reading.  Once the whole entry is read, its CRC is checked
+ against the central directory, and a mismatch fails with ReportArchiveErrorChecksum,
+ after the block has already seen the bad data.
+ */
+- (BOOL)readEntry:(ReportArchiveEntry *)entry toBlock:(BOOL(^)(const void *bytes, size_t length))block error:(NSError **)error;
+
+/**
+ Extract the entry to the given file path, replacing any existing file.  On failure, including
+ a CRC mismatch, the partly written file is removed.
+ */
+- (BOOL)extractEntry:(ReportArchiveEntry *)entry toPath:(NSString *)path error:(NSError **)error;
+
+/**
+ Extract the entry to the given file path, also handing each chunk written to the observer.
+ */
+- (BOOL)extractEntry:(ReportArchiveEntry *)entry toPath:(NSString *)path observer:(void(^)(const void *bytes, size_t length))observer error:(NSError **)error;
+
+/**
+ Read the whole uncompressed contents of the entry into memory.
+ */
+- (NSData *)dataForEntry:(ReportArchiveEntry *)entry error:(NSError **)error;
+
+@end
@@ -0,0 +1,620 @@
+//
+//  ReportArchive.m
+//  DICE
+//
+
+#import "ReportArchive.h"
+
+#import "zlib.h"
+#import <fcntl.h>
+#import <unistd.h>
+#if defined(__aarch64__)
+#import <sys/sysctl.h>
+#endif
+
+NSString * const ReportArchiveErrorDomain = @"DICE.ReportArchive";
+NSString * const ReportArchiveCorruptEntriesKey = @"corruptEntries";
+
+static const uint32_t kEndOfCentralDirectorySignature = 0x06054b50;
+static const uint32_t kCentralDirectorySignature = 0x02014b50;
+static const uint32_t kLocalFileHeaderSignature = 0x04034b50;
+static const uint32_t kZip64EndOfCentralDirectorySignature = 0x06064b50;
+static const uint32_t kZip64EndOfCentralDirectoryLocatorSignature = 0x07064b50;
+static const uint16_t kZip64ExtraFieldID = 0x0001;
+static const size_t kEndOfCentralDirectoryLength = 22;
+static const size_t kZip64EndOfCentralDirectoryLength = 56;
+static const size_t kZip64EndOfCentralDirectoryLocatorLength = 20;
+static const size_t kCentralDirectoryHeaderLength = 46;
+static const size_t kLocalFileHeaderLength = 30;
+static const size_t kMaxCommentLength = 0xffff;
+static const size_t kReaderBufferSize = 1 << 18;
+
+static inline uint16_t readUInt16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t readUInt32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t readUInt64(const uint8_t *p) {
+    return (uint64_t)readUInt32(p) | ((uint64_t)readUInt32(p + 4) << 32);
+}
+
+static uint32_t crc32Zlib(uint32_t crc, const uint8_t *p, size_t length)
+{
+    while (length > 0) {
+        uInt chunk = (uInt)MIN(length, (size_t)UINT32_MAX);
+        crc = (uint32_t)crc32(crc, p, chunk);
+        p += chunk;
+        length -= chunk;
+    }
+    return crc;
+}
+
+#if defined(__aarch64__)
+/*
+ * The CRC32 instructions are optional before ARMv8.1, and the app is not built for a CPU that is sure
+ * to have them, so this is compiled for them on its own and only called once the CPU says it has them.
+ * CRC32X takes 8 bytes a cycle or so, well ahead of inflate and the disk.
+ */
+__attribute__((target("crc")))
+static uint32_t crc32Hardware(uint32_t crc, const uint8_t *p, size_t length)
+{
+    crc = ~crc;
+    while (length > 0 && ((uintptr_t)p & 7)) {
+        crc = __builtin_arm_crc32b(crc, *p++);
+        length--;
+    }
+    for (; length >= 8; p += 8, length -= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        crc = __builtin_arm_crc32d(crc, word);
+    }
+    while (length > 0) {
+        crc = __builtin_arm_crc32b(crc, *p++);
+        length--;
+    }
+    return ~crc;
+}
+#endif
+
+uint32_t ReportArchiveCRC32(uint32_t crc, const void *bytes, size_t length)
+{
+    static uint32_t (*kernel)(uint32_t, const uint8_t *, size_t);
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        kernel = crc32Zlib;
+#if defined(__aarch64__)
+        int hasCRC32 = 0;
+        size_t size = sizeof(hasCRC32);
+        if (sysctlbyname("hw.optional.armv8_crc32", &hasCRC32, &size, NULL, 0) == 0 && hasCRC32) {
+            kernel = crc32Hardware;
+        }
+#endif
+    });
+    return kernel(crc, bytes, length);
+}
+
+static NSError *archiveError(ReportArchiveError code, NSString *format, ...) NS_FORMAT_FUNCTION(2,3);
+static NSError *archiveError(ReportArchiveError code, NSString *format, ...) {
+    va_list args;
+    va_start(args, format);
+    NSString *description = [[NSString alloc] initWithFormat:format arguments:args];
+    va_end(args);
+    return [NSError errorWithDomain:ReportArchiveErrorDomain code:code userInfo:@{NSLocalizedDescriptionKey: description}];
+}
+
+
+@interface ReportArchiveEntry ()
+
+@property (nonatomic, readwrite) NSString *name;
+@property (nonatomic, readwrite) NSUInteger index;
+@property (nonatomic, readwrite) uint16_t flags;
+@property (nonatomic, readwrite) uint16_t method;
+@property (nonatomic, readwrite) uint32_t crc32;
+@property (nonatomic, readwrite) uint64_t compressedSize;
+@property (nonatomic, readwrite) uint64_t uncompressedSize;
+@property (nonatomic, readwrite) uint64_t localHeaderOffset;
+@property (nonatomic, readwrite) BOOL isDirectory;
+
+@end
+
+@implementation ReportArchiveEntry
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<ReportArchiveEntry %@ method=%u size=%llu>", self.name, self.method, self.uncompressedSize];
+}
+
+@end
+
+
+@implementation ReportArchive
+{
+    int fd;
+    NSDictionary<NSString *, ReportArchiveEntry *> *entriesByName;
+}
+
++ (instancetype)archiveWithURL:(NSURL *)fileURL error:(NSError **)error
+{
+    ReportArchive *archive = [[ReportArchive alloc] initWithURL:fileURL];
+    if (![archive open:error]) {
+        return nil;
+    }
+    return archive;
+}
+
+- (instancetype)initWithURL:(NSURL *)fileURL
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _fileURL = fileURL;
+    fd = -1;
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [self close];
+}
+
+- (void)close
+{
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+- (BOOL)open:(NSError **)error
+{
+    fd = open(self.fileURL.path.fileSystemRepresentation, O_RDONLY);
+    if (fd < 0) {
+        if (error) {
+            *error = archiveError(ReportArchiveErrorIO, @"could not open %@: %s", self.fileURL.path, strerror(errno));
+        }
+        return NO;
+    }
+
+    off_t fileLength = lseek(fd, 0, SEEK_END);
+    if (fileLength < (off_t)kEndOfCentralDirectoryLength) {
+        if (error) {
+            *error = archiveError(ReportArchiveErrorFormat, @"%@ is too small to be a zip file", self.fileURL.lastPathComponent);
+        }
+        return NO;
+    }
+
+    // the end of central directory record is at the end of the file, followed by an optional comment
+    size_t tailLength = (size_t)MIN((off_t)(kEndOfCentralDirectoryLength + kMaxCommentLength), fileLength);
+    NSMutableData *tail = [NSMutableData dataWithLength:tailLength];
+    if ([self readBytes:tail.mutableBytes length:tailLength atOffset:(uint64_t)(fileLength - tailLength)] != (ssize_t)tailLength) {
+        if (error) {
+            *error = archiveError(ReportArchiveErrorIO, @"could not read the end of %@", self.fileURL.lastPathComponent);
+        }
+        return NO;
+    }
+
+    const uint8_t *bytes = tail.bytes;
+    const uint8_t *eocd = NULL;
+    for (const uint8_t *p = bytes + tailLength - kEndOfCentralDirectoryLength; p >= bytes; p--) {
+        if (readUInt32(p) == kEndOfCentralDirectorySignature) {
+            eocd = p;
+            break;
+        }
+    }
+    if (!eocd) {
+        if (error) {
+            *error = archiveError(ReportArchiveErrorFormat, @"%@ has no zip central directory", self.fileURL.lastPathComponent);
+        }
+        return NO;
+    }
+
+    uint64_t entryCount = readUInt16(eocd + 10);
+    uint64_t directoryLength = readUInt32(eocd + 12);
+    uint64_t directoryOffset = readUInt32(eocd + 16);
+
+    // a Zip64 archive, with more than 65535 entries or past 4 GB, has the real counts in a Zip64 end of
+    // central directory record, found through a locator just before the classic one
+    uint64_t eocdOffset = (uint64_t)(fileLength - tailLength) + (uint64_t)(eocd - bytes);
+    uint8_t locator[kZip64EndOfCentralDirectoryLocatorLength];
+    if (eocdOffset >= kZip64EndOfCentralDirectoryLocatorLength
+        && [self readBytes:locator length:sizeof(locator) atOffset:eocdOffset - sizeof(locator)] == (ssize_t)sizeof(locator)
+        && readUInt32(locator) == kZip64EndOfCentralDirectoryLocatorSignature) {
+        uint8_t zip64End[kZip64EndOfCentralDirectoryLength];
+        uint64_t zip64EndOffset = readUInt64(locator + 8);
+        if ([self readBytes:zip64End length:sizeof(zip64End) atOffset:zip64EndOffset] != (ssize_t)sizeof(zip64End)
+            || readUInt32(zip64End) != kZip64EndOfCentralDirectorySignature) {
+            if (error) {
+                *error = archiveError(ReportArchiveErrorFormat, @"%@ has a bad Zip64 end of central directory", self.fileURL.lastPathComponent);
+            }
+            return NO;
+        }
+        entryCount = readUInt64(zip64End + 32);
+        directoryLength = readUInt64(zip64End + 40);
+        directoryOffset = readUInt64(zip64End + 48);
+    }
+
+    if (directoryOffset > (uint64_t)fileLength || directoryLength > (uint64_t)fileLength - directoryOffset
+        || entryCount > directoryLength / kCentralDirectoryHeaderLength) {
+        if (error) {
+            *error = archiveError(ReportArchiveErrorFormat, @"%@ has a truncated central directory", self.fileURL.lastPathComponent);
+        }
+        return NO;
+    }
+
+    NSMutableData *directory = [NSMutableData dataWithLength:(NSUInteger)directoryLength];
+    if ([self readBytes:directory.mutableBytes length:(size_t)directoryLength atOffset:directoryOffset] != (ssize_t)directoryLength) {
+        if (error) {
+            *error = archiveError(ReportArchiveErrorIO, @"could not read the central directory of %@", self.fileURL.lastPathComponent);
+        }
+        return NO;
+    }
+
+    return [self parseCentralDirectory:directory entryCount:entryCount error:error];
+}
+
+- (BOOL)parseCentralDirectory:(NSData *)directory entryCount:(uint64_t)entryCount error:(NSError **)error
+{
+    NSMutableArray<ReportArchiveEntry *> *entries = [NSMutableArray arrayWithCapacity:(NSUInteger)entryCount];
+    NSMutableDictionary<NSString *, ReportArchiveEntry *> *byName = [NSMutableDictionary dictionaryWithCapacity:(NSUInteger)entryCount];
+    const uint8_t *p = directory.bytes;
+    const uint8_t *end = p + directory.length;
+    uint64_t totalSize = 0;
+
+    for (uint64_t i = 0; i < entryCount; i++) {
+        if (p + kCentralDirectoryHeaderLength > end || readUInt32(p) != kCentralDirectorySignature) {
+            if (error) {
+                *error = archiveError(ReportArchiveErrorFormat, @"bad central directory header for entry %llu in %@", i, self.fileURL.lastPathComponent);
+            }
+            return NO;
+        }
+
+        uint16_t nameLength = readUInt16(p + 28);
+        uint16_t extraLength = readUInt16(p + 30);
+        uint16_t commentLength = readUInt16(p + 32);
+        const uint8_t *next = p + kCentralDirectoryHeaderLength + nameLength + extraLength + commentLength;
+        if (next > end) {
+            if (error) {
+                *error = archiveError(ReportArchiveErrorFormat, @"truncated central directory entry %llu in %@", i, self.fileURL.lastPathComponent);
+            }
+            return NO;
+        }
+
+        ReportArchiveEntry *entry = [[ReportArchiveEntry alloc] init];
+        entry.index = (NSUInteger)i;
+        entry.flags = readUInt16(p + 8);
+        entry.method = readUInt16(p + 10);
+        entry.crc32 = readUInt32(p + 16);
+        entry.compressedSize = readUInt32(p + 20);
+        entry.uncompressedSize = readUInt32(p + 24);
+        entry.localHeaderOffset = readUInt32(p + 42);
+        if (![self readZip64ExtraField:p + kCentralDirectoryHeaderLength + nameLength length:extraLength intoEntry:entry]) {
+            if (error) {
+                *error = archiveError(ReportArchiveErrorFormat, @"bad Zip64 extra field for entry %llu in %@", i, self.fileURL.lastPathComponent);
+            }
+            return NO;
+        }
+
+        // most tools write UTF-8 names whether or not they set bit 11; fall back to Latin-1 for old CP437 names
+        const void *nameBytes = p + kCentralDirectoryHeaderLength;
+        NSString *name = [[NSString alloc] initWithBytes:nameBytes length:nameLength encoding:NSUTF8StringEncoding];
+        if (!name) {
+            name = [[NSString alloc] initWithBytes:nameBytes length:nameLength encoding:NSISOLatin1StringEncoding];
+        }
+        entry.name = name;
+        entry.isDirectory = [name hasSuffix:@"/"];
+
+        [entries addObject:entry];
+        byName[name] = entry;
+        totalSize += entry.uncompressedSize;
+        p = next;
+    }
+
+    _entries = entries;
+    _totalUncompressedSize = totalSize;
+    entriesByName = byName;
+
+    return YES;
+}
+
+/*
+ * Sizes and offsets too big for the central directory header are 0xffffffff there, with the real
+ * values in the Zip64 extra field, in header order, for only the fields that overflowed.
+ */
+- (BOOL)readZip64ExtraField:(const uint8_t *)extra length:(uint16_t)length intoEntry:(ReportArchiveEntry *)entry
+{
+    BOOL needsUncompressed = entry.uncompressedSize == 0xffffffff;
+    BOOL needsCompressed = entry.compressedSize == 0xffffffff;
+    BOOL needsOffset = entry.localHeaderOffset == 0xffffffff;
+    if (!needsUncompressed && !needsCompressed && !needsOffset) {
+        return YES;
+    }
+
+    for (size_t i = 0; i + 4 <= length; i += 4 + readUInt16(extra + i + 2)) {
+        uint16_t fieldLength = readUInt16(extra + i + 2);
+        if (readUInt16(extra + i) != kZip64ExtraFieldID || i + 4 + fieldLength > length) {
+            continue;
+        }
+        const uint8_t *value = extra + i + 4;
+        const uint8_t *end = value + fieldLength;
+        if (needsUncompressed) {
+            if (value + 8 > end) {
+                return NO;
+            }
+            entry.uncompressedSize = readUInt64(value);
+            value += 8;
+        }
+        if (needsCompressed) {
+            if (value + 8 > end) {
+                return NO;
+            }
+            entry.compressedSize = readUInt64(value);
+            value += 8;
+        }
+        if (needsOffset) {
+            if (value + 8 > end) {
+                return NO;
+            }
+            entry.localHeaderOffset = readUInt64(value);
+        }
+        return YES;
+    }
+    return NO;
+}
+
+- (ReportArchiveEntry *)entryNamed:(NSString *)name
+{
+    return entriesByName[name];
+}
+
+- (ssize_t)readBytes:(void *)buffer length:(size_t)length atOffset:(uint64_t)offset
+{
+    size_t total = 0;
+    while (total < length) {
+        ssize_t count = pread(fd, (uint8_t *)buffer + total, length - total, (off_t)(offset + total));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return count < 0 ? count : (ssize_t)total;
+        }
+        total += (size_t)count;
+    }
+    return (ssize_t)total;
+}
+
+- (BOOL)dataOffsetForEntry:(ReportArchiveEntry *)entry offset:(uint64_t *)offset error:(NSError **)error
+{
+    uint8_t header[kLocalFileHeaderLength];
+    if ([self readBytes:header length:kLocalFileHeaderLength atOffset:entry.localHeaderOffset] != (ssize_t)kLocalFileHeaderLength
+        || readUInt32(header) != kLocalFileHeaderSignature) {
+        if (error) {
+            *error = archiveError(ReportArchiveErrorFormat, @"bad local header for %@ in %@", entry.name, self.fileURL.lastPathComponent);
+        }
+        return NO;
+    }
+    // the local extra field can differ from the central directory's, so its length must come from here
+    *offset = entry.localHeaderOffset + kLocalFileHeaderLength + readUInt16(header + 26) + readUInt16(header + 28);
+    return YES;
+}
+
+- (NSString *)extractionPathForEntry:(ReportArchiveEntry *)entry inDirectory:(NSString *)directory
+{
+    return [ReportArchive extractionPathForName:entry.name inDirectory:directory];
+}
+
++ (NSString *)extractionPathForName:(NSString *)name inDirectory:(NSString *)directory
+{
+    if (name.length == 0 || [name hasPrefix:@"/"]) {
+        return nil;
+    }
+    for (NSString *component in [name componentsSeparatedByString:@"/"]) {
+        if ([component isEqualToString:@".."]) {
+            return nil;
+        }
+    }
+    return [directory stringByAppendingPathComponent:name];
+}
+
+@end
+
+
+@implementation ReportArchiveReader
+{
+    ReportArchive *archive;
+    z_stream stream;
+    BOOL streamReady;
+    uint8_t *inBuffer;
+    uint8_t *outBuffer;
+}
+
+- (instancetype)initWithArchive:(ReportArchive *)anArchive
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    archive = anArchive;
+    inBuffer = malloc(kReaderBufferSize);
+    outBuffer = malloc(kReaderBufferSize);
+    memset(&stream, 0, sizeof(stream));
+    // raw deflate, no zlib header
+    streamReady = (inflateInit2(&stream, -MAX_WBITS) == Z_OK);
+
+    return self;
+}
+
+- (void)dealloc
+{
+    if (streamReady) {
+        inflateEnd(&stream);
+    }
+    free(inBuffer);
+    free(outBuffer);
+}
+
+- (BOOL)readEntry:(ReportArchiveEntry *)entry toBlock:(BOOL(^)(const void *bytes, size_t length))block error:(NSError **)error
+{
+    if (entry.flags & 1) {
+        if (error) {
+            *error = archiveError(ReportArchiveErrorUnsupported, @"%@ is encrypted", entry.name);
+        }
+        return NO;
+    }
+    if (entry.method != Z_NO_COMPRESSION && entry.method != Z_DEFLATED) {
+        if (error) {
+            *error = archiveError(ReportArchiveErrorUnsupported, @"%@ uses unsupported compression method %u", entry.name, entry.method);
+        }
+        return NO;
+    }
+
+    uint64_t offset;
+    if (![archive dataOffsetForEntry:entry offset:&offset error:error]) {
+        return NO;
+    }
+
+    uint64_t remaining = entry.compressedSize;
+    uint64_t produced = 0;
+    uint32_t crc = 0;
+    BOOL inflating = (entry.method == Z_DEFLATED);
+    if (inflating) {
+        if (!streamReady || inflateReset(&stream) != Z_OK) {
+            if (error) {
+                *error = archiveError(ReportArchiveErrorIO, @"could not initialize inflate for %@", entry.name);
+            }
+            return NO;
+        }
+    }
+
+    int status = Z_OK;
+    while (remaining > 0 && status != Z_STREAM_END) {
+        size_t chunk = (size_t)MIN(remaining, (uint64_t)kReaderBufferSize);
+        if ([archive readBytes:inBuffer length:chunk atOffset:offset] != (ssize_t)chunk) {
+            if (error) {
+                *error = archiveError(ReportArchiveErrorIO, @"unexpected end of data reading %@", entry.name);
+            }
+            return NO;
+        }
+        offset += chunk;
+        remaining -= chunk;
+
+        if (!inflating) {
+            produced += chunk;
+            crc = ReportArchiveCRC32(crc, inBuffer, chunk);
+            if (!block(inBuffer, chunk)) {
+                return YES;
+            }
+            continue;
+        }
+
+        stream.next_in = inBuffer;
+        stream.avail_in = (uInt)chunk;
+        do {
+            stream.next_out = outBuffer;
+            stream.avail_out = (uInt)kReaderBufferSize;
+            status = inflate(&stream, Z_NO_FLUSH);
+            // the last call filled the output buffer just as it used up the input, so there was nothing to do
+            if (status == Z_BUF_ERROR && stream.avail_in == 0) {
+                status = Z_OK;
+            }
+            else if (status != Z_OK && status != Z_STREAM_END) {
+                if (error) {
+                    *error = archiveError(ReportArchiveErrorFormat, @"corrupt deflate data in %@ (%d)", entry.name, status);
+                }
+                return NO;
+            }
+            size_t have = kReaderBufferSize - stream.avail_out;
+            produced += have;
+            crc = ReportArchiveCRC32(crc, outBuffer, have);
+            if (have > 0 && !block(outBuffer, have)) {
+                return YES;
+            }
+        } while (stream.avail_out == 0 && status != Z_STREAM_END);
+    }
+
+    if (produced != entry.uncompressedSize) {
+        if (error) {
+            *error = archiveError(ReportArchiveErrorFormat, @"%@ produced %llu bytes, expected %llu", entry.name, produced, entry.uncompressedSize);
+        }
+        return NO;
+    }
+    if (crc != entry.crc32) {
+        if (error) {
+            *error = archiveError(ReportArchiveErrorChecksum, @"%@ is corrupt: CRC %08x, expected %08x", entry.name, crc, entry.crc32);
+        }
+        return NO;
+    }
+
+    return YES;
+}
+
+- (BOOL)extractEntry:(ReportArchiveEntry *)entry toPath:(NSString *)path error:(NSError **)error
+{
+    return [self extractEntry:entry toPath:path observer:nil error:error];
+}
+
+- (BOOL)extractEntry:(ReportArchiveEntry *)entry toPath:(NSString *)path observer:(void(^)(const void *bytes, size_t length))observer error:(NSError **)error
+{
+    // never write through an existing file; it may be a hard link shared with other reports
+    unlink(path.fileSystemRepresentation);
+    int out = open(path.fileSystemRepresentation, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) {
+        if (error) {
+            *error = archiveError(ReportArchiveErrorIO, @"could not create %@: %s", path, strerror(errno));
+        }
+        return NO;
+    }
+
+    __block int writeErrno = 0;
+    BOOL success = [self readEntry:entry toBlock:^BOOL(const void *bytes, size_t length) {
+        if (observer) {
+            observer(bytes, length);
+        }
+        const uint8_t *p = bytes;
+        while (length > 0) {
+            ssize_t written = write(out, p, length);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                writeErrno = errno;
+                return NO;
+            }
+            p += written;
+            length -= (size_t)written;
+        }
+        return YES;
+    } error:error];
+
+    close(out);
+
+    if (writeErrno) {
+        if (error) {
+            *error = archiveError(ReportArchiveErrorIO, @"could not write %@: %s", path, strerror(writeErrno));
+        }
+        success = NO;
+    }
+    if (!success) {
+        unlink(path.fileSystemRepresentation);
+    }
+
+    return success;
+}
+
+- (NSData *)dataForEntry:(ReportArchiveEntry *)entry error:(NSError **)error
+{
+    NSMutableData *data = [NSMutableData dataWithCapacity:(NSUInteger)entry.uncompressedSize];
+    BOOL success = [self readEntry:entry toBlock:^BOOL(const void *bytes, size_t length) {
+        [data appendBytes:bytes length:length];
+        return YES;
+    } error:error];
+    return success ? data : nil;
+}
+
+@end
@@ -0,0 +1,87 @@
+//
+//  ReportContentStore.h
+//  DICE
+//
+
+#import <Foundation/Foundation.h>
+#import "ReportArchive.h"
+
+/**
+ A content-addressed store of extracted report files.  Each file is written once as a
+ blob named by the SHA-256 of its contents, and every report that contains the same
+ bytes gets a hard link to that blob, so shared Leaflet builds and tile sets only
+ take up space once.  A blob's link count is its reference count: when it drops to
+ one, only the store holds it and it can be freed.  Blobs are read only,
+ since writing through one link would change the file in every report that shares it.
+ GeoPackages and other SQLite databases are opened for writing, so they are not stored,
+ and each report gets its own copy.
+
+ The store also keeps a manifest per report, keyed by the report's source file name,
+ that maps entry names to blob hashes, along with a fingerprint of the report's zip
+ central directory so importing the same report under another name is detected
+ before anything is extracted.
+ */
+@interface ReportContentStore : NSObject
+
+@property (nonatomic, readonly) NSString *directory;
+
++ (instancetype)sharedStore;
+
+- (instancetype)initWithDirectory:(NSString *)directory;
+
+/**
+ A hash of the names, sizes, and CRCs of every entry in the archive, ignoring the
+ name of the report's top level directory.
+ */
++ (NSString *)fingerprintForArchive:(ReportArchive *)archive;
+
+/**
+ Return the key of a stored report with the given fingerprint, or nil.
+ */
+- (NSString *)reportWithFingerprint:(NSString *)fingerprint;
+
+/**
+ NO for entries that are written to in place, which have to be extracted as the report's own files.
+ */
++ (BOOL)canShareEntry:(ReportArchiveEntry *)entry;
+
+/**
+ Extract the entry into the store and hard link it at the given path, returning the
+ hash of the entry's contents.  Only for entries that canShareEntry:.  Safe to call
+ from several threads at once.
+ */
+- (NSString *)storeEntry:(ReportArchiveEntry *)entry withReader:(ReportArchiveReader *)reader toPath:(NSString *)path error:(NSError **)error;
+
+/**
+ Move a file that is already extracted, e.g., streamed in by a download, into the store and
+ hard link it back in place, returning the hash of its contents.  Only for the files of entries
+ that canShareEntry:.  Returns nil if the file could not be stored, in which case it is left as
+ the report's own copy unless the error says it could not be put back.
+ */
+- (NSString *)storeFileAtPath:(NSString *)path error:(NSError **)error;
+
+/**
+ Populate the directory with the archive's entries by linking the blobs of a stored
+ report with the same fingerprint, without inflating anything.  Returns the entry
+ hashes for the new report, or nil if any blob is missing, or an entry can not be
+ shared, and the archive must be extracted instead.
+ */
+- (NSDictionary<NSString *, NSString *> *)linkArchive:(ReportArchive *)archive toContentOfReport:(NSString *)reportKey inDirectory:(NSString *)directory;
+
+- (void)saveManifestForReport:(NSString *)reportKey fingerprint:(NSString *)fingerprint entryHashes:(NSDictionary<NSString *, NSString *> *)entryHashes;
+
+- (NSDictionary<NSString *, NSString *> *)entryHashesForReport:(NSString *)reportKey;
+
+/**
+ Free the blobs with the given hashes that are no longer linked from any report,
+ returning how many were freed.
+ */
+- (NSUInteger)releaseHashes:(NSSet<NSString *> *)hashes;
+
+/**
+ Forget the report's manifest and free the blobs no other report links to.  Call this
+ after the report's own files have been removed.
+ */
+- (void)removeReport:(NSString *)reportKey;
+
+@end
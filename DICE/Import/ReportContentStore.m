@@ -0,0 +1,319 @@
+//
+//  ReportContentStore.m
+//  DICE
+//
+
+#import "ReportContentStore.h"
+
+#import "GPKGGeoPackageValidate.h"
+#import <CommonCrypto/CommonDigest.h>
+#import <sys/stat.h>
+#import <unistd.h>
+
+static NSString *hexString(const unsigned char *bytes, size_t length) {
+    static const char digits[] = "0123456789abcdef";
+    char hex[length * 2 + 1];
+    for (size_t i = 0; i < length; i++) {
+        hex[i * 2] = digits[bytes[i] >> 4];
+        hex[i * 2 + 1] = digits[bytes[i] & 0xf];
+    }
+    hex[length * 2] = '\0';
+    return [NSString stringWithUTF8String:hex];
+}
+
+@implementation ReportContentStore
+{
+    NSString *blobDirectory;
+    NSString *manifestDirectory;
+    NSString *tempDirectory;
+    NSString *fingerprintIndexPath;
+    NSMutableDictionary<NSString *, NSString *> *fingerprintIndex;
+}
+
++ (instancetype)sharedStore
+{
+    static ReportContentStore *_sharedStore = nil;
+    static dispatch_once_t oncePredicate;
+    dispatch_once(&oncePredicate, ^{
+        NSURL *supportDir = [[NSFileManager defaultManager] URLForDirectory:NSApplicationSupportDirectory inDomain:NSUserDomainMask appropriateForURL:nil create:YES error:nil];
+        _sharedStore = [[ReportContentStore alloc] initWithDirectory:[supportDir.path stringByAppendingPathComponent:@"ReportContent"]];
+    });
+    return _sharedStore;
+}
+
+- (instancetype)initWithDirectory:(NSString *)directory
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _directory = directory;
+    blobDirectory = [directory stringByAppendingPathComponent:@"blobs"];
+    manifestDirectory = [directory stringByAppendingPathComponent:@"manifests"];
+    tempDirectory = [directory stringByAppendingPathComponent:@"tmp"];
+    fingerprintIndexPath = [directory stringByAppendingPathComponent:@"fingerprints.plist"];
+
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    for (NSString *path in @[blobDirectory, manifestDirectory, tempDirectory]) {
+        [fileManager createDirectoryAtPath:path withIntermediateDirectories:YES attributes:nil error:nil];
+    }
+    // anything left in tmp is from an import that did not finish
+    for (NSString *leftover in [fileManager contentsOfDirectoryAtPath:tempDirectory error:nil]) {
+        [fileManager removeItemAtPath:[tempDirectory stringByAppendingPathComponent:leftover] error:nil];
+    }
+
+    fingerprintIndex = [NSMutableDictionary dictionaryWithContentsOfFile:fingerprintIndexPath];
+    if (!fingerprintIndex) {
+        fingerprintIndex = [[NSMutableDictionary alloc] init];
+    }
+
+    return self;
+}
+
+/*
+ * Reports keep their content under a top level directory named after the report, so
+ * compare entries without it to recognize the same report shipped under another name.
+ */
+static NSString *contentRelativeName(NSString *name) {
+    NSRange slash = [name rangeOfString:@"/"];
+    return slash.location == NSNotFound ? name : [name substringFromIndex:slash.location + 1];
+}
+
++ (NSString *)fingerprintForArchive:(ReportArchive *)archive
+{
+    CC_SHA256_CTX context;
+    CC_SHA256_Init(&context);
+    for (ReportArchiveEntry *entry in archive.entries) {
+        NSData *name = [contentRelativeName(entry.name) dataUsingEncoding:NSUTF8StringEncoding];
+        uint64_t size = entry.uncompressedSize;
+        uint32_t crc = entry.crc32;
+        CC_SHA256_Update(&context, name.bytes, (CC_LONG)name.length);
+        CC_SHA256_Update(&context, &size, sizeof(size));
+        CC_SHA256_Update(&context, &crc, sizeof(crc));
+    }
+    unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256_Final(digest, &context);
+    return hexString(digest, sizeof(digest));
+}
+
+- (NSString *)reportWithFingerprint:(NSString *)fingerprint
+{
+    @synchronized (fingerprintIndex) {
+        return fingerprintIndex[fingerprint];
+    }
+}
+
+- (NSString *)blobPathForHash:(NSString *)hash
+{
+    return [[blobDirectory stringByAppendingPathComponent:[hash substringToIndex:2]] stringByAppendingPathComponent:hash];
+}
+
+- (NSString *)manifestPathForReport:(NSString *)reportKey
+{
+    return [manifestDirectory stringByAppendingPathComponent:[reportKey stringByAppendingPathExtension:@"plist"]];
+}
+
++ (BOOL)canShareEntry:(ReportArchiveEntry *)entry
+{
+    if (entry.isDirectory) {
+        return NO;
+    }
+    // SQLite opens databases read-write, and GeoPackages get indexes and extensions added to them
+    NSString *extension = entry.name.pathExtension.lowercaseString;
+    return ![GPKGGeoPackageValidate hasGeoPackageExtension:entry.name]
+        && ![@[@"sqlite", @"sqlite3", @"db"] containsObject:extension];
+}
+
+- (NSString *)storeEntry:(ReportArchiveEntry *)entry withReader:(ReportArchiveReader *)reader toPath:(NSString *)path error:(NSError **)error
+{
+    NSString *tempPath = [tempDirectory stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    __block CC_SHA256_CTX context;
+    CC_SHA256_Init(&context);
+
+    BOOL extracted = [reader extractEntry:entry toPath:tempPath observer:^(const void *bytes, size_t length) {
+        CC_SHA256_Update(&context, bytes, (CC_LONG)length);
+    } error:error];
+    if (!extracted) {
+        unlink(tempPath.fileSystemRepresentation);
+        return nil;
+    }
+
+    unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256_Final(digest, &context);
+    NSString *hash = hexString(digest, sizeof(digest));
+    return [self placeFile:tempPath withHash:hash atPath:path name:entry.name error:error] ? hash : nil;
+}
+
+- (NSString *)storeFileAtPath:(NSString *)path error:(NSError **)error
+{
+    NSData *data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:error];
+    if (!data) {
+        return nil;
+    }
+    CC_SHA256_CTX context;
+    CC_SHA256_Init(&context);
+    const uint8_t *bytes = data.bytes;
+    for (NSUInteger offset = 0; offset < data.length; offset += (1 << 20)) {
+        CC_SHA256_Update(&context, bytes + offset, (CC_LONG)MIN((NSUInteger)(1 << 20), data.length - offset));
+    }
+    unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256_Final(digest, &context);
+    NSString *hash = hexString(digest, sizeof(digest));
+
+    NSString *tempPath = [tempDirectory stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    if (rename(path.fileSystemRepresentation, tempPath.fileSystemRepresentation) != 0) {
+        // on another volume, so leave the file as the report's own copy
+        return nil;
+    }
+    return [self placeFile:tempPath withHash:hash atPath:path name:path.lastPathComponent error:error] ? hash : nil;
+}
+
+/*
+ * Make the file in the store's temp directory the blob with the given hash, unless there already is
+ * one, and link the blob at the path.  If it can not be linked, the file is moved to the path instead.
+ */
+- (BOOL)placeFile:(NSString *)tempPath withHash:(NSString *)hash atPath:(NSString *)path name:(NSString *)name error:(NSError **)error
+{
+    NSString *blobPath = [self blobPathForHash:hash];
+    mkdir([blobPath stringByDeletingLastPathComponent].fileSystemRepresentation, 0755);
+    unlink(path.fileSystemRepresentation);
+    chmod(tempPath.fileSystemRepresentation, 0444);
+
+    /*
+     link(2) fails with EEXIST rather than replacing an existing blob, so when two imports
+     store the same content at once, both end up linked to whichever blob landed first.
+     The blob can disappear between the two links if its last report is being removed,
+     so try again in that case.
+     */
+    BOOL linked = NO;
+    for (int attempt = 0; attempt < 3 && !linked; attempt++) {
+        if (link(tempPath.fileSystemRepresentation, blobPath.fileSystemRepresentation) != 0) {
+            if (errno != EEXIST) {
+                break;
+            }
+            // stored before blobs were read only
+            chmod(blobPath.fileSystemRepresentation, 0444);
+        }
+        linked = (link(blobPath.fileSystemRepresentation, path.fileSystemRepresentation) == 0);
+    }
+
+    if (linked) {
+        unlink(tempPath.fileSystemRepresentation);
+    }
+    else {
+        // could not share the file, so at least put the report's own copy in place
+        chmod(tempPath.fileSystemRepresentation, 0644);
+        if (rename(tempPath.fileSystemRepresentation, path.fileSystemRepresentation) != 0) {
+            if (error) {
+                *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno
+                    userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"could not move %@ into place: %s", name, strerror(errno)]}];
+            }
+            unlink(tempPath.fileSystemRepresentation);
+            return NO;
+        }
+    }
+
+    return YES;
+}
+
+- (NSDictionary<NSString *, NSString *> *)linkArchive:(ReportArchive *)archive toContentOfReport:(NSString *)reportKey inDirectory:(NSString *)directory
+{
+    NSDictionary<NSString *, NSString *> *storedHashes = [self entryHashesForReport:reportKey];
+    if (!storedHashes) {
+        return nil;
+    }
+    NSMutableDictionary<NSString *, NSString *> *hashesByContentName = [NSMutableDictionary dictionaryWithCapacity:storedHashes.count];
+    [storedHashes enumerateKeysAndObjectsUsingBlock:^(NSString *name, NSString *hash, BOOL *stop) {
+        hashesByContentName[contentRelativeName(name)] = hash;
+    }];
+
+    for (ReportArchiveEntry *entry in archive.entries) {
+        if (!entry.isDirectory && ![ReportContentStore canShareEntry:entry]) {
+            return nil;
+        }
+    }
+
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSMutableDictionary<NSString *, NSString *> *entryHashes = [NSMutableDictionary dictionaryWithCapacity:archive.entries.count];
+    for (ReportArchiveEntry *entry in archive.entries) {
+        NSString *path = [archive extractionPathForEntry:entry inDirectory:directory];
+        if (!path) {
+            return nil;
+        }
+        if (entry.isDirectory) {
+            [fileManager createDirectoryAtPath:path withIntermediateDirectories:YES attributes:nil error:nil];
+            continue;
+        }
+        NSString *hash = hashesByContentName[contentRelativeName(entry.name)];
+        if (!hash) {
+            return nil;
+        }
+        [fileManager createDirectoryAtPath:[path stringByDeletingLastPathComponent] withIntermediateDirectories:YES attributes:nil error:nil];
+        unlink(path.fileSystemRepresentation);
+        if (link([self blobPathForHash:hash].fileSystemRepresentation, path.fileSystemRepresentation) != 0) {
+            return nil;
+        }
+        entryHashes[entry.name] = hash;
+    }
+
+    return entryHashes;
+}
+
+- (void)saveManifestForReport:(NSString *)reportKey fingerprint:(NSString *)fingerprint entryHashes:(NSDictionary<NSString *, NSString *> *)entryHashes
+{
+    NSDictionary *manifest = @{
+        @"fingerprint": fingerprint,
+        @"entries": entryHashes
+    };
+    [manifest writeToFile:[self manifestPathForReport:reportKey] atomically:YES];
+
+    @synchronized (fingerprintIndex) {
+        fingerprintIndex[fingerprint] = reportKey;
+        [fingerprintIndex writeToFile:fingerprintIndexPath atomically:YES];
+    }
+}
+
+- (NSDictionary<NSString *, NSString *> *)entryHashesForReport:(NSString *)reportKey
+{
+    NSDictionary *manifest = [NSDictionary dictionaryWithContentsOfFile:[self manifestPathForReport:reportKey]];
+    return manifest[@"entries"];
+}
+
+- (NSUInteger)releaseHashes:(NSSet<NSString *> *)hashes
+{
+    NSUInteger freed = 0;
+    for (NSString *hash in hashes) {
+        NSString *blobPath = [self blobPathForHash:hash];
+        struct stat info;
+        if (stat(blobPath.fileSystemRepresentation, &info) == 0 && info.st_nlink <= 1) {
+            unlink(blobPath.fileSystemRepresentation);
+            freed++;
+        }
+    }
+    return freed;
+}
+
+- (void)removeReport:(NSString *)reportKey
+{
+    NSString *manifestPath = [self manifestPathForReport:reportKey];
+    NSDictionary *manifest = [NSDictionary dictionaryWithContentsOfFile:manifestPath];
+    if (!manifest) {
+        return;
+    }
+
+    NSUInteger freed = [self releaseHashes:[NSSet setWithArray:[manifest[@"entries"] allValues]]];
+
+    [[NSFileManager defaultManager] removeItemAtPath:manifestPath error:nil];
+    @synchronized (fingerprintIndex) {
+        NSString *fingerprint = manifest[@"fingerprint"];
+        if ([fingerprintIndex[fingerprint] isEqualToString:reportKey]) {
+            [fingerprintIndex removeObjectForKey:fingerprint];
+            [fingerprintIndex writeToFile:fingerprintIndexPath atomically:YES];
+        }
+    }
+
+    NSLog(@"ReportContentStore: removed report %@, freed %lu unshared blobs", reportKey, (unsigned long)freed);
+}
+
+@end
@@ -0,0 +1,61 @@
+//
+//  ReportEntryClassifier.h
+//  DICE
+//
+
+#import <Foundation/Foundation.h>
+#import "ReportArchive.h"
+
+/**
+ Sees each entry of a report zip as the import goes past it, e.g., to note the files
+ the report needs registered, so nothing has to walk the extracted tree afterwards.
+ */
+@protocol ReportEntryClassifier <NSObject>
+
+/**
+ Called once for each entry, from extraction worker threads, so concurrently.
+ */
+- (void)classifyEntry:(ReportArchiveEntry *)entry;
+
+@end
+
+
+/**
+ Picks out the entries of a report's content directory that the import treats
+ specially: its metadata.json, its GeoPackages, and the assets in its shared
+ directory.  Entries outside the content directory are ignored.
+ */
+@interface ReportContentClassifier : NSObject <ReportEntryClassifier>
+
+/**
+ The name of the report's content directory, as its entries are prefixed in the zip.
+ */
+@property (nonatomic, readonly) NSString *contentDirectoryName;
+
+@property (nonatomic, readonly) ReportArchiveEntry *metadataEntry;
+
+/**
+ Sorted by name.
+ */
+@property (nonatomic, readonly) NSArray<ReportArchiveEntry *> *geoPackageEntries;
+
+/**
+ The files under the report's shared directory, GeoPackages included, sorted by name.
+ */
+@property (nonatomic, readonly) NSArray<ReportArchiveEntry *> *sharedEntries;
+
+- (instancetype)initWithContentDirectoryName:(NSString *)contentDirectoryName;
+
+/**
+ Classify every entry in the archive's central directory, for when the entries are not being extracted.
+ */
+- (void)classifyEntriesOfArchive:(ReportArchive *)archive;
+
+/**
+ The entry's path relative to the content directory.
+ */
+- (NSString *)contentPathForEntry:(ReportArchiveEntry *)entry;
+
+- (BOOL)isSharedEntry:(ReportArchiveEntry *)entry;
+
+@end
@@ -0,0 +1,104 @@
+//
+//  ReportEntryClassifier.m
+//  DICE
+//
+
+#import "ReportEntryClassifier.h"
+
+#import "DICEConstants.h"
+#import "GPKGGeoPackageValidate.h"
+
+@implementation ReportContentClassifier
+{
+    NSString *entryPrefix;
+    NSString *sharedPrefix;
+    ReportArchiveEntry *metadata;
+    NSMutableDictionary<NSString *, ReportArchiveEntry *> *geoPackages;
+    NSMutableDictionary<NSString *, ReportArchiveEntry *> *sharedAssets;
+}
+
+- (instancetype)initWithContentDirectoryName:(NSString *)contentDirectoryName
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _contentDirectoryName = contentDirectoryName;
+    entryPrefix = [contentDirectoryName stringByAppendingString:@"/"];
+    sharedPrefix = [NSString stringWithFormat:@"%@/", DICE_REPORT_SHARED_DIRECTORY];
+    geoPackages = [NSMutableDictionary dictionary];
+    sharedAssets = [NSMutableDictionary dictionary];
+
+    return self;
+}
+
+- (void)classifyEntry:(ReportArchiveEntry *)entry
+{
+    NSString *contentPath = [self contentPathForEntry:entry];
+    if (entry.isDirectory || contentPath.length == 0) {
+        return;
+    }
+
+    // keyed by name, so classifying the same entry again is harmless
+    @synchronized (self) {
+        if ([contentPath isEqualToString:@"metadata.json"]) {
+            metadata = entry;
+        }
+        if ([GPKGGeoPackageValidate hasGeoPackageExtension:contentPath]) {
+            geoPackages[entry.name] = entry;
+        }
+        if ([contentPath hasPrefix:sharedPrefix]) {
+            sharedAssets[entry.name] = entry;
+        }
+    }
+}
+
+- (void)classifyEntriesOfArchive:(ReportArchive *)archive
+{
+    for (ReportArchiveEntry *entry in archive.entries) {
+        [self classifyEntry:entry];
+    }
+}
+
+- (NSString *)contentPathForEntry:(ReportArchiveEntry *)entry
+{
+    return [entry.name hasPrefix:entryPrefix] ? [entry.name substringFromIndex:entryPrefix.length] : nil;
+}
+
+- (BOOL)isSharedEntry:(ReportArchiveEntry *)entry
+{
+    return [[self contentPathForEntry:entry] hasPrefix:sharedPrefix];
+}
+
+- (ReportArchiveEntry *)metadataEntry
+{
+    @synchronized (self) {
+        return metadata;
+    }
+}
+
+- (NSArray<ReportArchiveEntry *> *)geoPackageEntries
+{
+    @synchronized (self) {
+        return [self sortedEntries:geoPackages];
+    }
+}
+
+- (NSArray<ReportArchiveEntry *> *)sharedEntries
+{
+    @synchronized (self) {
+        return [self sortedEntries:sharedAssets];
+    }
+}
+
+- (NSArray<ReportArchiveEntry *> *)sortedEntries:(NSDictionary<NSString *, ReportArchiveEntry *> *)entries
+{
+    NSMutableArray<ReportArchiveEntry *> *sorted = [NSMutableArray arrayWithCapacity:entries.count];
+    for (NSString *name in [entries.allKeys sortedArrayUsingSelector:@selector(compare:)]) {
+        [sorted addObject:entries[name]];
+    }
+    return sorted;
+}
+
+@end
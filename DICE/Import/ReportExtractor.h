@@ -0,0 +1,83 @@
+//
+//  ReportExtractor.h
+//  DICE
+//
+
+#import <Foundation/Foundation.h>
+#import "ReportArchive.h"
+#import "ReportContentStore.h"
+#import "ReportEntryClassifier.h"
+
+@class ReportExtractor;
+
+typedef void (^ReportExtractorProgressBlock)(ReportExtractor *extractor, uint64_t entriesExtracted, uint64_t bytesExtracted);
+
+/**
+ Extracts all the entries of a ReportArchive into a directory using a bounded pool
+ of worker threads.  Each worker has its own ReportArchiveReader, and so its own
+ inflate state and buffers, and pulls the next entry index from a shared counter,
+ so many small entries spread evenly across the available cores.
+ */
+@interface ReportExtractor : NSObject
+
+@property (nonatomic, readonly) ReportArchive *archive;
+@property (nonatomic, readonly) NSString *destination;
+
+/**
+ The entries to extract; defaults to all of the archive's entries.
+ */
+@property (nonatomic, strong) NSArray<ReportArchiveEntry *> *entries;
+
+/**
+ The maximum number of entries to extract at once; defaults to the number of active processors.
+ */
+@property (nonatomic) NSUInteger maxConcurrentEntries;
+
+/**
+ When set, entries are extracted into the store and hard linked into the destination.
+ */
+@property (nonatomic, strong) ReportContentStore *contentStore;
+
+/**
+ The content hash of each extracted entry by name, when extracting into a content store.
+ */
+@property (nonatomic, readonly) NSDictionary<NSString *, NSString *> *entryHashes;
+
+/**
+ Shown each entry from worker threads once it is extracted.
+ */
+@property (nonatomic, strong) id<ReportEntryClassifier> entryClassifier;
+
+/**
+ Called from worker threads after each entry is extracted.
+ */
+@property (nonatomic, copy) ReportExtractorProgressBlock progressBlock;
+
+/**
+ The names of the entries whose data did not match their CRC in the last extraction.
+ */
+@property (nonatomic, readonly) NSArray<NSString *> *corruptEntryNames;
+
+@property (nonatomic, readonly) uint64_t entriesExtracted;
+@property (nonatomic, readonly) uint64_t bytesExtracted;
+@property (nonatomic, readonly) NSTimeInterval elapsedTime;
+@property (nonatomic, readonly) double entriesPerSecond;
+@property (nonatomic, readonly) double bytesPerSecond;
+
+- (instancetype)initWithArchive:(ReportArchive *)archive destination:(NSString *)destination;
+
+/**
+ Extract the archive, blocking until all workers finish.  On failure the error
+ describes the first entry that could not be extracted.  Entries that fail their
+ CRC check do not stop the other workers; once the rest are extracted, the
+ extraction fails with ReportArchiveErrorChecksum naming all of them.
+ */
+- (BOOL)extract:(NSError **)error;
+
+/**
+ Stop extracting; safe to call from any thread.  Workers finish the entries they are on and
+ extract: fails with ReportArchiveErrorCancelled.
+ */
+- (void)cancel;
+
+@end
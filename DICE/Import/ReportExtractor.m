@@ -0,0 +1,248 @@
+//
+//  ReportExtractor.m
+//  DICE
+//
+
+#import "ReportExtractor.h"
+
+#import <stdatomic.h>
+
+@implementation ReportExtractor
+{
+    atomic_ullong nextEntry;
+    atomic_ullong entryCount;
+    atomic_ullong byteCount;
+    atomic_bool failed;
+    atomic_bool cancelled;
+    NSError *firstError;
+    NSMutableDictionary<NSString *, NSString *> *hashes;
+    NSMutableArray<NSString *> *corruptNames;
+    CFAbsoluteTime startTime;
+    CFAbsoluteTime endTime;
+}
+
+- (instancetype)initWithArchive:(ReportArchive *)archive destination:(NSString *)destination
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _archive = archive;
+    _destination = destination;
+    _entries = archive.entries;
+    _maxConcurrentEntries = [NSProcessInfo processInfo].activeProcessorCount;
+
+    return self;
+}
+
+- (uint64_t)entriesExtracted
+{
+    return atomic_load(&entryCount);
+}
+
+- (uint64_t)bytesExtracted
+{
+    return atomic_load(&byteCount);
+}
+
+- (NSTimeInterval)elapsedTime
+{
+    if (startTime == 0) {
+        return 0;
+    }
+    return (endTime > 0 ? endTime : CFAbsoluteTimeGetCurrent()) - startTime;
+}
+
+- (double)entriesPerSecond
+{
+    NSTimeInterval elapsed = self.elapsedTime;
+    return elapsed > 0 ? self.entriesExtracted / elapsed : 0;
+}
+
+- (double)bytesPerSecond
+{
+    NSTimeInterval elapsed = self.elapsedTime;
+    return elapsed > 0 ? self.bytesExtracted / elapsed : 0;
+}
+
+- (NSDictionary<NSString *, NSString *> *)entryHashes
+{
+    @synchronized (hashes) {
+        return [hashes copy];
+    }
+}
+
+- (NSArray<NSString *> *)corruptEntryNames
+{
+    @synchronized (corruptNames) {
+        return [corruptNames copy];
+    }
+}
+
+- (void)recordError:(NSError *)error
+{
+    @synchronized (self) {
+        if (!firstError) {
+            firstError = error;
+        }
+    }
+    atomic_store(&failed, true);
+}
+
+/*
+ * A corrupt entry is only remembered, so one bad entry does not hide the others.
+ */
+- (BOOL)recordEntry:(ReportArchiveEntry *)entry error:(NSError *)error
+{
+    if ([error.domain isEqualToString:ReportArchiveErrorDomain] && error.code == ReportArchiveErrorChecksum) {
+        NSLog(@"ReportExtractor: %@", error.localizedDescription);
+        @synchronized (corruptNames) {
+            [corruptNames addObject:entry.name];
+        }
+        return YES;
+    }
+    [self recordError:error];
+    return NO;
+}
+
+- (NSError *)corruptEntriesError
+{
+    NSArray<NSString *> *names = [self.corruptEntryNames sortedArrayUsingSelector:@selector(compare:)];
+    NSString *listed = [[names subarrayWithRange:NSMakeRange(0, MIN(names.count, (NSUInteger)5))] componentsJoinedByString:@", "];
+    if (names.count > 5) {
+        listed = [listed stringByAppendingFormat:@", and %lu more", (unsigned long)(names.count - 5)];
+    }
+    return [NSError errorWithDomain:ReportArchiveErrorDomain code:ReportArchiveErrorChecksum
+        userInfo:@{
+            NSLocalizedDescriptionKey: [NSString stringWithFormat:@"%@ is damaged; these files failed their checksum: %@", self.archive.fileURL.lastPathComponent, listed],
+            ReportArchiveCorruptEntriesKey: names
+        }];
+}
+
+- (NSError *)cancelledError
+{
+    return [NSError errorWithDomain:ReportArchiveErrorDomain code:ReportArchiveErrorCancelled
+        userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"extraction of %@ was cancelled", self.archive.fileURL.lastPathComponent]}];
+}
+
+- (void)cancel
+{
+    atomic_store(&cancelled, true);
+    [self recordError:[self cancelledError]];
+}
+
+- (BOOL)extract:(NSError **)error
+{
+    NSArray<ReportArchiveEntry *> *entries = self.entries;
+    NSUInteger count = entries.count;
+    NSMutableArray<NSString *> *paths = [NSMutableArray arrayWithCapacity:count];
+    NSMutableSet<NSString *> *directories = [NSMutableSet set];
+
+    atomic_store(&nextEntry, 0);
+    atomic_store(&entryCount, 0);
+    atomic_store(&byteCount, 0);
+    @synchronized (self) {
+        firstError = nil;
+    }
+    atomic_store(&failed, false);
+    if (atomic_load(&cancelled)) {
+        if (error) {
+            *error = [self cancelledError];
+        }
+        return NO;
+    }
+    hashes = [NSMutableDictionary dictionaryWithCapacity:count];
+    corruptNames = [NSMutableArray array];
+    startTime = CFAbsoluteTimeGetCurrent();
+    endTime = 0;
+
+    // resolve every path and create the directory tree up front so workers never race on mkdir
+    for (ReportArchiveEntry *entry in entries) {
+        NSString *path = [self.archive extractionPathForEntry:entry inDirectory:self.destination];
+        if (!path) {
+            if (error) {
+                *error = [NSError errorWithDomain:ReportArchiveErrorDomain code:ReportArchiveErrorUnsafePath
+                    userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"refusing to extract %@ outside of %@", entry.name, self.destination]}];
+            }
+            endTime = CFAbsoluteTimeGetCurrent();
+            return NO;
+        }
+        [paths addObject:path];
+        [directories addObject:(entry.isDirectory ? path : [path stringByDeletingLastPathComponent])];
+    }
+
+    NSFileManager *fileManager = [[NSFileManager alloc] init];
+    for (NSString *directory in directories) {
+        if (![fileManager createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:error]) {
+            endTime = CFAbsoluteTimeGetCurrent();
+            return NO;
+        }
+    }
+
+    size_t workers = (size_t)MAX((NSUInteger)1, MIN(self.maxConcurrentEntries, count));
+    ReportExtractorProgressBlock progressBlock = self.progressBlock;
+    ReportContentStore *contentStore = self.contentStore;
+    id<ReportEntryClassifier> entryClassifier = self.entryClassifier;
+
+    dispatch_apply(workers, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t worker) {
+        ReportArchiveReader *reader = [[ReportArchiveReader alloc] initWithArchive:self.archive];
+        unsigned long long index;
+        while (!atomic_load(&failed) && (index = atomic_fetch_add(&nextEntry, 1)) < count) {
+            @autoreleasepool {
+                ReportArchiveEntry *entry = entries[(NSUInteger)index];
+                if (!entry.isDirectory) {
+                    NSError *entryError;
+                    NSString *path = paths[(NSUInteger)index];
+                    if (contentStore && [ReportContentStore canShareEntry:entry]) {
+                        NSString *hash = [contentStore storeEntry:entry withReader:reader toPath:path error:&entryError];
+                        if (!hash) {
+                            if ([self recordEntry:entry error:entryError]) {
+                                continue;
+                            }
+                            break;
+                        }
+                        @synchronized (hashes) {
+                            hashes[entry.name] = hash;
+                        }
+                    }
+                    else if (![reader extractEntry:entry toPath:path error:&entryError]) {
+                        if ([self recordEntry:entry error:entryError]) {
+                            continue;
+                        }
+                        break;
+                    }
+                }
+                [entryClassifier classifyEntry:entry];
+                uint64_t extracted = atomic_fetch_add(&entryCount, 1) + 1;
+                uint64_t bytes = atomic_fetch_add(&byteCount, entry.uncompressedSize) + entry.uncompressedSize;
+                if (progressBlock) {
+                    progressBlock(self, extracted, bytes);
+                }
+            }
+        }
+    });
+
+    endTime = CFAbsoluteTimeGetCurrent();
+
+    if (atomic_load(&failed)) {
+        if (error) {
+            *error = firstError;
+        }
+        return NO;
+    }
+    if (self.corruptEntryNames.count > 0) {
+        if (error) {
+            *error = [self corruptEntriesError];
+        }
+        return NO;
+    }
+
+    NSLog(@"ReportExtractor: extracted %llu entries, %llu bytes from %@ in %.2fs with %zu workers (%.0f files/sec, %.1f MB/sec)",
+        self.entriesExtracted, self.bytesExtracted, self.archive.fileURL.lastPathComponent, self.elapsedTime, workers,
+        self.entriesPerSecond, self.bytesPerSecond / (1 << 20));
+
+    return YES;
+}
+
+@end
@@ -0,0 +1,62 @@
+//
+//  ReportImportBatch.h
+//  DICE
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ A group of report zips imported together, e.g., a stack of zips dropped into Documents
+ through iTunes File Sharing.  Each zip's uncompressed size, from its central directory,
+ is counted against the free space before it is imported, along with what the batch's
+ unfinished extractions still need, so the batch only plans to extract the reports that
+ fit; the rest should be mounted instead.  As the imports go, the batch adds up their
+ progress into one throughput and time remaining for the whole batch.
+
+ Reports are keyed by their source file name.  All the methods are thread safe.
+ */
+@interface ReportImportBatch : NSObject
+
+/**
+ Free space to leave when planning extractions; defaults to 64 MB.
+ */
+@property (nonatomic) uint64_t reserve;
+
+@property (readonly) NSUInteger reportCount;
+@property (readonly) NSUInteger finishedCount;
+@property (readonly, getter=isFinished) BOOL finished;
+
+/**
+ The bytes the batch plans to extract, and how many of them are extracted so far.
+ */
+@property (readonly) uint64_t totalBytes;
+@property (readonly) uint64_t bytesExtracted;
+
+/**
+ Bytes extracted per second since the batch started.
+ */
+@property (readonly) double bytesPerSecond;
+
+/**
+ The seconds until the batch is done at its throughput so far, or -1 until there is a throughput.
+ */
+@property (readonly) NSTimeInterval estimatedTimeRemaining;
+
+/**
+ Add the report, returning YES if extracting it fits in the available space.  A report that does
+ not fit is still counted in the batch, but plans no bytes.
+ */
+- (BOOL)addReport:(NSString *)reportKey uncompressedSize:(uint64_t)size availableSpace:(uint64_t)availableSpace;
+
+- (BOOL)containsReport:(NSString *)reportKey;
+- (BOOL)shouldExtractReport:(NSString *)reportKey;
+
+- (void)updateReport:(NSString *)reportKey bytesExtracted:(uint64_t)bytes;
+
+/**
+ The report is done, whether it was imported, failed, or was cancelled; the rest of its planned
+ bytes no longer count as remaining.
+ */
+- (void)finishReport:(NSString *)reportKey;
+
+@end
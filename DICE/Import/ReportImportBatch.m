@@ -0,0 +1,153 @@
+//
+//  ReportImportBatch.m
+//  DICE
+//
+
+#import "ReportImportBatch.h"
+
+@implementation ReportImportBatch
+{
+    NSTimeInterval startTime;
+    NSMutableSet<NSString *> *reportKeys;
+    NSMutableSet<NSString *> *finishedKeys;
+    NSMutableDictionary<NSString *, NSNumber *> *plannedBytes;
+    NSMutableDictionary<NSString *, NSNumber *> *extractedBytes;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _reserve = 64 << 20;
+    startTime = [NSDate timeIntervalSinceReferenceDate];
+    reportKeys = [NSMutableSet set];
+    finishedKeys = [NSMutableSet set];
+    plannedBytes = [NSMutableDictionary dictionary];
+    extractedBytes = [NSMutableDictionary dictionary];
+
+    return self;
+}
+
+- (NSUInteger)reportCount
+{
+    @synchronized (self) {
+        return reportKeys.count;
+    }
+}
+
+- (NSUInteger)finishedCount
+{
+    @synchronized (self) {
+        return finishedKeys.count;
+    }
+}
+
+- (BOOL)isFinished
+{
+    @synchronized (self) {
+        return finishedKeys.count == reportKeys.count;
+    }
+}
+
+- (uint64_t)totalBytes
+{
+    @synchronized (self) {
+        uint64_t total = 0;
+        for (NSNumber *bytes in plannedBytes.allValues) {
+            total += bytes.unsignedLongLongValue;
+        }
+        return total;
+    }
+}
+
+- (uint64_t)bytesExtracted
+{
+    @synchronized (self) {
+        uint64_t total = 0;
+        for (NSNumber *bytes in extractedBytes.allValues) {
+            total += bytes.unsignedLongLongValue;
+        }
+        return total;
+    }
+}
+
+- (double)bytesPerSecond
+{
+    NSTimeInterval elapsed = [NSDate timeIntervalSinceReferenceDate] - startTime;
+    return elapsed > 0 ? self.bytesExtracted / elapsed : 0;
+}
+
+- (NSTimeInterval)estimatedTimeRemaining
+{
+    uint64_t total, extracted;
+    @synchronized (self) {
+        total = self.totalBytes;
+        extracted = self.bytesExtracted;
+    }
+    double rate = self.bytesPerSecond;
+    if (extracted >= total) {
+        return 0;
+    }
+    return rate > 0 ? (total - extracted) / rate : -1;
+}
+
+- (BOOL)addReport:(NSString *)reportKey uncompressedSize:(uint64_t)size availableSpace:(uint64_t)availableSpace
+{
+    @synchronized (self) {
+        [reportKeys addObject:reportKey];
+        [finishedKeys removeObject:reportKey];
+        [plannedBytes removeObjectForKey:reportKey];
+        [extractedBytes removeObjectForKey:reportKey];
+
+        uint64_t stillNeeded = self.totalBytes - self.bytesExtracted;
+        if (stillNeeded + size + self.reserve > availableSpace) {
+            return NO;
+        }
+        plannedBytes[reportKey] = @(size);
+        extractedBytes[reportKey] = @0;
+        return YES;
+    }
+}
+
+- (BOOL)containsReport:(NSString *)reportKey
+{
+    @synchronized (self) {
+        return [reportKeys containsObject:reportKey];
+    }
+}
+
+- (BOOL)shouldExtractReport:(NSString *)reportKey
+{
+    @synchronized (self) {
+        return plannedBytes[reportKey] != nil;
+    }
+}
+
+- (void)updateReport:(NSString *)reportKey bytesExtracted:(uint64_t)bytes
+{
+    @synchronized (self) {
+        NSNumber *planned = plannedBytes[reportKey];
+        if (planned && ![finishedKeys containsObject:reportKey]) {
+            extractedBytes[reportKey] = @(MIN(bytes, planned.unsignedLongLongValue));
+        }
+    }
+}
+
+- (void)finishReport:(NSString *)reportKey
+{
+    @synchronized (self) {
+        if (![reportKeys containsObject:reportKey]) {
+            return;
+        }
+        [finishedKeys addObject:reportKey];
+        NSNumber *planned = plannedBytes[reportKey];
+        if (planned) {
+            extractedBytes[reportKey] = planned;
+        }
+    }
+}
+
+@end
@@ -0,0 +1,52 @@
+//
+//  ReportImportManifest.h
+//  DICE
+//
+
+#import <Foundation/Foundation.h>
+#import "ReportArchive.h"
+
+/**
+ Records what was extracted the last time a report zip was imported: the zip's size
+ and modification date, and the CRC-32 and size of every entry.  When a revised zip
+ with the same name shows up, comparing its central directory against the manifest
+ tells which entries were added, changed, or removed, so only those are touched.
+ Manifests are kept under Application Support, keyed by the zip's file name.
+ */
+@interface ReportImportManifest : NSObject
+
+@property (nonatomic, readonly) uint64_t sourceSize;
+@property (nonatomic, readonly) NSDate *sourceModified;
+
++ (instancetype)manifestForReport:(NSString *)reportKey;
+
++ (instancetype)manifestWithArchive:(ReportArchive *)archive;
+
++ (void)removeManifestForReport:(NSString *)reportKey;
+
+- (BOOL)saveForReport:(NSString *)reportKey;
+
+/**
+ YES if the file has the same size and modification date as the zip this manifest was made from.
+ */
+- (BOOL)matchesSourceFile:(NSURL *)sourceFile;
+
+/**
+ The archive's entries that are new or whose CRC or size differ from the manifest.
+ */
+- (NSArray<ReportArchiveEntry *> *)entriesChangedInArchive:(ReportArchive *)archive;
+
+/**
+ Names in the manifest that no longer appear in the archive.
+ */
+- (NSArray<NSString *> *)entryNamesRemovedFromArchive:(ReportArchive *)archive;
+
+/**
+ Delete the files extracted to the directory for entries that are no longer in the archive, and
+ then the directories left empty, deepest first.  Directory entries the archive leaves out are
+ only removed if nothing is left in them, since a zip may list its files without their directories.
+ Returns the names of the removed entries, files and directories.
+ */
+- (NSArray<NSString *> *)removeEntriesRemovedFromArchive:(ReportArchive *)archive inDirectory:(NSString *)directory;
+
+@end
@@ -0,0 +1,148 @@
+//
+//  ReportImportManifest.m
+//  DICE
+//
+
+#import "ReportImportManifest.h"
+
+#import <unistd.h>
+
+@interface ReportImportManifest ()
+
+@property (nonatomic, readwrite) uint64_t sourceSize;
+@property (nonatomic, readwrite) NSDate *sourceModified;
+@property (nonatomic, strong) NSDictionary<NSString *, NSArray<NSNumber *> *> *entries;
+
+@end
+
+@implementation ReportImportManifest
+
++ (NSString *)manifestDirectory
+{
+    static NSString *directory = nil;
+    static dispatch_once_t oncePredicate;
+    dispatch_once(&oncePredicate, ^{
+        NSURL *supportDir = [[NSFileManager defaultManager] URLForDirectory:NSApplicationSupportDirectory inDomain:NSUserDomainMask appropriateForURL:nil create:YES error:nil];
+        directory = [supportDir.path stringByAppendingPathComponent:@"ReportManifests"];
+        [[NSFileManager defaultManager] createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:nil];
+    });
+    return directory;
+}
+
++ (NSString *)pathForReport:(NSString *)reportKey
+{
+    return [[self manifestDirectory] stringByAppendingPathComponent:[reportKey stringByAppendingPathExtension:@"plist"]];
+}
+
++ (instancetype)manifestForReport:(NSString *)reportKey
+{
+    NSData *data = [NSData dataWithContentsOfFile:[self pathForReport:reportKey]];
+    if (!data) {
+        return nil;
+    }
+    NSDictionary *plist = [NSPropertyListSerialization propertyListWithData:data options:NSPropertyListImmutable format:NULL error:nil];
+    if (![plist isKindOfClass:[NSDictionary class]]) {
+        return nil;
+    }
+
+    ReportImportManifest *manifest = [[ReportImportManifest alloc] init];
+    manifest.sourceSize = [plist[@"sourceSize"] unsignedLongLongValue];
+    manifest.sourceModified = plist[@"sourceModified"];
+    manifest.entries = plist[@"entries"];
+    return manifest;
+}
+
++ (instancetype)manifestWithArchive:(ReportArchive *)archive
+{
+    NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:archive.fileURL.path error:nil];
+    NSMutableDictionary<NSString *, NSArray<NSNumber *> *> *entries = [NSMutableDictionary dictionaryWithCapacity:archive.entries.count];
+    for (ReportArchiveEntry *entry in archive.entries) {
+        entries[entry.name] = @[@(entry.crc32), @(entry.uncompressedSize)];
+    }
+
+    ReportImportManifest *manifest = [[ReportImportManifest alloc] init];
+    manifest.sourceSize = attributes.fileSize;
+    manifest.sourceModified = attributes.fileModificationDate;
+    manifest.entries = entries;
+    return manifest;
+}
+
++ (void)removeManifestForReport:(NSString *)reportKey
+{
+    [[NSFileManager defaultManager] removeItemAtPath:[self pathForReport:reportKey] error:nil];
+}
+
+- (BOOL)saveForReport:(NSString *)reportKey
+{
+    NSDictionary *plist = @{
+        @"sourceSize": @(self.sourceSize),
+        @"sourceModified": self.sourceModified ? self.sourceModified : [NSDate date],
+        @"entries": self.entries
+    };
+    NSData *data = [NSPropertyListSerialization dataWithPropertyList:plist format:NSPropertyListBinaryFormat_v1_0 options:0 error:nil];
+    return [data writeToFile:[ReportImportManifest pathForReport:reportKey] atomically:YES];
+}
+
+- (BOOL)matchesSourceFile:(NSURL *)sourceFile
+{
+    NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:sourceFile.path error:nil];
+    return attributes && attributes.fileSize == self.sourceSize && [attributes.fileModificationDate isEqualToDate:self.sourceModified];
+}
+
+- (NSArray<ReportArchiveEntry *> *)entriesChangedInArchive:(ReportArchive *)archive
+{
+    NSMutableArray<ReportArchiveEntry *> *changed = [NSMutableArray array];
+    for (ReportArchiveEntry *entry in archive.entries) {
+        NSArray<NSNumber *> *previous = self.entries[entry.name];
+        if (!previous || [previous[0] unsignedIntValue] != entry.crc32 || [previous[1] unsignedLongLongValue] != entry.uncompressedSize) {
+            [changed addObject:entry];
+        }
+    }
+    return changed;
+}
+
+- (NSArray<NSString *> *)entryNamesRemovedFromArchive:(ReportArchive *)archive
+{
+    NSMutableArray<NSString *> *removed = [NSMutableArray array];
+    for (NSString *name in self.entries) {
+        if (![archive entryNamed:name]) {
+            [removed addObject:name];
+        }
+    }
+    return removed;
+}
+
+- (NSArray<NSString *> *)removeEntriesRemovedFromArchive:(ReportArchive *)archive inDirectory:(NSString *)directory
+{
+    NSArray<NSString *> *removed = [self entryNamesRemovedFromArchive:archive];
+    NSMutableSet<NSString *> *directories = [NSMutableSet set];
+    for (NSString *name in removed) {
+        if ([name hasPrefix:@"/"] || [name.pathComponents containsObject:@".."]) {
+            continue;
+        }
+        NSString *path = [directory stringByAppendingPathComponent:name];
+        if ([name hasSuffix:@"/"]) {
+            [directories addObject:path];
+        }
+        else {
+            unlink(path.fileSystemRepresentation);
+        }
+        // the file may have been the last thing in its directories
+        for (NSString *parent = path.stringByDeletingLastPathComponent; parent.length > directory.length; parent = parent.stringByDeletingLastPathComponent) {
+            [directories addObject:parent];
+        }
+    }
+
+    NSArray<NSString *> *deepestFirst = [directories.allObjects sortedArrayUsingComparator:^NSComparisonResult(NSString *a, NSString *b) {
+        NSUInteger depthA = a.pathComponents.count;
+        NSUInteger depthB = b.pathComponents.count;
+        return depthA > depthB ? NSOrderedAscending : depthA < depthB ? NSOrderedDescending : NSOrderedSame;
+    }];
+    for (NSString *path in deepestFirst) {
+        // fails, and leaves the directory, when anything is still in it
+        rmdir(path.fileSystemRepresentation);
+    }
+    return removed;
+}
+
+@end
@@ -0,0 +1,98 @@
+//
+//  ReportImportScheduler.h
+//  DICE
+//
+
+#import <Foundation/Foundation.h>
+#import "Report.h"
+
+typedef NS_ENUM(NSInteger, ReportImportPriority) {
+    /** found by scanning Documents */
+    ReportImportPriorityBackground = 0,
+    /** handed to DICE by another app or a download */
+    ReportImportPriorityUserInitiated,
+    /** the user is waiting to look at this report */
+    ReportImportPriorityInteractive,
+};
+
+@class ReportImportTask;
+
+typedef void (^ReportImportBlock)(ReportImportTask *task);
+
+
+/**
+ One scheduled import.  The import block should check isCancelled between steps,
+ and can set a cancellation handler to interrupt a step that is already running.
+ */
+@interface ReportImportTask : NSObject
+
+@property (nonatomic, readonly) Report *report;
+@property (nonatomic, readonly) uint64_t byteCount;
+@property (readonly) ReportImportPriority priority;
+@property (readonly, getter=isCancelled) BOOL cancelled;
+
+/**
+ Called once, on the cancelling thread, if the task is cancelled while it runs.  Set it
+ to nil when the step it interrupts is done.
+ */
+@property (copy) dispatch_block_t cancellationHandler;
+
+- (void)cancel;
+
+@end
+
+
+/**
+ Runs report imports a few at a time instead of all at once.  A queued import starts
+ when fewer than maxConcurrentImports are running and its bytes fit in what is left of
+ byteBudget, so a bulk import does not extract a hundred zips side by side.  An import
+ larger than the whole budget still runs, but alone.  Queued imports start in priority
+ order, first come first served within a priority, and a queued import can be moved up
+ when the user asks for its report.  Imports of the same report run one at a time; one
+ scheduled while another is still running, e.g., still winding down after it was
+ cancelled, waits in the queue for it to finish while other reports' imports go by.
+ */
+@interface ReportImportScheduler : NSObject
+
+/**
+ Defaults to 2; each import already extracts on every core.
+ */
+@property (nonatomic) NSUInteger maxConcurrentImports;
+
+/**
+ The total size of the imports allowed to run at once; defaults to 256 MB.
+ */
+@property (nonatomic) uint64_t byteBudget;
+
+@property (nonatomic, readonly) NSUInteger runningCount;
+@property (nonatomic, readonly) NSUInteger queuedCount;
+@property (nonatomic, readonly) uint64_t bytesInFlight;
+
+/**
+ Import blocks run on the given queue, which should be concurrent.
+ */
+- (instancetype)initWithQueue:(dispatch_queue_t)queue;
+
+/**
+ Queue an import of the report.  An import of the same report that is still queued is cancelled
+ without running and replaced by this one, which takes the higher of the two priorities.
+ */
+- (ReportImportTask *)scheduleImportOfReport:(Report *)report byteCount:(uint64_t)byteCount priority:(ReportImportPriority)priority block:(ReportImportBlock)block;
+
+/**
+ The queued or running task for the report, or nil.
+ */
+- (ReportImportTask *)taskForReport:(Report *)report;
+
+/**
+ Move the report's queued import up to the given priority.  Returns NO if it is not queued.
+ */
+- (BOOL)raiseImportOfReport:(Report *)report toPriority:(ReportImportPriority)priority;
+
+/**
+ Cancel the report's import.  A queued import is dropped without running; a running one
+ is told to stop.
+ */
+- (void)cancelImportOfReport:(Report *)report;
+
+@end
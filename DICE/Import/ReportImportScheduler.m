@@ -0,0 +1,260 @@
+//
+//  ReportImportScheduler.m
+//  DICE
+//
+
+#import "ReportImportScheduler.h"
+
+
+@interface ReportImportTask ()
+
+@property (readwrite) ReportImportPriority priority;
+@property (nonatomic, copy) ReportImportBlock block;
+
+- (instancetype)initWithReport:(Report *)report byteCount:(uint64_t)byteCount priority:(ReportImportPriority)priority block:(ReportImportBlock)block;
+
+@end
+
+@implementation ReportImportTask
+{
+    BOOL cancelled;
+    dispatch_block_t cancellationHandler;
+}
+
+- (instancetype)initWithReport:(Report *)report byteCount:(uint64_t)byteCount priority:(ReportImportPriority)priority block:(ReportImportBlock)block
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _report = report;
+    _byteCount = byteCount;
+    _priority = priority;
+    _block = block;
+
+    return self;
+}
+
+- (BOOL)isCancelled
+{
+    @synchronized (self) {
+        return cancelled;
+    }
+}
+
+- (dispatch_block_t)cancellationHandler
+{
+    @synchronized (self) {
+        return cancellationHandler;
+    }
+}
+
+- (void)setCancellationHandler:(dispatch_block_t)handler
+{
+    BOOL alreadyCancelled;
+    @synchronized (self) {
+        alreadyCancelled = cancelled;
+        cancellationHandler = alreadyCancelled ? nil : [handler copy];
+    }
+    // cancelled before the step started; stop it right away
+    if (alreadyCancelled && handler) {
+        handler();
+    }
+}
+
+- (void)cancel
+{
+    dispatch_block_t handler;
+    @synchronized (self) {
+        if (cancelled) {
+            return;
+        }
+        cancelled = YES;
+        handler = cancellationHandler;
+        cancellationHandler = nil;
+    }
+    if (handler) {
+        handler();
+    }
+}
+
+@end
+
+
+@implementation ReportImportScheduler
+{
+    dispatch_queue_t workQueue;
+    dispatch_queue_t stateQueue;
+    NSArray<NSMutableArray<ReportImportTask *> *> *lanes;
+    NSMapTable<Report *, ReportImportTask *> *tasksByReport;
+    NSHashTable<Report *> *runningReports;
+    NSUInteger running;
+    uint64_t inFlight;
+}
+
+- (instancetype)initWithQueue:(dispatch_queue_t)queue
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    workQueue = queue;
+    stateQueue = dispatch_queue_create("dice.import_scheduler", DISPATCH_QUEUE_SERIAL);
+    lanes = @[[NSMutableArray array], [NSMutableArray array], [NSMutableArray array]];
+    tasksByReport = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+    runningReports = [NSHashTable hashTableWithOptions:NSPointerFunctionsObjectPointerPersonality];
+    _maxConcurrentImports = 2;
+    _byteBudget = 256ull << 20;
+
+    return self;
+}
+
+- (NSUInteger)runningCount
+{
+    __block NSUInteger count;
+    dispatch_sync(stateQueue, ^{
+        count = running;
+    });
+    return count;
+}
+
+- (NSUInteger)queuedCount
+{
+    __block NSUInteger count = 0;
+    dispatch_sync(stateQueue, ^{
+        for (NSArray *lane in lanes) {
+            count += lane.count;
+        }
+    });
+    return count;
+}
+
+- (uint64_t)bytesInFlight
+{
+    __block uint64_t bytes;
+    dispatch_sync(stateQueue, ^{
+        bytes = inFlight;
+    });
+    return bytes;
+}
+
+- (NSMutableArray<ReportImportTask *> *)laneForPriority:(ReportImportPriority)priority
+{
+    return lanes[MAX(ReportImportPriorityBackground, MIN(priority, ReportImportPriorityInteractive))];
+}
+
+- (ReportImportTask *)scheduleImportOfReport:(Report *)report byteCount:(uint64_t)byteCount priority:(ReportImportPriority)priority block:(ReportImportBlock)block
+{
+    ReportImportTask *task = [[ReportImportTask alloc] initWithReport:report byteCount:byteCount priority:priority block:block];
+    dispatch_async(stateQueue, ^{
+        // an import of the report that has not started yet is replaced, keeping the higher priority,
+        // rather than left in its lane to run after this one
+        ReportImportTask *queued = [tasksByReport objectForKey:report];
+        NSMutableArray<ReportImportTask *> *queuedLane = queued ? [self laneForPriority:queued.priority] : nil;
+        if ([queuedLane containsObject:queued]) {
+            [queuedLane removeObjectIdenticalTo:queued];
+            task.priority = MAX(task.priority, queued.priority);
+            [queued cancel];
+        }
+        [[self laneForPriority:task.priority] addObject:task];
+        [tasksByReport setObject:task forKey:report];
+        [self startQueuedTasks];
+    });
+    return task;
+}
+
+- (ReportImportTask *)taskForReport:(Report *)report
+{
+    __block ReportImportTask *task;
+    dispatch_sync(stateQueue, ^{
+        task = [tasksByReport objectForKey:report];
+    });
+    return task;
+}
+
+- (BOOL)raiseImportOfReport:(Report *)report toPriority:(ReportImportPriority)priority
+{
+    __block BOOL raised = NO;
+    dispatch_sync(stateQueue, ^{
+        ReportImportTask *task = [tasksByReport objectForKey:report];
+        NSMutableArray<ReportImportTask *> *lane = task ? [self laneForPriority:task.priority] : nil;
+        if (![lane containsObject:task]) {
+            return;
+        }
+        if (priority > task.priority) {
+            [lane removeObjectIdenticalTo:task];
+            task.priority = priority;
+            [[self laneForPriority:priority] addObject:task];
+        }
+        raised = YES;
+        [self startQueuedTasks];
+    });
+    return raised;
+}
+
+- (void)cancelImportOfReport:(Report *)report
+{
+    __block ReportImportTask *task;
+    dispatch_sync(stateQueue, ^{
+        task = [tasksByReport objectForKey:report];
+        if (task && [[self laneForPriority:task.priority] containsObject:task]) {
+            // never started, so nothing else will clean it up
+            [[self laneForPriority:task.priority] removeObjectIdenticalTo:task];
+            [tasksByReport removeObjectForKey:report];
+        }
+    });
+    [task cancel];
+}
+
+/*
+ * Start queued tasks, highest priority first, while there are free slots and budget.  Tasks whose
+ * report is still importing are passed over until that import finishes.  The first of the rest
+ * waits for budget rather than letting smaller, lower priority imports past it.  Runs on the state
+ * queue.
+ */
+- (void)startQueuedTasks
+{
+    while (running < MAX(self.maxConcurrentImports, (NSUInteger)1)) {
+        ReportImportTask *next = nil;
+        for (NSMutableArray<ReportImportTask *> *lane in lanes.reverseObjectEnumerator) {
+            for (ReportImportTask *task in lane) {
+                if (![runningReports containsObject:task.report]) {
+                    next = task;
+                    break;
+                }
+            }
+            if (next) {
+                break;
+            }
+        }
+        if (!next || (running > 0 && inFlight + next.byteCount > self.byteBudget)) {
+            return;
+        }
+
+        [[self laneForPriority:next.priority] removeObjectIdenticalTo:next];
+        [runningReports addObject:next.report];
+        running += 1;
+        inFlight += next.byteCount;
+
+        dispatch_async(workQueue, ^{
+            if (!next.isCancelled) {
+                next.block(next);
+            }
+            next.cancellationHandler = nil;
+            next.block = nil;
+            dispatch_async(stateQueue, ^{
+                running -= 1;
+                inFlight -= next.byteCount;
+                [runningReports removeObject:next.report];
+                if ([tasksByReport objectForKey:next.report] == next) {
+                    [tasksByReport removeObjectForKey:next.report];
+                }
+                [self startQueuedTasks];
+            });
+        });
+    }
+}
+
+@end
@@ -0,0 +1,63 @@
+//
+//  ReportProgressChannel.h
+//  DICE
+//
+
+#import <Foundation/Foundation.h>
+#import "Report.h"
+
+/**
+ The progress counters of one report.  Updating them is a few atomic stores, with no
+ locking, allocation, or dispatch, so they can be updated from every extraction worker
+ and on every chunk of a download.
+ */
+@interface ReportProgress : NSObject
+
+@property (nonatomic, readonly) Report *report;
+@property (nonatomic, readonly) uint64_t filesExtracted;
+@property (nonatomic, readonly) uint64_t totalFiles;
+@property (nonatomic, readonly) uint64_t bytesExtracted;
+@property (nonatomic, readonly) uint64_t totalBytes;
+@property (nonatomic, readonly) int64_t bytesDownloaded;
+@property (nonatomic, readonly) int64_t downloadSize;
+
+- (void)setTotalFiles:(uint64_t)files totalBytes:(uint64_t)bytes;
+- (void)setFilesExtracted:(uint64_t)files bytesExtracted:(uint64_t)bytes;
+- (void)setBytesDownloaded:(int64_t)bytes ofDownloadSize:(int64_t)size;
+
+@end
+
+
+typedef void (^ReportProgressPublishBlock)(ReportProgress *progress);
+
+/**
+ Publishes report progress at a fixed rate instead of on every update.  A single display
+ link on the main thread ticks every few frames while any report is being tracked, and
+ calls the publish block once for each report whose counters changed since the last tick,
+ so a report with thousands of tiny entries, or a fast download, costs the main thread
+ at most one update per tick.
+ */
+@interface ReportProgressChannel : NSObject
+
+/**
+ Screen refreshes between ticks; defaults to 6, or 10 updates a second at 60 Hz.
+ */
+@property (nonatomic) NSInteger frameInterval;
+
+/**
+ Called on the main thread with the current counters of each report that changed.
+ */
+- (instancetype)initWithPublishBlock:(ReportProgressPublishBlock)publishBlock;
+
+/**
+ Start tracking the report, or return the counters it is already tracked with.  Counters whose tracking
+ already finished, but were not dropped yet, start over at zero files and bytes extracted.
+ */
+- (ReportProgress *)beginTrackingReport:(Report *)report;
+
+/**
+ Publish the report's final counters on the next tick and stop tracking it.
+ */
+- (void)finishTrackingReport:(Report *)report;
+
+@end
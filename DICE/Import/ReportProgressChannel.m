@@ -0,0 +1,208 @@
+//
+//  ReportProgressChannel.m
+//  DICE
+//
+
+#import "ReportProgressChannel.h"
+
+#import <QuartzCore/QuartzCore.h>
+#import <stdatomic.h>
+
+
+@interface ReportProgress ()
+
+@property (nonatomic) BOOL finished;
+@property (nonatomic) uint64_t publishedGeneration;
+
+- (instancetype)initWithReport:(Report *)report;
+- (uint64_t)generation;
+- (void)resetExtraction;
+
+@end
+
+@implementation ReportProgress
+{
+    atomic_ullong filesExtracted;
+    atomic_ullong totalFiles;
+    atomic_ullong bytesExtracted;
+    atomic_ullong totalBytes;
+    atomic_llong bytesDownloaded;
+    atomic_llong downloadSize;
+    atomic_ullong generation;
+}
+
+- (instancetype)initWithReport:(Report *)report
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _report = report;
+
+    return self;
+}
+
+- (uint64_t)filesExtracted
+{
+    return atomic_load(&filesExtracted);
+}
+
+- (uint64_t)totalFiles
+{
+    return atomic_load(&totalFiles);
+}
+
+- (uint64_t)bytesExtracted
+{
+    return atomic_load(&bytesExtracted);
+}
+
+- (uint64_t)totalBytes
+{
+    return atomic_load(&totalBytes);
+}
+
+- (int64_t)bytesDownloaded
+{
+    return atomic_load(&bytesDownloaded);
+}
+
+- (int64_t)downloadSize
+{
+    return atomic_load(&downloadSize);
+}
+
+- (uint64_t)generation
+{
+    return atomic_load(&generation);
+}
+
+- (void)setTotalFiles:(uint64_t)files totalBytes:(uint64_t)bytes
+{
+    atomic_store(&totalFiles, files);
+    atomic_store(&totalBytes, bytes);
+    atomic_fetch_add(&generation, 1);
+}
+
+- (void)setFilesExtracted:(uint64_t)files bytesExtracted:(uint64_t)bytes
+{
+    // workers finish out of order; never let the count go backwards
+    uint64_t current = atomic_load(&filesExtracted);
+    while (files > current && !atomic_compare_exchange_weak(&filesExtracted, &current, files)) {}
+    current = atomic_load(&bytesExtracted);
+    while (bytes > current && !atomic_compare_exchange_weak(&bytesExtracted, &current, bytes)) {}
+    atomic_fetch_add(&generation, 1);
+}
+
+- (void)setBytesDownloaded:(int64_t)bytes ofDownloadSize:(int64_t)size
+{
+    atomic_store(&bytesDownloaded, bytes);
+    atomic_store(&downloadSize, size);
+    atomic_fetch_add(&generation, 1);
+}
+
+/*
+ * Start the extraction counters over, which setFilesExtracted:bytesExtracted: only ever raises.  Nothing
+ * is published until the new import sets them, so the download counters stay up until then.
+ */
+- (void)resetExtraction
+{
+    atomic_store(&totalFiles, 0);
+    atomic_store(&totalBytes, 0);
+    atomic_store(&filesExtracted, 0);
+    atomic_store(&bytesExtracted, 0);
+}
+
+@end
+
+
+@implementation ReportProgressChannel
+{
+    ReportProgressPublishBlock publishBlock;
+    NSMapTable<Report *, ReportProgress *> *tracked;
+    CADisplayLink *displayLink;
+}
+
+- (instancetype)initWithPublishBlock:(ReportProgressPublishBlock)aPublishBlock
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    publishBlock = [aPublishBlock copy];
+    tracked = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+    _frameInterval = 6;
+
+    return self;
+}
+
+- (ReportProgress *)beginTrackingReport:(Report *)report
+{
+    ReportProgress *progress;
+    @synchronized (tracked) {
+        progress = [tracked objectForKey:report];
+        if (!progress) {
+            progress = [[ReportProgress alloc] initWithReport:report];
+            [tracked setObject:progress forKey:report];
+        }
+        else if (progress.finished) {
+            // imported again before the last import's counters were published and dropped
+            [progress resetExtraction];
+        }
+        progress.finished = NO;
+    }
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [self startTicking];
+    });
+    return progress;
+}
+
+- (void)finishTrackingReport:(Report *)report
+{
+    @synchronized (tracked) {
+        [tracked objectForKey:report].finished = YES;
+    }
+}
+
+/*
+ * The display link only runs while there is something to publish.  Main thread only.
+ */
+- (void)startTicking
+{
+    if (displayLink) {
+        return;
+    }
+    displayLink = [CADisplayLink displayLinkWithTarget:self selector:@selector(tick:)];
+    displayLink.frameInterval = MAX(self.frameInterval, (NSInteger)1);
+    [displayLink addToRunLoop:[NSRunLoop mainRunLoop] forMode:NSRunLoopCommonModes];
+}
+
+- (void)tick:(CADisplayLink *)sender
+{
+    NSArray<ReportProgress *> *current;
+    @synchronized (tracked) {
+        current = tracked.objectEnumerator.allObjects;
+        for (ReportProgress *progress in current) {
+            if (progress.finished) {
+                [tracked removeObjectForKey:progress.report];
+            }
+        }
+        if (tracked.count == 0) {
+            // invalidating releases the display link's hold on self
+            [displayLink invalidate];
+            displayLink = nil;
+        }
+    }
+
+    for (ReportProgress *progress in current) {
+        uint64_t generation = progress.generation;
+        if (generation != progress.publishedGeneration) {
+            progress.publishedGeneration = generation;
+            publishBlock(progress);
+        }
+    }
+}
+
+@end
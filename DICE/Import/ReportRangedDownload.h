@@ -0,0 +1,106 @@
+//
+//  ReportRangedDownload.h
+//  DICE
+//
+
+#import <Foundation/Foundation.h>
+
+extern NSString * const ReportDownloadErrorDomain;
+
+typedef NS_ENUM(NSInteger, ReportDownloadError) {
+    ReportDownloadErrorIO = 1,
+    /** the server does not serve byte ranges, or did not say how long the file is */
+    ReportDownloadErrorRangesUnsupported,
+    /** the file on the server changed since the download started */
+    ReportDownloadErrorSourceChanged,
+    ReportDownloadErrorIntegrity,
+    ReportDownloadErrorHTTP,
+};
+
+/**
+ Downloads a large file as a set of byte ranges fetched over several connections and
+ written in place into a preallocated file.  How much of each range has arrived is
+ saved next to the file as the download goes, so a dropped connection only costs the
+ unsaved part of one range, and a download interrupted by the app exiting picks up
+ where it left off with savedDownloadWithArchivePath:.  Range requests carry the file's
+ ETag or Last-Modified date in If-Range, so a file that changed on the server is not
+ stitched together from two versions.
+
+ When it finishes, the file must have the length the server reported and, if a SHA-256
+ digest is known, either given or from the server's Digest header, the same digest.
+ */
+@interface ReportRangedDownload : NSObject
+
+@property (nonatomic, readonly) NSURL *URL;
+@property (nonatomic, readonly) NSString *archivePath;
+@property (nonatomic, readonly) int64_t totalLength;
+@property (nonatomic, readonly) int64_t bytesReceived;
+
+/**
+ Defaults to 4.
+ */
+@property (nonatomic) NSUInteger maxConnections;
+
+/**
+ The size of the ranges a new download is split into; defaults to 16 MB.
+ */
+@property (nonatomic) int64_t rangeLength;
+
+/**
+ How many times a failed range is retried, with growing delays, before the download fails; defaults to 5.
+ */
+@property (nonatomic) NSUInteger maxRetriesPerRange;
+
+@property (nonatomic, strong) NSData *expectedSHA256;
+
+/**
+ Defaults to the default session configuration.
+ */
+@property (nonatomic, strong) NSURLSessionConfiguration *sessionConfiguration;
+
+/**
+ Called on the download's queue as bytes arrive.
+ */
+@property (nonatomic, copy) void (^progressBlock)(int64_t bytesReceived, int64_t totalLength);
+
+/**
+ Find out whether the server will serve the URL in ranges, and how long it is.
+ */
++ (void)probeURL:(NSURL *)URL sessionConfiguration:(NSURLSessionConfiguration *)configuration
+    completion:(void (^)(int64_t length, BOOL acceptsRanges, NSError *error))completion;
+
+/**
+ The interrupted download saved for the given file, or nil if there is none.
+ */
++ (instancetype)savedDownloadWithArchivePath:(NSString *)archivePath;
+
+/**
+ The paths of the files with interrupted downloads saved in the directory.
+ */
++ (NSArray<NSString *> *)savedArchivePathsInDirectory:(NSString *)directory;
+
+- (instancetype)initWithURL:(NSURL *)URL archivePath:(NSString *)archivePath;
+
+/**
+ Start or resume the download.  The completion block is called once on a background queue.
+ On failure the progress so far is kept, unless the file changed on the server or failed
+ verification, in which case the partial file is removed.
+ */
+- (void)startWithCompletion:(void (^)(NSError *error))completion;
+
+/**
+ Stop downloading, keeping the progress so far for a later resume.
+ */
+- (void)cancel;
+
+/**
+ Stop downloading and remove the partial file and its saved state.
+ */
+- (void)discard;
+/**
+ Discard the download, calling the block on a background queue once its files are gone, e.g., before
+ starting a new download to the same archive path.
+ */
+- (void)discardWithCompletion:(void (^)(void))completion;
+
+@end
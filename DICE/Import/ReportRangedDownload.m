@@ -0,0 +1,501 @@
+//
+//  ReportRangedDownload.m
+//  DICE
+//
+
+#import "ReportRangedDownload.h"
+
+#import <CommonCrypto/CommonDigest.h>
+#import <fcntl.h>
+#import <sys/stat.h>
+#import <unistd.h>
+
+NSString * const ReportDownloadErrorDomain = @"DICE.ReportDownload";
+
+static NSString * const kStateFileExtension = @"download";
+static const int64_t kCheckpointInterval = 4 << 20;
+
+static NSError *downloadError(ReportDownloadError code, NSString *format, ...) NS_FORMAT_FUNCTION(2,3);
+static NSError *downloadError(ReportDownloadError code, NSString *format, ...) {
+    va_list args;
+    va_start(args, format);
+    NSString *description = [[NSString alloc] initWithFormat:format arguments:args];
+    va_end(args);
+    return [NSError errorWithDomain:ReportDownloadErrorDomain code:code userInfo:@{NSLocalizedDescriptionKey: description}];
+}
+
+/*
+ * The SHA-256 from a Digest header, e.g., "SHA-256=base64digest", if there is one.
+ */
+static NSData *sha256FromDigestHeader(NSString *header) {
+    for (NSString *digest in [header componentsSeparatedByString:@","]) {
+        NSString *trimmed = [digest stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        if ([trimmed.lowercaseString hasPrefix:@"sha-256="]) {
+            return [[NSData alloc] initWithBase64EncodedString:[trimmed substringFromIndex:8] options:0];
+        }
+    }
+    return nil;
+}
+
+
+@interface ReportDownloadRange : NSObject
+
+@property (nonatomic) int64_t offset;
+@property (nonatomic) int64_t length;
+@property (nonatomic) int64_t received;
+@property (nonatomic) int64_t receivedSinceCheckpoint;
+@property (nonatomic) NSUInteger failures;
+@property (nonatomic) BOOL waitingToRetry;
+@property (nonatomic, strong) NSURLSessionDataTask *task;
+@property (nonatomic, readonly) BOOL isComplete;
+
+@end
+
+@implementation ReportDownloadRange
+
+- (BOOL)isComplete
+{
+    return self.received >= self.length;
+}
+
+@end
+
+
+@interface ReportRangedDownload () <NSURLSessionDataDelegate>
+
+@end
+
+@implementation ReportRangedDownload
+{
+    dispatch_queue_t workQueue;
+    NSURLSession *session;
+    NSString *validator;
+    NSArray<ReportDownloadRange *> *ranges;
+    NSMutableDictionary<NSNumber *, ReportDownloadRange *> *rangesByTask;
+    int archiveFile;
+    BOOL finished;
+    void (^completionBlock)(NSError *error);
+}
+
++ (void)probeURL:(NSURL *)URL sessionConfiguration:(NSURLSessionConfiguration *)configuration
+    completion:(void (^)(int64_t length, BOOL acceptsRanges, NSError *error))completion
+{
+    [self probeURL:URL sessionConfiguration:configuration fullCompletion:^(NSHTTPURLResponse *response, NSError *error) {
+        NSString *acceptRanges = response.allHeaderFields[@"Accept-Ranges"];
+        completion(response.expectedContentLength, [acceptRanges.lowercaseString containsString:@"bytes"], error);
+    }];
+}
+
++ (void)probeURL:(NSURL *)URL sessionConfiguration:(NSURLSessionConfiguration *)configuration
+    fullCompletion:(void (^)(NSHTTPURLResponse *response, NSError *error))completion
+{
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:URL];
+    request.HTTPMethod = @"HEAD";
+    NSURLSession *probeSession = [NSURLSession sessionWithConfiguration:(configuration ? configuration : [NSURLSessionConfiguration defaultSessionConfiguration])];
+    [[probeSession dataTaskWithRequest:request completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+        NSHTTPURLResponse *httpResponse = [response isKindOfClass:[NSHTTPURLResponse class]] ? (NSHTTPURLResponse *)response : nil;
+        if (!error && httpResponse.statusCode >= 400) {
+            error = downloadError(ReportDownloadErrorHTTP, @"%@ returned HTTP %ld", URL.host, (long)httpResponse.statusCode);
+        }
+        completion(httpResponse, error);
+    }] resume];
+    [probeSession finishTasksAndInvalidate];
+}
+
++ (NSString *)statePathForArchivePath:(NSString *)archivePath
+{
+    return [archivePath stringByAppendingPathExtension:kStateFileExtension];
+}
+
++ (instancetype)savedDownloadWithArchivePath:(NSString *)archivePath
+{
+    NSData *data = [NSData dataWithContentsOfFile:[self statePathForArchivePath:archivePath]];
+    NSDictionary *state = data ? [NSPropertyListSerialization propertyListWithData:data options:NSPropertyListImmutable format:NULL error:nil] : nil;
+    NSURL *URL = [state isKindOfClass:[NSDictionary class]] ? [NSURL URLWithString:state[@"url"]] : nil;
+    if (!URL || ![[NSFileManager defaultManager] fileExistsAtPath:archivePath]) {
+        return nil;
+    }
+
+    ReportRangedDownload *download = [[ReportRangedDownload alloc] initWithURL:URL archivePath:archivePath];
+    [download restoreState:state];
+    return download;
+}
+
++ (NSArray<NSString *> *)savedArchivePathsInDirectory:(NSString *)directory
+{
+    NSMutableArray<NSString *> *paths = [NSMutableArray array];
+    for (NSString *name in [[NSFileManager defaultManager] contentsOfDirectoryAtPath:directory error:nil]) {
+        if ([name.pathExtension isEqualToString:kStateFileExtension]) {
+            [paths addObject:[directory stringByAppendingPathComponent:name.stringByDeletingPathExtension]];
+        }
+    }
+    return paths;
+}
+
+- (instancetype)initWithURL:(NSURL *)URL archivePath:(NSString *)archivePath
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _URL = URL;
+    _archivePath = archivePath;
+    _maxConnections = 4;
+    _rangeLength = 16 << 20;
+    _maxRetriesPerRange = 5;
+    _sessionConfiguration = [NSURLSessionConfiguration defaultSessionConfiguration];
+    workQueue = dispatch_queue_create("dice.ranged_download", DISPATCH_QUEUE_SERIAL);
+    rangesByTask = [NSMutableDictionary dictionary];
+    archiveFile = -1;
+
+    return self;
+}
+
+- (void)dealloc
+{
+    if (archiveFile >= 0) {
+        close(archiveFile);
+    }
+}
+
+- (void)restoreState:(NSDictionary *)state
+{
+    _totalLength = [state[@"length"] longLongValue];
+    validator = state[@"validator"];
+    self.expectedSHA256 = state[@"sha256"];
+
+    NSMutableArray<ReportDownloadRange *> *restored = [NSMutableArray array];
+    int64_t received = 0;
+    for (NSArray<NSNumber *> *saved in state[@"ranges"]) {
+        ReportDownloadRange *range = [[ReportDownloadRange alloc] init];
+        range.offset = saved[0].longLongValue;
+        range.length = saved[1].longLongValue;
+        range.received = saved[2].longLongValue;
+        received += range.received;
+        [restored addObject:range];
+    }
+    ranges = restored;
+    _bytesReceived = received;
+}
+
+/*
+ * Record how far each range got.  The file is synced first, so the state never claims bytes that are not on disk.
+ */
+- (void)saveState
+{
+    if (archiveFile >= 0) {
+        fsync(archiveFile);
+    }
+    NSMutableArray *savedRanges = [NSMutableArray arrayWithCapacity:ranges.count];
+    for (ReportDownloadRange *range in ranges) {
+        [savedRanges addObject:@[@(range.offset), @(range.length), @(range.received)]];
+        range.receivedSinceCheckpoint = 0;
+    }
+    NSMutableDictionary *state = [NSMutableDictionary dictionaryWithDictionary:@{
+        @"url": self.URL.absoluteString,
+        @"length": @(self.totalLength),
+        @"ranges": savedRanges
+    }];
+    if (validator) {
+        state[@"validator"] = validator;
+    }
+    if (self.expectedSHA256) {
+        state[@"sha256"] = self.expectedSHA256;
+    }
+    NSData *data = [NSPropertyListSerialization dataWithPropertyList:state format:NSPropertyListBinaryFormat_v1_0 options:0 error:nil];
+    [data writeToFile:[ReportRangedDownload statePathForArchivePath:self.archivePath] atomically:YES];
+}
+
+- (void)removeFiles
+{
+    unlink(self.archivePath.fileSystemRepresentation);
+    unlink([ReportRangedDownload statePathForArchivePath:self.archivePath].fileSystemRepresentation);
+}
+
+- (void)startWithCompletion:(void (^)(NSError *error))completion
+{
+    dispatch_async(workQueue, ^{
+        completionBlock = [completion copy];
+        if (ranges) {
+            NSLog(@"ReportRangedDownload: resuming %@ at %lld of %lld bytes", self.URL, self.bytesReceived, self.totalLength);
+            [self openSession];
+            return;
+        }
+
+        [ReportRangedDownload probeURL:self.URL sessionConfiguration:self.sessionConfiguration fullCompletion:^(NSHTTPURLResponse *response, NSError *error) {
+            dispatch_async(workQueue, ^{
+                if (error) {
+                    [self finishWithError:error];
+                    return;
+                }
+                NSString *acceptRanges = response.allHeaderFields[@"Accept-Ranges"];
+                if (response.expectedContentLength <= 0 || ![acceptRanges.lowercaseString containsString:@"bytes"]) {
+                    [self finishWithError:downloadError(ReportDownloadErrorRangesUnsupported, @"%@ does not serve byte ranges", self.URL.host)];
+                    return;
+                }
+                [self planRangesForResponse:response];
+                [self openSession];
+            });
+        }];
+    });
+}
+
+- (void)planRangesForResponse:(NSHTTPURLResponse *)response
+{
+    _totalLength = response.expectedContentLength;
+    NSDictionary *headers = response.allHeaderFields;
+    validator = headers[@"ETag"] ? headers[@"ETag"] : headers[@"Last-Modified"];
+    if (!self.expectedSHA256) {
+        self.expectedSHA256 = sha256FromDigestHeader(headers[@"Digest"]);
+    }
+
+    int64_t rangeLength = MAX(self.rangeLength, (int64_t)1);
+    NSMutableArray<ReportDownloadRange *> *planned = [NSMutableArray array];
+    for (int64_t offset = 0; offset < self.totalLength; offset += rangeLength) {
+        ReportDownloadRange *range = [[ReportDownloadRange alloc] init];
+        range.offset = offset;
+        range.length = MIN(rangeLength, self.totalLength - offset);
+        [planned addObject:range];
+    }
+    ranges = planned;
+    _bytesReceived = 0;
+    NSLog(@"ReportRangedDownload: downloading %@, %lld bytes in %lu ranges", self.URL, self.totalLength, (unsigned long)ranges.count);
+}
+
+- (void)openSession
+{
+    [[NSFileManager defaultManager] createDirectoryAtPath:[self.archivePath stringByDeletingLastPathComponent] withIntermediateDirectories:YES attributes:nil error:nil];
+    archiveFile = open(self.archivePath.fileSystemRepresentation, O_RDWR | O_CREAT, 0644);
+    if (archiveFile < 0 || ftruncate(archiveFile, (off_t)self.totalLength) != 0) {
+        [self finishWithError:downloadError(ReportDownloadErrorIO, @"could not create %@: %s", self.archivePath, strerror(errno))];
+        return;
+    }
+    [self saveState];
+
+    NSURLSessionConfiguration *configuration = [self.sessionConfiguration copy];
+    configuration.HTTPMaximumConnectionsPerHost = (NSInteger)MAX(self.maxConnections, (NSUInteger)1);
+    NSOperationQueue *delegateQueue = [[NSOperationQueue alloc] init];
+    delegateQueue.underlyingQueue = workQueue;
+    delegateQueue.maxConcurrentOperationCount = 1;
+    session = [NSURLSession sessionWithConfiguration:configuration delegate:self delegateQueue:delegateQueue];
+    [self startRanges];
+}
+
+/*
+ * Keep up to maxConnections ranges downloading.  Runs on the work queue.
+ */
+- (void)startRanges
+{
+    if (finished) {
+        return;
+    }
+
+    BOOL complete = YES;
+    for (ReportDownloadRange *range in ranges) {
+        complete = complete && range.isComplete;
+        if (rangesByTask.count >= MAX(self.maxConnections, (NSUInteger)1)) {
+            break;
+        }
+        if (range.isComplete || range.task || range.waitingToRetry) {
+            continue;
+        }
+
+        NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:self.URL];
+        [request setValue:[NSString stringWithFormat:@"bytes=%lld-%lld", range.offset + range.received, range.offset + range.length - 1] forHTTPHeaderField:@"Range"];
+        if (validator) {
+            [request setValue:validator forHTTPHeaderField:@"If-Range"];
+        }
+        range.task = [session dataTaskWithRequest:request];
+        rangesByTask[@(range.task.taskIdentifier)] = range;
+        [range.task resume];
+    }
+
+    if (complete && rangesByTask.count == 0) {
+        [self verifyAndFinish];
+    }
+}
+
+- (void)URLSession:(NSURLSession *)aSession dataTask:(NSURLSessionDataTask *)task didReceiveResponse:(NSURLResponse *)response completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler
+{
+    ReportDownloadRange *range = rangesByTask[@(task.taskIdentifier)];
+    NSInteger status = [response isKindOfClass:[NSHTTPURLResponse class]] ? ((NSHTTPURLResponse *)response).statusCode : 0;
+    NSString *contentRange = [response isKindOfClass:[NSHTTPURLResponse class]] ? ((NSHTTPURLResponse *)response).allHeaderFields[@"Content-Range"] : nil;
+    NSString *expectedStart = [NSString stringWithFormat:@"bytes %lld-", range.offset + range.received];
+
+    if (!range || finished) {
+        completionHandler(NSURLSessionResponseCancel);
+    }
+    else if (status == 206 && [contentRange hasPrefix:expectedStart]) {
+        completionHandler(NSURLSessionResponseAllow);
+    }
+    else if (status == 200 || status == 206) {
+        // If-Range failed, so the server sent the whole new file, or it ignored the range
+        completionHandler(NSURLSessionResponseCancel);
+        [self removeFiles];
+        [self finishWithError:downloadError(ReportDownloadErrorSourceChanged, @"%@ changed on the server during the download", self.URL.lastPathComponent)];
+    }
+    else {
+        completionHandler(NSURLSessionResponseCancel);
+        [self finishWithError:downloadError(ReportDownloadErrorHTTP, @"%@ returned HTTP %ld", self.URL.host, (long)status)];
+    }
+}
+
+- (void)URLSession:(NSURLSession *)aSession dataTask:(NSURLSessionDataTask *)task didReceiveData:(NSData *)data
+{
+    ReportDownloadRange *range = rangesByTask[@(task.taskIdentifier)];
+    if (!range || finished) {
+        return;
+    }
+
+    __block BOOL failed = NO;
+    [data enumerateByteRangesUsingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
+        // never write past the range, whatever the server sends
+        size_t length = (size_t)MIN((int64_t)byteRange.length, range.length - range.received);
+        const uint8_t *p = bytes;
+        while (length > 0) {
+            ssize_t written = pwrite(archiveFile, p, length, (off_t)(range.offset + range.received));
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                failed = YES;
+                *stop = YES;
+                return;
+            }
+            p += written;
+            length -= (size_t)written;
+            range.received += written;
+            range.receivedSinceCheckpoint += written;
+            _bytesReceived += written;
+        }
+    }];
+
+    if (failed) {
+        [self finishWithError:downloadError(ReportDownloadErrorIO, @"could not write %@: %s", self.archivePath, strerror(errno))];
+        return;
+    }
+    if (range.receivedSinceCheckpoint >= kCheckpointInterval) {
+        [self saveState];
+    }
+    if (self.progressBlock) {
+        self.progressBlock(self.bytesReceived, self.totalLength);
+    }
+}
+
+- (void)URLSession:(NSURLSession *)aSession task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error
+{
+    ReportDownloadRange *range = rangesByTask[@(task.taskIdentifier)];
+    [rangesByTask removeObjectForKey:@(task.taskIdentifier)];
+    range.task = nil;
+    if (!range || finished) {
+        return;
+    }
+
+    [self saveState];
+    if (!range.isComplete) {
+        range.failures += 1;
+        if (range.failures > self.maxRetriesPerRange) {
+            [self finishWithError:(error ? error : downloadError(ReportDownloadErrorIO, @"the connection for %@ closed early", self.URL.lastPathComponent))];
+            return;
+        }
+        // back off, so a link that just dropped has a moment to come back
+        NSTimeInterval delay = MIN(pow(2.0, (double)range.failures), 60.0);
+        NSLog(@"ReportRangedDownload: range at %lld of %@ failed (%@), retrying in %.0fs", range.offset, self.URL.lastPathComponent, error.localizedDescription, delay);
+        range.waitingToRetry = YES;
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), workQueue, ^{
+            range.waitingToRetry = NO;
+            [self startRanges];
+        });
+    }
+    [self startRanges];
+}
+
+- (void)verifyAndFinish
+{
+    struct stat info;
+    if (fstat(archiveFile, &info) != 0 || info.st_size != self.totalLength) {
+        [self removeFiles];
+        [self finishWithError:downloadError(ReportDownloadErrorIntegrity, @"%@ is not %lld bytes long", self.archivePath.lastPathComponent, self.totalLength)];
+        return;
+    }
+
+    if (self.expectedSHA256) {
+        CC_SHA256_CTX context;
+        CC_SHA256_Init(&context);
+        size_t bufferSize = 1 << 20;
+        uint8_t *buffer = malloc(bufferSize);
+        off_t offset = 0;
+        ssize_t count;
+        while ((count = pread(archiveFile, buffer, bufferSize, offset)) > 0) {
+            CC_SHA256_Update(&context, buffer, (CC_LONG)count);
+            offset += count;
+        }
+        free(buffer);
+        unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+        CC_SHA256_Final(digest, &context);
+        if (![[NSData dataWithBytes:digest length:sizeof(digest)] isEqualToData:self.expectedSHA256]) {
+            [self removeFiles];
+            [self finishWithError:downloadError(ReportDownloadErrorIntegrity, @"%@ does not match its SHA-256 digest", self.archivePath.lastPathComponent)];
+            return;
+        }
+    }
+
+    unlink([ReportRangedDownload statePathForArchivePath:self.archivePath].fileSystemRepresentation);
+    [self finishWithError:nil];
+}
+
+/*
+ * Stop everything and call the completion block once.  Runs on the work queue.
+ */
+- (void)finishWithError:(NSError *)error
+{
+    if (finished) {
+        return;
+    }
+    finished = YES;
+
+    if (error && archiveFile >= 0 && [[NSFileManager defaultManager] fileExistsAtPath:[ReportRangedDownload statePathForArchivePath:self.archivePath]]) {
+        [self saveState];
+    }
+    if (archiveFile >= 0) {
+        close(archiveFile);
+        archiveFile = -1;
+    }
+    [session invalidateAndCancel];
+    session = nil;
+
+    if (error) {
+        NSLog(@"ReportRangedDownload: download of %@ stopped at %lld of %lld bytes: %@", self.URL, self.bytesReceived, self.totalLength, error.localizedDescription);
+    }
+    void (^completion)(NSError *) = completionBlock;
+    completionBlock = nil;
+    if (completion) {
+        completion(error);
+    }
+}
+
+- (void)cancel
+{
+    dispatch_async(workQueue, ^{
+        [self finishWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]];
+    });
+}
+
+- (void)discard
+{
+    [self discardWithCompletion:nil];
+}
+
+- (void)discardWithCompletion:(void (^)(void))completion
+{
+    dispatch_async(workQueue, ^{
+        [self finishWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]];
+        [self removeFiles];
+        if (completion) {
+            completion();
+        }
+    });
+}
+
+@end
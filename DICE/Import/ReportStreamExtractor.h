@@ -0,0 +1,51 @@
+//
+//  ReportStreamExtractor.h
+//  DICE
+//
+
+#import <Foundation/Foundation.h>
+#import "ReportArchive.h"
+
+/**
+ Extracts a zip from its bytes in file order, as they arrive, by following the local
+ file headers instead of waiting for the central directory at the end.  Local headers
+ are not authoritative, so once the whole archive is available the streamed entries are
+ checked against its central directory, and whatever did not stream cleanly is left for
+ a normal extraction.
+
+ Entries that cannot be streamed, e.g., stored entries with a trailing data descriptor,
+ whose size the local header does not give, stop the streaming; the rest of the archive
+ is extracted after the download.  Only use an extractor from one thread at a time.
+ */
+@interface ReportStreamExtractor : NSObject
+
+@property (nonatomic, readonly) NSString *destination;
+
+/**
+ NO once the extractor has given up on the rest of the stream.
+ */
+@property (nonatomic, readonly, getter=isStreaming) BOOL streaming;
+
+@property (nonatomic, readonly) NSUInteger entriesStreamed;
+@property (nonatomic, readonly) uint64_t bytesStreamed;
+
+- (instancetype)initWithDestination:(NSString *)destination;
+
+/**
+ Consume the next bytes of the archive.  Fails only if a file cannot be written.
+ */
+- (BOOL)appendBytes:(const void *)bytes length:(size_t)length error:(NSError **)error;
+
+/**
+ Compare what was streamed with the complete archive's central directory.  Streamed files
+ the archive does not list are removed; the entries returned are the ones that still need
+ to be extracted because they were not streamed or do not match their CRC and size.
+ */
+- (NSArray<ReportArchiveEntry *> *)entriesToExtractFromArchive:(ReportArchive *)archive;
+
+/**
+ Remove everything streamed so far, e.g., after the download failed.
+ */
+- (void)removeStreamedFiles;
+
+@end
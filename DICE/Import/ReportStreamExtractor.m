@@ -0,0 +1,479 @@
+//
+//  ReportStreamExtractor.m
+//  DICE
+//
+
+#import "ReportStreamExtractor.h"
+
+#import "zlib.h"
+#import <fcntl.h>
+#import <unistd.h>
+
+static const uint32_t kLocalFileHeaderSignature = 0x04034b50;
+static const uint32_t kCentralDirectorySignature = 0x02014b50;
+static const uint32_t kEndOfCentralDirectorySignature = 0x06054b50;
+static const uint32_t kDataDescriptorSignature = 0x08074b50;
+static const uint16_t kZip64ExtraFieldID = 0x0001;
+static const size_t kLocalFileHeaderLength = 30;
+static const size_t kOutBufferSize = 1 << 18;
+
+static inline uint16_t readUInt16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t readUInt32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t readUInt64(const uint8_t *p) {
+    return (uint64_t)readUInt32(p) | ((uint64_t)readUInt32(p + 4) << 32);
+}
+
+typedef NS_ENUM(NSInteger, ReportStreamState) {
+    ReportStreamStateHeader,
+    ReportStreamStateData,
+    ReportStreamStateDescriptor,
+    ReportStreamStateDone,
+};
+
+
+@implementation ReportStreamExtractor
+{
+    ReportStreamState state;
+    NSMutableData *header;
+    NSMutableDictionary<NSString *, NSArray<NSNumber *> *> *streamed;
+    NSMutableSet<NSString *> *knownDirectories;
+    NSMutableArray<NSString *> *createdDirectories;
+    NSFileManager *fileManager;
+    z_stream stream;
+    BOOL streamReady;
+    uint8_t *outBuffer;
+
+    // the entry being streamed
+    NSString *entryName;
+    NSString *entryPath;
+    int entryFile;
+    uint16_t entryMethod;
+    BOOL entryHasDescriptor;
+    BOOL entryIsZip64;
+    uint64_t entryRemaining;
+    uint64_t entryProduced;
+    uint32_t entryCRC;
+}
+
+- (instancetype)initWithDestination:(NSString *)destination
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _destination = destination;
+    _streaming = YES;
+    state = ReportStreamStateHeader;
+    header = [NSMutableData dataWithCapacity:1024];
+    streamed = [NSMutableDictionary dictionary];
+    knownDirectories = [NSMutableSet set];
+    createdDirectories = [NSMutableArray array];
+    fileManager = [[NSFileManager alloc] init];
+    entryFile = -1;
+    outBuffer = malloc(kOutBufferSize);
+    memset(&stream, 0, sizeof(stream));
+    // raw deflate, no zlib header
+    streamReady = (inflateInit2(&stream, -MAX_WBITS) == Z_OK);
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [self discardCurrentEntry];
+    if (streamReady) {
+        inflateEnd(&stream);
+    }
+    free(outBuffer);
+}
+
+- (BOOL)appendBytes:(const void *)bytes length:(size_t)length error:(NSError **)error
+{
+    const uint8_t *p = bytes;
+    while (length > 0 && self.isStreaming && state != ReportStreamStateDone) {
+        size_t used = 0;
+        switch (state) {
+            case ReportStreamStateHeader:
+                used = [self consumeHeader:p length:length];
+                break;
+            case ReportStreamStateData:
+                used = [self consumeData:p length:length error:error];
+                if (used == SIZE_MAX) {
+                    return NO;
+                }
+                break;
+            case ReportStreamStateDescriptor:
+                used = [self consumeDescriptor:p length:length];
+                break;
+            case ReportStreamStateDone:
+                break;
+        }
+        p += used;
+        length -= used;
+    }
+    return YES;
+}
+
+/*
+ * Buffer header bytes until there are at least the given number; returns how many were taken.
+ */
+- (size_t)fillHeader:(size_t)needed bytes:(const uint8_t *)p length:(size_t)length
+{
+    size_t take = header.length < needed ? MIN(needed - header.length, length) : 0;
+    [header appendBytes:p length:take];
+    return take;
+}
+
+- (size_t)consumeHeader:(const uint8_t *)p length:(size_t)length
+{
+    size_t used = [self fillHeader:4 bytes:p length:length];
+    if (header.length < 4) {
+        return used;
+    }
+
+    uint32_t signature = readUInt32(header.bytes);
+    if (signature != kLocalFileHeaderSignature) {
+        if (signature == kCentralDirectorySignature || signature == kEndOfCentralDirectorySignature) {
+            state = ReportStreamStateDone;
+        }
+        else {
+            [self abandon:[NSString stringWithFormat:@"unexpected signature 0x%08x", signature]];
+        }
+        return used;
+    }
+
+    used += [self fillHeader:kLocalFileHeaderLength bytes:p + used length:length - used];
+    if (header.length < kLocalFileHeaderLength) {
+        return used;
+    }
+    const uint8_t *h = header.bytes;
+    size_t fullLength = kLocalFileHeaderLength + readUInt16(h + 26) + readUInt16(h + 28);
+    used += [self fillHeader:fullLength bytes:p + used length:length - used];
+    if (header.length < fullLength) {
+        return used;
+    }
+
+    [self beginEntry];
+    return used;
+}
+
+- (void)beginEntry
+{
+    const uint8_t *h = header.bytes;
+    uint16_t flags = readUInt16(h + 6);
+    uint16_t method = readUInt16(h + 8);
+    uint64_t compressedSize = readUInt32(h + 18);
+    uint64_t uncompressedSize = readUInt32(h + 22);
+    uint16_t nameLength = readUInt16(h + 26);
+    uint16_t extraLength = readUInt16(h + 28);
+
+    const void *nameBytes = h + kLocalFileHeaderLength;
+    NSString *name = [[NSString alloc] initWithBytes:nameBytes length:nameLength encoding:NSUTF8StringEncoding];
+    if (!name) {
+        name = [[NSString alloc] initWithBytes:nameBytes length:nameLength encoding:NSISOLatin1StringEncoding];
+    }
+
+    // a Zip64 entry's local header has 0xffffffff for its sizes, and the real ones, uncompressed
+    // first, in the Zip64 extra field; its data descriptor, if any, has 8-byte sizes
+    BOOL zip64 = NO;
+    BOOL badZip64 = NO;
+    const uint8_t *extra = h + kLocalFileHeaderLength + nameLength;
+    for (size_t i = 0; i + 4 <= extraLength; i += 4 + readUInt16(extra + i + 2)) {
+        uint16_t fieldLength = readUInt16(extra + i + 2);
+        if (readUInt16(extra + i) != kZip64ExtraFieldID || i + 4 + fieldLength > extraLength) {
+            continue;
+        }
+        zip64 = YES;
+        const uint8_t *value = extra + i + 4;
+        const uint8_t *end = value + fieldLength;
+        if (uncompressedSize == 0xffffffff) {
+            badZip64 = badZip64 || value + 8 > end;
+            uncompressedSize = badZip64 ? 0 : readUInt64(value);
+            value += 8;
+        }
+        if (compressedSize == 0xffffffff) {
+            badZip64 = badZip64 || value + 8 > end;
+            compressedSize = badZip64 ? 0 : readUInt64(value);
+        }
+        break;
+    }
+    badZip64 = badZip64 || compressedSize == 0xffffffff || uncompressedSize == 0xffffffff;
+    [header setLength:0];
+
+    entryName = name;
+    if (flags & 1) {
+        [self abandon:@"encrypted entry"];
+        return;
+    }
+    if (method != 0 && method != Z_DEFLATED) {
+        [self abandon:[NSString stringWithFormat:@"unsupported compression method %u", method]];
+        return;
+    }
+    if ((flags & 8) && method != Z_DEFLATED) {
+        // nothing marks where stored data ends when its size comes after it
+        [self abandon:@"stored entry with a data descriptor"];
+        return;
+    }
+    if (badZip64) {
+        [self abandon:@"Zip64 entry without its sizes"];
+        return;
+    }
+    NSString *path = [ReportArchive extractionPathForName:name inDirectory:self.destination];
+    if (!path) {
+        [self abandon:@"entry outside of the destination"];
+        return;
+    }
+
+    entryPath = path;
+    entryMethod = method;
+    entryHasDescriptor = (flags & 8) != 0;
+    entryIsZip64 = zip64;
+    entryRemaining = compressedSize;
+    entryProduced = 0;
+    entryCRC = 0;
+
+    if ([name hasSuffix:@"/"]) {
+        if (![self ensureDirectory:path]) {
+            [self abandon:@"could not create directory"];
+            return;
+        }
+        [self finishEntry];
+        return;
+    }
+
+    if (![self ensureDirectory:[path stringByDeletingLastPathComponent]]) {
+        [self abandon:@"could not create directory"];
+        return;
+    }
+    // never write through an existing file; it may be a hard link shared with other reports
+    unlink(path.fileSystemRepresentation);
+    entryFile = open(path.fileSystemRepresentation, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (entryFile < 0) {
+        [self abandon:[NSString stringWithFormat:@"could not create file: %s", strerror(errno)]];
+        return;
+    }
+    if (method == Z_DEFLATED && (!streamReady || inflateReset(&stream) != Z_OK)) {
+        [self abandon:@"could not initialize inflate"];
+        return;
+    }
+
+    state = ReportStreamStateData;
+    if (!entryHasDescriptor && entryRemaining == 0) {
+        [self finishEntry];
+    }
+}
+
+/*
+ * Returns the number of bytes used, or SIZE_MAX if the entry could not be written.
+ */
+- (size_t)consumeData:(const uint8_t *)p length:(size_t)length error:(NSError **)error
+{
+    if (entryMethod != Z_DEFLATED) {
+        size_t take = (size_t)MIN((uint64_t)length, entryRemaining);
+        if (![self writeEntryBytes:p length:take error:error]) {
+            return SIZE_MAX;
+        }
+        entryRemaining -= take;
+        if (entryRemaining == 0) {
+            [self finishEntry];
+        }
+        return take;
+    }
+
+    size_t available = MIN(length, (size_t)UINT_MAX);
+    if (!entryHasDescriptor) {
+        available = (size_t)MIN((uint64_t)available, entryRemaining);
+    }
+    stream.next_in = (Bytef *)p;
+    stream.avail_in = (uInt)available;
+    int status;
+    do {
+        stream.next_out = outBuffer;
+        stream.avail_out = (uInt)kOutBufferSize;
+        status = inflate(&stream, Z_NO_FLUSH);
+        if (status == Z_BUF_ERROR && stream.avail_in == 0) {
+            status = Z_OK;
+        }
+        else if (status != Z_OK && status != Z_STREAM_END) {
+            [self abandon:[NSString stringWithFormat:@"corrupt deflate data (%d)", status]];
+            return available - stream.avail_in;
+        }
+        size_t have = kOutBufferSize - stream.avail_out;
+        if (have > 0 && ![self writeEntryBytes:outBuffer length:have error:error]) {
+            return SIZE_MAX;
+        }
+    } while (status == Z_OK && stream.avail_out == 0);
+
+    size_t used = available - stream.avail_in;
+    if (!entryHasDescriptor) {
+        entryRemaining -= used;
+    }
+
+    if (status == Z_STREAM_END) {
+        if (entryHasDescriptor) {
+            state = ReportStreamStateDescriptor;
+        }
+        else if (entryRemaining == 0) {
+            [self finishEntry];
+        }
+        else {
+            [self abandon:@"deflate data ended before its compressed size"];
+        }
+    }
+    else if (!entryHasDescriptor && entryRemaining == 0) {
+        [self abandon:@"deflate data is truncated"];
+    }
+    return used;
+}
+
+- (size_t)consumeDescriptor:(const uint8_t *)p length:(size_t)length
+{
+    size_t used = [self fillHeader:4 bytes:p length:length];
+    if (header.length < 4) {
+        return used;
+    }
+    // the signature is optional; the CRC and sizes are checked against the central directory later
+    size_t descriptorLength = (readUInt32(header.bytes) == kDataDescriptorSignature ? 4 : 0) + (entryIsZip64 ? 20 : 12);
+    used += [self fillHeader:descriptorLength bytes:p + used length:length - used];
+    if (header.length < descriptorLength) {
+        return used;
+    }
+    [header setLength:0];
+    [self finishEntry];
+    return used;
+}
+
+- (BOOL)writeEntryBytes:(const uint8_t *)p length:(size_t)length error:(NSError **)error
+{
+    entryCRC = ReportArchiveCRC32(entryCRC, p, length);
+    entryProduced += length;
+    _bytesStreamed += length;
+    while (length > 0) {
+        ssize_t written = write(entryFile, p, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (error) {
+                *error = [NSError errorWithDomain:ReportArchiveErrorDomain code:ReportArchiveErrorIO
+                    userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"could not write %@: %s", entryPath, strerror(errno)]}];
+            }
+            [self discardCurrentEntry];
+            _streaming = NO;
+            return NO;
+        }
+        p += written;
+        length -= (size_t)written;
+    }
+    return YES;
+}
+
+- (void)finishEntry
+{
+    if (entryFile >= 0) {
+        close(entryFile);
+        entryFile = -1;
+    }
+    streamed[entryName] = @[@(entryCRC), @(entryProduced)];
+    _entriesStreamed += 1;
+    entryName = nil;
+    entryPath = nil;
+    state = ReportStreamStateHeader;
+}
+
+- (void)discardCurrentEntry
+{
+    if (entryFile >= 0) {
+        close(entryFile);
+        entryFile = -1;
+        unlink(entryPath.fileSystemRepresentation);
+    }
+}
+
+- (void)abandon:(NSString *)reason
+{
+    NSLog(@"ReportStreamExtractor: stopped streaming at %@ (%@); the rest will be extracted after the download",
+        entryName ? entryName : @"the next entry", reason);
+    [self discardCurrentEntry];
+    _streaming = NO;
+}
+
+/*
+ * Create the directory and any missing parents, remembering which ones were created here.
+ */
+- (BOOL)ensureDirectory:(NSString *)directory
+{
+    if ([knownDirectories containsObject:directory]) {
+        return YES;
+    }
+    NSMutableArray<NSString *> *missing = [NSMutableArray array];
+    for (NSString *dir = directory; dir.length > self.destination.length && ![fileManager fileExistsAtPath:dir]; dir = [dir stringByDeletingLastPathComponent]) {
+        [missing addObject:dir];
+    }
+    if (![fileManager createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:nil]) {
+        return NO;
+    }
+    [createdDirectories addObjectsFromArray:missing.reverseObjectEnumerator.allObjects];
+    [knownDirectories addObject:directory];
+    return YES;
+}
+
+- (void)removePathForName:(NSString *)name
+{
+    NSString *path = [ReportArchive extractionPathForName:name inDirectory:self.destination];
+    if (!path) {
+        return;
+    }
+    if ([name hasSuffix:@"/"]) {
+        rmdir(path.fileSystemRepresentation);
+    }
+    else {
+        unlink(path.fileSystemRepresentation);
+    }
+}
+
+- (NSArray<ReportArchiveEntry *> *)entriesToExtractFromArchive:(ReportArchive *)archive
+{
+    [self discardCurrentEntry];
+
+    NSMutableArray<ReportArchiveEntry *> *remaining = [NSMutableArray array];
+    for (ReportArchiveEntry *entry in archive.entries) {
+        NSArray<NSNumber *> *record = streamed[entry.name];
+        if (!record || [record[0] unsignedIntValue] != entry.crc32 || [record[1] unsignedLongLongValue] != entry.uncompressedSize) {
+            [remaining addObject:entry];
+        }
+    }
+    for (NSString *name in streamed) {
+        if (![archive entryNamed:name]) {
+            [self removePathForName:name];
+        }
+    }
+
+    NSLog(@"ReportStreamExtractor: streamed %lu of %lu entries from %@, %lu left to extract",
+        (unsigned long)self.entriesStreamed, (unsigned long)archive.entries.count, archive.fileURL.lastPathComponent, (unsigned long)remaining.count);
+    return remaining;
+}
+
+- (void)removeStreamedFiles
+{
+    [self discardCurrentEntry];
+    for (NSString *name in streamed) {
+        [self removePathForName:name];
+    }
+    // deepest first, and only if nothing else was put there
+    for (NSString *directory in createdDirectories.reverseObjectEnumerator) {
+        rmdir(directory.fileSystemRepresentation);
+    }
+    [streamed removeAllObjects];
+    [createdDirectories removeAllObjects];
+    [knownDirectories removeAllObjects];
+}
+
+@end
@@ -0,0 +1,49 @@
+//
+//  ReportStreamingDownload.h
+//  DICE
+//
+
+#import <Foundation/Foundation.h>
+#import "ReportStreamExtractor.h"
+
+/**
+ Downloads a report zip while extracting it.  Each chunk received is appended to the
+ archive file and handed to a ReportStreamExtractor, so most of the report is on disk
+ by the time the last byte arrives.  When the download finishes the streamed entries
+ are verified against the archive's central directory, and the entries that did not
+ stream or do not match are extracted from the downloaded file.
+ */
+@interface ReportStreamingDownload : NSObject
+
+@property (nonatomic, readonly) NSURL *URL;
+@property (nonatomic, readonly) NSString *archivePath;
+@property (nonatomic, readonly) NSString *destination;
+@property (nonatomic, readonly) ReportStreamExtractor *streamExtractor;
+
+/**
+ Defaults to the default session configuration.
+ */
+@property (nonatomic, strong) NSURLSessionConfiguration *sessionConfiguration;
+
+/**
+ Called on the download's delegate queue as bytes arrive.
+ */
+@property (nonatomic, copy) void (^progressBlock)(int64_t bytesReceived, int64_t bytesExpected);
+
+/**
+ The number of entries extracted from the downloaded file after streaming.
+ */
+@property (nonatomic, readonly) NSUInteger entriesExtractedAfterDownload;
+
+- (instancetype)initWithURL:(NSURL *)URL archivePath:(NSString *)archivePath destination:(NSString *)destination;
+
+/**
+ Start the download.  The completion block is called once, on a background queue, after
+ the report is fully extracted or with the error that stopped it.  On failure the archive
+ file and the streamed files are removed.
+ */
+- (void)startWithCompletion:(void (^)(NSError *error))completion;
+
+- (void)cancel;
+
+@end
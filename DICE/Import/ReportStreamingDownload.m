@@ -0,0 +1,186 @@
+//
+//  ReportStreamingDownload.m
+//  DICE
+//
+
+#import "ReportStreamingDownload.h"
+
+#import "ReportExtractor.h"
+#import <fcntl.h>
+#import <unistd.h>
+
+@interface ReportStreamingDownload () <NSURLSessionDataDelegate>
+
+@end
+
+@implementation ReportStreamingDownload
+{
+    NSURLSession *session;
+    NSURLSessionDataTask *dataTask;
+    int archiveFile;
+    NSError *failure;
+    int64_t bytesReceived;
+    int64_t bytesExpected;
+    void (^completionBlock)(NSError *error);
+}
+
+- (instancetype)initWithURL:(NSURL *)URL archivePath:(NSString *)archivePath destination:(NSString *)destination
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _URL = URL;
+    _archivePath = archivePath;
+    _destination = destination;
+    _streamExtractor = [[ReportStreamExtractor alloc] initWithDestination:destination];
+    _sessionConfiguration = [NSURLSessionConfiguration defaultSessionConfiguration];
+    archiveFile = -1;
+
+    return self;
+}
+
+- (void)dealloc
+{
+    if (archiveFile >= 0) {
+        close(archiveFile);
+    }
+}
+
+- (void)startWithCompletion:(void (^)(NSError *error))completion
+{
+    completionBlock = [completion copy];
+
+    [[NSFileManager defaultManager] createDirectoryAtPath:[self.archivePath stringByDeletingLastPathComponent] withIntermediateDirectories:YES attributes:nil error:nil];
+    archiveFile = open(self.archivePath.fileSystemRepresentation, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (archiveFile < 0) {
+        NSError *error = [NSError errorWithDomain:ReportArchiveErrorDomain code:ReportArchiveErrorIO
+            userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"could not create %@: %s", self.archivePath, strerror(errno)]}];
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            [self finishWithError:error];
+        });
+        return;
+    }
+
+    // one chunk at a time, in order, since the stream extractor has to see the bytes sequentially
+    NSOperationQueue *delegateQueue = [[NSOperationQueue alloc] init];
+    delegateQueue.maxConcurrentOperationCount = 1;
+    delegateQueue.name = @"dice.streaming_download";
+    session = [NSURLSession sessionWithConfiguration:self.sessionConfiguration delegate:self delegateQueue:delegateQueue];
+    dataTask = [session dataTaskWithURL:self.URL];
+    [dataTask resume];
+}
+
+- (void)cancel
+{
+    [dataTask cancel];
+}
+
+- (void)URLSession:(NSURLSession *)aSession dataTask:(NSURLSessionDataTask *)task didReceiveResponse:(NSURLResponse *)response completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler
+{
+    if ([response isKindOfClass:[NSHTTPURLResponse class]] && ((NSHTTPURLResponse *)response).statusCode >= 400) {
+        NSInteger status = ((NSHTTPURLResponse *)response).statusCode;
+        failure = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorBadServerResponse
+            userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"%@ returned HTTP %ld", self.URL.host, (long)status]}];
+        completionHandler(NSURLSessionResponseCancel);
+        return;
+    }
+    bytesExpected = response.expectedContentLength;
+    completionHandler(NSURLSessionResponseAllow);
+}
+
+- (void)URLSession:(NSURLSession *)aSession dataTask:(NSURLSessionDataTask *)task didReceiveData:(NSData *)data
+{
+    if (failure) {
+        return;
+    }
+
+    __block NSError *chunkError;
+    [data enumerateByteRangesUsingBlock:^(const void *bytes, NSRange range, BOOL *stop) {
+        const uint8_t *p = bytes;
+        size_t length = range.length;
+        while (length > 0) {
+            ssize_t written = write(archiveFile, p, length);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                chunkError = [NSError errorWithDomain:ReportArchiveErrorDomain code:ReportArchiveErrorIO
+                    userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"could not write %@: %s", self.archivePath, strerror(errno)]}];
+                *stop = YES;
+                return;
+            }
+            p += written;
+            length -= (size_t)written;
+        }
+        if (self.streamExtractor.isStreaming && ![self.streamExtractor appendBytes:bytes length:range.length error:&chunkError]) {
+            *stop = YES;
+        }
+    }];
+
+    if (chunkError) {
+        failure = chunkError;
+        [task cancel];
+        return;
+    }
+
+    bytesReceived += data.length;
+    if (self.progressBlock) {
+        self.progressBlock(bytesReceived, bytesExpected);
+    }
+}
+
+- (void)URLSession:(NSURLSession *)aSession task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error
+{
+    close(archiveFile);
+    archiveFile = -1;
+    // the session holds on to its delegate until it is invalidated
+    [session finishTasksAndInvalidate];
+
+    NSError *result = failure ? failure : error;
+    if (!result) {
+        result = [self extractRemainingEntries];
+    }
+    [self finishWithError:result];
+}
+
+/*
+ * Check the streamed entries against the central directory and extract whatever is missing or wrong.
+ */
+- (NSError *)extractRemainingEntries
+{
+    NSError *error;
+    ReportArchive *archive = [ReportArchive archiveWithURL:[NSURL fileURLWithPath:self.archivePath] error:&error];
+    if (!archive) {
+        return error;
+    }
+
+    NSArray<ReportArchiveEntry *> *remaining = [self.streamExtractor entriesToExtractFromArchive:archive];
+    BOOL success = YES;
+    if (remaining.count > 0) {
+        ReportExtractor *extractor = [[ReportExtractor alloc] initWithArchive:archive destination:self.destination];
+        extractor.entries = remaining;
+        success = [extractor extract:&error];
+        _entriesExtractedAfterDownload = (NSUInteger)extractor.entriesExtracted;
+    }
+    [archive close];
+
+    return success ? nil : error;
+}
+
+- (void)finishWithError:(NSError *)error
+{
+    if (error) {
+        NSLog(@"ReportStreamingDownload: download of %@ failed: %@", self.URL, error.localizedDescription);
+        [self.streamExtractor removeStreamedFiles];
+        unlink(self.archivePath.fileSystemRepresentation);
+    }
+    void (^completion)(NSError *) = completionBlock;
+    completionBlock = nil;
+    if (completion) {
+        completion(error);
+    }
+}
+
+@end
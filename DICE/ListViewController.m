@@ -25,7 +25,10 @@
     
     [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(refreshReportList:) name:[ReportNotification reportImportFinished] object:nil];
     [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(refreshReportList:) name:[ReportNotification reportImportProgress] object:nil];
+    [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(refreshReportList:) name:[ReportNotification reportMetadataReady] object:nil];
     [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(refreshReportList:) name:[ReportNotification reportsLoaded] object:nil];
+    [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(refreshReportList:) name:[ReportNotification reportRemoved] object:nil];
+    [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(refreshReportList:) name:[ReportNotification reportsChanged] object:nil];
     
     self.title = @"Disconnected Interactive Content Explorer";
     
@@ -60,6 +63,7 @@
         if ([notification.name isEqualToString:[ReportNotification reportsLoaded]]) {
             [_tableViewController.refreshControl endRefreshing];
         }
+        self.reports = [[ReportAPI sharedInstance] getReports];
         [_tableView reloadData];
     });
 }
@@ -128,7 +132,7 @@
     else {
         cell.userInteractionEnabled = cell.textLabel.enabled = cell.detailTextLabel.enabled = NO;
         if (report.totalNumberOfFiles > 0 && report.progress > 0) {
-            cell.detailTextLabel.text = [NSString stringWithFormat:@"%d of %d files unzipped", report.progress, report.totalNumberOfFiles ];
+            cell.detailTextLabel.text = [NSString stringWithFormat:@"%lld of %lld files unzipped", report.progress, report.totalNumberOfFiles];
         } else if (report.downloadSize > 0 && report.downloadProgress > 0) {
             float progress = ((float)report.downloadProgress) / report.downloadSize;
             cell.detailTextLabel.text = [NSString stringWithFormat:@"%d %% downloaded", (int)(progress *100)];
@@ -166,7 +170,7 @@
 -(void)tableView:(UITableView *)tableView commitEditingStyle:(UITableViewCellEditingStyle)editingStyle forRowAtIndexPath:(NSIndexPath *)indexPath
 {
     if (editingStyle == UITableViewCellEditingStyleDelete) {
-        [[ReportAPI sharedInstance] deleteReportAtIndexPath:indexPath];
+        [[ReportAPI sharedInstance] deleteReport:self.reports[indexPath.row]];
     }
 }
 
@@ -0,0 +1,77 @@
+//
+//  GeoPackageRenderContext.h
+//  DICE
+//
+
+#import <Foundation/Foundation.h>
+#import "GPKGGeoPackage.h"
+#import "GPKGGeoPackageTileRetriever.h"
+#import "GPKGFeatureTiles.h"
+#import "GeoPackageTileReader.h"
+
+/**
+ *  The objects needed to serve tiles from a single GeoPackage table, created once and reused for
+ *  every tile so a tile request only runs its tile query or feature draw.  A context must only be
+ *  used by one request at a time; GeoPackageRenderContextPool hands them out.
+ */
+@interface GeoPackageRenderContext : NSObject
+
+/**
+ *  GeoPackage the context was created from
+ */
+@property (nonatomic, strong, readonly) GPKGGeoPackage * geoPackage;
+
+/**
+ *  Table name
+ */
+@property (nonatomic, strong, readonly) NSString * table;
+
+/**
+ *  Tile retriever, when a tile table
+ */
+@property (nonatomic, strong, readonly) GPKGGeoPackageTileRetriever * retriever;
+
+/**
+ *  Stored tile reader, when a tile table with zoom levels that line up with web mercator tiles
+ */
+@property (nonatomic, strong, readonly) GeoPackageTileReader * reader;
+
+/**
+ *  Feature tiles with their index manager, when an indexed feature table
+ */
+@property (nonatomic, strong, readonly) GPKGFeatureTiles * featureTiles;
+
+/**
+ *  Initializer
+ *
+ *  @param geoPackage GeoPackage
+ *  @param table      table name
+ *
+ *  @return new instance, or nil if the table is neither a tile table nor an indexed feature table
+ */
+-(instancetype) initWithGeoPackage: (GPKGGeoPackage *) geoPackage andTable: (NSString *) table;
+
+/**
+ *  Get the tile data, reading the stored tile of a tile table, retrieving it, or drawing the features of a feature table
+ *
+ *  @param x    x coordinate
+ *  @param y    y coordinate
+ *  @param zoom zoom level
+ *
+ *  @return tile data, or nil if the table has nothing at the tile
+ */
+-(NSData *) tileDataWithX: (int) x andY: (int) y andZoom: (int) zoom;
+
+/**
+ *  Get the tile data, giving up before the feature draw if the tile is no longer wanted
+ *
+ *  @param x         x coordinate
+ *  @param y         y coordinate
+ *  @param zoom      zoom level
+ *  @param cancelled returns true once the tile is no longer wanted, may be nil
+ *
+ *  @return tile data, or nil if the table has nothing at the tile or the tile was cancelled
+ */
+-(NSData *) tileDataWithX: (int) x andY: (int) y andZoom: (int) zoom andCancelled: (BOOL (^)(void)) cancelled;
+
+@end
@@ -0,0 +1,67 @@
+//
+//  GeoPackageRenderContext.m
+//  DICE
+//
+
+#import "GeoPackageRenderContext.h"
+
+@implementation GeoPackageRenderContext
+
+-(instancetype) initWithGeoPackage: (GPKGGeoPackage *) geoPackage andTable: (NSString *) table{
+    self = [super init];
+    if(self == nil){
+        return nil;
+    }
+    
+    _geoPackage = geoPackage;
+    _table = table;
+    
+    if([geoPackage isTileTable:table]){
+        GPKGTileDao * tileDao = [geoPackage getTileDaoWithTableName:table];
+        _retriever = [[GPKGGeoPackageTileRetriever alloc] initWithTileDao:tileDao];
+        _reader = [[GeoPackageTileReader alloc] initWithPath:geoPackage.path andTable:table];
+    } else if([geoPackage isFeatureTable:table]){
+        GPKGFeatureDao * featureDao = [geoPackage getFeatureDaoWithTableName:table];
+        GPKGFeatureTiles * featureTiles = [[GPKGFeatureTiles alloc] initWithFeatureDao:featureDao];
+        GPKGFeatureIndexManager * indexer = [[GPKGFeatureIndexManager alloc] initWithGeoPackage:geoPackage andFeatureDao:featureDao];
+        [featureTiles setIndexManager:indexer];
+        // Only indexed feature tables are drawn as tiles
+        if([featureTiles isIndexQuery]){
+            _featureTiles = featureTiles;
+        }
+    }
+    
+    if(_retriever == nil && _featureTiles == nil){
+        return nil;
+    }
+    
+    return self;
+}
+
+-(NSData *) tileDataWithX: (int) x andY: (int) y andZoom: (int) zoom{
+    return [self tileDataWithX:x andY:y andZoom:zoom andCancelled:nil];
+}
+
+-(NSData *) tileDataWithX: (int) x andY: (int) y andZoom: (int) zoom andCancelled: (BOOL (^)(void)) cancelled{
+    NSData * tileData = nil;
+    
+    if(self.reader != nil && [self.reader readsZoom:zoom]){
+        tileData = [self.reader tileDataWithX:x andY:y andZoom:zoom];
+    } else if(self.retriever != nil){
+        if([self.retriever hasTileWithX:x andY:y andZoom:zoom]){
+            GPKGGeoPackageTile * tile = [self.retriever getTileWithX:x andY:y andZoom:zoom];
+            if(tile != nil){
+                tileData = tile.data;
+            }
+        }
+    } else if([self.featureTiles queryIndexedFeaturesCountWithX:x andY:y andZoom:zoom] > 0){
+        // The draw itself can not be interrupted, so check right before it
+        if(cancelled == nil || !cancelled()){
+            tileData = [self.featureTiles drawTileDataWithX:x andY:y andZoom:zoom];
+        }
+    }
+    
+    return tileData;
+}
+
+@end
@@ -0,0 +1,46 @@
+//
+//  GeoPackageRenderContextPool.h
+//  DICE
+//
+
+#import <Foundation/Foundation.h>
+#import "GeoPackageRenderContext.h"
+
+/**
+ *  Render contexts kept per GeoPackage and table for the life of a report's map, so concurrent tile
+ *  requests each check out a context of their own instead of building one for every tile.  Thread safe.
+ */
+@interface GeoPackageRenderContextPool : NSObject
+
+/**
+ *  Check out an idle context for the table, creating one if there is none
+ *
+ *  @param geoPackage GeoPackage
+ *  @param name       GeoPackage name
+ *  @param table      table name
+ *
+ *  @return render context, or nil if the table can not be drawn as tiles
+ */
+-(GeoPackageRenderContext *) checkOutContextForGeoPackage: (GPKGGeoPackage *) geoPackage withName: (NSString *) name andTable: (NSString *) table;
+
+/**
+ *  Return a context checked out for the GeoPackage name
+ *
+ *  @param context render context
+ *  @param name    GeoPackage name
+ */
+-(void) checkInContext: (GeoPackageRenderContext *) context withName: (NSString *) name;
+
+/**
+ *  Drop the contexts of a GeoPackage, e.g., when it is closed
+ *
+ *  @param name GeoPackage name
+ */
+-(void) removeContextsForGeoPackage: (NSString *) name;
+
+/**
+ *  Drop all contexts
+ */
+-(void) removeAll;
+
+@end
@@ -0,0 +1,96 @@
+//
+//  GeoPackageRenderContextPool.m
+//  DICE
+//
+
+#import "GeoPackageRenderContextPool.h"
+
+@interface GeoPackageRenderContextPool ()
+
+/**
+ *  Idle contexts by GeoPackage name, then by table name
+ */
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSMutableDictionary<NSString *, NSMutableArray<GeoPackageRenderContext *> *> *> * idleContexts;
+
+/**
+ *  Tables by GeoPackage name that can not be drawn as tiles
+ */
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSMutableSet<NSString *> *> * undrawableTables;
+
+@end
+
+@implementation GeoPackageRenderContextPool
+
+-(instancetype) init{
+    if (self = [super init]) {
+        self.idleContexts = [[NSMutableDictionary alloc] init];
+        self.undrawableTables = [[NSMutableDictionary alloc] init];
+    }
+    return self;
+}
+
+-(GeoPackageRenderContext *) checkOutContextForGeoPackage: (GPKGGeoPackage *) geoPackage withName: (NSString *) name andTable: (NSString *) table{
+    @synchronized (self) {
+        if([[self.undrawableTables objectForKey:name] containsObject:table]){
+            return nil;
+        }
+        NSMutableArray<GeoPackageRenderContext *> * contexts = [[self.idleContexts objectForKey:name] objectForKey:table];
+        while(contexts.count > 0){
+            GeoPackageRenderContext * context = contexts.lastObject;
+            [contexts removeLastObject];
+            // Contexts of a GeoPackage that has since been closed and reopened are dropped
+            if(context.geoPackage == geoPackage){
+                return context;
+            }
+        }
+    }
+    
+    // Build outside the lock, it queries the GeoPackage metadata
+    GeoPackageRenderContext * context = [[GeoPackageRenderContext alloc] initWithGeoPackage:geoPackage andTable:table];
+    if(context == nil){
+        @synchronized (self) {
+            NSMutableSet<NSString *> * tables = [self.undrawableTables objectForKey:name];
+            if(tables == nil){
+                tables = [[NSMutableSet alloc] init];
+                [self.undrawableTables setObject:tables forKey:name];
+            }
+            [tables addObject:table];
+        }
+    }
+    return context;
+}
+
+-(void) checkInContext: (GeoPackageRenderContext *) context withName: (NSString *) name{
+    if(context == nil){
+        return;
+    }
+    @synchronized (self) {
+        NSMutableDictionary<NSString *, NSMutableArray<GeoPackageRenderContext *> *> * tables = [self.idleContexts objectForKey:name];
+        if(tables == nil){
+            tables = [[NSMutableDictionary alloc] init];
+            [self.idleContexts setObject:tables forKey:name];
+        }
+        NSMutableArray<GeoPackageRenderContext *> * contexts = [tables objectForKey:context.table];
+        if(contexts == nil){
+            contexts = [[NSMutableArray alloc] init];
+            [tables setObject:contexts forKey:context.table];
+        }
+        [contexts addObject:context];
+    }
+}
+
+-(void) removeContextsForGeoPackage: (NSString *) name{
+    @synchronized (self) {
+        [self.idleContexts removeObjectForKey:name];
+        [self.undrawableTables removeObjectForKey:name];
+    }
+}
+
+-(void) removeAll{
+    @synchronized (self) {
+        [self.idleContexts removeAllObjects];
+        [self.undrawableTables removeAllObjects];
+    }
+}
+
+@end
@@ -0,0 +1,63 @@
+//
+//  GeoPackageTileReader.h
+//  DICE
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ *  Reads the stored tile images of a GeoPackage tile table whose tile matrices line up with the
+ *  web mercator tiles the map asks for, so a tile is served as it is stored, without the retriever
+ *  decoding, redrawing, and encoding it again.  The reader has its own read only, memory mapped
+ *  connection to the GeoPackage file and keeps its tile query prepared, so each tile runs one
+ *  bound query and its blob is copied once, from the mapped page into the returned data.
+ *
+ *  A reader must only be used by one request at a time, like the render context that holds it.
+ */
+@interface GeoPackageTileReader : NSObject
+
+/**
+ *  Tile table name
+ */
+@property (nonatomic, strong, readonly) NSString * table;
+
+/**
+ *  Initializer
+ *
+ *  @param path  GeoPackage file path
+ *  @param table tile table name
+ *
+ *  @return new instance, or nil if the file can not be opened or no zoom level of the table lines up with web mercator tiles
+ */
+-(instancetype) initWithPath: (NSString *) path andTable: (NSString *) table;
+
+/**
+ *  Check if the tiles at the zoom level are stored as web mercator tiles, so they can be read as they are
+ *
+ *  @param zoom zoom level
+ *
+ *  @return true if the reader serves the zoom level
+ */
+-(BOOL) readsZoom: (int) zoom;
+
+/**
+ *  Get the stored tile image
+ *
+ *  @param x    x coordinate
+ *  @param y    y coordinate
+ *  @param zoom zoom level, one the reader serves
+ *
+ *  @return tile data, or nil if there is no tile
+ */
+-(NSData *) tileDataWithX: (int) x andY: (int) y andZoom: (int) zoom;
+
+/**
+ *  Get the MIME type of tile image data from its leading bytes
+ *
+ *  @param data tile data
+ *
+ *  @return image/png, image/jpeg, image/webp, image/gif, or image/tiff, defaulting to image/png
+ */
++(NSString *) mimeTypeOfTileData: (NSData *) data;
+
+@end
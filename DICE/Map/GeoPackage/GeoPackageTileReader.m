@@ -0,0 +1,173 @@
+//
+//  GeoPackageTileReader.m
+//  DICE
+//
+
+#import "GeoPackageTileReader.h"
+#import <sqlite3.h>
+
+/**
+ *  Web mercator bounds are +/- this in both x and y
+ */
+static double const WEB_MERCATOR_HALF_WORLD = 20037508.342789244;
+
+/**
+ *  Width and height of the map's tiles
+ */
+static int const WEB_MERCATOR_TILE_SIZE = 256;
+
+/**
+ *  Largest map of the GeoPackage file for reading tiles
+ */
+static int64_t const MMAP_SIZE = 256 << 20;
+
+@interface GeoPackageTileReader ()
+
+/**
+ *  Zoom levels stored as web mercator tiles
+ */
+@property (nonatomic, strong) NSIndexSet * zoomLevels;
+
+@end
+
+@implementation GeoPackageTileReader{
+    sqlite3 * database;
+    sqlite3_stmt * tileStatement;
+}
+
+-(instancetype) initWithPath: (NSString *) path andTable: (NSString *) table{
+    self = [super init];
+    if(self == nil){
+        return nil;
+    }
+
+    _table = table;
+
+    if(path == nil || table == nil || sqlite3_open_v2([path UTF8String], &database, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK){
+        return nil;
+    }
+
+    // Map the file, so tile pages are read where they are instead of copied into the page cache
+    NSString * mmapSql = [NSString stringWithFormat:@"PRAGMA mmap_size = %lld", (long long)MMAP_SIZE];
+    sqlite3_exec(database, [mmapSql UTF8String], NULL, NULL, NULL);
+
+    self.zoomLevels = [self webMercatorZoomLevels];
+    if(self.zoomLevels.count == 0){
+        return nil;
+    }
+
+    NSString * quotedTable = [table stringByReplacingOccurrencesOfString:@"\"" withString:@"\"\""];
+    NSString * tileSql = [NSString stringWithFormat:@"SELECT tile_data FROM \"%@\" WHERE zoom_level = ? AND tile_column = ? AND tile_row = ?", quotedTable];
+    if(sqlite3_prepare_v2(database, [tileSql UTF8String], -1, &tileStatement, NULL) != SQLITE_OK){
+        return nil;
+    }
+
+    return self;
+}
+
+-(void) dealloc{
+    sqlite3_finalize(tileStatement);
+    sqlite3_close(database);
+}
+
+/**
+ *  Find the zoom levels of the table whose tile matrix is the web mercator tile grid: a tile matrix set in
+ *  EPSG:3857 covering the world, and at the zoom level, 2^zoom by 2^zoom tiles of 256 by 256 pixels
+ *
+ *  @return zoom levels
+ */
+-(NSIndexSet *) webMercatorZoomLevels{
+
+    NSMutableIndexSet * zoomLevels = [[NSMutableIndexSet alloc] init];
+
+    double boundsError = -1;
+    sqlite3_stmt * statement = NULL;
+    const char * tileMatrixSetSql = "SELECT t.min_x, t.min_y, t.max_x, t.max_y FROM gpkg_tile_matrix_set t"
+        " JOIN gpkg_spatial_ref_sys s ON s.srs_id = t.srs_id"
+        " WHERE t.table_name = ? AND upper(s.organization) = 'EPSG' AND s.organization_coordsys_id = 3857";
+    if(sqlite3_prepare_v2(database, tileMatrixSetSql, -1, &statement, NULL) == SQLITE_OK){
+        sqlite3_bind_text(statement, 1, [self.table UTF8String], -1, SQLITE_TRANSIENT);
+        if(sqlite3_step(statement) == SQLITE_ROW){
+            boundsError = MAX(MAX(fabs(sqlite3_column_double(statement, 0) + WEB_MERCATOR_HALF_WORLD),
+                                  fabs(sqlite3_column_double(statement, 1) + WEB_MERCATOR_HALF_WORLD)),
+                              MAX(fabs(sqlite3_column_double(statement, 2) - WEB_MERCATOR_HALF_WORLD),
+                                  fabs(sqlite3_column_double(statement, 3) - WEB_MERCATOR_HALF_WORLD)));
+        }
+    }
+    sqlite3_finalize(statement);
+
+    if(boundsError < 0){
+        return zoomLevels;
+    }
+
+    statement = NULL;
+    const char * tileMatrixSql = "SELECT zoom_level, matrix_width, matrix_height, tile_width, tile_height FROM gpkg_tile_matrix WHERE table_name = ?";
+    if(sqlite3_prepare_v2(database, tileMatrixSql, -1, &statement, NULL) == SQLITE_OK){
+        sqlite3_bind_text(statement, 1, [self.table UTF8String], -1, SQLITE_TRANSIENT);
+        while(sqlite3_step(statement) == SQLITE_ROW){
+            int zoom = sqlite3_column_int(statement, 0);
+            if(zoom < 0 || zoom > 30){
+                continue;
+            }
+            sqlite3_int64 tiles = (sqlite3_int64)1 << zoom;
+            // Bounds off by less than half a pixel at the zoom level still line up
+            double halfPixel = WEB_MERCATOR_HALF_WORLD / (tiles * WEB_MERCATOR_TILE_SIZE);
+            if(sqlite3_column_int64(statement, 1) == tiles
+               && sqlite3_column_int64(statement, 2) == tiles
+               && sqlite3_column_int(statement, 3) == WEB_MERCATOR_TILE_SIZE
+               && sqlite3_column_int(statement, 4) == WEB_MERCATOR_TILE_SIZE
+               && boundsError < halfPixel){
+                [zoomLevels addIndex:zoom];
+            }
+        }
+    }
+    sqlite3_finalize(statement);
+
+    return zoomLevels;
+}
+
+-(BOOL) readsZoom: (int) zoom{
+    return zoom >= 0 && [self.zoomLevels containsIndex:zoom];
+}
+
+-(NSData *) tileDataWithX: (int) x andY: (int) y andZoom: (int) zoom{
+
+    NSData * tileData = nil;
+
+    // GeoPackage tile rows count down from the top, like the map's y
+    sqlite3_bind_int(tileStatement, 1, zoom);
+    sqlite3_bind_int(tileStatement, 2, x);
+    sqlite3_bind_int(tileStatement, 3, y);
+    if(sqlite3_step(tileStatement) == SQLITE_ROW){
+        const void * blob = sqlite3_column_blob(tileStatement, 0);
+        int length = sqlite3_column_bytes(tileStatement, 0);
+        if(blob != NULL && length > 0){
+            // The blob is only valid until the statement is reset, so this is its one copy
+            tileData = [NSData dataWithBytes:blob length:length];
+        }
+    }
+    sqlite3_reset(tileStatement);
+
+    return tileData;
+}
+
++(NSString *) mimeTypeOfTileData: (NSData *) data{
+
+    NSString * mimeType = @"image/png";
+
+    const uint8_t * bytes = data.bytes;
+    NSUInteger length = data.length;
+    if(length >= 3 && bytes[0] == 0xFF && bytes[1] == 0xD8 && bytes[2] == 0xFF){
+        mimeType = @"image/jpeg";
+    } else if(length >= 12 && memcmp(bytes, "RIFF", 4) == 0 && memcmp(bytes + 8, "WEBP", 4) == 0){
+        mimeType = @"image/webp";
+    } else if(length >= 4 && memcmp(bytes, "GIF8", 4) == 0){
+        mimeType = @"image/gif";
+    } else if(length >= 4 && (memcmp(bytes, "II*\0", 4) == 0 || memcmp(bytes, "MM\0*", 4) == 0)){
+        mimeType = @"image/tiff";
+    }
+
+    return mimeType;
+}
+
+@end
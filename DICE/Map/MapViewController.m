@@ -4,6 +4,7 @@
 //
 
 #import "MapViewController.h"
+#import "ReportAPI.h"
 #import "GeoPackageMapOverlays.h"
 #import "DICEConstants.h"
 #import "GPKGMapPoint.h"
@@ -61,6 +62,8 @@ static NSString *mapPointPinReuseIdentifier = @"mapPointPinReuseIdentifier";
     
     [self update];
     
+    [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(reportMetadataReady:) name:[ReportNotification reportMetadataReady] object:nil];
+    
     NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
     [defaults addObserver:self
                forKeyPath:DICE_SELECTED_CACHES_UPDATED
@@ -72,6 +75,8 @@ static NSString *mapPointPinReuseIdentifier = @"mapPointPinReuseIdentifier";
     
     [super viewWillDisappear:animated];
     
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:[ReportNotification reportMetadataReady] object:nil];
+    
     NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
     [defaults removeObserver:self forKeyPath:DICE_SELECTED_CACHES_UPDATED];
 }
@@ -93,6 +98,7 @@ static NSString *mapPointPinReuseIdentifier = @"mapPointPinReuseIdentifier";
 
 -(void) update{
     
+    self.reports = [[ReportAPI sharedInstance] getReports];
     self.noLocationsView.hidden = NO;
     
     [self.mapView removeAnnotations:self.reportAnnotations];
@@ -153,6 +159,27 @@ static NSString *mapPointPinReuseIdentifier = @"mapPointPinReuseIdentifier";
     });
 }
 
+/*
+ * Pin a report as soon as its location is known, rather than waiting for it to finish importing.
+ */
+- (void)reportMetadataReady:(NSNotification *)notification
+{
+    Report *report = notification.userInfo[@"report"];
+    if (report.lat == 0.0f || report.lon == 0.0f) {
+        return;
+    }
+    for (ReportMapAnnotation *annotation in self.mapView.annotations) {
+        if ([annotation isKindOfClass:[ReportMapAnnotation class]] && annotation.report == report) {
+            return;
+        }
+    }
+    
+    ReportMapAnnotation *annotation = [[ReportMapAnnotation alloc] initWithReport:report];
+    [self.reportAnnotations addObject:annotation];
+    [self.mapView addAnnotation:(id)annotation];
+    self.noLocationsView.hidden = YES;
+}
+
 - (void)didReceiveMemoryWarning
 {
     [super didReceiveMemoryWarning];
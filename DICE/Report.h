@@ -6,7 +6,7 @@
 #import <Foundation/Foundation.h>
 #import "ReportCache.h"
 
-@interface Report : NSObject
+@interface Report : NSObject <NSCoding>
 
 @property (nonatomic, strong) NSString *reportID;
 @property (nonatomic, strong) NSString *title;
@@ -19,10 +19,10 @@
 @property (nonatomic, strong) NSURL *sourceFile;
 @property (nonatomic) double lat;
 @property (nonatomic) double lon;
-@property (nonatomic) int totalNumberOfFiles;
-@property (nonatomic) int progress;
-@property (nonatomic) long downloadSize;
-@property (nonatomic) long downloadProgress;
+@property (nonatomic) int64_t totalNumberOfFiles;
+@property (nonatomic) int64_t progress;
+@property (nonatomic) int64_t downloadSize;
+@property (nonatomic) int64_t downloadProgress;
 @property (nonatomic) BOOL isEnabled;
 @property (nonatomic) NSMutableArray<ReportCache *> * cacheFiles;
 
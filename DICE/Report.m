@@ -28,6 +28,50 @@
     return self;
 }
 
+- (id) initWithCoder:(NSCoder *)decoder {
+    self = [self initWithTitle:[decoder decodeObjectForKey:@"title"]];
+
+    if (self) {
+        self.reportID = [decoder decodeObjectForKey:@"reportID"];
+        self.summary = [decoder decodeObjectForKey:@"summary"];
+        self.thumbnail = [decoder decodeObjectForKey:@"thumbnail"];
+        self.tileThumbnail = [decoder decodeObjectForKey:@"tileThumbnail"];
+        self.fileExtension = [decoder decodeObjectForKey:@"fileExtension"];
+        self.error = [decoder decodeObjectForKey:@"error"];
+        self.url = [decoder decodeObjectForKey:@"url"];
+        self.sourceFile = [decoder decodeObjectForKey:@"sourceFile"];
+        self.lat = [decoder decodeDoubleForKey:@"lat"];
+        self.lon = [decoder decodeDoubleForKey:@"lon"];
+        self.totalNumberOfFiles = [decoder decodeInt64ForKey:@"totalNumberOfFiles"];
+        self.progress = [decoder decodeInt64ForKey:@"progress"];
+        self.isEnabled = [decoder decodeBoolForKey:@"isEnabled"];
+        NSArray *cacheFiles = [decoder decodeObjectForKey:@"cacheFiles"];
+        if (cacheFiles) {
+            [self.cacheFiles addObjectsFromArray:cacheFiles];
+        }
+    }
+
+    return self;
+}
+
+- (void) encodeWithCoder:(NSCoder *)encoder {
+    [encoder encodeObject:self.reportID forKey:@"reportID"];
+    [encoder encodeObject:self.title forKey:@"title"];
+    [encoder encodeObject:self.summary forKey:@"summary"];
+    [encoder encodeObject:self.thumbnail forKey:@"thumbnail"];
+    [encoder encodeObject:self.tileThumbnail forKey:@"tileThumbnail"];
+    [encoder encodeObject:self.fileExtension forKey:@"fileExtension"];
+    [encoder encodeObject:self.error forKey:@"error"];
+    [encoder encodeObject:self.url forKey:@"url"];
+    [encoder encodeObject:self.sourceFile forKey:@"sourceFile"];
+    [encoder encodeDouble:self.lat forKey:@"lat"];
+    [encoder encodeDouble:self.lon forKey:@"lon"];
+    [encoder encodeInt64:self.totalNumberOfFiles forKey:@"totalNumberOfFiles"];
+    [encoder encodeInt64:self.progress forKey:@"progress"];
+    [encoder encodeBool:self.isEnabled forKey:@"isEnabled"];
+    [encoder encodeObject:[self.cacheFiles copy] forKey:@"cacheFiles"];
+}
+
 - (NSURL *) thumbnailURL {
     return [NSURL URLWithString:self.thumbnail];
 }
@@ -34,13 +34,29 @@
  */
 + (NSString *)reportImportBegan;
 /**
- This notification indicates progress on importing a given report.
+ This notification indicates that a report's title, description, thumbnails, and
+ location were read from its metadata.json, ahead of extracting the rest of the
+ report.  The report is not ready to view until reportImportFinished.
+ The NSNotification object userInfo dictionary contains
+ {
+     @"report": (Report*) the report being imported,
+     @"index": (NSString*) integral index of the report in the reports array
+ }
+ */
++ (NSString *)reportMetadataReady;
+/**
+ This notification indicates progress on importing a given report.  It is posted
+ at most a few times a second for each report, no matter how fast the import goes.
  The NSNotification object userInfo dictionary contains
  {
      @"report": (Report*) the report object being imported,
      @"progress": (NSString*) integral number of files that have been imported,
-     @"totalNumberOfFiles": (NSString*) integral total number for files the report contains
+     @"totalNumberOfFiles": (NSString*) integral total number for files the report contains,
+     @"bytesExtracted": (NSNumber*) bytes of the report that have been extracted,
+     @"totalBytes": (NSNumber*) total bytes of the files being extracted
  }
+ While the report is downloading, @"progress" is the fraction downloaded and there
+ are no byte counts.
  */
 + (NSString *)reportImportProgress;
 /**
@@ -53,6 +69,16 @@
  }
  */
 + (NSString *)reportImportFinished;
+/**
+ This notification indicates that the import of a given report was cancelled, e.g., because
+ the report was deleted or its file was removed from Documents, so the report will not
+ become ready to view unless it is imported again.
+ The NSNotification object userInfo dictionary contains
+ {
+     @"report": (Report*) the report whose import was cancelled
+ }
+ */
++ (NSString *)reportImportCancelled;
 /**
  This notification indicates that ReportAPI has finished scanning for report files
  in the Documents directory and has populated the report list with its findings.
@@ -61,6 +87,43 @@
  The NSNotification object has a nil userInfo dictionary.
  */
 + (NSString *)reportsLoaded;
+/**
+ This notification indicates that a report was deleted and is no longer in the report list.
+ The NSNotification object userInfo dictionary contains
+ {
+     @"report": (Report*) the deleted report,
+     @"index": (NSString*) integral index the report had in the reports array
+ }
+ */
++ (NSString *)reportRemoved;
+/**
+ This notification indicates that files in the Documents directory were added, removed, or
+ changed after the reports were loaded, and carries only the reports that changed because
+ of it, rather than a rescan of the whole list.  Added reports also get reportAdded, and
+ changed reports are imported again.
+ The NSNotification object userInfo dictionary contains
+ {
+     @"added": (NSArray<Report*>*) the reports for new files,
+     @"removed": (NSArray<Report*>*) the reports whose files were removed, no longer in the reports array,
+     @"modified": (NSArray<Report*>*) the reports whose files changed
+ }
+ */
++ (NSString *)reportsChanged;
+/**
+ This notification indicates the combined progress of a batch of reports imported together,
+ e.g., several zips dropped into Documents at once.  It is posted a few times a second at most
+ while the batch imports, and once more when the last report in it is done.
+ The NSNotification object userInfo dictionary contains
+ {
+     @"reportCount": (NSNumber*) the number of reports in the batch,
+     @"finishedCount": (NSNumber*) the number of them that are done,
+     @"bytesExtracted": (NSNumber*) bytes extracted so far across the batch,
+     @"totalBytes": (NSNumber*) total bytes the batch extracts; reports mounted for lack of space are not counted,
+     @"bytesPerSecond": (NSNumber*) the batch's throughput so far,
+     @"secondsRemaining": (NSNumber*) the estimated time left, or -1 until it can be estimated
+ }
+ */
++ (NSString *)reportBatchProgress;
 
 @end
 
@@ -75,6 +138,25 @@
 - (void)loadReportsWithCompletionHandler:(void(^) (void))completionHandler;
 - (Report *)reportForID:(NSString *)reportID;
 - (void)downloadReportAtURL:(NSURL *)URL withFilename:(NSString *)filename;
-- (void)deleteReportAtIndexPath:(NSIndexPath *)indexPath;
+/**
+ Delete the report and its files.  Views pass the report they show rather than its position, which
+ may differ from the position in the report list by the time the user confirms.
+ */
+- (void)deleteReport:(Report *)report;
+
+/**
+ Import the report ahead of the others waiting to be imported, e.g., because the user is waiting to view it.
+ */
+- (void)prioritizeImportOfReport:(Report *)report;
+/**
+ Note that the user is opening the report, so its extracted contents are the last to be evicted.
+ A report that was evicted is extracted again, first in line; one still importing is moved to
+ the front of the line.  Either way, the report is not enabled until reportImportFinished, so
+ the block is called on the main thread with YES once the report can be shown, right away if
+ it already can, or with NO if its import fails or is cancelled, e.g., because the report was
+ deleted while the user waited.
+ */
+- (void)openReport:(Report *)report whenReady:(void(^)(BOOL ready))readyBlock;
+- (void)cancelImportOfReport:(Report *)report;
 
 @end
@@ -6,18 +6,28 @@
 #import "ReportAPI.h"
 
 #import "ResourceTypes.h"
-#import "zlib.h"
-#import "ZipFile.h"
-#import "ZipReadStream.h"
-#import "ZipException.h"
-#import "FileInZipInfo.h"
-#import "GPKGIOUtils.h"
+#import "ReportArchive.h"
+#import "ReportExtractor.h"
+#import "ReportContentStore.h"
+#import "ReportEntryClassifier.h"
+#import "ReportImportBatch.h"
+#import "ReportImportManifest.h"
+#import "ReportImportScheduler.h"
+#import "ReportProgressChannel.h"
+#import "ReportStreamingDownload.h"
+#import "ReportRangedDownload.h"
 #import "DICEConstants.h"
 #import "AFNetworking.h"
-#import "GPKGGeoPackageConstants.h"
 #import "GPKGGeoPackageFactory.h"
+#import "GeoPackageTileCache.h"
 #import "GeoPackageURLProtocol.h"
-#import <math.h>
+#import "GPKGGeoPackageValidate.h"
+#import "ReportArchiveURLProtocol.h"
+#import "ReportCatalog.h"
+#import "ReportDirectoryWatcher.h"
+#import "ReportRegistry.h"
+#import "ReportStorageManager.h"
+#import "ReportTrash.h"
 
 @implementation ReportNotification
 
@@ -27,6 +37,9 @@
 + (NSString *)reportImportBegan {
     return @"DICE.ReportImportBegan";
 }
++ (NSString *)reportMetadataReady {
+    return @"DICE.ReportMetadataReady";
+}
 + (NSString *)reportImportProgress {
     return @"DICE.ReportImportProgress";
 }
@@ -36,28 +49,61 @@
 + (NSString *)reportImportFail {
     return @"DICE.ReportImportFail";
 }
++ (NSString *)reportImportCancelled {
+    return @"DICE.ReportImportCancelled";
+}
 + (NSString *)reportsLoaded {
     return @"DICE.ReportsLoaded";
 }
++ (NSString *)reportRemoved {
+    return @"DICE.ReportRemoved";
+}
++ (NSString *)reportsChanged {
+    return @"DICE.ReportsChanged";
+}
++ (NSString *)reportBatchProgress {
+    return @"DICE.ReportBatchProgress";
+}
 
 @end
 
 
 
-// TODO: implement report content hashing to detect new reports and duplicates
-// TODO: assess thread safety of reports array read/write and notifications - dispatch everything on main thread?
 /*
-     i think currently everything that reads the array is on the main thread, but we should address thread safety properly
+ * Marks a report content directory whose files are served from the report zip by
+ * ReportArchiveURLProtocol rather than extracted.
+ */
+static NSString * const ReportMountMarkerFileName = @".dice-mounted";
+
+/*
+ * Report zips at least this large are downloaded in resumable byte ranges when the server allows it.
  */
+static const int64_t RangedDownloadMinimumLength = 64 << 20;
+
+
 // TODO: use core data to build report store?
 
 @implementation ReportAPI
 {
     dispatch_queue_t reportListQueue;
     dispatch_queue_t backgroundQueue;
-    NSMutableArray *reports;
+    ReportRegistry *reports;
+    ReportImportScheduler *importScheduler;
+    ReportProgressChannel *progressChannel;
     NSFileManager *fileManager;
     NSURL *documentsDir;
+    NSString *downloadsDir;
+    ReportTrash *trash;
+    NSString *stagingRoot;
+    // staging directories that streamed downloads extracted into, by report file name, until their import takes them
+    NSMutableDictionary<NSString *, NSString *> *stagedDownloads;
+    ReportDirectoryWatcher *documentsWatcher;
+    ReportCatalog *catalog;
+    BOOL catalogSaveScheduled;
+    ReportStorageManager *storage;
+    BOOL evictionScheduled;
+    ReportImportBatch *importBatch;
+    NSTimeInterval lastBatchProgressTime;
 }
 
 + (NSString *)userGuideReportID {
@@ -82,12 +128,54 @@
         return nil;
     }
     
-    reports = [[NSMutableArray alloc] init];
     fileManager = [NSFileManager defaultManager];
     reportListQueue = dispatch_queue_create("dice.report_list", DISPATCH_QUEUE_SERIAL);
     backgroundQueue = dispatch_queue_create("dice_work", DISPATCH_QUEUE_CONCURRENT);
+    importScheduler = [[ReportImportScheduler alloc] initWithQueue:backgroundQueue];
+    __weak ReportAPI *weakSelf = self;
+    progressChannel = [[ReportProgressChannel alloc] initWithPublishBlock:^(ReportProgress *progress) {
+        [weakSelf publishProgress:progress];
+    }];
     documentsDir = [fileManager URLForDirectory:NSDocumentDirectory inDomain:NSUserDomainMask appropriateForURL:nil create:YES error:nil];
     
+    NSURL *supportDir = [fileManager URLForDirectory:NSApplicationSupportDirectory inDomain:NSUserDomainMask appropriateForURL:nil create:YES error:nil];
+    downloadsDir = [supportDir.path stringByAppendingPathComponent:@"ReportDownloads"];
+    // partial downloads can be hundreds of megabytes, and are no use in a backup
+    NSURL *downloadsURL = [NSURL fileURLWithPath:downloadsDir isDirectory:YES];
+    [fileManager createDirectoryAtURL:downloadsURL withIntermediateDirectories:YES attributes:nil error:nil];
+    [downloadsURL setResourceValue:@YES forKey:NSURLIsExcludedFromBackupKey error:nil];
+    trash = [[ReportTrash alloc] initWithDirectory:[supportDir.path stringByAppendingPathComponent:@"ReportTrash"]];
+    [trash empty];
+    stagingRoot = [supportDir.path stringByAppendingPathComponent:@"ReportStaging"];
+    stagedDownloads = [NSMutableDictionary dictionary];
+    if ([fileManager fileExistsAtPath:stagingRoot]) {
+        // extractions the app exited in the middle of
+        [trash moveItemToTrash:stagingRoot completion:nil];
+    }
+    storage = [[ReportStorageManager alloc] initWithPath:[supportDir.path stringByAppendingPathComponent:@"ReportStorage.plist"]];
+    documentsWatcher = [[ReportDirectoryWatcher alloc] initWithDirectory:documentsDir.path queue:reportListQueue];
+    documentsWatcher.changeHandler = ^(NSArray<NSString *> *added, NSArray<NSString *> *removed, NSArray<NSString *> *modified) {
+        [weakSelf documentsChangedWithAdded:added removed:removed modified:modified];
+    };
+    
+    // show the reports from the last run as soon as they are read, off the main thread; loadReports,
+    // queued behind this, revalidates them
+    catalog = [[ReportCatalog alloc] initWithPath:[supportDir.path stringByAppendingPathComponent:@"ReportCatalog.archive"] documentsDirectory:documentsDir];
+    reports = [[ReportRegistry alloc] init];
+    dispatch_async(reportListQueue, ^{
+        NSArray<Report *> *restoredReports = [catalog restoreReports];
+        [reports addReports:restoredReports];
+        for (Report *report in restoredReports) {
+            [self remountReport:report];
+        }
+        [self resumeSavedDownloads];
+        if (restoredReports.count) {
+            dispatch_async(dispatch_get_main_queue(), ^{
+                [[NSNotificationCenter defaultCenter] postNotificationName:[ReportNotification reportsLoaded] object:self userInfo:nil];
+            });
+        }
+    });
+    
     return self;
 }
 
@@ -99,61 +187,43 @@
 
 - (NSArray *)getReports
 {
-    return reports;
+    return reports.reports;
 }
 
 - (Report *)reportForID:(NSString *)reportID
 {
-    return [reports filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"reportID == %@", reportID]].firstObject;
+    return [reports reportForID:reportID];
 }
 
 - (Report *)reportForSourceFile:(NSURL *)sourceFile
 {
-    return [reports filteredArrayUsingPredicate:[NSPredicate predicateWithBlock:^BOOL(Report *report, NSDictionary *bindings) {
-        return [report.sourceFile.absoluteString isEqualToString:sourceFile.absoluteString];
-    }]].firstObject;
+    return [reports reportForSourceFile:sourceFile];
 }
 
 /*
- * Load the reports that are stored in the app's Documents directory
+ * Load the reports that are stored in the app's Documents directory.  The first call checks the reports
+ * restored from the catalog and adds the files the catalog does not have; after that, the documents
+ * watcher has kept up with Documents, so only the changes it has not passed on yet are looked at.
  */
 - (void)loadReports
 {
     NSLog(@"ReportAPI: loading reports from %@ ...", documentsDir);
     
     dispatch_async(reportListQueue, ^{
-        [reports filterUsingPredicate:[NSPredicate predicateWithBlock:^BOOL(Report *report, NSDictionary *bindings) {
-            return (!report.isEnabled && [fileManager fileExistsAtPath:report.sourceFile.path])
-            || (report.isEnabled && [fileManager fileExistsAtPath:report.url.path]);
-            // TODO: dispatch report removed notification
-        }]];
-        
-        NSDirectoryEnumerator *files = [fileManager enumeratorAtURL:documentsDir
-            includingPropertiesForKeys:@[NSURLNameKey, NSURLIsRegularFileKey, NSURLIsReadableKey, NSURLLocalizedNameKey]
-            options:(NSDirectoryEnumerationSkipsPackageDescendants | NSDirectoryEnumerationSkipsSubdirectoryDescendants)
-            errorHandler:nil];
-        
-        for (NSURL *file in files) {
-            /*
-             While seemingly unnecessary, this bit of code avoids an error that arises because the NSURL objects
-             returned by the above enumerator have a /private component prepended to them which ends up resulting
-             in null CGPDFDocument objects in the vfrReader code and app crashing.  For some reason, this only 
-             happens when the PDF file name has spaces.  This code effectively removes the /private component
-             from the report URL, because the documentsDir NSURL object does not end up getting the /private
-             prefix.
-             */
-            NSString *fileName = [file.lastPathComponent stringByRemovingPercentEncoding];
-            if(![fileName isEqualToString:[GPKGIOUtils geoPackageDirectory]]){
-                NSLog(@"ReportAPI: attempting to add report from file %@", file);
-                NSURL *reportURL = [documentsDir URLByAppendingPathComponent:fileName isDirectory:NO];
-                [self addReportFromFile:reportURL afterComplete:nil];
-            }
+        if (documentsWatcher.isWatching) {
+            [documentsWatcher scanForChanges];
+        }
+        else {
+            [self scanDocumentsAtLaunch];
         }
         
         if (reports.count == 0) {
-            [reports addObject:[self getUserGuideReport]];
+            [reports addReport:[self getUserGuideReport]];
         }
         
+        [self scheduleCatalogSave];
+        [self scheduleEviction];
+        
         dispatch_async(dispatch_get_main_queue(), ^{
             [[NSNotificationCenter defaultCenter] postNotificationName:[ReportNotification reportsLoaded] object:self userInfo:nil];
         });
@@ -161,372 +231,1480 @@
 }
 
 
-- (void)loadReportsWithCompletionHandler:(void(^) (void))completionHandler
+/*
+ * Drop the restored reports whose files went away or were replaced while the app was not running,
+ * then start watching Documents and add the files that are not in the list.  Only the catalog's
+ * own source files are checked; the rest of Documents is read once, by the watcher's first listing.
+ */
+- (void)scanDocumentsAtLaunch
 {
-    [self loadReports];
-    completionHandler();
+    NSHashTable<Report *> *dropped = [NSHashTable hashTableWithOptions:NSPointerFunctionsObjectPointerPersonality];
+    NSMutableArray<NSDictionary *> *removals = [NSMutableArray array];
+    // last first, so each index is still right once the reports after it have been removed
+    [reports.reports enumerateObjectsWithOptions:NSEnumerationReverse usingBlock:^(Report *report, NSUInteger index, BOOL *stop) {
+        // a replaced report is imported again below
+        BOOL stale = report.sourceFile && ![catalog isReportCurrent:report];
+        if (stale || ![self isReportAvailable:report]) {
+            [dropped addObject:report];
+            [removals addObject:@{
+                @"report": report,
+                @"index": [NSString stringWithFormat:@"%lu", (unsigned long)index]
+            }];
+        }
+    }];
+    if (dropped.count) {
+        [reports filterUsingBlock:^BOOL(Report *report) {
+            return ![dropped containsObject:report];
+        }];
+        dispatch_async(dispatch_get_main_queue(), ^{
+            for (NSDictionary *userInfo in removals) {
+                [[NSNotificationCenter defaultCenter] postNotificationName:[ReportNotification reportRemoved] object:self userInfo:userInfo];
+            }
+        });
+    }
+    
+    // from here on, only what changes in Documents needs looking at
+    [documentsWatcher start];
+    NSMutableArray<NSURL *> *reportFiles = [NSMutableArray array];
+    for (NSString *fileName in documentsWatcher.fileNames) {
+        NSURL *file = [documentsDir URLByAppendingPathComponent:fileName isDirectory:NO];
+        if (![self reportForSourceFile:file]) {
+            NSLog(@"ReportAPI: attempting to add report from file %@", file);
+            [reportFiles addObject:file];
+        }
+    }
+    [self addReportsFromFiles:reportFiles priority:ReportImportPriorityBackground];
 }
 
 
-- (void)importReportFromUrl:(NSURL *)reportURL afterImport:(void(^)(Report *))afterImportBlock
+/*
+ * Whether the report still has something to show: its source file while it imports, or its content
+ * once imported, extracted, mounted, or evicted with the zip to extract it from again.
+ */
+- (BOOL)isReportAvailable:(Report *)report
 {
-    NSLog(@"ReportAPI: importing report from %@", reportURL);
-    // TODO: notify import begin if anyone cares
-    
-    NSString *fileName = reportURL.lastPathComponent;
-    NSURL *destFile = [documentsDir URLByAppendingPathComponent:fileName];
-    NSError *error;
-    
-    [fileManager moveItemAtURL:reportURL toURL:destFile error:&error];
-    
-    if (error) {
-        NSLog(@"ReportAPI: error moving file %@ to documents directory for import request: %@", reportURL, [error localizedDescription]);
-    }
-
-    dispatch_async(reportListQueue, ^{
-        [self addReportFromFile:destFile afterComplete:afterImportBlock];
-    });
+    return (!report.isEnabled && [fileManager fileExistsAtPath:report.sourceFile.path])
+    || (report.isEnabled && ([fileManager fileExistsAtPath:report.url.path] || [ReportArchiveURLProtocol isMountedPath:report.url.path]))
+    || (report.isEnabled && [storage isReportEvicted:report.sourceFile.lastPathComponent] && [fileManager fileExistsAtPath:report.sourceFile.path]);
 }
 
-// TODO: remove afterCompleteBlock and use only the notification?
-- (void)addReportFromFile:(NSURL *)file afterComplete:(void(^)(Report *))afterCompleteBlock
+
+/*
+ * Import the files that appeared in Documents, import again the zips that changed, and drop the reports
+ * whose files went away, leaving every other report alone.  The documents watcher calls this on the
+ * report list queue.
+ */
+- (void)documentsChangedWithAdded:(NSArray<NSString *> *)addedNames removed:(NSArray<NSString *> *)removedNames modified:(NSArray<NSString *> *)modifiedNames
 {
-    NSLog(@"ReportAPI: attempting to create report from %@", file);
-    NSNumber* isRegularFile;
-    [file getResourceValue:&isRegularFile forKey:NSURLIsRegularFileKey error:nil];
+    NSMutableArray<Report *> *added = [NSMutableArray array];
+    NSMutableArray<Report *> *removed = [NSMutableArray array];
+    NSMutableArray<Report *> *modified = [NSMutableArray array];
     
-    if (isRegularFile.boolValue && [ResourceTypes canOpenResource:file]) {
+    NSMutableArray<NSURL *> *newFiles = [NSMutableArray array];
+    for (NSString *name in [addedNames arrayByAddingObjectsFromArray:modifiedNames]) {
+        NSURL *file = [documentsDir URLByAppendingPathComponent:name isDirectory:NO];
         Report *report = [self reportForSourceFile:file];
-        if (report) {
-            // it's already in the list, and possibly still unzipping
-            // TODO: check if the source file is new and re-import the file
-            return;
+        if (!report) {
+            [newFiles addObject:file];
         }
-        
-        NSString *title = [file.lastPathComponent stringByDeletingPathExtension];
-        report = [[Report alloc] initWithTitle:title];
-        report.sourceFile = file;
-        report.reportID = [report.sourceFile.lastPathComponent stringByAddingPercentEscapesUsingEncoding:NSUTF8StringEncoding];
-        
-        [reports addObject:report];
-        NSLog(@"ReportAPI: added new report placeholder at index %lu for report %@", reports.count - 1, file);
-        Report *placeHolder = [self reportForID:[ReportAPI userGuideReportID]];
-        if (placeHolder) {
-            // TODO: notify report removed
-            [reports removeObject:placeHolder];
+        else if ([modifiedNames containsObject:name] && [file.pathExtension caseInsensitiveCompare:@"zip"] == NSOrderedSame) {
+            // an import that already started may have read the zip as it was; the import that replaces
+            // it is still coming, so this is not announced as a cancellation
+            NSLog(@"ReportAPI: source file changed for report %@, re-importing", file);
+            [importScheduler cancelImportOfReport:report];
+            report.isEnabled = NO;
+            [self scheduleZipImport:report priority:ReportImportPriorityBackground afterComplete:nil];
+            [modified addObject:report];
         }
-        dispatch_async(dispatch_get_main_queue(), ^{
-            [[NSNotificationCenter defaultCenter]
-                postNotificationName:[ReportNotification reportAdded] object:self
-                userInfo:@{
-                    @"report": report,
-                    @"index": [NSString stringWithFormat:@"%lu", reports.count - 1]
-                }];
-        });
-        
-        NSString *fileExtension = file.pathExtension;
-        
-        if ( [fileExtension caseInsensitiveCompare:@"zip"] == NSOrderedSame ) {
-            dispatch_async(backgroundQueue, ^(void) {
-                [self processZip:report atIndex:(reports.count - 1)];
-                dispatch_async(dispatch_get_main_queue(), ^{
-                    if (afterCompleteBlock) {
-                        afterCompleteBlock(report);
-                    }
-                    [self notifyReportImportFinished:report];
-                });
-            });
+    }
+    [self addReportsFromFiles:newFiles priority:ReportImportPriorityBackground];
+    for (NSURL *file in newFiles) {
+        Report *report = [self reportForSourceFile:file];
+        if (report) {
+            [added addObject:report];
         }
-        else { // PDFs and office files
-            dispatch_async(backgroundQueue, ^(void) {
-                // make sure the url's baseURL property is set
-                NSURL *baseURL = [report.sourceFile URLByDeletingLastPathComponent];
-                NSString *reportFileName = [report.sourceFile.lastPathComponent stringByAddingPercentEscapesUsingEncoding:NSUTF8StringEncoding];
-                report.url = [NSURL URLWithString:reportFileName relativeToURL:baseURL];
-                report.fileExtension = fileExtension;
-                report.isEnabled = YES;
-                dispatch_async(dispatch_get_main_queue(), ^{
-                    if (afterCompleteBlock) {
-                        afterCompleteBlock(report);
-                    }
-                    [self notifyReportImportFinished:report];
-                });
-                
+    }
+    
+    for (NSString *name in removedNames) {
+        Report *report = [self reportForSourceFile:[documentsDir URLByAppendingPathComponent:name isDirectory:NO]];
+        if (report && ![self isReportAvailable:report]) {
+            [self cancelImportOfReport:report];
+            [reports removeReport:report];
+            [removed addObject:report];
+            dispatch_async(dispatch_get_main_queue(), ^{
+                [self finishBatchedImportOfReport:report];
             });
         }
     }
+    
+    if (added.count == 0 && removed.count == 0 && modified.count == 0) {
+        return;
+    }
+    NSLog(@"ReportAPI: Documents changed: %lu reports added, %lu removed, %lu modified",
+        (unsigned long)added.count, (unsigned long)removed.count, (unsigned long)modified.count);
+    [self scheduleCatalogSave];
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [[NSNotificationCenter defaultCenter]
+            postNotificationName:[ReportNotification reportsChanged] object:self
+            userInfo:@{
+                @"added": added,
+                @"removed": removed,
+                @"modified": modified
+            }];
+    });
 }
 
 
-- (void)notifyReportImportFinished:(Report *)report
+/*
+ * Save the report catalog shortly, coalescing the saves from a burst of imports into one write.
+ */
+- (void)scheduleCatalogSave
 {
-    [[NSNotificationCenter defaultCenter] postNotificationName:[ReportNotification reportImportFinished] object:self
-        userInfo:@{
-            @"report": report,
-            @"index": [NSString stringWithFormat:@"%lu", [reports indexOfObject:report]]
-        }];
+    dispatch_async(reportListQueue, ^{
+        if (catalogSaveScheduled) {
+            return;
+        }
+        catalogSaveScheduled = YES;
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(1 * NSEC_PER_SEC)), reportListQueue, ^{
+            catalogSaveScheduled = NO;
+            [catalog saveReports:reports.reports];
+        });
+    });
 }
 
 
 /*
- * Unzip the report, if there is a metadata.json file included, spruce up the object so it displays fancier
- * in the list, grid, and map views. Otherwise, note the error and send back an error placeholder object.
+ * Evict the least recently opened reports shortly, coalescing the passes after a burst of imports into one.
  */
-- (void)processZip:(Report*)report atIndex:(NSUInteger)index
+- (void)scheduleEviction
 {
-    NSLog(@"processing zipped report %@ ...", report.sourceFile);
-    NSURL *sourceFile = report.sourceFile;
-    NSString *sourceFileName = sourceFile.lastPathComponent;
-    report.title = sourceFile.lastPathComponent;
+    dispatch_async(reportListQueue, ^{
+        if (evictionScheduled) {
+            return;
+        }
+        evictionScheduled = YES;
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(5 * NSEC_PER_SEC)), reportListQueue, ^{
+            evictionScheduled = NO;
+            [self evictColdReports];
+        });
+    });
+}
 
-    NSRange rangeOfDot = [sourceFileName rangeOfString:@"."];
-    NSString *fileExtension = [sourceFile pathExtension];
-    NSString *expectedContentDirName = (rangeOfDot.location != NSNotFound) ? [sourceFileName substringToIndex:rangeOfDot.location] : nil;
-    NSURL *expectedContentDir = [documentsDir URLByAppendingPathComponent: expectedContentDirName isDirectory:YES];
-    NSURL *jsonFile = [expectedContentDir URLByAppendingPathComponent: @"metadata.json"];
-    NSError *error;
+
+/*
+ * Remove the extracted contents of the least recently opened reports, except for their metadata and
+ * thumbnails, until the rest fit the storage budget, set in megabytes in the user defaults.  Reports
+ * that are importing, mounted, or have GeoPackages, which other reports and the map may have open,
+ * are kept.  Runs on the report list queue.
+ */
+- (void)evictColdReports
+{
+    storage.budget = (uint64_t)MAX((NSInteger)0, [[NSUserDefaults standardUserDefaults] integerForKey:DICE_REPORT_STORAGE_BUDGET]) << 20;
+    NSMutableDictionary<NSString *, Report *> *reportsByKey = [NSMutableDictionary dictionary];
+    for (Report *report in reports.reports) {
+        if (report.sourceFile) {
+            reportsByKey[report.sourceFile.lastPathComponent] = report;
+        }
+    }
     
-    if (![fileManager fileExistsAtPath:expectedContentDir.path]) {
-        [self unzipReportContents:report toDirectory:documentsDir error:&error];
+    NSArray<NSString *> *evict = [storage reportsToEvictSkipping:^BOOL(NSString *reportKey) {
+        Report *report = reportsByKey[reportKey];
+        return !report || !report.isEnabled || report.cacheFiles.count > 0 || [ReportArchiveURLProtocol isMountedPath:report.url.path];
+    }];
+    for (NSString *reportKey in evict) {
+        Report *report = reportsByKey[reportKey];
+        if ([self trashContentsOfReport:report]) {
+            [storage reportEvicted:reportKey];
+            // keep what the report list shows
+            [self extractMetadataOfReport:report atDirectory:[self contentDirectoryForReportFile:report.sourceFile]];
+            NSLog(@"ReportAPI: evicted the extracted contents of %@ to stay within %llu MB", reportKey, storage.budget >> 20);
+        }
     }
-    else {
-        NSLog(@"directory already exists for report zip %@", report.sourceFile);
+}
+
+
+/*
+ * Move the report's extracted contents into the trash and drop it from the content store.  The blobs
+ * only its files linked to are released once the trash reaper has removed those files.
+ */
+- (BOOL)trashContentsOfReport:(Report *)report
+{
+    NSString *reportKey = report.sourceFile.lastPathComponent;
+    NSString *contentDir = [self contentDirectoryForReportFile:report.sourceFile].path;
+    ReportContentStore *contentStore = [ReportContentStore sharedStore];
+    NSDictionary<NSString *, NSString *> *entryHashes = [contentStore entryHashesForReport:reportKey];
+    BOOL moved = [trash moveItemToTrash:contentDir completion:^{
+        [contentStore releaseHashes:[NSSet setWithArray:entryHashes.allValues]];
+    }];
+    if (moved) {
+        // so no other report links to the trashed files
+        [contentStore removeReport:reportKey];
     }
-    
-    // Handle the metadata.json, make the report fancier, if it is available
-    if ( [fileManager fileExistsAtPath:jsonFile.path] && error == nil) {
-        NSString *jsonString = [[NSString alloc] initWithContentsOfFile:jsonFile.path encoding:NSUTF8StringEncoding error:NULL];
-        NSDictionary *json = [NSJSONSerialization JSONObjectWithData:[jsonString dataUsingEncoding:NSUTF8StringEncoding] options:kNilOptions error:&error];
+    return moved;
+}
 
-        // TODO: what are the potential problems of changing the report id here from its initial value above?
-        NSString *reportID = [json valueForKey:@"reportID"];
-        if (reportID) {
-            report.reportID = reportID;
-        }
-        report.title = [json objectForKey:@"title"];
-        report.summary = [json objectForKey:@"description"];
-        report.thumbnail = [json objectForKey:@"thumbnail"];
 
-        if ([json objectForKey:@"tile_thumbnail"] != nil) {
-            report.tileThumbnail = [json objectForKey:@"tile_thumbnail"];
-        } else if (report.thumbnail != nil)  {
-            report.tileThumbnail = report.thumbnail;
+- (void)openReport:(Report *)report whenReady:(void(^)(BOOL ready))readyBlock
+{
+    if (report.sourceFile) {
+        NSString *reportKey = report.sourceFile.lastPathComponent;
+        [storage reportOpened:reportKey];
+        if (report.isEnabled && [storage isReportEvicted:reportKey]) {
+            NSLog(@"ReportAPI: extracting evicted report %@ again", reportKey);
+            report.isEnabled = NO;
+            [self scheduleZipImport:report priority:ReportImportPriorityInteractive afterComplete:nil];
+        }
+        else if (!report.isEnabled) {
+            [self prioritizeImportOfReport:report];
         }
-        
-        report.lat = [[json valueForKey:@"lat"] doubleValue];
-        report.lon = [[json valueForKey:@"lon"] doubleValue];
-        report.fileExtension = fileExtension;
-        report.isEnabled = YES;
-        
-        // Set the map to zoom to all report locations
-        NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
-        [defaults setBool:YES forKey:DICE_ZOOM_TO_REPORTS];
-        [defaults synchronize];
     }
-    else if (error == nil) {
-        report.title = expectedContentDirName;
-        report.isEnabled = YES;
+
+    if (!readyBlock) {
+        return;
     }
-    
-    if (!report.reportID) {
-        report.reportID = report.sourceFile.lastPathComponent;
+    if (report.isEnabled) {
+        readyBlock(YES);
+        return;
     }
-    
-    // make sure url's baseURL property is set
-    report.url = [NSURL URLWithString:@"index.html" relativeToURL:expectedContentDir];
-    
-    // Find all report GeoPackages
-    NSString * geoPackagePredicate = [NSString stringWithFormat:@"self ENDSWITH '.%@' OR self ENDSWITH '.%@'", GPKG_GEOPACKAGE_EXTENSION, GPKG_GEOPACKAGE_EXTENDED_EXTENSION];
-    NSArray *allFiles = [[NSFileManager defaultManager] subpathsOfDirectoryAtPath:expectedContentDir.path error:nil];
-    NSArray *geoPackageFiles = [allFiles filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:geoPackagePredicate]];
-    for(NSString * geoPackageFile in geoPackageFiles){
-        
-        BOOL shared = [geoPackageFile hasPrefix:[NSString stringWithFormat:@"%@/", DICE_REPORT_SHARED_DIRECTORY]];
-        NSString * filePath = [NSString stringWithFormat:@"%@/%@", expectedContentDir.path, geoPackageFile];
-        
-        NSString * nameWithExtension = [geoPackageFile lastPathComponent];
-        NSString * name = [nameWithExtension stringByDeletingPathExtension];
-        
-        NSString * reportName = [report.reportID stringByDeletingPathExtension];
-        name = [GeoPackageURLProtocol reportIdPrefixWithName:name andReport:reportName andShare:shared];
-        if(shared){
-            GPKGGeoPackageManager * manager = [GPKGGeoPackageFactory getManager];
-            if(![manager exists:name]){
-                NSString * importPath = [NSString stringWithFormat:@"%@/%@", expectedContentDir.path, geoPackageFile];
-                [manager importGeoPackageAsLinkToPath:importPath withName:name];
-            }
+
+    // all of these are posted on the main thread, so only the first of them gets here
+    NSNotificationCenter *notificationCenter = [NSNotificationCenter defaultCenter];
+    NSMutableArray *observers = [NSMutableArray array];
+    void (^importEnded)(NSNotification *) = ^(NSNotification *notification) {
+        if (notification.userInfo[@"report"] != report) {
+            return;
         }
-        
-        ReportCache * reportCache = [[ReportCache alloc] initWithName:name andPath:filePath andShared:shared];
-        [report.cacheFiles addObject:reportCache];
+        for (id observer in observers) {
+            [notificationCenter removeObserver:observer];
+        }
+        [observers removeAllObjects];
+        readyBlock(report.isEnabled);
+    };
+    for (NSString *name in @[[ReportNotification reportImportFinished], [ReportNotification reportImportFail], [ReportNotification reportImportCancelled]]) {
+        [observers addObject:[notificationCenter addObserverForName:name object:self
+            queue:[NSOperationQueue mainQueue] usingBlock:importEnded]];
     }
-    
-    NSLog(@"finished processing report zip %@; report url: %@", report.sourceFile, report.url.absoluteString);
 }
 
 
-- (BOOL)unzipReportContents:(Report *)report toDirectory:(NSURL *)directory error:(NSError **)error {
-    if (error) {
-        *error = nil;
+/*
+ * Mounts only live in memory, so mounted reports restored from the catalog have to be mounted again.
+ */
+- (void)remountReport:(Report *)report
+{
+    NSString *contentDir = report.url.baseURL.path;
+    if (!contentDir || ![fileManager fileExistsAtPath:[contentDir stringByAppendingPathComponent:ReportMountMarkerFileName]]) {
+        return;
     }
-    
-    NSLog(@"ReportAPI: extracting report contents from %@", report.sourceFile);
-    
-    @try {
-        ZipFile *unzipFile = [[ZipFile alloc] initWithFileName:report.sourceFile.path mode:ZipFileModeUnzip];
-        int totalNumberOfFiles = (int)[unzipFile numFilesInZip];
-        report.totalNumberOfFiles = totalNumberOfFiles;
-        [unzipFile goToFirstFileInZip];
-        NSUInteger bufferSize = 1 << 20;
-        NSMutableData *entryData = [NSMutableData dataWithLength:(bufferSize)];
-        for (int filesExtracted = 0; filesExtracted < totalNumberOfFiles; filesExtracted++) {
-            FileInZipInfo *info = [unzipFile getCurrentFileInZipInfo];
-            NSString *name = info.name;
-            if (![name hasSuffix:@"/"]) {
-                NSString *filePath = [directory.path stringByAppendingPathComponent:name];
-                NSString *basePath = [filePath stringByDeletingLastPathComponent];
-                if (![fileManager fileExistsAtPath:basePath]) {
-                    if (![fileManager createDirectoryAtPath:basePath withIntermediateDirectories:YES attributes:nil error:error]) {
-                        [unzipFile close];
-                        return NO;
-                    }
-                }
-                
-                [[NSData data] writeToFile:filePath options:0 error:nil];
-                NSFileHandle *handle = [NSFileHandle fileHandleForWritingAtPath:filePath];
-                ZipReadStream *read = [unzipFile readCurrentFileInZip];
-                NSUInteger count;
-                while ((count = [read readDataWithBuffer:entryData])) {
-                    entryData.length = count;
-                    [handle writeData:entryData];
-                    entryData.length = bufferSize;
-                }
-                [read finishedReading];
-                [handle closeFile];
-            }
-            
-            report.progress = filesExtracted;
-            [unzipFile goToNextFileInZip];
-            
-            if (filesExtracted % 25 == 0) {
-                report.progress = filesExtracted;
-                dispatch_async(dispatch_get_main_queue(), ^{
-                    [[NSNotificationCenter defaultCenter]
-                     postNotificationName:[ReportNotification reportImportProgress]
-                     object:self
-                     userInfo:@{
-                                @"report": report,
-                                @"progress": [NSString stringWithFormat:@"%d", filesExtracted],
-                                @"totalNumberOfFiles": [NSString stringWithFormat:@"%d", totalNumberOfFiles]
-                                }];
-                });
-            }
-        }
-        
-        [unzipFile close];
-        
-        NSLog(@"ReportAPI: finished extracting report %@", report.sourceFile);
-        
-        return YES;
-
+    NSError *error;
+    ReportArchive *archive = [ReportArchive archiveWithURL:report.sourceFile error:&error];
+    if (archive) {
+        [ReportArchiveURLProtocol mountArchive:archive atDirectory:contentDir];
     }
-    @catch(ZipException *exctption) {
-        NSLog(@"Problem unzipping %@: %@",report.title, exctption.description);
-        
-        [[NSNotificationCenter defaultCenter]
-         postNotificationName:[ReportNotification reportImportFail] object:self
-         userInfo:@{
-                    @"report": report,
-                    @"index": [NSString stringWithFormat:@"%lu", reports.count - 1],
-                    @"message": exctption.description
-                    }];
-
-        return NO;
+    else {
+        NSLog(@"ReportAPI: could not remount report %@: %@", report.sourceFile, error.localizedDescription);
     }
 }
 
 
-- (Report*)getUserGuideReport
+- (void)loadReportsWithCompletionHandler:(void(^) (void))completionHandler
 {
-    Report *userGuide = [[Report alloc] init];
-    userGuide.title = @"Tap here to download the user guide";
-    userGuide.summary = @"Select \"Open in DICE\"";
-    userGuide.isEnabled = YES;
-    userGuide.reportID = [ReportAPI userGuideReportID];
-    
-    return userGuide;
+    [self loadReports];
+    completionHandler();
 }
 
 
-- (void)downloadReportAtURL:(NSURL *)URL withFilename:(NSString *)filename {
-    // make a new report object that can track the download progress
-    Report *report = [[Report alloc] initWithTitle:[URL absoluteString]];
-    report.isEnabled = NO;
-    report.summary = @"Downloading...";
-    [reports addObject:report];
-    
-    // broadcast a message with that report
-    NSURL *destFile = [documentsDir URLByAppendingPathComponent:filename];
-    NSURLRequest *request = [NSURLRequest requestWithURL:URL];
+- (void)importReportFromUrl:(NSURL *)reportURL afterImport:(void(^)(Report *))afterImportBlock
+{
+    NSLog(@"ReportAPI: importing report from %@", reportURL);
+    // TODO: notify import begin if anyone cares
     
-    NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration defaultSessionConfiguration];
-    AFURLSessionManager *manager = [[AFURLSessionManager alloc] initWithSessionConfiguration:configuration];
+    NSString *fileName = reportURL.lastPathComponent;
+    NSURL *destFile = [documentsDir URLByAppendingPathComponent:fileName];
+    NSError *error;
     
-    NSURLSessionDownloadTask *downloadTask = [manager downloadTaskWithRequest:request progress:nil destination:^NSURL *(NSURL *targetPath, NSURLResponse *response) {
-        return destFile;
-    } completionHandler:^(NSURLResponse *response, NSURL *filePath, NSError *error) {
-        if(!error){
-            NSLog(@"Successfully downloaded: %@", [URL absoluteString]);
-            // Maybe add a dictionary value to NSUserDefaults to a downloaded dictionary with the URL as a key and YES as the value, check that dictionary before displaying the action sheet
-            [self loadReports];
-        }else{
-            NSLog(@"Problem downloading %@: %@", [URL path], [error localizedDescription]);
-        }
-    }];
+    if ([fileManager fileExistsAtPath:destFile.path]) {
+        // a revised copy of a report we already have; the import picks up only what changed
+        [fileManager replaceItemAtURL:destFile withItemAtURL:reportURL backupItemName:nil options:0 resultingItemURL:nil error:&error];
+    }
+    else {
+        [fileManager moveItemAtURL:reportURL toURL:destFile error:&error];
+    }
     
-    [manager setDownloadTaskDidWriteDataBlock:^(NSURLSession *session, NSURLSessionDownloadTask *downloadTask, int64_t bytesWritten, int64_t totalBytesWritten, int64_t totalBytesExpectedToWrite) {
-        // TODO: Add code
-        // set the description to a status using the size of the file and download progress
-        float progress = ((float)totalBytesWritten) / totalBytesExpectedToWrite;
-        
-        if (fmodf(totalBytesWritten, 25) == 0) {
-            report.summary = [NSString stringWithFormat:@"%lld of %lld downloaded", totalBytesWritten, totalBytesExpectedToWrite];
-            report.downloadSize = totalBytesExpectedToWrite;
-            report.downloadProgress = totalBytesWritten;
+    if (error) {
+        NSLog(@"ReportAPI: error moving file %@ to documents directory for import request: %@", reportURL, [error localizedDescription]);
+    }
+
+    dispatch_async(reportListQueue, ^{
+        [self addReportFromFile:destFile priority:ReportImportPriorityUserInitiated afterComplete:afterImportBlock];
+    });
+}
+
+
+- (void)prioritizeImportOfReport:(Report *)report
+{
+    if ([importScheduler raiseImportOfReport:report toPriority:ReportImportPriorityInteractive]) {
+        NSLog(@"ReportAPI: moved import of %@ to the front of the queue", report.sourceFile.lastPathComponent);
+    }
+}
+
+
+/*
+ * A cancelled import ends without reportImportFinished or reportImportFail, so announce it for
+ * anyone waiting on the report, e.g., openReport:whenReady:.
+ */
+- (void)cancelImportOfReport:(Report *)report
+{
+    [importScheduler cancelImportOfReport:report];
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [[NSNotificationCenter defaultCenter]
+         postNotificationName:[ReportNotification reportImportCancelled] object:self
+         userInfo:@{@"report": report}];
+    });
+}
+
+
+/*
+ * Queue the zip import with the scheduler, sized by the zip file, and finish up on the main thread.
+ * Cancelled imports finish silently; whoever cancelled them has already dealt with the report.
+ */
+- (void)scheduleZipImport:(Report *)report priority:(ReportImportPriority)priority afterComplete:(void(^)(Report *))afterCompleteBlock
+{
+    // the budget is for what the import writes, which the central directory knows up front
+    ReportArchive *archive = [ReportArchive archiveWithURL:report.sourceFile error:nil];
+    uint64_t byteCount = archive ? archive.totalUncompressedSize : [fileManager attributesOfItemAtPath:report.sourceFile.path error:nil].fileSize;
+    [archive close];
+    [importScheduler scheduleImportOfReport:report byteCount:byteCount priority:priority block:^(ReportImportTask *task) {
+        [self processZip:report importTask:task];
+        if (task.isCancelled) {
+            return;
+        }
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (afterCompleteBlock) {
+                afterCompleteBlock(report);
+            }
+            [self notifyReportImportFinished:report];
+        });
+    }];
+}
+
+/*
+ * Add the report files found in Documents.  When several of them are new zips, e.g., from a drop
+ * through iTunes File Sharing, preflight them as a batch before any starts importing: count each zip's
+ * uncompressed size, from its central directory, against the free space, plan to extract the ones
+ * that fit, and mount the rest, rather than fill the disk halfway through an extraction.
+ */
+- (void)addReportsFromFiles:(NSArray<NSURL *> *)files priority:(ReportImportPriority)priority
+{
+    NSMutableArray<NSURL *> *newZips = [NSMutableArray array];
+    for (NSURL *file in files) {
+        if ([file.pathExtension caseInsensitiveCompare:@"zip"] == NSOrderedSame && ![self reportForSourceFile:file]) {
+            [newZips addObject:file];
+        }
+    }
+    
+    if (newZips.count > 1) {
+        ReportImportBatch *batch = [self importBatchForNewReports];
+        uint64_t freeSpace = [[fileManager attributesOfFileSystemForPath:documentsDir.path error:nil][NSFileSystemFreeSize] unsignedLongLongValue];
+        for (NSURL *file in newZips) {
+            ReportArchive *archive = [ReportArchive archiveWithURL:file error:nil];
+            if (!archive) {
+                continue;
+            }
+            if (![batch addReport:file.lastPathComponent uncompressedSize:archive.totalUncompressedSize availableSpace:freeSpace]) {
+                NSLog(@"ReportAPI: not enough free space to extract %@ with the rest of the batch; mounting it instead", file.lastPathComponent);
+            }
+            [archive close];
+        }
+        NSLog(@"ReportAPI: importing a batch of %lu reports, extracting %llu MB",
+            (unsigned long)batch.reportCount, batch.totalBytes >> 20);
+    }
+    
+    // list all the new reports in one change, rather than publish a new list for each
+    NSMutableArray<Report *> *newReports = [NSMutableArray array];
+    for (NSURL *file in files) {
+        Report *report = [self newReportFromFile:file priority:priority afterComplete:nil];
+        if (report) {
+            [newReports addObject:report];
+        }
+    }
+    [self listNewReports:newReports];
+    for (Report *report in newReports) {
+        [self startImportOfReport:report priority:priority afterComplete:nil];
+    }
+}
+
+
+/*
+ * The batch that new reports join, started afresh once the last one finished.
+ */
+- (ReportImportBatch *)importBatchForNewReports
+{
+    @synchronized (self) {
+        if (!importBatch || importBatch.isFinished) {
+            importBatch = [[ReportImportBatch alloc] init];
+            lastBatchProgressTime = 0;
+        }
+        return importBatch;
+    }
+}
+
+
+- (ReportImportBatch *)importBatchOfReport:(Report *)report
+{
+    @synchronized (self) {
+        return [importBatch containsReport:report.sourceFile.lastPathComponent] ? importBatch : nil;
+    }
+}
+
+
+/*
+ * Post the batch's combined progress, a few times a second at most, and always when it finishes.
+ * Runs on the main thread.
+ */
+- (void)publishProgressOfBatch:(ReportImportBatch *)batch
+{
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+    if (!batch.isFinished && now - lastBatchProgressTime < 0.25) {
+        return;
+    }
+    lastBatchProgressTime = now;
+    
+    if (batch.isFinished) {
+        NSLog(@"ReportAPI: imported a batch of %lu reports, %llu MB at %.1f MB/s", (unsigned long)batch.reportCount,
+            batch.totalBytes >> 20, batch.bytesPerSecond / (1 << 20));
+    }
+    [[NSNotificationCenter defaultCenter] postNotificationName:[ReportNotification reportBatchProgress] object:self
+        userInfo:@{
+            @"reportCount": @(batch.reportCount),
+            @"finishedCount": @(batch.finishedCount),
+            @"bytesExtracted": @(batch.bytesExtracted),
+            @"totalBytes": @(batch.totalBytes),
+            @"bytesPerSecond": @(batch.bytesPerSecond),
+            @"secondsRemaining": @(batch.estimatedTimeRemaining)
+        }];
+}
+
+
+/*
+ * Count the report as done in its batch, however its import ended.  Runs on the main thread.
+ */
+- (void)finishBatchedImportOfReport:(Report *)report
+{
+    ReportImportBatch *batch = [self importBatchOfReport:report];
+    if (batch) {
+        [batch finishReport:report.sourceFile.lastPathComponent];
+        [self publishProgressOfBatch:batch];
+    }
+}
+
+
+// TODO: remove afterCompleteBlock and use only the notification?
+- (void)addReportFromFile:(NSURL *)file priority:(ReportImportPriority)priority afterComplete:(void(^)(Report *))afterCompleteBlock
+{
+    Report *report = [self newReportFromFile:file priority:priority afterComplete:afterCompleteBlock];
+    if (report) {
+        [self listNewReports:@[report]];
+        [self startImportOfReport:report priority:priority afterComplete:afterCompleteBlock];
+    }
+}
+
+
+/*
+ * Make the placeholder report for a file that is not in the list yet, or return nil if the file is not a
+ * report or is already listed.  A listed zip that was replaced since the catalog recorded it imports again.
+ */
+- (Report *)newReportFromFile:(NSURL *)file priority:(ReportImportPriority)priority afterComplete:(void(^)(Report *))afterCompleteBlock
+{
+    NSLog(@"ReportAPI: attempting to create report from %@", file);
+    NSNumber* isRegularFile;
+    [file getResourceValue:&isRegularFile forKey:NSURLIsRegularFileKey error:nil];
+    
+    if (!isRegularFile.boolValue || ![ResourceTypes canOpenResource:file]) {
+        return nil;
+    }
+    
+    Report *report = [self reportForSourceFile:file];
+    if (report) {
+        // it's already in the list, and possibly still unzipping; re-import it if the zip was replaced since
+        // the catalog recorded it, leaving the manifest for processZip to load only when it does
+        if (report.isEnabled && ![catalog isReportCurrent:report]) {
+            NSLog(@"ReportAPI: source file changed for report %@, re-importing", file);
+            report.isEnabled = NO;
+            [self scheduleZipImport:report priority:priority afterComplete:afterCompleteBlock];
+        }
+        return nil;
+    }
+    
+    NSString *title = [file.lastPathComponent stringByDeletingPathExtension];
+    report = [[Report alloc] initWithTitle:title];
+    report.sourceFile = file;
+    report.reportID = [report.sourceFile.lastPathComponent stringByAddingPercentEscapesUsingEncoding:NSUTF8StringEncoding];
+    return report;
+}
+
+
+/*
+ * Add the new placeholder reports to the list in one change, dropping the user guide placeholder,
+ * and post a reportAdded notification for each.
+ */
+- (void)listNewReports:(NSArray<Report *> *)newReports
+{
+    if (newReports.count == 0) {
+        return;
+    }
+    [reports addReports:newReports];
+    Report *placeHolder = [self reportForID:[ReportAPI userGuideReportID]];
+    NSUInteger placeHolderIndex = [reports indexOfReport:placeHolder];
+    if (placeHolderIndex != NSNotFound) {
+        [reports removeReport:placeHolder];
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [[NSNotificationCenter defaultCenter]
+                postNotificationName:[ReportNotification reportRemoved] object:self
+                userInfo:@{
+                    @"report": placeHolder,
+                    @"index": [NSString stringWithFormat:@"%lu", (unsigned long)placeHolderIndex]
+                }];
+        });
+    }
+    for (Report *report in newReports) {
+        NSUInteger index = [reports indexOfReport:report];
+        NSLog(@"ReportAPI: added new report placeholder at index %lu for report %@", (unsigned long)index, report.sourceFile);
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [[NSNotificationCenter defaultCenter]
+                postNotificationName:[ReportNotification reportAdded] object:self
+                userInfo:@{
+                    @"report": report,
+                    @"index": [NSString stringWithFormat:@"%lu", (unsigned long)index]
+                }];
+        });
+    }
+}
+
+
+/*
+ * Start importing a report that was just listed: schedule a zip to be extracted, and point
+ * PDFs and office files at their source file.
+ */
+- (void)startImportOfReport:(Report *)report priority:(ReportImportPriority)priority afterComplete:(void(^)(Report *))afterCompleteBlock
+{
+    NSString *fileExtension = report.sourceFile.pathExtension;
+    
+    if ( [fileExtension caseInsensitiveCompare:@"zip"] == NSOrderedSame ) {
+        [self scheduleZipImport:report priority:priority afterComplete:afterCompleteBlock];
+    }
+    else { // PDFs and office files
+        dispatch_async(backgroundQueue, ^(void) {
+            // make sure the url's baseURL property is set
+            NSURL *baseURL = [report.sourceFile URLByDeletingLastPathComponent];
+            NSString *reportFileName = [report.sourceFile.lastPathComponent stringByAddingPercentEscapesUsingEncoding:NSUTF8StringEncoding];
+            report.url = [NSURL URLWithString:reportFileName relativeToURL:baseURL];
+            report.fileExtension = fileExtension;
+            report.isEnabled = YES;
+            dispatch_async(dispatch_get_main_queue(), ^{
+                if (afterCompleteBlock) {
+                    afterCompleteBlock(report);
+                }
+                [self notifyReportImportFinished:report];
+            });
+            
+        });
+    }
+}
+
+
+/*
+ * Copy a report's progress counters into the report and post one progress notification.  The
+ * progress channel calls this on the main thread, at most once per tick for each report.
+ */
+- (void)publishProgress:(ReportProgress *)progress
+{
+    Report *report = progress.report;
+    NSDictionary *userInfo;
+    
+    if (report.isEnabled) {
+        // the import finished before this tick; don't clobber the summary from its metadata
+        return;
+    }
+    
+    if (progress.totalFiles > 0) {
+        ReportImportBatch *batch = [self importBatchOfReport:report];
+        [batch updateReport:report.sourceFile.lastPathComponent bytesExtracted:progress.bytesExtracted];
+        if (batch) {
+            [self publishProgressOfBatch:batch];
+        }
+        report.totalNumberOfFiles = (int64_t)progress.totalFiles;
+        report.progress = (int64_t)progress.filesExtracted;
+        userInfo = @{
+            @"report": report,
+            @"progress": [NSString stringWithFormat:@"%llu", progress.filesExtracted],
+            @"totalNumberOfFiles": [NSString stringWithFormat:@"%llu", progress.totalFiles],
+            @"bytesExtracted": @(progress.bytesExtracted),
+            @"totalBytes": @(progress.totalBytes)
+        };
+    }
+    else {
+        int64_t downloaded = progress.bytesDownloaded;
+        int64_t downloadSize = progress.downloadSize;
+        report.summary = [NSString stringWithFormat:@"%lld of %lld downloaded", downloaded, downloadSize];
+        report.downloadSize = downloadSize;
+        report.downloadProgress = downloaded;
+        userInfo = @{
+            @"report": report,
+            @"progress": [NSString stringWithFormat:@"%g", downloadSize > 0 ? (double)downloaded / downloadSize : 0.0],
+            @"totalNumberOfFiles": [NSString stringWithFormat:@"%lld downloaded", downloadSize]
+        };
+    }
+    
+    [[NSNotificationCenter defaultCenter] postNotificationName:[ReportNotification reportImportProgress] object:self userInfo:userInfo];
+}
+
+
+- (void)notifyReportImportFinished:(Report *)report
+{
+    [self scheduleCatalogSave];
+    [self scheduleEviction];
+    [self finishBatchedImportOfReport:report];
+    [[NSNotificationCenter defaultCenter] postNotificationName:[ReportNotification reportImportFinished] object:self
+        userInfo:@{
+            @"report": report,
+            @"index": [NSString stringWithFormat:@"%lu", (unsigned long)[reports indexOfReport:report]]
+        }];
+}
+
+
+/*
+ * The directory a report zip's contents are expected to extract to, named for the zip up to its first dot.
+ */
+- (NSURL *)contentDirectoryForReportFile:(NSURL *)sourceFile
+{
+    NSString *sourceFileName = sourceFile.lastPathComponent;
+    NSRange rangeOfDot = [sourceFileName rangeOfString:@"."];
+    NSString *contentDirName = (rangeOfDot.location != NSNotFound) ? [sourceFileName substringToIndex:rangeOfDot.location] : nil;
+    return [documentsDir URLByAppendingPathComponent: contentDirName isDirectory:YES];
+}
+
+
+/*
+ * Unzip the report, if there is a metadata.json file included, spruce up the object so it displays fancier
+ * in the list, grid, and map views. Otherwise, note the error and send back an error placeholder object.
+ */
+- (void)processZip:(Report*)report importTask:(ReportImportTask *)task
+{
+    NSLog(@"processing zipped report %@ ...", report.sourceFile);
+    NSURL *sourceFile = report.sourceFile;
+    NSString *sourceFileName = sourceFile.lastPathComponent;
+    report.title = sourceFile.lastPathComponent;
+
+    NSString *fileExtension = [sourceFile pathExtension];
+    NSURL *expectedContentDir = [self contentDirectoryForReportFile:sourceFile];
+    NSString *expectedContentDirName = expectedContentDir.lastPathComponent;
+    NSURL *jsonFile = [expectedContentDir URLByAppendingPathComponent: @"metadata.json"];
+    NSError *error;
+    // notes the GeoPackages and shared assets as the import goes over the zip's entries
+    ReportContentClassifier *classifier = [[ReportContentClassifier alloc] initWithContentDirectoryName:expectedContentDirName];
+    
+    NSString *mountMarker = [expectedContentDir.path stringByAppendingPathComponent:ReportMountMarkerFileName];
+    // set when the content directory is only there for the metadata read ahead of this extraction
+    BOOL extractingFresh = NO;
+    if ([fileManager fileExistsAtPath:mountMarker]) {
+        [self mountReportContents:report atDirectory:expectedContentDir classifier:classifier error:&error];
+    }
+    else if ([storage isReportEvicted:sourceFileName]) {
+        // only the metadata and thumbnails were kept
+        [self unzipReportContents:report toDirectory:documentsDir previousManifest:nil classifier:classifier importTask:task error:&error];
+    }
+    else {
+        ReportImportManifest *previousManifest = [ReportImportManifest manifestForReport:sourceFileName];
+        if (!previousManifest || ![fileManager fileExistsAtPath:expectedContentDir.path]) {
+            // without a manifest the directory is at most what an earlier, unfinished import left behind;
+            // a download that streamed the report in has it all on disk already, so it is never mounted
+            if (![self hasStagedDownloadOfReport:sourceFileName] && [self shouldMountReport:report]) {
+                [self mountReportContents:report atDirectory:expectedContentDir classifier:classifier error:&error];
+            }
+            else {
+                extractingFresh = ![fileManager fileExistsAtPath:expectedContentDir.path];
+                [self readEarlyMetadataOfReport:report atDirectory:expectedContentDir];
+                [self unzipReportContents:report toDirectory:documentsDir previousManifest:nil classifier:classifier importTask:task error:&error];
+            }
+        }
+        else if (![previousManifest matchesSourceFile:sourceFile]) {
+            [self readEarlyMetadataOfReport:report atDirectory:expectedContentDir];
+            [self unzipReportContents:report toDirectory:documentsDir previousManifest:previousManifest classifier:classifier importTask:task error:&error];
+        }
+        else {
+            NSLog(@"directory already exists for report zip %@", report.sourceFile);
+            // nothing to extract, but the central directory still says what is in the report
+            ReportArchive *archive = [ReportArchive archiveWithURL:sourceFile error:nil];
+            [classifier classifyEntriesOfArchive:archive];
+            if (archive) {
+                [storage recordContentSize:archive.totalUncompressedSize ofReport:sourceFileName];
+            }
+            [archive close];
+        }
+    }
+    if (extractingFresh && (error || task.isCancelled)) {
+        // drop the metadata read ahead, so the next import does not take it for an extracted report
+        [trash moveItemToTrash:expectedContentDir.path completion:nil];
+    }
+    if (task.isCancelled) {
+        NSLog(@"ReportAPI: import of %@ cancelled", report.sourceFile);
+        return;
+    }
+    
+    // Handle the metadata.json, make the report fancier, if it is available
+    if ( [fileManager fileExistsAtPath:jsonFile.path] && error == nil) {
+        NSString *jsonString = [[NSString alloc] initWithContentsOfFile:jsonFile.path encoding:NSUTF8StringEncoding error:NULL];
+        NSDictionary *json = [NSJSONSerialization JSONObjectWithData:[jsonString dataUsingEncoding:NSUTF8StringEncoding] options:kNilOptions error:&error];
+        [self applyMetadata:json toReport:report];
+        report.fileExtension = fileExtension;
+        report.isEnabled = YES;
+        
+        // Set the map to zoom to all report locations
+        NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+        [defaults setBool:YES forKey:DICE_ZOOM_TO_REPORTS];
+        [defaults synchronize];
+    }
+    else if (error == nil) {
+        report.title = expectedContentDirName;
+        report.isEnabled = YES;
+    }
+    
+    if (!report.reportID) {
+        report.reportID = report.sourceFile.lastPathComponent;
+    }
+    [reports reindexReport:report];
+    
+    // make sure url's baseURL property is set
+    report.url = [NSURL URLWithString:@"index.html" relativeToURL:expectedContentDir];
+    
+    // Register the report GeoPackages the classifier found
+    [report.cacheFiles removeAllObjects];
+    for(ReportArchiveEntry * geoPackageEntry in classifier.geoPackageEntries){
+        
+        NSString * geoPackageFile = [classifier contentPathForEntry:geoPackageEntry];
+        BOOL shared = [classifier isSharedEntry:geoPackageEntry];
+        NSString * filePath = [NSString stringWithFormat:@"%@/%@", expectedContentDir.path, geoPackageFile];
+        
+        NSString * nameWithExtension = [geoPackageFile lastPathComponent];
+        NSString * name = [nameWithExtension stringByDeletingPathExtension];
+        
+        NSString * reportName = [report.reportID stringByDeletingPathExtension];
+        name = [GeoPackageURLProtocol reportIdPrefixWithName:name andReport:reportName andShare:shared];
+        if(shared){
+            GPKGGeoPackageManager * manager = [GPKGGeoPackageFactory getManager];
+            if(![manager exists:name]){
+                NSString * importPath = [NSString stringWithFormat:@"%@/%@", expectedContentDir.path, geoPackageFile];
+                [manager importGeoPackageAsLinkToPath:importPath withName:name];
+            }
+        }
+        
+        ReportCache * reportCache = [[ReportCache alloc] initWithName:name andPath:filePath andShared:shared];
+        [report.cacheFiles addObject:reportCache];
+    }
+    
+    NSLog(@"finished processing report zip %@; report url: %@; %lu GeoPackages, %lu shared assets", report.sourceFile, report.url.absoluteString,
+        (unsigned long)report.cacheFiles.count, (unsigned long)classifier.sharedEntries.count);
+}
+
+
+/*
+ * Fill in the report's title, description, thumbnails, and location from its metadata.json.
+ */
+- (void)applyMetadata:(NSDictionary *)json toReport:(Report *)report
+{
+    // TODO: what are the potential problems of changing the report id here from its initial value above?
+    NSString *reportID = [json valueForKey:@"reportID"];
+    if (reportID) {
+        report.reportID = reportID;
+    }
+    report.title = [json objectForKey:@"title"];
+    report.summary = [json objectForKey:@"description"];
+    report.thumbnail = [json objectForKey:@"thumbnail"];
+    
+    if ([json objectForKey:@"tile_thumbnail"] != nil) {
+        report.tileThumbnail = [json objectForKey:@"tile_thumbnail"];
+    } else if (report.thumbnail != nil)  {
+        report.tileThumbnail = report.thumbnail;
+    }
+    
+    report.lat = [[json valueForKey:@"lat"] doubleValue];
+    report.lon = [[json valueForKey:@"lon"] doubleValue];
+}
+
+
+/*
+ * Parse the metadata.json entry of the report zip, and collect it and the thumbnail entries it
+ * names into entries.  Returns nil if the zip has no metadata.json or it does not parse.
+ */
+- (NSDictionary *)readMetadataFromArchive:(ReportArchive *)archive reader:(ReportArchiveReader *)reader
+    contentDirectory:(NSURL *)contentDir entries:(NSMutableArray<ReportArchiveEntry *> *)entries
+{
+    NSString *entryPrefix = [contentDir.lastPathComponent stringByAppendingString:@"/"];
+    ReportArchiveEntry *metadataEntry = [archive entryNamed:[entryPrefix stringByAppendingString:@"metadata.json"]];
+    if (!metadataEntry) {
+        return nil;
+    }
+    
+    [entries addObject:metadataEntry];
+    NSData *jsonData = [reader dataForEntry:metadataEntry error:nil];
+    NSDictionary *json = jsonData ? [NSJSONSerialization JSONObjectWithData:jsonData options:kNilOptions error:nil] : nil;
+    if (![json isKindOfClass:[NSDictionary class]]) {
+        return nil;
+    }
+    for (NSString *key in @[@"thumbnail", @"tile_thumbnail"]) {
+        NSString *thumbnail = json[key];
+        ReportArchiveEntry *thumbnailEntry = [thumbnail isKindOfClass:[NSString class]] ? [archive entryNamed:[entryPrefix stringByAppendingString:thumbnail]] : nil;
+        if (thumbnailEntry) {
+            [entries addObject:thumbnailEntry];
+        }
+    }
+    return json;
+}
+
+
+/*
+ * Extract just the report's metadata.json and the thumbnails it names, returning the parsed metadata.
+ */
+- (NSDictionary *)extractMetadataOfReport:(Report *)report atDirectory:(NSURL *)contentDir
+{
+    ReportArchive *archive = [ReportArchive archiveWithURL:report.sourceFile error:nil];
+    if (!archive) {
+        return nil;
+    }
+    
+    ReportArchiveReader *reader = [[ReportArchiveReader alloc] initWithArchive:archive];
+    NSMutableArray<ReportArchiveEntry *> *metadataEntries = [NSMutableArray array];
+    NSDictionary *json = [self readMetadataFromArchive:archive reader:reader contentDirectory:contentDir entries:metadataEntries];
+    for (ReportArchiveEntry *entry in metadataEntries) {
+        NSString *path = [archive extractionPathForEntry:entry inDirectory:documentsDir.path];
+        if (path && ![fileManager fileExistsAtPath:path]) {
+            [fileManager createDirectoryAtPath:[path stringByDeletingLastPathComponent] withIntermediateDirectories:YES attributes:nil error:nil];
+            [reader extractEntry:entry toPath:path error:nil];
+        }
+    }
+    [archive close];
+    return json;
+}
+
+
+/*
+ * Before extracting the whole report, seek straight to its metadata.json and thumbnails through
+ * the zip's central directory, so the list, grid, and map can show the report while the rest of
+ * it extracts.  Thumbnails already on disk are left alone; the extraction replaces them if they changed.
+ */
+- (BOOL)readEarlyMetadataOfReport:(Report *)report atDirectory:(NSURL *)contentDir
+{
+    NSDictionary *json = [self extractMetadataOfReport:report atDirectory:contentDir];
+    if (!json) {
+        return NO;
+    }
+    
+    [self applyMetadata:json toReport:report];
+    report.url = [NSURL URLWithString:@"index.html" relativeToURL:contentDir];
+    [reports reindexReport:report];
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [[NSNotificationCenter defaultCenter] postNotificationName:[ReportNotification reportMetadataReady] object:self
+            userInfo:@{
+                @"report": report,
+                @"index": [NSString stringWithFormat:@"%lu", (unsigned long)[reports indexOfReport:report]]
+            }];
+    });
+    
+    return YES;
+}
+
+
+/*
+ * Extract the report zip.  Given the manifest of a previous import of the same file, only the
+ * entries whose CRC or size changed are extracted, and entries no longer in the zip are removed
+ * once the new manifest is saved.  Every entry is shown to the classifier.  Cancelling the import
+ * task stops the extraction.
+ */
+- (BOOL)unzipReportContents:(Report *)report toDirectory:(NSURL *)directory previousManifest:(ReportImportManifest *)previousManifest
+    classifier:(ReportContentClassifier *)classifier importTask:(ReportImportTask *)task error:(NSError **)error {
+    if (error) {
+        *error = nil;
+    }
+    
+    NSLog(@"ReportAPI: extracting report contents from %@", report.sourceFile);
+    
+    NSError *unzipError;
+    ReportArchive *archive = [ReportArchive archiveWithURL:report.sourceFile error:&unzipError];
+    BOOL success = NO;
+    // the extraction goes to a staging directory and is renamed into place once it is all there, so
+    // running out of space or being cancelled partway leaves nothing half extracted in Documents, and
+    // an update leaves the previous files in place until their replacements are; a streamed download
+    // already extracted into one
+    NSString *stagedDownload = previousManifest ? nil : [self takeStagedDownloadOfReport:report.sourceFile.lastPathComponent];
+    NSString *stagingDir = stagedDownload ?: [stagingRoot stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    NSArray<NSString *> *removedNames = nil;
+    if (archive) {
+        ReportExtractor *extractor = [[ReportExtractor alloc] initWithArchive:archive destination:stagingDir];
+        ReportContentStore *contentStore = [ReportContentStore sharedStore];
+        NSString *reportKey = report.sourceFile.lastPathComponent;
+        NSString *fingerprint = [ReportContentStore fingerprintForArchive:archive];
+        NSMutableDictionary<NSString *, NSString *> *entryHashes = [NSMutableDictionary dictionary];
+        NSMutableSet<NSString *> *replacedHashes = [NSMutableSet set];
+        
+        if (previousManifest) {
+            NSArray<ReportArchiveEntry *> *changedEntries = [previousManifest entriesChangedInArchive:archive];
+            removedNames = [previousManifest entryNamesRemovedFromArchive:archive];
+            NSLog(@"ReportAPI: updating report %@: %lu changed and %lu removed of %lu entries", reportKey,
+                (unsigned long)changedEntries.count, (unsigned long)removedNames.count, (unsigned long)archive.entries.count);
             
-            dispatch_async(dispatch_get_main_queue(), ^{
-                [[NSNotificationCenter defaultCenter]
-                 postNotificationName:[ReportNotification reportImportProgress]
-                 object:self
-                 userInfo:@{
-                            @"report": report,
-                            @"progress": [NSString stringWithFormat:@"%g", progress],
-                            @"totalNumberOfFiles": [NSString stringWithFormat:@"%lld downloaded", totalBytesExpectedToWrite]
-                            }];
+            NSDictionary<NSString *, NSString *> *previousHashes = [contentStore entryHashesForReport:reportKey];
+            if (previousHashes) {
+                [entryHashes addEntriesFromDictionary:previousHashes];
+            }
+            for (NSString *name in [removedNames arrayByAddingObjectsFromArray:[changedEntries valueForKey:@"name"]]) {
+                if (entryHashes[name]) {
+                    [replacedHashes addObject:entryHashes[name]];
+                    [entryHashes removeObjectForKey:name];
+                }
+                if ([GPKGGeoPackageValidate hasGeoPackageExtension:name]) {
+                    [[GeoPackageTileCache sharedCache] removeTilesOfGeoPackageAtPath:[directory.path stringByAppendingPathComponent:name]];
+                }
+            }
+            extractor.entries = changedEntries;
+        }
+        
+        uint64_t totalBytes = 0;
+        for (ReportArchiveEntry *entry in extractor.entries) {
+            totalBytes += entry.uncompressedSize;
+        }
+        ReportProgress *progress = [progressChannel beginTrackingReport:report];
+        [progress setTotalFiles:extractor.entries.count totalBytes:totalBytes];
+        extractor.progressBlock = ^(ReportExtractor *activeExtractor, uint64_t entriesExtracted, uint64_t bytesExtracted) {
+            [progress setFilesExtracted:entriesExtracted bytesExtracted:bytesExtracted];
+        };
+        
+        NSString *duplicateKey = [contentStore reportWithFingerprint:fingerprint];
+        if (stagedDownload) {
+            success = [self storeStagedDownload:stagedDownload ofArchive:archive inStore:contentStore entryHashes:entryHashes error:&unzipError];
+            [progress setFilesExtracted:progress.totalFiles bytesExtracted:totalBytes];
+            [classifier classifyEntriesOfArchive:archive];
+        }
+        else if (!previousManifest && duplicateKey && ![duplicateKey isEqualToString:reportKey]) {
+            NSLog(@"ReportAPI: %@ has the same content as %@, linking its files", reportKey, duplicateKey);
+            NSDictionary<NSString *, NSString *> *linkedHashes = [contentStore linkArchive:archive toContentOfReport:duplicateKey inDirectory:stagingDir];
+            if (linkedHashes) {
+                [entryHashes addEntriesFromDictionary:linkedHashes];
+                success = YES;
+                [progress setFilesExtracted:progress.totalFiles bytesExtracted:totalBytes];
+                [classifier classifyEntriesOfArchive:archive];
+            }
+        }
+        if (!success && !stagedDownload) {
+            extractor.contentStore = contentStore;
+            // an update only extracts the changed entries, but the classifier has to see them all
+            if (previousManifest) {
+                [classifier classifyEntriesOfArchive:archive];
+            }
+            else {
+                extractor.entryClassifier = classifier;
+            }
+            __weak ReportExtractor *weakExtractor = extractor;
+            task.cancellationHandler = ^{
+                [weakExtractor cancel];
+            };
+            success = [extractor extract:&unzipError];
+            task.cancellationHandler = nil;
+            [entryHashes addEntriesFromDictionary:extractor.entryHashes];
+        }
+        [progressChannel finishTrackingReport:report];
+        if (success && previousManifest) {
+            success = [self moveStagedEntries:extractor.entries fromDirectory:stagingDir intoDirectory:directory.path error:&unzipError];
+        }
+        else if (success) {
+            success = [self moveStagedContents:stagingDir intoDirectory:directory.path error:&unzipError];
+        }
+        if (success) {
+            [contentStore saveManifestForReport:reportKey fingerprint:fingerprint entryHashes:entryHashes];
+            [[ReportImportManifest manifestWithArchive:archive] saveForReport:reportKey];
+            // until the new manifest is saved, the previous one still describes what is in the directory
+            if (removedNames.count) {
+                [previousManifest removeEntriesRemovedFromArchive:archive inDirectory:directory.path];
+            }
+            [contentStore releaseHashes:replacedHashes];
+            [storage recordContentSize:archive.totalUncompressedSize ofReport:reportKey];
+        }
+        [archive close];
+    }
+    
+    if (success) {
+        NSLog(@"ReportAPI: finished extracting report %@", report.sourceFile);
+        return YES;
+    }
+    
+    if ([fileManager fileExistsAtPath:stagingDir]) {
+        [trash moveItemToTrash:stagingDir completion:nil];
+    }
+    
+    NSLog(@"Problem unzipping %@: %@", report.title, unzipError.localizedDescription);
+    if (error) {
+        *error = unzipError;
+    }
+    if (task.isCancelled) {
+        return NO;
+    }
+    
+    NSMutableDictionary *failure = [NSMutableDictionary dictionaryWithDictionary:@{
+        @"report": report,
+        @"message": unzipError.localizedDescription
+    }];
+    // a damaged zip, e.g., from a copy that was cut short, names the entries that failed their CRC
+    NSArray<NSString *> *corruptEntries = unzipError.userInfo[ReportArchiveCorruptEntriesKey];
+    if (corruptEntries) {
+        failure[@"corruptEntries"] = corruptEntries;
+    }
+    dispatch_async(dispatch_get_main_queue(), ^{
+        failure[@"index"] = [NSString stringWithFormat:@"%lu", (unsigned long)[reports indexOfReport:report]];
+        [[NSNotificationCenter defaultCenter]
+         postNotificationName:[ReportNotification reportImportFail] object:self
+         userInfo:failure];
+    });
+    
+    return NO;
+}
+
+
+/*
+ * Move the files a streamed download extracted into the content store, as the extractor does for
+ * the files it extracts, adding their hashes to entryHashes.
+ */
+- (BOOL)storeStagedDownload:(NSString *)stagingDir ofArchive:(ReportArchive *)archive inStore:(ReportContentStore *)contentStore
+    entryHashes:(NSMutableDictionary<NSString *, NSString *> *)entryHashes error:(NSError **)error
+{
+    for (ReportArchiveEntry *entry in archive.entries) {
+        if (![ReportContentStore canShareEntry:entry]) {
+            continue;
+        }
+        NSString *path = [archive extractionPathForEntry:entry inDirectory:stagingDir];
+        if (!path || ![fileManager fileExistsAtPath:path]) {
+            continue;
+        }
+        NSError *storeError;
+        NSString *hash = [contentStore storeFileAtPath:path error:&storeError];
+        if (hash) {
+            entryHashes[entry.name] = hash;
+        }
+        else if (storeError) {
+            if (error) {
+                *error = storeError;
+            }
+            return NO;
+        }
+    }
+    return YES;
+}
+
+
+- (BOOL)hasStagedDownloadOfReport:(NSString *)reportKey
+{
+    @synchronized (stagedDownloads) {
+        return stagedDownloads[reportKey] != nil;
+    }
+}
+
+
+- (NSString *)takeStagedDownloadOfReport:(NSString *)reportKey
+{
+    @synchronized (stagedDownloads) {
+        NSString *stagingDir = stagedDownloads[reportKey];
+        [stagedDownloads removeObjectForKey:reportKey];
+        return stagingDir;
+    }
+}
+
+
+/*
+ * Rename each top-level item of a finished extraction into place, trashing whatever was there before,
+ * e.g., the metadata and thumbnails read ahead of the extraction or kept after an eviction.
+ */
+- (BOOL)moveStagedContents:(NSString *)stagingDir intoDirectory:(NSString *)directory error:(NSError **)error
+{
+    if (![fileManager fileExistsAtPath:stagingDir]) {
+        // nothing in the zip to extract
+        return YES;
+    }
+    NSArray<NSString *> *names = [fileManager contentsOfDirectoryAtPath:stagingDir error:error];
+    if (!names) {
+        return NO;
+    }
+    for (NSString *name in names) {
+        NSString *destination = [directory stringByAppendingPathComponent:name];
+        if ([fileManager fileExistsAtPath:destination]) {
+            [trash moveItemToTrash:destination completion:nil];
+        }
+        if (![fileManager moveItemAtPath:[stagingDir stringByAppendingPathComponent:name] toPath:destination error:error]) {
+            return NO;
+        }
+    }
+    [fileManager removeItemAtPath:stagingDir error:nil];
+    return YES;
+}
+
+
+/*
+ * Rename each entry an update extracted over the file it replaces, leaving the rest of the report's
+ * files as they are.  rename(2) replaces a file in one step, so a page open in the report reads
+ * either the old file or the new one.
+ */
+- (BOOL)moveStagedEntries:(NSArray<ReportArchiveEntry *> *)entries fromDirectory:(NSString *)stagingDir
+    intoDirectory:(NSString *)directory error:(NSError **)error
+{
+    for (ReportArchiveEntry *entry in entries) {
+        NSString *staged = [ReportArchive extractionPathForName:entry.name inDirectory:stagingDir];
+        NSString *destination = [ReportArchive extractionPathForName:entry.name inDirectory:directory];
+        if (!staged || !destination) {
+            continue;
+        }
+        NSString *parent = entry.isDirectory ? destination : destination.stringByDeletingLastPathComponent;
+        if (![fileManager createDirectoryAtPath:parent withIntermediateDirectories:YES attributes:nil error:error]) {
+            return NO;
+        }
+        if (entry.isDirectory || ![fileManager fileExistsAtPath:staged]) {
+            continue;
+        }
+        if (rename(staged.fileSystemRepresentation, destination.fileSystemRepresentation) != 0) {
+            if (error) {
+                *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{
+                    NSFilePathErrorKey: destination
+                }];
+            }
+            return NO;
+        }
+    }
+    [fileManager removeItemAtPath:stagingDir error:nil];
+    return YES;
+}
+
+
+/*
+ * Mount the report zip instead of extracting it when the user prefers that, or when
+ * there is not enough free space to hold the extracted copy next to the zip.
+ */
+- (BOOL)shouldMountReport:(Report *)report
+{
+    if ([[NSUserDefaults standardUserDefaults] boolForKey:DICE_MOUNT_REPORT_ARCHIVES]) {
+        return YES;
+    }
+    ReportImportBatch *batch = [self importBatchOfReport:report];
+    if (batch) {
+        // the batch already counted the space the other reports in it will take
+        return ![batch shouldExtractReport:report.sourceFile.lastPathComponent];
+    }
+    
+    ReportArchive *archive = [ReportArchive archiveWithURL:report.sourceFile error:nil];
+    NSDictionary *attributes = [fileManager attributesOfFileSystemForPath:documentsDir.path error:nil];
+    NSNumber *freeSpace = attributes[NSFileSystemFreeSize];
+    return archive && freeSpace && archive.totalUncompressedSize > freeSpace.unsignedLongLongValue;
+}
+
+
+/*
+ * Extract only the files that must exist on disk - metadata.json, its thumbnails, and GeoPackages,
+ * which SQLite has to open by path - and serve everything else from the zip.
+ */
+- (BOOL)mountReportContents:(Report *)report atDirectory:(NSURL *)contentDir classifier:(ReportContentClassifier *)classifier error:(NSError **)error
+{
+    NSLog(@"ReportAPI: mounting report contents from %@", report.sourceFile);
+    
+    ReportArchive *archive = [ReportArchive archiveWithURL:report.sourceFile error:error];
+    if (!archive) {
+        return NO;
+    }
+    
+    ReportArchiveReader *reader = [[ReportArchiveReader alloc] initWithArchive:archive];
+    NSMutableArray<ReportArchiveEntry *> *diskEntries = [NSMutableArray array];
+    [self readMetadataFromArchive:archive reader:reader contentDirectory:contentDir entries:diskEntries];
+    [classifier classifyEntriesOfArchive:archive];
+    [diskEntries addObjectsFromArray:classifier.geoPackageEntries];
+    
+    for (ReportArchiveEntry *entry in diskEntries) {
+        NSString *path = [archive extractionPathForEntry:entry inDirectory:documentsDir.path];
+        if (!path || [fileManager fileExistsAtPath:path]) {
+            continue;
+        }
+        if (![fileManager createDirectoryAtPath:[path stringByDeletingLastPathComponent] withIntermediateDirectories:YES attributes:nil error:error]
+            || ![reader extractEntry:entry toPath:path error:error]) {
+            return NO;
+        }
+    }
+    
+    [fileManager createDirectoryAtURL:contentDir withIntermediateDirectories:YES attributes:nil error:nil];
+    [[NSData data] writeToFile:[contentDir.path stringByAppendingPathComponent:ReportMountMarkerFileName] atomically:YES];
+    [ReportArchiveURLProtocol mountArchive:archive atDirectory:contentDir.path];
+    report.totalNumberOfFiles = (int64_t)archive.entries.count;
+    report.progress = report.totalNumberOfFiles;
+    
+    return YES;
+}
+
+
+- (Report*)getUserGuideReport
+{
+    Report *userGuide = [[Report alloc] init];
+    userGuide.title = @"Tap here to download the user guide";
+    userGuide.summary = @"Select \"Open in DICE\"";
+    userGuide.isEnabled = YES;
+    userGuide.reportID = [ReportAPI userGuideReportID];
+    
+    return userGuide;
+}
+
+
+- (void)downloadReportAtURL:(NSURL *)URL withFilename:(NSString *)filename {
+    // make a new report object that can track the download progress
+    Report *report = [[Report alloc] initWithTitle:[URL absoluteString]];
+    report.isEnabled = NO;
+    report.summary = @"Downloading...";
+    [reports addReport:report];
+    
+    // broadcast a message with that report
+    NSURL *destFile = [documentsDir URLByAppendingPathComponent:filename];
+    // the progress channel sets the report's summary to the download status on each tick
+    ReportProgress *progress = [progressChannel beginTrackingReport:report];
+    
+    if ([filename.pathExtension caseInsensitiveCompare:@"zip"] == NSOrderedSame
+        && ![fileManager fileExistsAtPath:destFile.path]
+        && ![fileManager fileExistsAtPath:[self contentDirectoryForReportFile:destFile].path]) {
+        NSString *archivePath = [downloadsDir stringByAppendingPathComponent:filename];
+        ReportRangedDownload *saved = [ReportRangedDownload savedDownloadWithArchivePath:archivePath];
+        if (saved && [saved.URL isEqual:URL]) {
+            [self rangedDownloadReport:report download:saved toFile:destFile progress:progress];
+            return;
+        }
+        
+        // large reports on a server that serves ranges can resume; everything else extracts as it streams
+        void (^probe)(void) = ^{
+            [ReportRangedDownload probeURL:URL sessionConfiguration:nil completion:^(int64_t length, BOOL acceptsRanges, NSError *error) {
+                if (!error && acceptsRanges && length >= RangedDownloadMinimumLength) {
+                    ReportRangedDownload *download = [[ReportRangedDownload alloc] initWithURL:URL archivePath:archivePath];
+                    [self rangedDownloadReport:report download:download toFile:destFile progress:progress];
+                }
+                else {
+                    [self streamReport:report fromURL:URL toFile:destFile progress:progress];
+                }
+            }];
+        };
+        if (saved) {
+            // a download of another URL to the same file; its files have to be gone before a new one
+            // writes there
+            [saved discardWithCompletion:probe];
+        }
+        else {
+            probe();
+        }
+        return;
+    }
+    
+    NSURLRequest *request = [NSURLRequest requestWithURL:URL];
+    
+    NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration defaultSessionConfiguration];
+    AFURLSessionManager *manager = [[AFURLSessionManager alloc] initWithSessionConfiguration:configuration];
+    
+    NSURLSessionDownloadTask *downloadTask = [manager downloadTaskWithRequest:request progress:nil destination:^NSURL *(NSURL *targetPath, NSURLResponse *response) {
+        return destFile;
+    } completionHandler:^(NSURLResponse *response, NSURL *filePath, NSError *error) {
+        [progressChannel finishTrackingReport:report];
+        if(!error){
+            NSLog(@"Successfully downloaded: %@", [URL absoluteString]);
+            // Maybe add a dictionary value to NSUserDefaults to a downloaded dictionary with the URL as a key and YES as the value, check that dictionary before displaying the action sheet
+            dispatch_async(reportListQueue, ^{
+                [documentsWatcher scanForChanges];
             });
-            
+        }else{
+            NSLog(@"Problem downloading %@: %@", [URL path], [error localizedDescription]);
         }
     }];
     
+    [manager setDownloadTaskDidWriteDataBlock:^(NSURLSession *session, NSURLSessionDownloadTask *downloadTask, int64_t bytesWritten, int64_t totalBytesWritten, int64_t totalBytesExpectedToWrite) {
+        [progress setBytesDownloaded:totalBytesWritten ofDownloadSize:totalBytesExpectedToWrite];
+    }];
+    
     [downloadTask resume];
     
     // hand off completed file to be unzipped
 }
 
 
-- (void)deleteReportAtIndexPath:(NSIndexPath *)indexPath
+/*
+ * Extract a new report zip into a staging directory while it downloads, then give the placeholder report
+ * to the normal import, which moves the staged files into the content store and into place, as it
+ * does with an extraction of its own.
+ */
+- (void)streamReport:(Report *)report fromURL:(NSURL *)URL toFile:(NSURL *)destFile progress:(ReportProgress *)progress
 {
-    Report *report = reports[indexPath.item];
-    NSError *error;
-    NSLog(@"%@", [report.url absoluteURL]);
-    NSURL *folderURL = [NSURL URLWithString:[[report.url absoluteString] stringByDeletingLastPathComponent]];
-    BOOL folderDeleteSuccess = [fileManager removeItemAtPath:folderURL error:&error];
-    BOOL zipDeleteSuccess = [fileManager removeItemAtPath:[report.sourceFile absoluteURL] error:&error];
+    NSString *archivePath = [[NSTemporaryDirectory() stringByAppendingPathComponent:@"ReportDownloads"] stringByAppendingPathComponent:destFile.lastPathComponent];
+    NSString *stagingDir = [stagingRoot stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    ReportStreamingDownload *download = [[ReportStreamingDownload alloc] initWithURL:URL archivePath:archivePath destination:stagingDir];
+    download.progressBlock = ^(int64_t bytesReceived, int64_t bytesExpected) {
+        [progress setBytesDownloaded:bytesReceived ofDownloadSize:bytesExpected];
+    };
+    
+    [download startWithCompletion:^(NSError *error) {
+        [progressChannel finishTrackingReport:report];
+        if (!error) {
+            NSLog(@"Successfully downloaded: %@", [URL absoluteString]);
+            [self adoptDownloadedArchive:archivePath forReport:report toFile:destFile stagedContents:stagingDir];
+        }
+        else {
+            if ([fileManager fileExistsAtPath:stagingDir]) {
+                [trash moveItemToTrash:stagingDir completion:nil];
+            }
+            [self notifyDownloadFailed:report error:error];
+        }
+    }];
+}
+
+
+/*
+ * Download a report zip in resumable byte ranges, then import it like any other new zip.  Falls back
+ * to streaming when the server turns out not to serve ranges of the same file.
+ */
+- (void)rangedDownloadReport:(Report *)report download:(ReportRangedDownload *)download toFile:(NSURL *)destFile progress:(ReportProgress *)progress
+{
+    download.progressBlock = ^(int64_t bytesReceived, int64_t totalLength) {
+        [progress setBytesDownloaded:bytesReceived ofDownloadSize:totalLength];
+    };
+    [download startWithCompletion:^(NSError *error) {
+        if (!error) {
+            NSLog(@"Successfully downloaded: %@", download.URL.absoluteString);
+            [progressChannel finishTrackingReport:report];
+            [self adoptDownloadedArchive:download.archivePath forReport:report toFile:destFile stagedContents:nil];
+        }
+        else if ([error.domain isEqualToString:ReportDownloadErrorDomain]
+            && (error.code == ReportDownloadErrorRangesUnsupported || error.code == ReportDownloadErrorSourceChanged)) {
+            [download discard];
+            [self streamReport:report fromURL:download.URL toFile:destFile progress:progress];
+        }
+        else {
+            // the ranges received so far are kept; downloading the report again resumes it
+            [progressChannel finishTrackingReport:report];
+            [self notifyDownloadFailed:report error:error];
+        }
+    }];
+}
+
+
+/*
+ * Downloads interrupted by the app exiting pick up where they left off at the next launch.
+ */
+- (void)resumeSavedDownloads
+{
+    for (NSString *archivePath in [ReportRangedDownload savedArchivePathsInDirectory:downloadsDir]) {
+        ReportRangedDownload *download = [ReportRangedDownload savedDownloadWithArchivePath:archivePath];
+        NSURL *destFile = [documentsDir URLByAppendingPathComponent:archivePath.lastPathComponent];
+        if (!download || [fileManager fileExistsAtPath:destFile.path]) {
+            [download discard];
+            continue;
+        }
+        Report *report = [[Report alloc] initWithTitle:download.URL.absoluteString];
+        report.isEnabled = NO;
+        report.summary = @"Downloading...";
+        [reports addReport:report];
+        [self rangedDownloadReport:report download:download toFile:destFile progress:[progressChannel beginTrackingReport:report]];
+    }
+}
+
+
+/*
+ * Move a finished download into Documents and hand its placeholder report to the import scheduler.
+ * The staging directory of an archive that was extracted as it downloaded is left for the import
+ * to take, instead of extracting the archive again.
+ */
+- (void)adoptDownloadedArchive:(NSString *)archivePath forReport:(Report *)report toFile:(NSURL *)destFile stagedContents:(NSString *)stagingDir
+{
+    dispatch_async(reportListQueue, ^{
+        NSError *moveError;
+        // on the list queue, so a rescan can't pick up the zip before the placeholder claims it
+        if (![fileManager moveItemAtPath:archivePath toPath:destFile.path error:&moveError]) {
+            if (stagingDir) {
+                [trash moveItemToTrash:stagingDir completion:nil];
+            }
+            [self notifyDownloadFailed:report error:moveError];
+            return;
+        }
+        if (stagingDir) {
+            @synchronized (stagedDownloads) {
+                stagedDownloads[destFile.lastPathComponent] = stagingDir;
+            }
+        }
+        
+        report.sourceFile = destFile;
+        report.title = [destFile.lastPathComponent stringByDeletingPathExtension];
+        report.reportID = [destFile.lastPathComponent stringByAddingPercentEscapesUsingEncoding:NSUTF8StringEncoding];
+        [reports reindexReport:report];
+        [self scheduleZipImport:report priority:ReportImportPriorityUserInitiated afterComplete:nil];
+    });
+}
+
+
+- (void)notifyDownloadFailed:(Report *)report error:(NSError *)error
+{
+    NSLog(@"Problem downloading %@: %@", report.title, error.localizedDescription);
+    dispatch_async(dispatch_get_main_queue(), ^{
+        report.summary = [NSString stringWithFormat:@"Download failed: %@", error.localizedDescription];
+        [[NSNotificationCenter defaultCenter]
+         postNotificationName:[ReportNotification reportImportFail] object:self
+         userInfo:@{
+                    @"report": report,
+                    @"index": [NSString stringWithFormat:@"%lu", (unsigned long)[reports indexOfReport:report]],
+                    @"message": error.localizedDescription
+                    }];
+    });
+}
+
 
-    if (zipDeleteSuccess && folderDeleteSuccess) {
-        NSLog(@"Deleted %@", report.sourceFile);
-        [self loadReports];
+/*
+ * Rename the report's files into the trash, so a report of any size is gone at once, and take it out
+ * of the list without rescanning the Documents directory.  The trash reaper removes the files in the
+ * background.
+ */
+- (void)deleteReport:(Report *)report
+{
+    NSUInteger index = [reports indexOfReport:report];
+    if (index == NSNotFound) {
+        // already deleted, e.g., its file was removed from Documents first
+        return;
+    }
+    [self cancelImportOfReport:report];
+    
+    if (report.sourceFile) {
+        if (![trash moveItemToTrash:report.sourceFile.path completion:nil]) {
+            return;
+        }
+        BOOL extracted = [report.sourceFile.pathExtension caseInsensitiveCompare:@"zip"] == NSOrderedSame;
+        if (extracted) {
+            [ReportArchiveURLProtocol unmountDirectory:[self contentDirectoryForReportFile:report.sourceFile].path];
+        }
+        dispatch_async(reportListQueue, ^{
+            NSString *reportKey = report.sourceFile.lastPathComponent;
+            if (extracted) {
+                [self trashContentsOfReport:report];
+            }
+            [ReportImportManifest removeManifestForReport:reportKey];
+            [storage forgetReport:reportKey];
+        });
     }
+    
+    for (ReportCache *cache in report.cacheFiles) {
+        [[GeoPackageTileCache sharedCache] removeTilesOfGeoPackageAtPath:cache.path];
+    }
+    [reports removeReport:report];
+    [self scheduleCatalogSave];
+    [self finishBatchedImportOfReport:report];
+    NSLog(@"Deleted %@", report.sourceFile);
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [[NSNotificationCenter defaultCenter]
+            postNotificationName:[ReportNotification reportRemoved] object:self
+            userInfo:@{
+                @"report": report,
+                @"index": [NSString stringWithFormat:@"%lu", (unsigned long)index]
+            }];
+    });
 }
 
 
@@ -0,0 +1,33 @@
+//
+//  ReportArchiveURLProtocol.h
+//  DICE
+//
+
+#import <Foundation/Foundation.h>
+#import "ReportArchive.h"
+
+/**
+ Serves file URLs for reports that are mounted straight from their zip file instead
+ of being extracted.  A mounted report's content directory only holds the few files
+ that must exist on disk, like GeoPackages and thumbnails; every other request under
+ that directory is answered by inflating the matching archive entry.  Recently served
+ entries are kept in memory.
+ */
+@interface ReportArchiveURLProtocol : NSURLProtocol
+
+/**
+ *  Start and register the report archive URL Protocol
+ */
++ (void)start;
+
+/**
+ Serve requests under the given content directory from the archive.  The directory's
+ last path component must be the archive's top level directory.
+ */
++ (void)mountArchive:(ReportArchive *)archive atDirectory:(NSString *)contentDirectory;
+
++ (void)unmountDirectory:(NSString *)contentDirectory;
+
++ (BOOL)isMountedPath:(NSString *)path;
+
+@end
@@ -0,0 +1,241 @@
+//
+//  ReportArchiveURLProtocol.m
+//  DICE
+//
+
+#import "ReportArchiveURLProtocol.h"
+#import "GPKGGeoPackageValidate.h"
+#import <MobileCoreServices/MobileCoreServices.h>
+
+static const NSUInteger kMaxCachedEntrySize = 1 << 20;
+static const NSUInteger kEntryCacheCostLimit = 16 << 20;
+
+/**
+ A mounted archive and the readers available to serve its entries.
+ */
+@interface ReportArchiveMount : NSObject
+
+@property (nonatomic, strong) ReportArchive *archive;
+@property (nonatomic, strong) NSString *entryPrefix;
+@property (nonatomic, strong) NSMutableArray<ReportArchiveReader *> *idleReaders;
+/** keys of the entries this mount put in the entry cache, so unmounting evicts only those */
+@property (nonatomic, strong) NSMutableSet<NSString *> *cacheKeys;
+
+@end
+
+@implementation ReportArchiveMount
+
+- (ReportArchiveReader *)checkOutReader
+{
+    @synchronized (self) {
+        ReportArchiveReader *reader = self.idleReaders.lastObject;
+        if (reader) {
+            [self.idleReaders removeLastObject];
+            return reader;
+        }
+    }
+    return [[ReportArchiveReader alloc] initWithArchive:self.archive];
+}
+
+- (void)checkInReader:(ReportArchiveReader *)reader
+{
+    @synchronized (self) {
+        [self.idleReaders addObject:reader];
+    }
+}
+
+- (void)addCacheKey:(NSString *)key
+{
+    @synchronized (self) {
+        [self.cacheKeys addObject:key];
+    }
+}
+
+- (NSArray<NSString *> *)takeCacheKeys
+{
+    @synchronized (self) {
+        NSArray<NSString *> *keys = self.cacheKeys.allObjects;
+        [self.cacheKeys removeAllObjects];
+        return keys;
+    }
+}
+
+@end
+
+
+@implementation ReportArchiveURLProtocol
+
+static NSMutableDictionary<NSString *, ReportArchiveMount *> *mounts;
+static NSCache<NSString *, NSData *> *entryCache;
+
+/*
+ * Reports restored at launch are mounted again on the report list queue, which may get there before
+ * start, so the mounts have to exist as soon as the class is used.
+ */
++ (void)initialize {
+    if (self != [ReportArchiveURLProtocol class]) {
+        return;
+    }
+    mounts = [[NSMutableDictionary alloc] init];
+    entryCache = [[NSCache alloc] init];
+    entryCache.totalCostLimit = kEntryCacheCostLimit;
+}
+
++ (void)start {
+    [NSURLProtocol registerClass:self];
+}
+
+/*
+ * File URLs handed out by the system sometimes carry a /private prefix that the
+ * documents directory path does not, so compare paths without it.
+ */
++ (NSString *)normalizedPath:(NSString *)path {
+    if ([path hasPrefix:@"/private/var/"]) {
+        return [path substringFromIndex:@"/private".length];
+    }
+    return path;
+}
+
++ (void)mountArchive:(ReportArchive *)archive atDirectory:(NSString *)contentDirectory {
+    ReportArchiveMount *mount = [[ReportArchiveMount alloc] init];
+    mount.archive = archive;
+    mount.entryPrefix = [contentDirectory.lastPathComponent stringByAppendingString:@"/"];
+    mount.idleReaders = [[NSMutableArray alloc] init];
+    mount.cacheKeys = [[NSMutableSet alloc] init];
+    NSString *directory = [self normalizedPath:contentDirectory];
+    ReportArchiveMount *replaced;
+    @synchronized (mounts) {
+        replaced = mounts[directory];
+        mounts[directory] = mount;
+    }
+    // a revised zip mounted in place of the old one must not be served the old one's entries
+    [self evictCachedEntriesOfMount:replaced];
+    NSLog(@"ReportArchiveURLProtocol: mounted %@ at %@", archive.fileURL.lastPathComponent, contentDirectory);
+}
+
++ (void)unmountDirectory:(NSString *)contentDirectory {
+    NSString *directory = [self normalizedPath:contentDirectory];
+    ReportArchiveMount *mount;
+    @synchronized (mounts) {
+        mount = mounts[directory];
+        [mounts removeObjectForKey:directory];
+    }
+    [self evictCachedEntriesOfMount:mount];
+}
+
+/*
+ * Drop the mount's entries from the cache, leaving the entries of the other mounted reports.  Keys the
+ * cache already evicted on its own are removed again, which does nothing.
+ */
++ (void)evictCachedEntriesOfMount:(ReportArchiveMount *)mount {
+    for (NSString *key in [mount takeCacheKeys]) {
+        [entryCache removeObjectForKey:key];
+    }
+}
+
+/*
+ * Find the mount whose content directory contains the path by walking up the path,
+ * so a lookup costs a few dictionary probes no matter how many reports are mounted.
+ */
++ (ReportArchiveMount *)mountForPath:(NSString *)path entryName:(NSString **)entryName {
+    NSString *normalized = [self normalizedPath:path];
+    NSString *directory = normalized;
+    @synchronized (mounts) {
+        if (mounts.count == 0) {
+            return nil;
+        }
+        while (directory.length > 1) {
+            directory = [directory stringByDeletingLastPathComponent];
+            ReportArchiveMount *mount = mounts[directory];
+            if (mount) {
+                if (entryName) {
+                    *entryName = [mount.entryPrefix stringByAppendingString:[normalized substringFromIndex:directory.length + 1]];
+                }
+                return mount;
+            }
+        }
+    }
+    return nil;
+}
+
++ (BOOL)isMountedPath:(NSString *)path {
+    NSString *entryName;
+    ReportArchiveMount *mount = [self mountForPath:path entryName:&entryName];
+    return mount != nil && [mount.archive entryNamed:entryName] != nil;
+}
+
+/*
+ * Every file URL the web views load comes through here, so only paths under a mounted directory
+ * naming an entry of its archive go on to touch the file system.
+ */
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+    NSURL *url = request.URL;
+    if (!url.isFileURL || [GPKGGeoPackageValidate hasGeoPackageExtension:url.path]) {
+        return NO;
+    }
+    NSString *entryName;
+    ReportArchiveMount *mount = [self mountForPath:url.path entryName:&entryName];
+    if (!mount || ![mount.archive entryNamed:entryName]) {
+        return NO;
+    }
+    // files that were extracted next to the mount, like thumbnails, load normally
+    return ![[NSFileManager defaultManager] fileExistsAtPath:url.path];
+}
+
++ (NSURLRequest *)canonicalRequestForRequest:(NSURLRequest *)request {
+    return request;
+}
+
++ (NSString *)MIMETypeForPath:(NSString *)path {
+    NSString *mimeType = nil;
+    CFStringRef uti = UTTypeCreatePreferredIdentifierForTag(kUTTagClassFilenameExtension, (__bridge CFStringRef)path.pathExtension, NULL);
+    if (uti) {
+        mimeType = (__bridge_transfer NSString *)UTTypeCopyPreferredTagWithClass(uti, kUTTagClassMIMEType);
+        CFRelease(uti);
+    }
+    return mimeType ? mimeType : @"application/octet-stream";
+}
+
+- (void)startLoading {
+    NSURL *url = self.request.URL;
+    NSString *entryName;
+    ReportArchiveMount *mount = [ReportArchiveURLProtocol mountForPath:url.path entryName:&entryName];
+    ReportArchiveEntry *entry = [mount.archive entryNamed:entryName];
+
+    if (!entry || entry.isDirectory) {
+        [self.client URLProtocol:self didFailWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorFileDoesNotExist userInfo:@{NSURLErrorFailingURLErrorKey: url}]];
+        return;
+    }
+
+    NSString *cacheKey = [mount.archive.fileURL.path stringByAppendingPathComponent:entryName];
+    NSData *data = [entryCache objectForKey:cacheKey];
+    if (!data) {
+        NSError *error;
+        ReportArchiveReader *reader = [mount checkOutReader];
+        data = [reader dataForEntry:entry error:&error];
+        [mount checkInReader:reader];
+        if (!data) {
+            NSLog(@"ReportArchiveURLProtocol: error reading %@: %@", entryName, error.localizedDescription);
+            [self.client URLProtocol:self didFailWithError:error];
+            return;
+        }
+        if (data.length <= kMaxCachedEntrySize) {
+            [entryCache setObject:data forKey:cacheKey cost:data.length];
+            [mount addCacheKey:cacheKey];
+        }
+    }
+
+    NSURLResponse *response = [[NSURLResponse alloc] initWithURL:url
+                                                        MIMEType:[ReportArchiveURLProtocol MIMETypeForPath:entryName]
+                                           expectedContentLength:data.length
+                                                textEncodingName:nil];
+
+    [self.client URLProtocol:self didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageNotAllowed];
+    [self.client URLProtocol:self didLoadData:data];
+    [self.client URLProtocolDidFinishLoading:self];
+}
+
+- (void)stopLoading {
+}
+
+@end
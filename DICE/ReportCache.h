@@ -8,7 +8,7 @@
 
 #import <Foundation/Foundation.h>
 
-@interface ReportCache : NSObject
+@interface ReportCache : NSObject <NSCoding>
 
 @property (nonatomic, strong) NSString *name;
 @property (nonatomic, strong) NSString *path;
@@ -22,4 +22,14 @@
     return self;
 }
 
+- (id) initWithCoder:(NSCoder *)decoder{
+    return [self initWithName:[decoder decodeObjectForKey:@"name"] andPath:[decoder decodeObjectForKey:@"path"] andShared:[decoder decodeBoolForKey:@"shared"]];
+}
+
+- (void) encodeWithCoder:(NSCoder *)encoder{
+    [encoder encodeObject:self.name forKey:@"name"];
+    [encoder encodeObject:self.path forKey:@"path"];
+    [encoder encodeBool:self.shared forKey:@"shared"];
+}
+
 @end
@@ -0,0 +1,33 @@
+//
+//  ReportCatalog.h
+//  DICE
+//
+
+#import <Foundation/Foundation.h>
+#import "Report.h"
+
+/**
+ A persisted snapshot of the imported reports, so the report list can be shown at
+ launch without rescanning and reprocessing every file in Documents.  Each report
+ is stored with the size and modification date its source file had when the
+ catalog was saved; a report whose source file no longer matches is stale and has
+ to be imported again.  A catalog written by a different version, or for a
+ different Documents directory, is ignored.
+ */
+@interface ReportCatalog : NSObject
+
+- (instancetype)initWithPath:(NSString *)path documentsDirectory:(NSURL *)documentsDirectory;
+
+/**
+ Read the catalog, returning the reports it holds, or an empty array.
+ */
+- (NSArray<Report *> *)restoreReports;
+
+/**
+ NO if the report's source file changed since the catalog recorded it.
+ */
+- (BOOL)isReportCurrent:(Report *)report;
+
+- (BOOL)saveReports:(NSArray<Report *> *)reports;
+
+@end
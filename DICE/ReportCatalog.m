@@ -0,0 +1,116 @@
+//
+//  ReportCatalog.m
+//  DICE
+//
+
+#import "ReportCatalog.h"
+
+static const NSInteger kReportCatalogVersion = 1;
+
+@implementation ReportCatalog
+{
+    NSString *path;
+    NSURL *documentsDir;
+    NSMutableDictionary<NSString *, NSDictionary *> *sourceFileStats;
+}
+
+- (instancetype)initWithPath:(NSString *)aPath documentsDirectory:(NSURL *)documentsDirectory
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    path = aPath;
+    documentsDir = documentsDirectory;
+    sourceFileStats = [[NSMutableDictionary alloc] init];
+
+    return self;
+}
+
++ (NSDictionary *)statForFile:(NSURL *)file
+{
+    NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:file.path error:nil];
+    if (!attributes) {
+        return nil;
+    }
+    return @{
+        @"size": @(attributes.fileSize),
+        @"modified": attributes.fileModificationDate
+    };
+}
+
+- (NSArray<Report *> *)restoreReports
+{
+    NSData *data = [NSData dataWithContentsOfFile:path];
+    if (!data) {
+        return @[];
+    }
+
+    NSDictionary *catalog = nil;
+    @try {
+        catalog = [NSKeyedUnarchiver unarchiveObjectWithData:data];
+    }
+    @catch (NSException *exception) {
+        NSLog(@"ReportCatalog: discarding unreadable catalog %@: %@", path, exception.reason);
+        return @[];
+    }
+
+    // app updates move the container, which invalidates every stored URL
+    if (![catalog isKindOfClass:[NSDictionary class]]
+        || [catalog[@"version"] integerValue] != kReportCatalogVersion
+        || ![catalog[@"documentsDirectory"] isEqualToString:documentsDir.path]) {
+        NSLog(@"ReportCatalog: discarding out of date catalog %@", path);
+        return @[];
+    }
+
+    NSMutableArray<Report *> *restored = [NSMutableArray array];
+    for (NSDictionary *entry in catalog[@"reports"]) {
+        Report *report = entry[@"report"];
+        if (report.sourceFile) {
+            sourceFileStats[report.sourceFile.path] = entry[@"stat"];
+            [restored addObject:report];
+        }
+    }
+
+    NSLog(@"ReportCatalog: restored %lu reports", (unsigned long)restored.count);
+    return restored;
+}
+
+- (BOOL)isReportCurrent:(Report *)report
+{
+    NSDictionary *recorded = sourceFileStats[report.sourceFile.path];
+    if (!recorded) {
+        return YES;
+    }
+    return [recorded isEqualToDictionary:[ReportCatalog statForFile:report.sourceFile]];
+}
+
+- (BOOL)saveReports:(NSArray<Report *> *)reports
+{
+    NSMutableArray<NSDictionary *> *entries = [NSMutableArray arrayWithCapacity:reports.count];
+    for (Report *report in reports) {
+        // only completed imports; anything else gets picked up by the next scan
+        if (!report.sourceFile || !report.isEnabled) {
+            continue;
+        }
+        NSDictionary *stat = [ReportCatalog statForFile:report.sourceFile];
+        if (!stat) {
+            continue;
+        }
+        sourceFileStats[report.sourceFile.path] = stat;
+        [entries addObject:@{
+            @"report": report,
+            @"stat": stat
+        }];
+    }
+
+    NSDictionary *catalog = @{
+        @"version": @(kReportCatalogVersion),
+        @"documentsDirectory": documentsDir.path,
+        @"reports": entries
+    };
+    return [[NSKeyedArchiver archivedDataWithRootObject:catalog] writeToFile:path atomically:YES];
+}
+
+@end
@@ -21,7 +21,7 @@
 
 @protocol ReportCollectionView
 
-// TODO: make this non-mutable and fix view classes that attempt to mutate it
+// a snapshot from ReportAPI getReports; views fetch a new one when the list changes
 @property (strong, nonatomic) NSArray *reports;
 @property (strong, nonatomic) id<ReportCollectionViewDelegate> delegate;
 
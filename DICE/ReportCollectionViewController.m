@@ -8,6 +8,7 @@
 
 #import "ReportCollectionViewController.h"
 
+#import "DICENavigationController.h"
 #import "ReportAPI.h"
 #import "ReportCollectionView.h"
 #import "ReportResourceViewController.h"
@@ -127,10 +128,14 @@
 - (void)reportSelectedToView:(Report *)report {
     selectedReport = report;
     if ([selectedReport.reportID isEqualToString:[ReportAPI userGuideReportID]]) {
+        [[ReportAPI sharedInstance] openReport:report whenReady:nil];
         [[UIApplication sharedApplication] openURL:[NSURL URLWithString:@"https://github.com/ngageoint/disconnected-content-explorer-examples/raw/master/reportzips/DICEUserGuide.zip"]];
     }
     else {
-        [self performSegueWithIdentifier:@"showReport" sender:self];
+        // an evicted report is unzipped again before it is shown
+        [(DICENavigationController *)self.navigationController openReport:report thenShow:^{
+            [self performSegueWithIdentifier:@"showReport" sender:self];
+        }];
     }
 }
 
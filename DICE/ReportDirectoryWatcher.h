@@ -0,0 +1,70 @@
+//
+//  ReportDirectoryWatcher.h
+//  DICE
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ Watches the regular files directly in a directory, e.g., the report files in Documents, and
+ reports which were added, removed, or modified, by name, instead of leaving its owner to
+ rescan the directory and check every file it knows about.  The kernel signals that the
+ directory changed through a dispatch source; the watcher then lists the directory once,
+ compares the names and inodes with the listing before, and passes on only the difference.
+ Only the files that are new or were replaced are stat'ed, for the size and modification
+ time they settle on.  Bursts of changes are coalesced into one listing.  Hidden files are
+ ignored.
+
+ A file that is still being written, e.g., copied in in chunks, is not passed on until its
+ size and modification time have stayed the same for the settle interval; while any file
+ is settling, the watcher lists the directory again each settle interval and stats just
+ the settling files.  Watching holds one file descriptor open, for the directory.  A file
+ rewritten in place, rather than replaced, leaves the directory as it was, so it is not
+ seen as modified.
+ */
+@interface ReportDirectoryWatcher : NSObject
+
+@property (nonatomic, readonly) NSString *directory;
+@property (nonatomic, readonly) BOOL isWatching;
+
+/**
+ The regular files in the directory as of the last listing, sorted by name, e.g., the files that were
+ there when the watcher started.  Files still settling are left out.  Call on the watcher's queue.
+ */
+@property (nonatomic, readonly) NSArray<NSString *> *fileNames;
+
+/**
+ How long to wait after the directory changes for more changes before listing it; defaults to 0.25 seconds.
+ */
+@property (nonatomic) NSTimeInterval coalescingDelay;
+
+/**
+ How long a changed file's size and modification time have to stay the same before it is passed on;
+ defaults to 1 second.
+ */
+@property (nonatomic) NSTimeInterval settleInterval;
+
+/**
+ Called on the watcher's queue with the names of the files that changed, only when something did.
+ */
+@property (nonatomic, copy) void (^changeHandler)(NSArray<NSString *> *added, NSArray<NSString *> *removed, NSArray<NSString *> *modified);
+
+/**
+ The watcher lists the directory and calls the change handler on the given serial queue.
+ */
+- (instancetype)initWithDirectory:(NSString *)directory queue:(dispatch_queue_t)queue;
+
+/**
+ List the directory as it is now, as the baseline for the changes that follow, and start watching it.
+ Call on the watcher's queue, after the owner has dealt with the files already there.
+ */
+- (BOOL)start;
+- (void)stop;
+
+/**
+ List the directory now and report what changed since the last listing, except the files still settling.
+ Call on the watcher's queue.
+ */
+- (void)scanForChanges;
+
+@end
@@ -0,0 +1,202 @@
+//
+//  ReportDirectoryWatcher.m
+//  DICE
+//
+
+#import "ReportDirectoryWatcher.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+@implementation ReportDirectoryWatcher
+{
+    dispatch_queue_t queue;
+    dispatch_source_t source;
+    NSDictionary<NSString *, NSArray<NSNumber *> *> *listing;
+    NSMutableDictionary<NSString *, NSArray<NSNumber *> *> *settling;
+    NSMutableDictionary<NSString *, NSNumber *> *settlingSince;
+    BOOL scanScheduled;
+}
+
+- (instancetype)initWithDirectory:(NSString *)directory queue:(dispatch_queue_t)aQueue
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _directory = directory;
+    _coalescingDelay = 0.25;
+    _settleInterval = 1;
+    queue = aQueue;
+    listing = @{};
+    settling = [NSMutableDictionary dictionary];
+    settlingSince = [NSMutableDictionary dictionary];
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [self stop];
+}
+
+- (BOOL)isWatching
+{
+    return source != nil;
+}
+
+- (NSArray<NSString *> *)fileNames
+{
+    return [listing.allKeys sortedArrayUsingSelector:@selector(compare:)];
+}
+
+- (BOOL)start
+{
+    if (source) {
+        return YES;
+    }
+
+    int fd = open(self.directory.fileSystemRepresentation, O_EVTONLY);
+    if (fd < 0) {
+        NSLog(@"ReportDirectoryWatcher: could not watch %@: %s", self.directory, strerror(errno));
+        return NO;
+    }
+    source = dispatch_source_create(DISPATCH_SOURCE_TYPE_VNODE, (uintptr_t)fd, DISPATCH_VNODE_WRITE, queue);
+    __weak ReportDirectoryWatcher *weakSelf = self;
+    dispatch_source_set_event_handler(source, ^{
+        [weakSelf scheduleScan];
+    });
+    dispatch_source_set_cancel_handler(source, ^{
+        close(fd);
+    });
+    dispatch_resume(source);
+    listing = [self listDirectoryComparingWith:@{}];
+    [settling removeAllObjects];
+    [settlingSince removeAllObjects];
+
+    return YES;
+}
+
+- (void)stop
+{
+    if (source) {
+        dispatch_source_cancel(source);
+        source = nil;
+    }
+}
+
+- (void)scheduleScan
+{
+    [self scheduleScanAfter:self.coalescingDelay];
+}
+
+- (void)scheduleScanAfter:(NSTimeInterval)delay
+{
+    if (scanScheduled) {
+        return;
+    }
+    scanScheduled = YES;
+    __weak ReportDirectoryWatcher *weakSelf = self;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), queue, ^{
+        ReportDirectoryWatcher *watcher = weakSelf;
+        if (watcher) {
+            watcher->scanScheduled = NO;
+            [watcher scanForChanges];
+        }
+    });
+}
+
+- (void)scanForChanges
+{
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    NSDictionary<NSString *, NSArray<NSNumber *> *> *current = [self listDirectoryComparingWith:listing];
+    NSMutableDictionary<NSString *, NSArray<NSNumber *> *> *passedOn = [listing mutableCopy];
+    NSMutableArray<NSString *> *added = [NSMutableArray array];
+    NSMutableArray<NSString *> *removed = [NSMutableArray array];
+    NSMutableArray<NSString *> *modified = [NSMutableArray array];
+    [current enumerateKeysAndObjectsUsingBlock:^(NSString *name, NSArray<NSNumber *> *attrs, BOOL *stop) {
+        NSArray<NSNumber *> *before = listing[name];
+        if ([before isEqualToArray:attrs]) {
+            [settling removeObjectForKey:name];
+            [settlingSince removeObjectForKey:name];
+            return;
+        }
+        // still being written if it changed since the last scan, so it starts settling again
+        if (![settling[name] isEqualToArray:attrs]) {
+            settling[name] = attrs;
+            settlingSince[name] = @(now);
+        }
+        if (now - settlingSince[name].doubleValue < self.settleInterval) {
+            return;
+        }
+        [settling removeObjectForKey:name];
+        [settlingSince removeObjectForKey:name];
+        passedOn[name] = attrs;
+        if (!before) {
+            [added addObject:name];
+        }
+        else {
+            [modified addObject:name];
+        }
+    }];
+    for (NSString *name in listing) {
+        if (!current[name]) {
+            [removed addObject:name];
+            [passedOn removeObjectForKey:name];
+        }
+    }
+    for (NSString *name in settling.allKeys) {
+        if (!current[name]) {
+            [settling removeObjectForKey:name];
+            [settlingSince removeObjectForKey:name];
+        }
+    }
+    listing = passedOn;
+
+    // files still settling may not change the directory again, so look at them again either way
+    if (source && settling.count) {
+        [self scheduleScanAfter:self.settleInterval];
+    }
+
+    if ((added.count || removed.count || modified.count) && self.changeHandler) {
+        self.changeHandler(added, removed, modified);
+    }
+}
+
+/*
+ * The size, modification time, and inode of each regular file in the directory, by name.  Only the
+ * files that are new, were replaced by another file under the same name, or are still settling are
+ * stat'ed; the rest keep their attributes from the previous listing.
+ */
+- (NSDictionary<NSString *, NSArray<NSNumber *> *> *)listDirectoryComparingWith:(NSDictionary<NSString *, NSArray<NSNumber *> *> *)previous
+{
+    NSMutableDictionary<NSString *, NSArray<NSNumber *> *> *files = [NSMutableDictionary dictionary];
+    DIR *dir = opendir(self.directory.fileSystemRepresentation);
+    if (!dir) {
+        return files;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        if (entry->d_name[0] == '.' || (entry->d_type != DT_REG && entry->d_type != DT_UNKNOWN)) {
+            continue;
+        }
+        NSString *name = [[NSFileManager defaultManager] stringWithFileSystemRepresentation:entry->d_name length:strlen(entry->d_name)];
+        NSArray<NSNumber *> *before = previous[name];
+        if (before && !settling[name] && [before[3] unsignedLongLongValue] == entry->d_ino) {
+            files[name] = before;
+            continue;
+        }
+        struct stat info;
+        if (fstatat(dirfd(dir), entry->d_name, &info, AT_SYMLINK_NOFOLLOW) != 0 || !S_ISREG(info.st_mode)) {
+            continue;
+        }
+        files[name] = @[@(info.st_size), @(info.st_mtimespec.tv_sec), @(info.st_mtimespec.tv_nsec), @(info.st_ino)];
+    }
+    closedir(dir);
+    return files;
+}
+
+@end
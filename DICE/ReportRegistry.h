@@ -0,0 +1,57 @@
+//
+//  ReportRegistry.h
+//  DICE
+//
+
+#import <Foundation/Foundation.h>
+#import "Report.h"
+
+/**
+ The list of reports ReportAPI knows about, indexed by report ID and source file.
+ Every change to the list publishes a new immutable snapshot, so readers on any thread
+ get a consistent array without locking and never see a list that is mutated while they
+ iterate it.  Lookups by ID, source file, or report are dictionary probes rather than
+ scans of the list.  Changes are serialized and update the indexes in place, touching
+ only the entries of the reports that changed, and of the reports after a removed one.
+ */
+@interface ReportRegistry : NSObject
+
+/**
+ The current snapshot.  The array never changes after it is returned.
+ */
+@property (readonly) NSArray<Report *> *reports;
+@property (readonly) NSUInteger count;
+
+- (instancetype)initWithReports:(NSArray<Report *> *)reports;
+
+- (Report *)reportForID:(NSString *)reportID;
+- (Report *)reportForSourceFile:(NSURL *)sourceFile;
+
+/**
+ The report's index in the current snapshot, or NSNotFound.
+ */
+- (NSUInteger)indexOfReport:(Report *)report;
+
+/**
+ Append the report, returning its index in the new snapshot.
+ */
+- (NSUInteger)addReport:(Report *)report;
+
+/**
+ Append the reports, publishing one snapshot for all of them, e.g., for the reports found at launch.
+ */
+- (void)addReports:(NSArray<Report *> *)reports;
+
+- (void)removeReport:(Report *)report;
+
+/**
+ Keep only the reports for which the block returns YES.
+ */
+- (void)filterUsingBlock:(BOOL (^)(Report *report))keep;
+
+/**
+ Update the report's index entries after its ID or source file changed.
+ */
+- (void)reindexReport:(Report *)report;
+
+@end
@@ -0,0 +1,243 @@
+//
+//  ReportRegistry.m
+//  DICE
+//
+
+#import "ReportRegistry.h"
+
+
+@interface ReportRegistry ()
+
+@property (atomic, copy) NSArray<Report *> *snapshot;
+
+@end
+
+@implementation ReportRegistry
+{
+    // lookups run concurrently on the index queue; changes are barriers on it
+    dispatch_queue_t indexQueue;
+    // each key's reports in list order, so the first report in the list wins, as it did when lookups scanned the list
+    NSMutableDictionary<NSString *, NSMutableArray<Report *> *> *reportsByID;
+    NSMutableDictionary<NSString *, NSMutableArray<Report *> *> *reportsBySourceFile;
+    NSMapTable<Report *, NSNumber *> *indexesByReport;
+    // the keys each report is indexed under, to find its entries again once its ID or source file changed
+    NSMapTable<Report *, NSString *> *indexedIDs;
+    NSMapTable<Report *, NSString *> *indexedSourceKeys;
+}
+
+- (instancetype)init
+{
+    return [self initWithReports:@[]];
+}
+
+- (instancetype)initWithReports:(NSArray<Report *> *)reports
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    indexQueue = dispatch_queue_create("dice.report_registry", DISPATCH_QUEUE_CONCURRENT);
+    reportsByID = [NSMutableDictionary dictionary];
+    reportsBySourceFile = [NSMutableDictionary dictionary];
+    indexesByReport = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+    indexedIDs = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+    indexedSourceKeys = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+    self.snapshot = @[];
+    [self appendReports:reports];
+
+    return self;
+}
+
+- (NSArray<Report *> *)reports
+{
+    return self.snapshot;
+}
+
+- (NSUInteger)count
+{
+    return self.snapshot.count;
+}
+
+- (Report *)reportForID:(NSString *)reportID
+{
+    if (!reportID) {
+        return nil;
+    }
+    __block Report *report;
+    dispatch_sync(indexQueue, ^{
+        report = reportsByID[reportID].firstObject;
+    });
+    return report;
+}
+
+- (Report *)reportForSourceFile:(NSURL *)sourceFile
+{
+    NSString *sourceKey = sourceFile.absoluteString;
+    if (!sourceKey) {
+        return nil;
+    }
+    __block Report *report;
+    dispatch_sync(indexQueue, ^{
+        report = reportsBySourceFile[sourceKey].firstObject;
+    });
+    return report;
+}
+
+- (NSUInteger)indexOfReport:(Report *)report
+{
+    if (!report) {
+        return NSNotFound;
+    }
+    __block NSNumber *index;
+    dispatch_sync(indexQueue, ^{
+        index = [indexesByReport objectForKey:report];
+    });
+    return index ? index.unsignedIntegerValue : NSNotFound;
+}
+
+- (NSUInteger)addReport:(Report *)report
+{
+    __block NSUInteger index = NSNotFound;
+    dispatch_barrier_sync(indexQueue, ^{
+        index = self.snapshot.count;
+        [self appendReports:@[report]];
+    });
+    return index;
+}
+
+- (void)addReports:(NSArray<Report *> *)reports
+{
+    if (reports.count == 0) {
+        return;
+    }
+    dispatch_barrier_sync(indexQueue, ^{
+        [self appendReports:reports];
+    });
+}
+
+- (void)removeReport:(Report *)report
+{
+    dispatch_barrier_sync(indexQueue, ^{
+        NSNumber *index = [indexesByReport objectForKey:report];
+        if (!index) {
+            return;
+        }
+        NSMutableArray<Report *> *next = [self.snapshot mutableCopy];
+        [next removeObjectAtIndex:index.unsignedIntegerValue];
+        [self unindexReport:report];
+        [indexesByReport removeObjectForKey:report];
+        // only the reports after it moved
+        for (NSUInteger i = index.unsignedIntegerValue; i < next.count; i++) {
+            [indexesByReport setObject:@(i) forKey:next[i]];
+        }
+        self.snapshot = next;
+    });
+}
+
+- (void)filterUsingBlock:(BOOL (^)(Report *report))keep
+{
+    dispatch_barrier_sync(indexQueue, ^{
+        NSArray<Report *> *current = self.snapshot;
+        NSMutableArray<Report *> *next = [NSMutableArray arrayWithCapacity:current.count];
+        for (Report *report in current) {
+            if (keep(report)) {
+                [indexesByReport setObject:@(next.count) forKey:report];
+                [next addObject:report];
+            }
+            else {
+                [self unindexReport:report];
+                [indexesByReport removeObjectForKey:report];
+            }
+        }
+        if (next.count != current.count) {
+            self.snapshot = next;
+        }
+    });
+}
+
+- (void)reindexReport:(Report *)report
+{
+    dispatch_barrier_sync(indexQueue, ^{
+        if (![indexesByReport objectForKey:report]) {
+            return;
+        }
+        [self unindexReport:report];
+        [self indexReport:report];
+    });
+}
+
+/*
+ * Append the reports to the list, index them, and publish the new list.  Called within a barrier, or from init.
+ */
+- (void)appendReports:(NSArray<Report *> *)reports
+{
+    NSArray<Report *> *next = [self.snapshot arrayByAddingObjectsFromArray:reports];
+    for (NSUInteger i = next.count - reports.count; i < next.count; i++) {
+        [indexesByReport setObject:@(i) forKey:next[i]];
+        [self indexReport:next[i]];
+    }
+    self.snapshot = next;
+}
+
+/*
+ * Add the report to the ID and source file indexes under its current keys.  The report's
+ * index in the list has to be set first.
+ */
+- (void)indexReport:(Report *)report
+{
+    NSString *reportID = report.reportID;
+    NSString *sourceKey = report.sourceFile.absoluteString;
+    if (reportID) {
+        [self insertReport:report intoIndex:reportsByID forKey:reportID];
+        [indexedIDs setObject:reportID forKey:report];
+    }
+    if (sourceKey) {
+        [self insertReport:report intoIndex:reportsBySourceFile forKey:sourceKey];
+        [indexedSourceKeys setObject:sourceKey forKey:report];
+    }
+}
+
+/*
+ * Drop the report from the ID and source file indexes under the keys it was indexed with.
+ */
+- (void)unindexReport:(Report *)report
+{
+    NSString *reportID = [indexedIDs objectForKey:report];
+    if (reportID) {
+        [self removeReport:report fromIndex:reportsByID forKey:reportID];
+        [indexedIDs removeObjectForKey:report];
+    }
+    NSString *sourceKey = [indexedSourceKeys objectForKey:report];
+    if (sourceKey) {
+        [self removeReport:report fromIndex:reportsBySourceFile forKey:sourceKey];
+        [indexedSourceKeys removeObjectForKey:report];
+    }
+}
+
+- (void)insertReport:(Report *)report intoIndex:(NSMutableDictionary<NSString *, NSMutableArray<Report *> *> *)index forKey:(NSString *)key
+{
+    NSMutableArray<Report *> *reports = index[key];
+    if (!reports) {
+        index[key] = [NSMutableArray arrayWithObject:report];
+        return;
+    }
+    // keys are almost always unique, so this is rarely more than one comparison
+    NSUInteger listIndex = [[indexesByReport objectForKey:report] unsignedIntegerValue];
+    NSUInteger position = reports.count;
+    while (position > 0 && [[indexesByReport objectForKey:reports[position - 1]] unsignedIntegerValue] > listIndex) {
+        position--;
+    }
+    [reports insertObject:report atIndex:position];
+}
+
+- (void)removeReport:(Report *)report fromIndex:(NSMutableDictionary<NSString *, NSMutableArray<Report *> *> *)index forKey:(NSString *)key
+{
+    NSMutableArray<Report *> *reports = index[key];
+    [reports removeObjectIdenticalTo:report];
+    if (reports.count == 0) {
+        [index removeObjectForKey:key];
+    }
+}
+
+@end
@@ -0,0 +1,52 @@
+//
+//  ReportStorageManager.h
+//  DICE
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ Keeps the extracted contents of reports within a disk budget.  It records how much
+ space each report's extracted directory takes and when the report was last opened,
+ keyed by the report's source file name, and picks the least recently opened reports
+ to evict when the total goes over budget.  An evicted report keeps its zip and its
+ place in the report list, and is extracted again the next time it is opened.
+ The records are saved to a file as they change.
+ */
+@interface ReportStorageManager : NSObject
+
+/**
+ The most bytes of extracted report contents to keep; 0, the default, for no limit.
+ */
+@property (nonatomic) uint64_t budget;
+
+/**
+ Reports opened more recently than this are never evicted; defaults to an hour.
+ */
+@property (nonatomic) NSTimeInterval minimumIdleTime;
+
+/**
+ The total size of the reports that are extracted.
+ */
+@property (nonatomic, readonly) uint64_t extractedSize;
+
+- (instancetype)initWithPath:(NSString *)path;
+
+/**
+ Record the size of the report's newly extracted contents.  A report that was evicted
+ is extracted again.  A report seen for the first time counts as opened now.
+ */
+- (void)recordContentSize:(uint64_t)size ofReport:(NSString *)reportKey;
+
+- (void)reportOpened:(NSString *)reportKey;
+- (void)reportEvicted:(NSString *)reportKey;
+- (BOOL)isReportEvicted:(NSString *)reportKey;
+- (void)forgetReport:(NSString *)reportKey;
+
+/**
+ The reports to evict, least recently opened first, to bring the extracted size within
+ budget.  Reports the block returns YES for are left alone.
+ */
+- (NSArray<NSString *> *)reportsToEvictSkipping:(BOOL (^)(NSString *reportKey))skip;
+
+@end
@@ -0,0 +1,141 @@
+//
+//  ReportStorageManager.m
+//  DICE
+//
+
+#import "ReportStorageManager.h"
+
+static NSString * const kSizeKey = @"size";
+static NSString * const kLastOpenedKey = @"lastOpened";
+static NSString * const kEvictedKey = @"evicted";
+
+@implementation ReportStorageManager
+{
+    NSString *path;
+    NSMutableDictionary<NSString *, NSMutableDictionary *> *records;
+}
+
+- (instancetype)initWithPath:(NSString *)aPath
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    path = aPath;
+    _minimumIdleTime = 60 * 60;
+    records = [NSMutableDictionary dictionary];
+    NSData *data = [NSData dataWithContentsOfFile:path];
+    NSDictionary *saved = data ? [NSPropertyListSerialization propertyListWithData:data options:NSPropertyListImmutable format:NULL error:nil] : nil;
+    if ([saved isKindOfClass:[NSDictionary class]]) {
+        for (NSString *reportKey in saved) {
+            records[reportKey] = [saved[reportKey] mutableCopy];
+        }
+    }
+
+    return self;
+}
+
+/*
+ * Runs with the records locked.
+ */
+- (void)save
+{
+    NSData *data = [NSPropertyListSerialization dataWithPropertyList:records format:NSPropertyListBinaryFormat_v1_0 options:0 error:nil];
+    if (![data writeToFile:path atomically:YES]) {
+        NSLog(@"ReportStorageManager: could not save %@", path);
+    }
+}
+
+- (uint64_t)extractedSize
+{
+    @synchronized (self) {
+        uint64_t total = 0;
+        for (NSDictionary *record in records.allValues) {
+            if (![record[kEvictedKey] boolValue]) {
+                total += [record[kSizeKey] unsignedLongLongValue];
+            }
+        }
+        return total;
+    }
+}
+
+- (void)recordContentSize:(uint64_t)size ofReport:(NSString *)reportKey
+{
+    @synchronized (self) {
+        NSMutableDictionary *record = records[reportKey];
+        if (!record) {
+            record = records[reportKey] = [NSMutableDictionary dictionaryWithObject:[NSDate date] forKey:kLastOpenedKey];
+        }
+        record[kSizeKey] = @(size);
+        record[kEvictedKey] = @NO;
+        [self save];
+    }
+}
+
+- (void)reportOpened:(NSString *)reportKey
+{
+    @synchronized (self) {
+        NSMutableDictionary *record = records[reportKey];
+        if (record) {
+            record[kLastOpenedKey] = [NSDate date];
+            [self save];
+        }
+    }
+}
+
+- (void)reportEvicted:(NSString *)reportKey
+{
+    @synchronized (self) {
+        records[reportKey][kEvictedKey] = @YES;
+        [self save];
+    }
+}
+
+- (BOOL)isReportEvicted:(NSString *)reportKey
+{
+    @synchronized (self) {
+        return [records[reportKey][kEvictedKey] boolValue];
+    }
+}
+
+- (void)forgetReport:(NSString *)reportKey
+{
+    @synchronized (self) {
+        [records removeObjectForKey:reportKey];
+        [self save];
+    }
+}
+
+- (NSArray<NSString *> *)reportsToEvictSkipping:(BOOL (^)(NSString *reportKey))skip
+{
+    uint64_t extracted = self.extractedSize;
+    if (self.budget == 0 || extracted <= self.budget) {
+        return @[];
+    }
+
+    NSDictionary<NSString *, NSDictionary *> *snapshot;
+    @synchronized (self) {
+        snapshot = [[NSDictionary alloc] initWithDictionary:records copyItems:YES];
+    }
+    NSArray<NSString *> *leastRecentFirst = [snapshot keysSortedByValueUsingComparator:^NSComparisonResult(NSDictionary *a, NSDictionary *b) {
+        return [a[kLastOpenedKey] compare:b[kLastOpenedKey]];
+    }];
+
+    NSDate *idleSince = [NSDate dateWithTimeIntervalSinceNow:-self.minimumIdleTime];
+    NSMutableArray<NSString *> *evict = [NSMutableArray array];
+    for (NSString *reportKey in leastRecentFirst) {
+        NSDictionary *record = snapshot[reportKey];
+        if (extracted <= self.budget || [record[kLastOpenedKey] compare:idleSince] == NSOrderedDescending) {
+            break;
+        }
+        if ([record[kEvictedKey] boolValue] || skip(reportKey)) {
+            continue;
+        }
+        [evict addObject:reportKey];
+        extracted -= MIN(extracted, [record[kSizeKey] unsignedLongLongValue]);
+    }
+    return evict;
+}
+
+@end
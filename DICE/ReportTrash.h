@@ -0,0 +1,39 @@
+//
+//  ReportTrash.h
+//  DICE
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ A directory that report files and directories are renamed into when they are deleted or
+ evicted, so they are gone from where they were in one atomic step, however many files
+ they hold.  A reaper on a background queue then unlinks what is in the trash a batch at
+ a time, letting other background work in between batches.  The trash must be on the
+ same volume as the items moved into it.
+ */
+@interface ReportTrash : NSObject
+
+@property (nonatomic, readonly) NSString *directory;
+
+/**
+ How many files and directories the reaper removes before yielding; defaults to 256.
+ */
+@property (nonatomic) NSUInteger batchSize;
+
+- (instancetype)initWithDirectory:(NSString *)directory;
+
+/**
+ Rename the file or directory into the trash and queue it for reaping.  The completion block
+ is called on a background queue once the item is removed from disk.  Returns NO, without
+ calling the completion block, if the item could not be moved.
+ */
+- (BOOL)moveItemToTrash:(NSString *)path completion:(void (^)(void))completion;
+
+/**
+ Queue whatever is already in the trash, e.g., left over from when the app last exited,
+ for reaping.
+ */
+- (void)empty;
+
+@end
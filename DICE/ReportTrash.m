@@ -0,0 +1,102 @@
+//
+//  ReportTrash.m
+//  DICE
+//
+
+#import "ReportTrash.h"
+
+#include <fts.h>
+#include <unistd.h>
+
+@implementation ReportTrash
+{
+    dispatch_queue_t reaperQueue;
+}
+
+- (instancetype)initWithDirectory:(NSString *)directory
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _directory = directory;
+    _batchSize = 256;
+    reaperQueue = dispatch_queue_create("dice.report_trash", DISPATCH_QUEUE_SERIAL);
+    dispatch_set_target_queue(reaperQueue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0));
+
+    return self;
+}
+
+- (BOOL)moveItemToTrash:(NSString *)path completion:(void (^)(void))completion
+{
+    NSFileManager *fileManager = [[NSFileManager alloc] init];
+    NSString *trashPath = [self.directory stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    [fileManager createDirectoryAtPath:self.directory withIntermediateDirectories:YES attributes:nil error:nil];
+    if (rename(path.fileSystemRepresentation, trashPath.fileSystemRepresentation) != 0) {
+        NSLog(@"ReportTrash: could not move %@ to the trash: %s", path, strerror(errno));
+        return NO;
+    }
+    [self reapItemAtPath:trashPath completion:completion];
+    return YES;
+}
+
+- (void)empty
+{
+    for (NSString *name in [[[NSFileManager alloc] init] contentsOfDirectoryAtPath:self.directory error:nil]) {
+        [self reapItemAtPath:[self.directory stringByAppendingPathComponent:name] completion:nil];
+    }
+}
+
+- (void)reapItemAtPath:(NSString *)path completion:(void (^)(void))completion
+{
+    dispatch_async(reaperQueue, ^{
+        char *paths[] = { (char *)path.fileSystemRepresentation, NULL };
+        FTS *fts = fts_open(paths, FTS_PHYSICAL | FTS_NOCHDIR | FTS_NOSTAT, NULL);
+        if (!fts) {
+            NSLog(@"ReportTrash: could not remove %@: %s", path, strerror(errno));
+            if (completion) {
+                completion();
+            }
+            return;
+        }
+        [self reapBatchOf:fts completion:completion];
+    });
+}
+
+/*
+ * Remove the next batch of what the walk finds, directories after their contents, then queue the
+ * following batch behind whatever else is waiting, until the walk is done.  Runs on the reaper queue.
+ */
+- (void)reapBatchOf:(FTS *)fts completion:(void (^)(void))completion
+{
+    NSUInteger batchSize = MAX(self.batchSize, (NSUInteger)1);
+    NSUInteger removed = 0;
+    FTSENT *entry = NULL;
+    while (removed < batchSize && (entry = fts_read(fts))) {
+        switch (entry->fts_info) {
+            case FTS_D:
+                break;
+            case FTS_DP:
+                rmdir(entry->fts_accpath);
+                removed++;
+                break;
+            default:
+                unlink(entry->fts_accpath);
+                removed++;
+                break;
+        }
+    }
+    if (entry) {
+        dispatch_async(reaperQueue, ^{
+            [self reapBatchOf:fts completion:completion];
+        });
+        return;
+    }
+    fts_close(fts);
+    if (completion) {
+        completion();
+    }
+}
+
+@end
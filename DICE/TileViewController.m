@@ -25,7 +25,10 @@
     
     [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(updateReportImportProgress:) name:[ReportNotification reportImportProgress] object:nil];
     [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(refreshReportTiles:) name:[ReportNotification reportImportFinished] object:nil];
+    [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(refreshReportTiles:) name:[ReportNotification reportMetadataReady] object:nil];
     [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(refreshReportTiles:) name:[ReportNotification reportsLoaded] object:nil];
+    [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(refreshReportTiles:) name:[ReportNotification reportRemoved] object:nil];
+    [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(refreshReportTiles:) name:[ReportNotification reportsChanged] object:nil];
     
     [self.tileView setDataSource:self];
     [self.tileView setDelegate:self];
@@ -104,7 +107,7 @@
     else {
         cell.userInteractionEnabled = NO;
         if (report.totalNumberOfFiles > 0 && report.progress > 0) {
-            cell.reportDescription.text = [NSString stringWithFormat:@"%d of %d files unzipped", report.progress, report.totalNumberOfFiles];
+            cell.reportDescription.text = [NSString stringWithFormat:@"%lld of %lld files unzipped", report.progress, report.totalNumberOfFiles];
         } else if (report.downloadSize > 0 && report.downloadProgress > 0) {
             float progress = ((float)report.downloadProgress) / report.downloadSize;
             cell.reportDescription.text = [NSString stringWithFormat:@"%d %% downloaded", (int)(progress * 100) ];
@@ -153,6 +156,7 @@
         if ([notification.name isEqualToString:[ReportNotification reportsLoaded]]) {
             [self.refreshControl endRefreshing];
         }
+        self.reports = [[ReportAPI sharedInstance] getReports];
         [self.tileView reloadData];
     });
 }
@@ -175,8 +179,8 @@
     if (indexPath == nil) {
         NSLog(@"Cant find index path.");
     } else {
-        self.indexToDelete = indexPath;
-        Report *longPressedReport = self.reports[self.indexToDelete.item];
+        Report *longPressedReport = self.reports[indexPath.item];
+        self.reportToDelete = longPressedReport;
         NSLog(@"Long pressed on %@",  longPressedReport.title);
         
         NSString *title = [NSString stringWithFormat:@"Delete %@?", longPressedReport.title];
@@ -193,8 +197,9 @@
         NSLog(@"Delete tapped");
         // make the call to the ReportAPI
 
-        [[ReportAPI sharedInstance] deleteReportAtIndexPath:self.indexToDelete];
+        [[ReportAPI sharedInstance] deleteReport:self.reportToDelete];
     }
+    self.reportToDelete = nil;
 }
 
 
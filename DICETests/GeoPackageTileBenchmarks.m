@@ -0,0 +1,176 @@
+//
+//  GeoPackageTileBenchmarks.m
+//  DICE
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+#import <malloc/malloc.h>
+
+#import "GeoPackageTileReader.h"
+#import "GeoPackageTileFixture.h"
+
+
+static malloc_statistics_t mallocStatistics(void) {
+    malloc_statistics_t stats;
+    malloc_zone_statistics(NULL, &stats);
+    return stats;
+}
+
+static double percentile(NSArray<NSNumber *> *values, double fraction) {
+    NSArray<NSNumber *> *sorted = [values sortedArrayUsingSelector:@selector(compare:)];
+    return sorted.count ? sorted[MIN(sorted.count - 1, (NSUInteger)(sorted.count * fraction))].doubleValue : 0;
+}
+
+
+/**
+ Per-tile latency and allocations of serving stored tiles from a synthetic web mercator
+ GeoPackage, the way GeoPackageURLProtocol's fast path does: read the tile's blob with
+ the reader's prepared query, sniff its MIME type, and build the response.  Like the
+ import benchmarks, they only run when DICE_BENCHMARKS is set in the test environment,
+ print one "DICE_BENCHMARK " JSON line per case, and append it to DICE_BENCHMARK_OUTPUT.
+
+ DICE_BENCHMARK_SCALE multiplies the tile size (default 16 KB).  The "warm" case reuses
+ one reader for every tile, as a pooled render context does; the "cold" case opens a
+ reader per tile, the per-request setup the pool saves.  Allocations are counted as the
+ malloc blocks and bytes still in use per tile while every response is held, so a
+ second copy of a tile's blob shows up as twice the tile size.
+ */
+@interface GeoPackageTileBenchmarks : XCTestCase
+
+@end
+
+@implementation GeoPackageTileBenchmarks
+{
+    NSString *tempDir;
+    NSFileManager *fileManager;
+    NSDictionary<NSString *, NSString *> *environment;
+    double scale;
+}
+
+- (void)setUp {
+    [super setUp];
+    fileManager = [NSFileManager defaultManager];
+    environment = [NSProcessInfo processInfo].environment;
+    scale = environment[@"DICE_BENCHMARK_SCALE"] ? environment[@"DICE_BENCHMARK_SCALE"].doubleValue : 1.0;
+    tempDir = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    [fileManager createDirectoryAtPath:tempDir withIntermediateDirectories:YES attributes:nil error:nil];
+}
+
+- (void)tearDown {
+    [fileManager removeItemAtPath:tempDir error:nil];
+    [super tearDown];
+}
+
+- (BOOL)benchmarksEnabled {
+    if (!environment[@"DICE_BENCHMARKS"]) {
+        NSLog(@"GeoPackageTileBenchmarks: set DICE_BENCHMARKS to run %@", self.name);
+        return NO;
+    }
+    return YES;
+}
+
+/*
+ * A GeoPackage with every tile of zoom levels 0 through maxZoom, each a PNG signature
+ * followed by varying bytes.
+ */
+- (NSString *)geoPackageWithMaxZoom:(int)maxZoom tileLength:(NSUInteger)tileLength {
+    NSString *path = [tempDir stringByAppendingPathComponent:@"benchmark.gpkg"];
+    GeoPackageTileFixture *fixture = [[GeoPackageTileFixture alloc] initWithPath:path];
+    [fixture addTileTable:@"imagery" srsId:3857];
+    NSMutableData *tile = [NSMutableData dataWithLength:MAX(tileLength, (NSUInteger)8)];
+    uint8_t *bytes = tile.mutableBytes;
+    uint32_t state = 1;
+    for (NSUInteger i = 8; i < tile.length; i++) {
+        state = state * 1664525u + 1013904223u;
+        bytes[i] = (uint8_t)(state >> 24);
+    }
+    memcpy(bytes, "\x89PNG\r\n\x1A\n", 8);
+    for (int zoom = 0; zoom <= maxZoom; zoom++) {
+        [fixture addWebMercatorZoom:zoom toTable:@"imagery"];
+        for (int x = 0; x < 1 << zoom; x++) {
+            for (int y = 0; y < 1 << zoom; y++) {
+                bytes[8] = (uint8_t)(x + y);
+                [fixture addTileToTable:@"imagery" zoom:zoom column:x row:y data:tile];
+            }
+        }
+    }
+    XCTAssertTrue([fixture close]);
+    return path;
+}
+
+- (void)benchmarkCase:(NSString *)name path:(NSString *)path maxZoom:(int)maxZoom tileLength:(NSUInteger)tileLength reuseReader:(BOOL)reuseReader {
+    NSURL *url = [NSURL fileURLWithPath:path];
+    NSUInteger tileCount = 0;
+    for (int zoom = 0; zoom <= maxZoom; zoom++) {
+        tileCount += (NSUInteger)1 << (2 * zoom);
+    }
+    NSMutableArray<NSNumber *> *latencies = [NSMutableArray arrayWithCapacity:tileCount];
+    NSMutableArray *responses = [NSMutableArray arrayWithCapacity:tileCount * 2];
+    GeoPackageTileReader *reader = [[GeoPackageTileReader alloc] initWithPath:path andTable:@"imagery"];
+    XCTAssertNotNil(reader);
+
+    malloc_statistics_t before = mallocStatistics();
+    for (int zoom = 0; zoom <= maxZoom; zoom++) {
+        for (int x = 0; x < 1 << zoom; x++) {
+            for (int y = 0; y < 1 << zoom; y++) {
+                @autoreleasepool {
+                    CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+                    GeoPackageTileReader *tileReader = reuseReader ? reader : [[GeoPackageTileReader alloc] initWithPath:path andTable:@"imagery"];
+                    NSData *tileData = [tileReader tileDataWithX:x andY:y andZoom:zoom];
+                    NSURLResponse *response = [[NSURLResponse alloc] initWithURL:url
+                                                                        MIMEType:[GeoPackageTileReader mimeTypeOfTileData:tileData]
+                                                           expectedContentLength:tileData.length
+                                                                textEncodingName:nil];
+                    [latencies addObject:@((CFAbsoluteTimeGetCurrent() - start) * 1000000)];
+                    XCTAssertEqual(tileData.length, tileLength);
+                    [responses addObject:response];
+                    [responses addObject:tileData];
+                }
+            }
+        }
+    }
+    malloc_statistics_t after = mallocStatistics();
+    // the latencies array and its numbers are counted too, a block or two per tile
+    double blocksPerTile = ((double)after.blocks_in_use - before.blocks_in_use) / tileCount;
+    double bytesPerTile = ((double)after.size_in_use - before.size_in_use) / tileCount;
+
+    NSDictionary *result = @{
+        @"corpus": name,
+        @"scale": @(scale),
+        @"tiles": @(tileCount),
+        @"tile_bytes": @(tileLength),
+        @"median_us": @(percentile(latencies, 0.5)),
+        @"p95_us": @(percentile(latencies, 0.95)),
+        @"tiles_per_sec": @(tileCount / MAX([[latencies valueForKeyPath:@"@sum.self"] doubleValue] / 1000000, 1e-9)),
+        @"retained_blocks_per_tile": @(blocksPerTile),
+        @"retained_bytes_per_tile": @(bytesPerTile)
+    };
+    NSData *json = [NSJSONSerialization dataWithJSONObject:result options:0 error:nil];
+    NSString *line = [NSString stringWithFormat:@"DICE_BENCHMARK %@\n", [[NSString alloc] initWithData:json encoding:NSUTF8StringEncoding]];
+    printf("%s", line.UTF8String);
+
+    NSString *outputPath = environment[@"DICE_BENCHMARK_OUTPUT"];
+    if (outputPath) {
+        if (![fileManager fileExistsAtPath:outputPath]) {
+            [fileManager createFileAtPath:outputPath contents:nil attributes:nil];
+        }
+        NSFileHandle *output = [NSFileHandle fileHandleForWritingAtPath:outputPath];
+        [output seekToEndOfFile];
+        [output writeData:[line dataUsingEncoding:NSUTF8StringEncoding]];
+        [output closeFile];
+    }
+}
+
+- (void)testStoredTiles {
+    if (![self benchmarksEnabled]) {
+        return;
+    }
+    NSUInteger tileLength = MAX((NSUInteger)16, (NSUInteger)(16 * 1024 * scale));
+    int maxZoom = 5;
+    NSString *path = [self geoPackageWithMaxZoom:maxZoom tileLength:tileLength];
+    [self benchmarkCase:@"stored_tiles_warm" path:path maxZoom:maxZoom tileLength:tileLength reuseReader:YES];
+    [self benchmarkCase:@"stored_tiles_cold" path:path maxZoom:maxZoom tileLength:tileLength reuseReader:NO];
+}
+
+@end
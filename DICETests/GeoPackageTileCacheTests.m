@@ -0,0 +1,111 @@
+//
+//  GeoPackageTileCacheTests.m
+//  DICE
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+
+#import "GeoPackageTileCache.h"
+
+
+@interface GeoPackageTileCacheTests : XCTestCase
+
+@end
+
+@implementation GeoPackageTileCacheTests
+{
+    NSString *tempDir;
+    NSString *cacheDir;
+    NSString *geoPackagePath;
+    NSFileManager *fileManager;
+}
+
+- (void)setUp {
+    [super setUp];
+    fileManager = [NSFileManager defaultManager];
+    tempDir = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    cacheDir = [tempDir stringByAppendingPathComponent:@"tiles"];
+    geoPackagePath = [tempDir stringByAppendingPathComponent:@"roads.gpkg"];
+    [fileManager createDirectoryAtPath:tempDir withIntermediateDirectories:YES attributes:nil error:nil];
+    [[@"SQLite format 3" dataUsingEncoding:NSUTF8StringEncoding] writeToFile:geoPackagePath atomically:YES];
+}
+
+- (void)tearDown {
+    [fileManager removeItemAtPath:tempDir error:nil];
+    [super tearDown];
+}
+
+- (NSData *)tileOfLength:(NSUInteger)length {
+    return [NSMutableData dataWithLength:length];
+}
+
+- (NSString *)keyForX:(int)x {
+    return [GeoPackageTileCache keyForGeoPackageAtPath:geoPackagePath tables:@[@"roads"] zoom:10 x:x y:20];
+}
+
+- (void)testEvictsLeastRecentlyUsedTilesFromMemory {
+    GeoPackageTileCache *cache = [[GeoPackageTileCache alloc] initWithDirectory:cacheDir memoryLimit:3200 diskLimit:1 << 20];
+    [cache setTileData:[self tileOfLength:800] forKey:[self keyForX:1]];
+    [cache setTileData:[self tileOfLength:800] forKey:[self keyForX:2]];
+    [cache setTileData:[self tileOfLength:800] forKey:[self keyForX:3]];
+    XCTAssertNotNil([cache tileDataForKey:[self keyForX:1]]);
+    [cache setTileData:[self tileOfLength:800] forKey:[self keyForX:4]];
+    XCTAssertLessThanOrEqual(cache.memoryUsage, (NSUInteger)3200);
+
+    // with the disk tier gone, only the tiles still in memory are left; tile 2 was the least recently used
+    [cache flush];
+    [fileManager removeItemAtPath:cacheDir error:nil];
+    XCTAssertNil([cache tileDataForKey:[self keyForX:2]]);
+    XCTAssertEqual([cache tileDataForKey:[self keyForX:1]].length, (NSUInteger)800);
+    XCTAssertEqual([cache tileDataForKey:[self keyForX:4]].length, (NSUInteger)800);
+}
+
+- (void)testKeepsTilesOnDiskAcrossInstances {
+    GeoPackageTileCache *cache = [[GeoPackageTileCache alloc] initWithDirectory:cacheDir memoryLimit:1 << 20 diskLimit:1 << 20];
+    [cache setTileData:[self tileOfLength:500] forKey:[self keyForX:1]];
+    [cache setTileData:[NSData data] forKey:[self keyForX:2]];
+    [cache flush];
+    XCTAssertGreaterThanOrEqual(cache.diskUsage, (uint64_t)500);
+
+    GeoPackageTileCache *reopened = [[GeoPackageTileCache alloc] initWithDirectory:cacheDir memoryLimit:1 << 20 diskLimit:1 << 20];
+    XCTAssertEqual([reopened tileDataForKey:[self keyForX:1]].length, (NSUInteger)500);
+    XCTAssertNotNil([reopened tileDataForKey:[self keyForX:2]], @"lost an empty tile");
+    XCTAssertNil([reopened tileDataForKey:[self keyForX:3]]);
+}
+
+- (void)testReimportedGeoPackageGetsNewKeys {
+    NSString *before = [self keyForX:1];
+    XCTAssertEqualObjects([self keyForX:1], before);
+    [fileManager removeItemAtPath:geoPackagePath error:nil];
+    XCTAssertNil([self keyForX:1]);
+
+    [NSThread sleepForTimeInterval:0.01];
+    [[@"SQLite format 3" dataUsingEncoding:NSUTF8StringEncoding] writeToFile:geoPackagePath atomically:NO];
+    XCTAssertNotEqualObjects([self keyForX:1], before);
+}
+
+- (void)testRemovesTilesOfGeoPackage {
+    GeoPackageTileCache *cache = [[GeoPackageTileCache alloc] initWithDirectory:cacheDir memoryLimit:1 << 20 diskLimit:1 << 20];
+    NSString *otherPath = [tempDir stringByAppendingPathComponent:@"rivers.gpkg"];
+    [[@"SQLite format 3" dataUsingEncoding:NSUTF8StringEncoding] writeToFile:otherPath atomically:YES];
+    NSString *otherKey = [GeoPackageTileCache keyForGeoPackageAtPath:otherPath tables:@[@"rivers"] zoom:10 x:1 y:20];
+    [cache setTileData:[self tileOfLength:100] forKey:[self keyForX:1]];
+    [cache setTileData:[self tileOfLength:100] forKey:otherKey];
+
+    [cache removeTilesOfGeoPackageAtPath:geoPackagePath];
+    [cache flush];
+    XCTAssertNil([cache tileDataForKey:[self keyForX:1]]);
+    XCTAssertNotNil([cache tileDataForKey:otherKey]);
+}
+
+- (void)testTrimsDiskToItsLimit {
+    GeoPackageTileCache *cache = [[GeoPackageTileCache alloc] initWithDirectory:cacheDir memoryLimit:1 << 20 diskLimit:10000];
+    for (int x = 0; x < 30; x++) {
+        [cache setTileData:[self tileOfLength:1000] forKey:[self keyForX:x]];
+    }
+    [cache flush];
+    XCTAssertLessThanOrEqual(cache.diskUsage, (uint64_t)10000);
+}
+
+@end
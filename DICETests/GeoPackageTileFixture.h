@@ -0,0 +1,33 @@
+//
+//  GeoPackageTileFixture.h
+//  DICE
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ Writes GeoPackage files with tile tables for tests, straight through SQLite, with only the
+ tables and columns tile reading looks at.  Everything is written in one transaction that
+ close commits.
+ */
+@interface GeoPackageTileFixture : NSObject
+
+- (instancetype)initWithPath:(NSString *)path;
+
+/**
+ Add a tile table whose tile matrix set covers the world in the given SRS, EPSG 3857 or 4326.
+ */
+- (void)addTileTable:(NSString *)table srsId:(int)srsId;
+
+- (void)addTileMatrixToTable:(NSString *)table zoom:(int)zoom matrixWidth:(int)width matrixHeight:(int)height tileSize:(int)tileSize;
+
+/**
+ Add the tile matrix of the web mercator tile grid at the zoom level, 2^zoom by 2^zoom tiles of 256 pixels.
+ */
+- (void)addWebMercatorZoom:(int)zoom toTable:(NSString *)table;
+
+- (void)addTileToTable:(NSString *)table zoom:(int)zoom column:(int)column row:(int)row data:(NSData *)data;
+
+- (BOOL)close;
+
+@end
@@ -0,0 +1,102 @@
+//
+//  GeoPackageTileFixture.m
+//  DICE
+//
+
+#import "GeoPackageTileFixture.h"
+#import <sqlite3.h>
+
+@implementation GeoPackageTileFixture
+{
+    sqlite3 *database;
+    BOOL failed;
+}
+
+- (instancetype)initWithPath:(NSString *)path
+{
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    if (sqlite3_open(path.UTF8String, &database) != SQLITE_OK) {
+        failed = YES;
+        return self;
+    }
+    [self execute:@"BEGIN"];
+    [self execute:@"CREATE TABLE gpkg_spatial_ref_sys (srs_name TEXT NOT NULL, srs_id INTEGER PRIMARY KEY, organization TEXT NOT NULL, "
+        "organization_coordsys_id INTEGER NOT NULL, definition TEXT NOT NULL, description TEXT)"];
+    [self execute:@"INSERT INTO gpkg_spatial_ref_sys VALUES ('WGS 84', 4326, 'EPSG', 4326, 'undefined', NULL)"];
+    [self execute:@"INSERT INTO gpkg_spatial_ref_sys VALUES ('WGS 84 / Pseudo-Mercator', 3857, 'epsg', 3857, 'undefined', NULL)"];
+    [self execute:@"CREATE TABLE gpkg_tile_matrix_set (table_name TEXT NOT NULL PRIMARY KEY, srs_id INTEGER NOT NULL, "
+        "min_x DOUBLE NOT NULL, min_y DOUBLE NOT NULL, max_x DOUBLE NOT NULL, max_y DOUBLE NOT NULL)"];
+    [self execute:@"CREATE TABLE gpkg_tile_matrix (table_name TEXT NOT NULL, zoom_level INTEGER NOT NULL, matrix_width INTEGER NOT NULL, "
+        "matrix_height INTEGER NOT NULL, tile_width INTEGER NOT NULL, tile_height INTEGER NOT NULL, pixel_x_size DOUBLE NOT NULL, "
+        "pixel_y_size DOUBLE NOT NULL, PRIMARY KEY (table_name, zoom_level))"];
+
+    return self;
+}
+
+- (void)dealloc
+{
+    sqlite3_close(database);
+}
+
+- (void)execute:(NSString *)sql
+{
+    if (sqlite3_exec(database, sql.UTF8String, NULL, NULL, NULL) != SQLITE_OK) {
+        NSLog(@"GeoPackageTileFixture: %s in %@", sqlite3_errmsg(database), sql);
+        failed = YES;
+    }
+}
+
+- (void)addTileTable:(NSString *)table srsId:(int)srsId
+{
+    double halfWidth = srsId == 3857 ? 20037508.342789244 : 180;
+    double halfHeight = srsId == 3857 ? 20037508.342789244 : 90;
+    [self execute:[NSString stringWithFormat:@"CREATE TABLE \"%@\" (id INTEGER PRIMARY KEY AUTOINCREMENT, zoom_level INTEGER NOT NULL, "
+        "tile_column INTEGER NOT NULL, tile_row INTEGER NOT NULL, tile_data BLOB NOT NULL, UNIQUE (zoom_level, tile_column, tile_row))", table]];
+    [self execute:[NSString stringWithFormat:@"INSERT INTO gpkg_tile_matrix_set VALUES ('%@', %d, %.9f, %.9f, %.9f, %.9f)",
+        table, srsId, -halfWidth, -halfHeight, halfWidth, halfHeight]];
+}
+
+- (void)addTileMatrixToTable:(NSString *)table zoom:(int)zoom matrixWidth:(int)width matrixHeight:(int)height tileSize:(int)tileSize
+{
+    [self execute:[NSString stringWithFormat:@"INSERT INTO gpkg_tile_matrix VALUES ('%@', %d, %d, %d, %d, %d, 1, 1)",
+        table, zoom, width, height, tileSize, tileSize]];
+}
+
+- (void)addWebMercatorZoom:(int)zoom toTable:(NSString *)table
+{
+    [self addTileMatrixToTable:table zoom:zoom matrixWidth:1 << zoom matrixHeight:1 << zoom tileSize:256];
+}
+
+- (void)addTileToTable:(NSString *)table zoom:(int)zoom column:(int)column row:(int)row data:(NSData *)data
+{
+    NSString *sql = [NSString stringWithFormat:@"INSERT INTO \"%@\" (zoom_level, tile_column, tile_row, tile_data) VALUES (?, ?, ?, ?)", table];
+    sqlite3_stmt *statement = NULL;
+    if (sqlite3_prepare_v2(database, sql.UTF8String, -1, &statement, NULL) != SQLITE_OK) {
+        failed = YES;
+        return;
+    }
+    sqlite3_bind_int(statement, 1, zoom);
+    sqlite3_bind_int(statement, 2, column);
+    sqlite3_bind_int(statement, 3, row);
+    sqlite3_bind_blob(statement, 4, data.bytes, (int)data.length, SQLITE_STATIC);
+    if (sqlite3_step(statement) != SQLITE_DONE) {
+        failed = YES;
+    }
+    sqlite3_finalize(statement);
+}
+
+- (BOOL)close
+{
+    if (database) {
+        [self execute:@"COMMIT"];
+        failed |= sqlite3_close(database) != SQLITE_OK;
+        database = NULL;
+    }
+    return !failed;
+}
+
+@end
@@ -0,0 +1,107 @@
+//
+//  GeoPackageTilePrefetcherTests.m
+//  DICE
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+
+#import "GeoPackageTilePrefetcher.h"
+
+
+@interface GeoPackageTilePrefetcherTests : XCTestCase
+
+@end
+
+@implementation GeoPackageTilePrefetcherTests
+
+- (GeoPackageTileCoordinate *)zoom:(int)zoom x:(int)x y:(int)y {
+    return [[GeoPackageTileCoordinate alloc] initWithZoom:zoom x:x y:y];
+}
+
+/*
+ * Request a 3 by 3 viewport around the tile from the center out, the way Leaflet loads one.
+ */
+- (void)loadViewportOf:(GeoPackageTilePrefetcher *)prefetcher zoom:(int)zoom aroundX:(int)x y:(int)y {
+    int offsets[][2] = {{0, 0}, {1, 0}, {-1, 0}, {0, 1}, {0, -1}, {-1, -1}, {1, -1}, {-1, 1}, {1, 1}};
+    for (int i = 0; i < 9; i++) {
+        [prefetcher recordRequestForLayer:@"imagery" zoom:zoom x:x + offsets[i][0] y:y + offsets[i][1]];
+    }
+}
+
+- (void)testPlansTheRingAndTheNextZoomLevel {
+    GeoPackageTilePrefetcher *prefetcher = [[GeoPackageTilePrefetcher alloc] init];
+    [self loadViewportOf:prefetcher zoom:4 aroundX:6 y:6];
+
+    NSArray<GeoPackageTileCoordinate *> *tiles = [prefetcher tilesToPrefetchForLayer:@"imagery"];
+    XCTAssertEqual(tiles.count, (NSUInteger)32);
+    for (int x = 4; x <= 8; x++) {
+        XCTAssertTrue([tiles containsObject:[self zoom:4 x:x y:4]]);
+        XCTAssertTrue([tiles containsObject:[self zoom:4 x:x y:8]]);
+    }
+    XCTAssertTrue([tiles containsObject:[self zoom:4 x:4 y:6]]);
+    XCTAssertTrue([tiles containsObject:[self zoom:4 x:8 y:6]]);
+    XCTAssertFalse([tiles containsObject:[self zoom:4 x:6 y:6]], @"planned a tile already requested");
+    for (int x = 11; x <= 14; x++) {
+        XCTAssertTrue([tiles containsObject:[self zoom:5 x:x y:11]]);
+        XCTAssertTrue([tiles containsObject:[self zoom:5 x:x y:14]]);
+    }
+    XCTAssertEqualObjects(tiles[16].description, @"5/12/12", @"the next zoom level should start from the center");
+
+    XCTAssertEqual([prefetcher tilesToPrefetchForLayer:@"imagery"].count, (NSUInteger)0, @"planned an unchanged viewport again");
+    [prefetcher deferLayer:@"imagery"];
+    XCTAssertEqualObjects([prefetcher tilesToPrefetchForLayer:@"imagery"], tiles);
+}
+
+- (void)testPlansAheadOfAPan {
+    GeoPackageTilePrefetcher *prefetcher = [[GeoPackageTilePrefetcher alloc] init];
+    [self loadViewportOf:prefetcher zoom:4 aroundX:6 y:6];
+    [prefetcher tilesToPrefetchForLayer:@"imagery"];
+
+    // panning east uncovers the next column
+    for (int y = 5; y <= 7; y++) {
+        [prefetcher recordRequestForLayer:@"imagery" zoom:4 x:8 y:y];
+    }
+    NSArray<GeoPackageTileCoordinate *> *tiles = [prefetcher tilesToPrefetchForLayer:@"imagery"];
+    NSArray *ahead = @[[self zoom:4 x:9 y:4], [self zoom:4 x:9 y:5], [self zoom:4 x:9 y:6], [self zoom:4 x:9 y:7], [self zoom:4 x:9 y:8],
+                       [self zoom:4 x:10 y:4], [self zoom:4 x:10 y:5], [self zoom:4 x:10 y:6], [self zoom:4 x:10 y:7], [self zoom:4 x:10 y:8]];
+    XCTAssertEqualObjects([tiles subarrayWithRange:NSMakeRange(0, ahead.count)], ahead);
+    for (GeoPackageTileCoordinate *tile in tiles) {
+        XCTAssertFalse(tile.zoom == 4 && tile.x == 4, @"planned %@ behind the pan", tile);
+    }
+}
+
+- (void)testZoomingStartsOver {
+    GeoPackageTilePrefetcher *prefetcher = [[GeoPackageTilePrefetcher alloc] init];
+    XCTAssertFalse([prefetcher recordRequestForLayer:@"imagery" zoom:4 x:6 y:6]);
+    XCTAssertFalse([prefetcher recordRequestForLayer:@"imagery" zoom:4 x:7 y:6]);
+    XCTAssertFalse([prefetcher recordRequestForLayer:@"roads" zoom:3 x:3 y:3], @"layers are tracked apart");
+    XCTAssertTrue([prefetcher recordRequestForLayer:@"imagery" zoom:5 x:12 y:12]);
+
+    NSArray<GeoPackageTileCoordinate *> *tiles = [prefetcher tilesToPrefetchForLayer:@"imagery"];
+    XCTAssertTrue([tiles containsObject:[self zoom:5 x:11 y:11]]);
+    for (GeoPackageTileCoordinate *tile in tiles) {
+        XCTAssertNotEqual(tile.zoom, 4);
+    }
+}
+
+- (void)testStaysOnTheMap {
+    GeoPackageTilePrefetcher *prefetcher = [[GeoPackageTilePrefetcher alloc] init];
+    prefetcher.maxZoom = 1;
+    [prefetcher recordRequestForLayer:@"imagery" zoom:0 x:0 y:0];
+    NSArray *tiles = @[[self zoom:1 x:0 y:0], [self zoom:1 x:1 y:0], [self zoom:1 x:0 y:1], [self zoom:1 x:1 y:1]];
+    XCTAssertEqualObjects([NSSet setWithArray:[prefetcher tilesToPrefetchForLayer:@"imagery"]], [NSSet setWithArray:tiles]);
+
+    [prefetcher recordRequestForLayer:@"imagery" zoom:1 x:1 y:1];
+    tiles = [prefetcher tilesToPrefetchForLayer:@"imagery"];
+    XCTAssertEqual(tiles.count, (NSUInteger)3, @"%@", tiles);
+}
+
+- (void)testKeepsToTheBudget {
+    GeoPackageTilePrefetcher *prefetcher = [[GeoPackageTilePrefetcher alloc] init];
+    prefetcher.maxTilesPerPlan = 5;
+    [self loadViewportOf:prefetcher zoom:10 aroundX:100 y:100];
+    XCTAssertEqual([prefetcher tilesToPrefetchForLayer:@"imagery"].count, (NSUInteger)5);
+}
+
+@end
@@ -0,0 +1,93 @@
+//
+//  GeoPackageTileReaderTests.m
+//  DICE
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+
+#import "GeoPackageTileReader.h"
+#import "GeoPackageTileFixture.h"
+
+
+@interface GeoPackageTileReaderTests : XCTestCase
+
+@end
+
+@implementation GeoPackageTileReaderTests
+{
+    NSString *tempDir;
+    NSFileManager *fileManager;
+}
+
+- (void)setUp {
+    [super setUp];
+    fileManager = [NSFileManager defaultManager];
+    tempDir = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    [fileManager createDirectoryAtPath:tempDir withIntermediateDirectories:YES attributes:nil error:nil];
+}
+
+- (void)tearDown {
+    [fileManager removeItemAtPath:tempDir error:nil];
+    [super tearDown];
+}
+
+- (NSData *)pngWithMarker:(uint8_t)marker {
+    uint8_t bytes[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n', marker};
+    return [NSData dataWithBytes:bytes length:sizeof(bytes)];
+}
+
+- (void)testReadsStoredWebMercatorTiles {
+    NSString *path = [tempDir stringByAppendingPathComponent:@"tiles.gpkg"];
+    GeoPackageTileFixture *fixture = [[GeoPackageTileFixture alloc] initWithPath:path];
+    [fixture addTileTable:@"imagery" srsId:3857];
+    [fixture addWebMercatorZoom:0 toTable:@"imagery"];
+    [fixture addWebMercatorZoom:1 toTable:@"imagery"];
+    // a zoom level of 512 pixel tiles has to go through the retriever
+    [fixture addTileMatrixToTable:@"imagery" zoom:2 matrixWidth:4 matrixHeight:4 tileSize:512];
+    [fixture addTileToTable:@"imagery" zoom:0 column:0 row:0 data:[self pngWithMarker:0]];
+    [fixture addTileToTable:@"imagery" zoom:1 column:1 row:0 data:[self pngWithMarker:10]];
+    [fixture addTileToTable:@"imagery" zoom:1 column:0 row:1 data:[self pngWithMarker:1]];
+    XCTAssertTrue([fixture close]);
+
+    GeoPackageTileReader *reader = [[GeoPackageTileReader alloc] initWithPath:path andTable:@"imagery"];
+    XCTAssertNotNil(reader);
+    XCTAssertTrue([reader readsZoom:0]);
+    XCTAssertTrue([reader readsZoom:1]);
+    XCTAssertFalse([reader readsZoom:2]);
+    XCTAssertFalse([reader readsZoom:3]);
+
+    XCTAssertEqualObjects([reader tileDataWithX:0 andY:0 andZoom:0], [self pngWithMarker:0]);
+    XCTAssertEqualObjects([reader tileDataWithX:1 andY:0 andZoom:1], [self pngWithMarker:10], @"rows should count from the top");
+    XCTAssertEqualObjects([reader tileDataWithX:0 andY:1 andZoom:1], [self pngWithMarker:1]);
+    XCTAssertNil([reader tileDataWithX:1 andY:1 andZoom:1]);
+    // the prepared query is reset after a miss
+    XCTAssertEqualObjects([reader tileDataWithX:0 andY:0 andZoom:0], [self pngWithMarker:0]);
+}
+
+- (void)testDoesNotReadOtherTileGrids {
+    NSString *path = [tempDir stringByAppendingPathComponent:@"geodetic.gpkg"];
+    GeoPackageTileFixture *fixture = [[GeoPackageTileFixture alloc] initWithPath:path];
+    [fixture addTileTable:@"geodetic" srsId:4326];
+    [fixture addTileMatrixToTable:@"geodetic" zoom:0 matrixWidth:1 matrixHeight:1 tileSize:256];
+    [fixture addTileTable:@"web_mercator" srsId:3857];
+    [fixture addTileMatrixToTable:@"web_mercator" zoom:1 matrixWidth:2 matrixHeight:1 tileSize:256];
+    XCTAssertTrue([fixture close]);
+
+    XCTAssertNil([[GeoPackageTileReader alloc] initWithPath:path andTable:@"geodetic"]);
+    XCTAssertNil([[GeoPackageTileReader alloc] initWithPath:path andTable:@"web_mercator"]);
+    XCTAssertNil([[GeoPackageTileReader alloc] initWithPath:path andTable:@"missing"]);
+    XCTAssertNil([[GeoPackageTileReader alloc] initWithPath:[tempDir stringByAppendingPathComponent:@"missing.gpkg"] andTable:@"geodetic"]);
+}
+
+- (void)testSniffsMIMETypes {
+    uint8_t jpeg[] = {0xFF, 0xD8, 0xFF, 0xE0};
+    uint8_t webp[] = {'R', 'I', 'F', 'F', 0x10, 0, 0, 0, 'W', 'E', 'B', 'P', 'V', 'P', '8', ' '};
+    XCTAssertEqualObjects([GeoPackageTileReader mimeTypeOfTileData:[self pngWithMarker:0]], @"image/png");
+    XCTAssertEqualObjects([GeoPackageTileReader mimeTypeOfTileData:[NSData dataWithBytes:jpeg length:sizeof(jpeg)]], @"image/jpeg");
+    XCTAssertEqualObjects([GeoPackageTileReader mimeTypeOfTileData:[NSData dataWithBytes:webp length:sizeof(webp)]], @"image/webp");
+    XCTAssertEqualObjects([GeoPackageTileReader mimeTypeOfTileData:[@"GIF89a" dataUsingEncoding:NSASCIIStringEncoding]], @"image/gif");
+    XCTAssertEqualObjects([GeoPackageTileReader mimeTypeOfTileData:nil], @"image/png");
+}
+
+@end
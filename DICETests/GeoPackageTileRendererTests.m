@@ -0,0 +1,321 @@
+//
+//  GeoPackageTileRendererTests.m
+//  DICE
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+
+#import "GeoPackageTileRenderer.h"
+
+
+@interface GeoPackageTileRendererTests : XCTestCase
+
+@end
+
+@implementation GeoPackageTileRendererTests
+
+- (void)testCoalescesRendersOfTheSameTile {
+    GeoPackageTileRenderer *renderer = [[GeoPackageTileRenderer alloc] initWithMaxConcurrentRenders:2];
+    dispatch_semaphore_t release = dispatch_semaphore_create(0);
+    __block NSUInteger renders = 0;
+    NSMutableArray<NSData *> *results = [NSMutableArray array];
+    XCTestExpectation *done = [self expectationWithDescription:@"all requests answered"];
+
+    for (NSUInteger i = 0; i < 5; i++) {
+        [renderer renderTileWithKey:@"roads/10/1/2" render:^NSData *(GeoPackageTileRender *render) {
+            @synchronized (results) {
+                renders++;
+            }
+            dispatch_semaphore_wait(release, DISPATCH_TIME_FOREVER);
+            return [@"tile" dataUsingEncoding:NSUTF8StringEncoding];
+        } completion:^(NSData *tileData) {
+            @synchronized (results) {
+                [results addObject:tileData];
+                if (results.count == 5) {
+                    [done fulfill];
+                }
+            }
+        }];
+    }
+    dispatch_semaphore_signal(release);
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    XCTAssertEqual(renders, (NSUInteger)1);
+    XCTAssertEqual(renderer.coalescedCount, (uint64_t)4);
+    XCTAssertEqual(renderer.renderCount, (uint64_t)1);
+    for (NSData *tileData in results) {
+        XCTAssertEqualObjects(tileData, [@"tile" dataUsingEncoding:NSUTF8StringEncoding]);
+    }
+}
+
+- (void)testBoundsConcurrentRenders {
+    GeoPackageTileRenderer *renderer = [[GeoPackageTileRenderer alloc] initWithMaxConcurrentRenders:2];
+    __block NSUInteger running = 0;
+    __block NSUInteger mostRunning = 0;
+    __block NSUInteger finished = 0;
+    XCTestExpectation *done = [self expectationWithDescription:@"all tiles rendered"];
+    NSObject *lock = [[NSObject alloc] init];
+
+    for (int x = 0; x < 12; x++) {
+        [renderer renderTileWithKey:[NSString stringWithFormat:@"roads/10/%d/2", x] render:^NSData *(GeoPackageTileRender *render) {
+            @synchronized (lock) {
+                running++;
+                mostRunning = MAX(mostRunning, running);
+            }
+            [NSThread sleepForTimeInterval:0.02];
+            @synchronized (lock) {
+                running--;
+            }
+            return nil;
+        } completion:^(NSData *tileData) {
+            @synchronized (lock) {
+                if (++finished == 12) {
+                    [done fulfill];
+                }
+            }
+        }];
+    }
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    XCTAssertLessThanOrEqual(mostRunning, (NSUInteger)2);
+    XCTAssertGreaterThan(renderer.peakQueueDepth, (NSUInteger)2);
+    XCTAssertEqual(renderer.queueDepth, (NSUInteger)0);
+    XCTAssertGreaterThan(renderer.averageRenderTime, 0.01);
+}
+
+- (void)testExceptionRendersAnEmptyTile {
+    GeoPackageTileRenderer *renderer = [[GeoPackageTileRenderer alloc] initWithMaxConcurrentRenders:1];
+    XCTestExpectation *done = [self expectationWithDescription:@"request answered"];
+    __block BOOL answered = NO;
+    __block NSData *result = [NSData data];
+    [renderer renderTileWithKey:@"broken/0/0/0" render:^NSData *(GeoPackageTileRender *render) {
+        [NSException raise:NSInternalInconsistencyException format:@"no such table"];
+        return nil;
+    } completion:^(NSData *tileData) {
+        answered = YES;
+        result = tileData;
+        [done fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    XCTAssertTrue(answered);
+    XCTAssertNil(result);
+}
+
+- (void)testDropsQueuedRendersWhenCancelled {
+    GeoPackageTileRenderer *renderer = [[GeoPackageTileRenderer alloc] initWithMaxConcurrentRenders:1];
+    dispatch_semaphore_t release = dispatch_semaphore_create(0);
+    XCTestExpectation *blockerDone = [self expectationWithDescription:@"first tile answered"];
+    [renderer renderTileWithKey:@"roads/10/0/0" render:^NSData *(GeoPackageTileRender *render) {
+        dispatch_semaphore_wait(release, DISPATCH_TIME_FOREVER);
+        return nil;
+    } completion:^(NSData *tileData) {
+        [blockerDone fulfill];
+    }];
+
+    __block BOOL staleRendered = NO;
+    __block BOOL staleAnswered = NO;
+    GeoPackageTileRequest *stale = [renderer renderTileWithKey:@"roads/10/5/5" render:^NSData *(GeoPackageTileRender *render) {
+        staleRendered = YES;
+        return nil;
+    } completion:^(NSData *tileData) {
+        staleAnswered = YES;
+    }];
+    [stale cancel];
+    [stale cancel];
+    dispatch_semaphore_signal(release);
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    [NSThread sleepForTimeInterval:0.05];
+
+    XCTAssertFalse(staleRendered);
+    XCTAssertFalse(staleAnswered);
+    XCTAssertEqual(renderer.droppedCount, (uint64_t)1);
+    XCTAssertEqual(renderer.cancelledCount, (uint64_t)1);
+    XCTAssertEqual(renderer.queueDepth, (NSUInteger)0);
+}
+
+- (void)testRunningRenderSeesCancellation {
+    GeoPackageTileRenderer *renderer = [[GeoPackageTileRenderer alloc] initWithMaxConcurrentRenders:1];
+    dispatch_semaphore_t started = dispatch_semaphore_create(0);
+    XCTestExpectation *gaveUp = [self expectationWithDescription:@"render gave up"];
+    __block BOOL answered = NO;
+    GeoPackageTileRequest *request = [renderer renderTileWithKey:@"roads/12/1/1" render:^NSData *(GeoPackageTileRender *render) {
+        dispatch_semaphore_signal(started);
+        while (!render.isCancelled) {
+            [NSThread sleepForTimeInterval:0.005];
+        }
+        [gaveUp fulfill];
+        return nil;
+    } completion:^(NSData *tileData) {
+        answered = YES;
+    }];
+    dispatch_semaphore_wait(started, DISPATCH_TIME_FOREVER);
+    [request cancel];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    [NSThread sleepForTimeInterval:0.05];
+
+    XCTAssertFalse(answered);
+    XCTAssertEqual(renderer.wastedCount, (uint64_t)1);
+    XCTAssertEqual(renderer.deliveredCount, (uint64_t)0);
+    XCTAssertEqual(renderer.renderCount, (uint64_t)0);
+}
+
+- (void)testCancellingOneOfSeveralRequestsKeepsTheRender {
+    GeoPackageTileRenderer *renderer = [[GeoPackageTileRenderer alloc] initWithMaxConcurrentRenders:1];
+    dispatch_semaphore_t release = dispatch_semaphore_create(0);
+    XCTestExpectation *done = [self expectationWithDescription:@"remaining request answered"];
+    GeoPackageTileRenderBlock renderBlock = ^NSData *(GeoPackageTileRender *render) {
+        dispatch_semaphore_wait(release, DISPATCH_TIME_FOREVER);
+        return render.isCancelled ? nil : [@"tile" dataUsingEncoding:NSUTF8StringEncoding];
+    };
+    GeoPackageTileRequest *first = [renderer renderTileWithKey:@"roads/10/3/3" render:renderBlock completion:^(NSData *tileData) {
+        XCTFail(@"answered a cancelled request");
+    }];
+    __block NSData *result;
+    [renderer renderTileWithKey:@"roads/10/3/3" render:renderBlock completion:^(NSData *tileData) {
+        result = tileData;
+        [done fulfill];
+    }];
+    [first cancel];
+    dispatch_semaphore_signal(release);
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    XCTAssertEqualObjects(result, [@"tile" dataUsingEncoding:NSUTF8StringEncoding]);
+    XCTAssertEqual(renderer.deliveredCount, (uint64_t)1);
+}
+
+/*
+ * Start a render that holds the renderer's one worker until the semaphore is signalled.
+ */
+- (void)occupyWorkerOf:(GeoPackageTileRenderer *)renderer until:(dispatch_semaphore_t)release done:(XCTestExpectation *)done {
+    dispatch_semaphore_t started = dispatch_semaphore_create(0);
+    [renderer renderTileWithKey:@"roads/10/0/0" render:^NSData *(GeoPackageTileRender *render) {
+        dispatch_semaphore_signal(started);
+        dispatch_semaphore_wait(release, DISPATCH_TIME_FOREVER);
+        return nil;
+    } completion:^(NSData *tileData) {
+        [done fulfill];
+    }];
+    dispatch_semaphore_wait(started, DISPATCH_TIME_FOREVER);
+}
+
+- (void)testPrefetchWaitsForRequests {
+    GeoPackageTileRenderer *renderer = [[GeoPackageTileRenderer alloc] initWithMaxConcurrentRenders:1];
+    dispatch_semaphore_t release = dispatch_semaphore_create(0);
+    [self occupyWorkerOf:renderer until:release done:[self expectationWithDescription:@"first tile answered"]];
+    XCTAssertTrue(renderer.canPrefetch, @"a request being drawn is not waiting");
+
+    XCTestExpectation *waitingDone = [self expectationWithDescription:@"waiting tile answered"];
+    [renderer renderTileWithKey:@"roads/10/1/0" render:^NSData *(GeoPackageTileRender *render) {
+        return nil;
+    } completion:^(NSData *tileData) {
+        [waitingDone fulfill];
+    }];
+    XCTAssertFalse(renderer.canPrefetch);
+    __block BOOL prefetched = NO;
+    XCTAssertFalse([renderer prefetchTileWithKey:@"roads/10/2/0" render:^NSData *(GeoPackageTileRender *render) {
+        prefetched = YES;
+        return nil;
+    }]);
+    XCTAssertTrue([renderer prefetchTileWithKey:@"roads/10/1/0" render:^NSData *(GeoPackageTileRender *render) {
+        prefetched = YES;
+        return nil;
+    }], @"a tile already being drawn needs no prefetch");
+
+    dispatch_semaphore_signal(release);
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    XCTAssertFalse(prefetched);
+    XCTAssertEqual(renderer.prefetchQueueDepth, (NSUInteger)0);
+}
+
+- (void)testRequestJoinsPrefetch {
+    GeoPackageTileRenderer *renderer = [[GeoPackageTileRenderer alloc] initWithMaxConcurrentRenders:1];
+    renderer.maxPendingPrefetches = 2;
+    dispatch_semaphore_t release = dispatch_semaphore_create(0);
+    [self occupyWorkerOf:renderer until:release done:[self expectationWithDescription:@"first tile answered"]];
+
+    XCTestExpectation *warmed = [self expectationWithDescription:@"unrequested tile prefetched"];
+    __block NSUInteger renders = 0;
+    XCTAssertTrue([renderer prefetchTileWithKey:@"roads/10/1/0" render:^NSData *(GeoPackageTileRender *render) {
+        renders++;
+        return [@"tile" dataUsingEncoding:NSUTF8StringEncoding];
+    }]);
+    XCTAssertTrue([renderer prefetchTileWithKey:@"roads/10/2/0" render:^NSData *(GeoPackageTileRender *render) {
+        [warmed fulfill];
+        return nil;
+    }]);
+    XCTAssertFalse(renderer.canPrefetch, @"the prefetch budget is spent");
+
+    XCTestExpectation *joined = [self expectationWithDescription:@"request answered by the prefetch"];
+    __block NSData *result;
+    [renderer renderTileWithKey:@"roads/10/1/0" render:^NSData *(GeoPackageTileRender *render) {
+        XCTFail(@"drew a tile already being prefetched");
+        return nil;
+    } completion:^(NSData *tileData) {
+        result = tileData;
+        [joined fulfill];
+    }];
+    XCTAssertEqual(renderer.prefetchHitCount, (uint64_t)1);
+    XCTAssertEqual(renderer.prefetchQueueDepth, (NSUInteger)1);
+
+    dispatch_semaphore_signal(release);
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    [NSThread sleepForTimeInterval:0.05];
+
+    XCTAssertEqual(renders, (NSUInteger)1);
+    XCTAssertEqualObjects(result, [@"tile" dataUsingEncoding:NSUTF8StringEncoding]);
+    XCTAssertEqual(renderer.prefetchCount, (uint64_t)1);
+    XCTAssertEqual(renderer.deliveredCount, (uint64_t)2);
+    XCTAssertEqual(renderer.wastedCount, (uint64_t)0);
+    XCTAssertEqual(renderer.prefetchQueueDepth, (NSUInteger)0);
+}
+
+- (void)testCancelPrefetchesDropsQueuedPrefetches {
+    GeoPackageTileRenderer *renderer = [[GeoPackageTileRenderer alloc] initWithMaxConcurrentRenders:1];
+    dispatch_semaphore_t release = dispatch_semaphore_create(0);
+    [self occupyWorkerOf:renderer until:release done:[self expectationWithDescription:@"first tile answered"]];
+
+    __block BOOL prefetched = NO;
+    for (int x = 1; x <= 2; x++) {
+        XCTAssertTrue([renderer prefetchTileWithKey:[NSString stringWithFormat:@"roads/10/%d/0", x] render:^NSData *(GeoPackageTileRender *render) {
+            prefetched = YES;
+            return nil;
+        }]);
+    }
+    [renderer cancelPrefetches];
+    XCTAssertEqual(renderer.prefetchQueueDepth, (NSUInteger)0);
+    XCTAssertEqual(renderer.queueDepth, (NSUInteger)0);
+
+    dispatch_semaphore_signal(release);
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    [NSThread sleepForTimeInterval:0.05];
+
+    XCTAssertFalse(prefetched);
+    XCTAssertEqual(renderer.droppedCount, (uint64_t)2);
+    XCTAssertEqual(renderer.prefetchCount, (uint64_t)0);
+}
+
+- (void)testWaitUntilIdleWaitsForCancelledRenderToGiveUp {
+    GeoPackageTileRenderer *renderer = [[GeoPackageTileRenderer alloc] initWithMaxConcurrentRenders:1];
+    dispatch_semaphore_t started = dispatch_semaphore_create(0);
+    __block BOOL gaveUp = NO;
+    GeoPackageTileRequest *request = [renderer renderTileWithKey:@"roads/12/2/2" render:^NSData *(GeoPackageTileRender *render) {
+        dispatch_semaphore_signal(started);
+        while (!render.isCancelled) {
+            [NSThread sleepForTimeInterval:0.005];
+        }
+        // still reading the GeoPackage for a moment after the cancellation
+        [NSThread sleepForTimeInterval:0.05];
+        gaveUp = YES;
+        return nil;
+    } completion:^(NSData *tileData) {}];
+    dispatch_semaphore_wait(started, DISPATCH_TIME_FOREVER);
+    [request cancel];
+    [renderer waitUntilIdle];
+
+    XCTAssertTrue(gaveUp);
+    XCTAssertEqual(renderer.activeRenders, (NSUInteger)0);
+    XCTAssertEqual(renderer.queueDepth, (NSUInteger)0);
+}
+
+@end
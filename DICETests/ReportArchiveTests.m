@@ -0,0 +1,304 @@
+//
+//  ReportArchiveTests.m
+//  DICE
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+
+#import "ReportArchive.h"
+#import "ReportExtractor.h"
+#import "ReportImportManifest.h"
+#import "ReportZipFixture.h"
+#import "zlib.h"
+
+@interface ReportArchiveTests : XCTestCase
+
+@end
+
+// the read buffer size of ReportArchiveReader
+static const size_t kReaderBufferSize = 1 << 18;
+
+// deflate the way ReportZipFixture does
+static NSData *deflateData(NSData *data) {
+    z_stream stream = {0};
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    NSMutableData *compressed = [NSMutableData dataWithLength:deflateBound(&stream, data.length)];
+    stream.next_in = (Bytef *)data.bytes;
+    stream.avail_in = (uInt)data.length;
+    stream.next_out = compressed.mutableBytes;
+    stream.avail_out = (uInt)compressed.length;
+    deflate(&stream, Z_FINISH);
+    compressed.length = stream.total_out;
+    deflateEnd(&stream);
+    return compressed;
+}
+
+/*
+ * Inflate the first read buffer of compressed data into read buffers as ReportArchiveReader
+ * does, returning how much it produced, and whether the last call had neither input left nor
+ * output to make, and so returned Z_BUF_ERROR.
+ */
+static size_t inflateFirstReadBuffer(NSData *compressed, BOOL *ranOutOfInput) {
+    NSMutableData *output = [NSMutableData dataWithLength:kReaderBufferSize];
+    z_stream stream = {0};
+    inflateInit2(&stream, -MAX_WBITS);
+    stream.next_in = (Bytef *)compressed.bytes;
+    stream.avail_in = (uInt)MIN(compressed.length, kReaderBufferSize);
+    int status;
+    do {
+        stream.next_out = output.mutableBytes;
+        stream.avail_out = (uInt)output.length;
+        status = inflate(&stream, Z_NO_FLUSH);
+    } while (stream.avail_out == 0 && status == Z_OK);
+    *ranOutOfInput = (status == Z_BUF_ERROR && stream.avail_in == 0);
+    size_t produced = stream.total_out;
+    inflateEnd(&stream);
+    return produced;
+}
+
+@implementation ReportArchiveTests
+{
+    NSURL *tempDir;
+    NSFileManager *fileManager;
+}
+
+- (void)setUp {
+    [super setUp];
+    fileManager = [NSFileManager defaultManager];
+    tempDir = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:[NSUUID UUID].UUIDString isDirectory:YES];
+    [fileManager createDirectoryAtURL:tempDir withIntermediateDirectories:YES attributes:nil error:nil];
+}
+
+- (void)tearDown {
+    [fileManager removeItemAtURL:tempDir error:nil];
+    [super tearDown];
+}
+
+- (NSURL *)writeReportZip:(NSUInteger)tileCount {
+    NSURL *zipURL = [tempDir URLByAppendingPathComponent:@"test_report.zip"];
+    ReportZipFixture *zip = [[ReportZipFixture alloc] initWithURL:zipURL];
+    [zip addDirectory:@"test_report/"];
+    [zip addEntry:@"test_report/index.html" string:@"<html><body>test</body></html>"];
+    [zip addEntry:@"test_report/metadata.json" string:@"{\"title\": \"Test Report\"}"];
+    for (NSUInteger i = 0; i < tileCount; i++) {
+        NSString *tile = [NSString stringWithFormat:@"test_report/tiles/%lu/%lu.png", i / 10, i];
+        NSMutableData *data = [NSMutableData dataWithLength:512 + i];
+        memset(data.mutableBytes, (int)(i & 0xff), data.length);
+        [zip addEntry:tile data:data deflate:(i % 2 == 0)];
+    }
+    XCTAssert([zip finish], @"could not write test zip");
+    return zipURL;
+}
+
+- (void)testReadsCentralDirectory {
+    NSError *error;
+    ReportArchive *archive = [ReportArchive archiveWithURL:[self writeReportZip:20] error:&error];
+    XCTAssertNotNil(archive, @"%@", error);
+    XCTAssertEqual(archive.entries.count, 23);
+
+    ReportArchiveEntry *metadata = [archive entryNamed:@"test_report/metadata.json"];
+    XCTAssertNotNil(metadata);
+    XCTAssertFalse(metadata.isDirectory);
+    XCTAssertTrue([archive entryNamed:@"test_report/"].isDirectory);
+
+    ReportArchiveReader *reader = [[ReportArchiveReader alloc] initWithArchive:archive];
+    NSData *data = [reader dataForEntry:metadata error:&error];
+    XCTAssertEqualObjects([[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding], @"{\"title\": \"Test Report\"}");
+}
+
+- (void)testParallelExtraction {
+    NSError *error;
+    ReportArchive *archive = [ReportArchive archiveWithURL:[self writeReportZip:200] error:&error];
+    ReportExtractor *extractor = [[ReportExtractor alloc] initWithArchive:archive destination:tempDir.path];
+    extractor.maxConcurrentEntries = 4;
+
+    XCTAssert([extractor extract:&error], @"%@", error);
+    XCTAssertEqual(extractor.entriesExtracted, archive.entries.count);
+    XCTAssertEqual(extractor.bytesExtracted, archive.totalUncompressedSize);
+
+    for (NSUInteger i = 0; i < 200; i++) {
+        NSString *tile = [tempDir.path stringByAppendingPathComponent:[NSString stringWithFormat:@"test_report/tiles/%lu/%lu.png", i / 10, i]];
+        NSData *data = [NSData dataWithContentsOfFile:tile];
+        XCTAssertEqual(data.length, 512 + i);
+        XCTAssertEqual(((const uint8_t *)data.bytes)[data.length - 1], (uint8_t)(i & 0xff));
+    }
+}
+
+- (void)testClassifiesEntriesAsTheyExtract {
+    NSURL *zipURL = [tempDir URLByAppendingPathComponent:@"test_report.zip"];
+    ReportZipFixture *zip = [[ReportZipFixture alloc] initWithURL:zipURL];
+    [zip addDirectory:@"test_report/"];
+    [zip addEntry:@"test_report/metadata.json" string:@"{\"title\": \"Test Report\"}"];
+    [zip addEntry:@"test_report/layers/roads.gpkg" string:@"SQLite format 3"];
+    [zip addEntry:@"test_report/shared/basemap.gpkg" string:@"SQLite format 3"];
+    [zip addEntry:@"test_report/shared/style.css" string:@"body {}"];
+    [zip addEntry:@"other_report/stray.gpkg" string:@"SQLite format 3"];
+    [zip finish];
+
+    NSError *error;
+    ReportArchive *archive = [ReportArchive archiveWithURL:zipURL error:&error];
+    ReportContentClassifier *classifier = [[ReportContentClassifier alloc] initWithContentDirectoryName:@"test_report"];
+    ReportExtractor *extractor = [[ReportExtractor alloc] initWithArchive:archive destination:tempDir.path];
+    extractor.entryClassifier = classifier;
+
+    XCTAssert([extractor extract:&error], @"%@", error);
+    XCTAssertEqualObjects(classifier.metadataEntry.name, @"test_report/metadata.json");
+    XCTAssertEqualObjects([classifier.geoPackageEntries valueForKey:@"name"], (@[@"test_report/layers/roads.gpkg", @"test_report/shared/basemap.gpkg"]));
+    XCTAssertEqualObjects([classifier.sharedEntries valueForKey:@"name"], (@[@"test_report/shared/basemap.gpkg", @"test_report/shared/style.css"]));
+    XCTAssertEqualObjects([classifier contentPathForEntry:classifier.geoPackageEntries[1]], @"shared/basemap.gpkg");
+    XCTAssertFalse([classifier isSharedEntry:classifier.geoPackageEntries[0]]);
+}
+
+- (void)testManifestFindsChangedEntries {
+    NSError *error;
+    ReportArchive *original = [ReportArchive archiveWithURL:[self writeReportZip:10] error:&error];
+    ReportImportManifest *manifest = [ReportImportManifest manifestWithArchive:original];
+
+    NSURL *revisedURL = [tempDir URLByAppendingPathComponent:@"revised.zip"];
+    ReportZipFixture *zip = [[ReportZipFixture alloc] initWithURL:revisedURL];
+    [zip addDirectory:@"test_report/"];
+    [zip addEntry:@"test_report/index.html" string:@"<html><body>revised</body></html>"];
+    [zip addEntry:@"test_report/metadata.json" string:@"{\"title\": \"Test Report\"}"];
+    [zip addEntry:@"test_report/new.js" string:@"var x = 1;"];
+    [zip finish];
+    ReportArchive *revised = [ReportArchive archiveWithURL:revisedURL error:&error];
+
+    NSArray *changed = [[manifest entriesChangedInArchive:revised] valueForKey:@"name"];
+    XCTAssertEqualObjects([NSSet setWithArray:changed], ([NSSet setWithObjects:@"test_report/index.html", @"test_report/new.js", nil]));
+    XCTAssertEqual([manifest entryNamesRemovedFromArchive:revised].count, 10);
+}
+
+- (void)testKeepsFilesWhenDirectoryEntriesAreDropped {
+    NSError *error;
+    NSURL *originalURL = [tempDir URLByAppendingPathComponent:@"original.zip"];
+    ReportZipFixture *zip = [[ReportZipFixture alloc] initWithURL:originalURL];
+    [zip addDirectory:@"test_report/"];
+    [zip addDirectory:@"test_report/sub/"];
+    [zip addDirectory:@"test_report/gone/"];
+    [zip addEntry:@"test_report/index.html" string:@"<html><body>test</body></html>"];
+    [zip addEntry:@"test_report/sub/a.txt" string:@"kept"];
+    [zip addEntry:@"test_report/gone/b.txt" string:@"removed"];
+    [zip finish];
+    ReportArchive *original = [ReportArchive archiveWithURL:originalURL error:&error];
+    NSString *destination = [tempDir.path stringByAppendingPathComponent:@"out"];
+    XCTAssertTrue([[[ReportExtractor alloc] initWithArchive:original destination:destination] extract:&error], @"%@", error);
+    ReportImportManifest *manifest = [ReportImportManifest manifestWithArchive:original];
+
+    // the revision lists the same files without their directories, and drops one file
+    NSURL *revisedURL = [tempDir URLByAppendingPathComponent:@"revised.zip"];
+    zip = [[ReportZipFixture alloc] initWithURL:revisedURL];
+    [zip addEntry:@"test_report/index.html" string:@"<html><body>test</body></html>"];
+    [zip addEntry:@"test_report/sub/a.txt" string:@"kept"];
+    [zip finish];
+    ReportArchive *revised = [ReportArchive archiveWithURL:revisedURL error:&error];
+
+    NSArray *removed = [manifest removeEntriesRemovedFromArchive:revised inDirectory:destination];
+    XCTAssertEqual(removed.count, (NSUInteger)4);
+    XCTAssertEqual([manifest entriesChangedInArchive:revised].count, (NSUInteger)0);
+    XCTAssertTrue([fileManager fileExistsAtPath:[destination stringByAppendingPathComponent:@"test_report/index.html"]]);
+    XCTAssertTrue([fileManager fileExistsAtPath:[destination stringByAppendingPathComponent:@"test_report/sub/a.txt"]]);
+    XCTAssertFalse([fileManager fileExistsAtPath:[destination stringByAppendingPathComponent:@"test_report/gone"]], @"left an empty directory");
+}
+
+- (void)testInflatesEntriesFillingTheReadBufferExactly {
+    // zeros, then noise deflate stores as it is, sized so the first read buffer of compressed
+    // data inflates to exactly two read buffers, ending inside a stored block
+    NSMutableData *noise = [NSMutableData dataWithLength:600000];
+    uint8_t *bytes = noise.mutableBytes;
+    uint64_t x = 0x9E3779B97F4A7C15ULL;
+    for (NSUInteger i = 0; i < noise.length; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        bytes[i] = (uint8_t)(x >> 56);
+    }
+    NSMutableData *aligned;
+    BOOL ranOutOfInput = NO;
+    NSUInteger zeros = kReaderBufferSize;
+    for (NSUInteger attempt = 0; attempt < 20 && !ranOutOfInput; attempt++) {
+        aligned = [NSMutableData dataWithLength:zeros];
+        [aligned appendData:noise];
+        size_t produced = inflateFirstReadBuffer(deflateData(aligned), &ranOutOfInput);
+        zeros += (produced == 2 * kReaderBufferSize) ? 1000 : 2 * kReaderBufferSize - produced;
+    }
+    XCTAssertTrue(ranOutOfInput, @"could not line up the compressed data with the read buffer");
+
+    NSURL *zipURL = [tempDir URLByAppendingPathComponent:@"aligned.zip"];
+    ReportZipFixture *zip = [[ReportZipFixture alloc] initWithURL:zipURL];
+    [zip addEntry:@"aligned/noise.bin" data:aligned deflate:YES];
+    [zip addEntry:@"aligned/zeros.bin" data:[NSMutableData dataWithLength:4 * kReaderBufferSize] deflate:YES];
+    XCTAssert([zip finish], @"could not write test zip");
+
+    NSError *error;
+    ReportArchive *archive = [ReportArchive archiveWithURL:zipURL error:&error];
+    XCTAssertNotNil(archive, @"%@", error);
+    ReportArchiveReader *reader = [[ReportArchiveReader alloc] initWithArchive:archive];
+    for (ReportArchiveEntry *entry in archive.entries) {
+        __block uint64_t length = 0;
+        __block uint32_t crc = 0;
+        BOOL read = [reader readEntry:entry toBlock:^BOOL(const void *chunk, size_t chunkLength) {
+            length += chunkLength;
+            crc = (uint32_t)crc32(crc, chunk, (uInt)chunkLength);
+            return YES;
+        } error:&error];
+        XCTAssertTrue(read, @"%@: %@", entry.name, error);
+        XCTAssertEqual(length, entry.uncompressedSize, @"%@", entry.name);
+        XCTAssertEqual(crc, entry.crc32, @"%@", entry.name);
+    }
+}
+
+- (void)testRejectsEntriesOutsideDestination {
+    NSURL *zipURL = [tempDir URLByAppendingPathComponent:@"evil.zip"];
+    ReportZipFixture *zip = [[ReportZipFixture alloc] initWithURL:zipURL];
+    [zip addEntry:@"../evil.txt" string:@"nope"];
+    [zip finish];
+
+    NSError *error;
+    ReportArchive *archive = [ReportArchive archiveWithURL:zipURL error:&error];
+    NSString *destination = [tempDir.path stringByAppendingPathComponent:@"out"];
+    ReportExtractor *extractor = [[ReportExtractor alloc] initWithArchive:archive destination:destination];
+
+    XCTAssertFalse([extractor extract:&error]);
+    XCTAssertEqual(error.code, ReportArchiveErrorUnsafePath);
+    XCTAssertFalse([fileManager fileExistsAtPath:[tempDir.path stringByAppendingPathComponent:@"evil.txt"]]);
+}
+
+- (void)testCRC32MatchesZlib {
+    NSMutableData *data = [NSMutableData dataWithLength:100003];
+    uint8_t *bytes = data.mutableBytes;
+    for (NSUInteger i = 0; i < data.length; i++) {
+        bytes[i] = (uint8_t)(i * 31 + (i >> 7));
+    }
+    for (NSUInteger offset = 0; offset < 9; offset++) {
+        size_t length = data.length - offset;
+        uint32_t expected = (uint32_t)crc32(0, bytes + offset, (uInt)length);
+        XCTAssertEqual(ReportArchiveCRC32(0, bytes + offset, length), expected);
+        uint32_t split = ReportArchiveCRC32(ReportArchiveCRC32(0, bytes + offset, 1001), bytes + offset + 1001, length - 1001);
+        XCTAssertEqual(split, expected);
+    }
+}
+
+- (void)testNamesCorruptEntries {
+    NSError *error;
+    NSURL *zipURL = [self writeReportZip:10];
+    ReportArchive *archive = [ReportArchive archiveWithURL:zipURL error:&error];
+    // odd tiles are stored, so flipping a byte corrupts the data without breaking the deflate stream
+    NSFileHandle *file = [NSFileHandle fileHandleForUpdatingURL:zipURL error:&error];
+    for (NSString *name in @[@"test_report/tiles/0/3.png", @"test_report/tiles/0/7.png"]) {
+        uint64_t offset;
+        XCTAssert([archive dataOffsetForEntry:[archive entryNamed:name] offset:&offset error:&error], @"%@", error);
+        [file seekToFileOffset:offset + 100];
+        [file writeData:[NSData dataWithBytes:"\xff" length:1]];
+    }
+    [file closeFile];
+
+    ReportExtractor *extractor = [[ReportExtractor alloc] initWithArchive:archive destination:tempDir.path];
+    XCTAssertFalse([extractor extract:&error]);
+    XCTAssertEqual(error.code, ReportArchiveErrorChecksum);
+    XCTAssertEqualObjects(error.userInfo[ReportArchiveCorruptEntriesKey], (@[@"test_report/tiles/0/3.png", @"test_report/tiles/0/7.png"]));
+    XCTAssertFalse([fileManager fileExistsAtPath:[tempDir.path stringByAppendingPathComponent:@"test_report/tiles/0/3.png"]]);
+    XCTAssertTrue([fileManager fileExistsAtPath:[tempDir.path stringByAppendingPathComponent:@"test_report/tiles/0/5.png"]]);
+}
+
+@end
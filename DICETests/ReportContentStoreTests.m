@@ -0,0 +1,89 @@
+//
+//  ReportContentStoreTests.m
+//  DICE
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+#include <sys/stat.h>
+
+#import "ReportArchive.h"
+#import "ReportContentStore.h"
+#import "ReportExtractor.h"
+#import "ReportZipFixture.h"
+
+@interface ReportContentStoreTests : XCTestCase
+
+@end
+
+@implementation ReportContentStoreTests
+{
+    NSString *tempDir;
+    NSFileManager *fileManager;
+}
+
+- (void)setUp {
+    [super setUp];
+    fileManager = [NSFileManager defaultManager];
+    tempDir = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    [fileManager createDirectoryAtPath:tempDir withIntermediateDirectories:YES attributes:nil error:nil];
+}
+
+- (void)tearDown {
+    [fileManager removeItemAtPath:tempDir error:nil];
+    [super tearDown];
+}
+
+- (void)testSharesReadOnlyBlobsButNotGeoPackages {
+    NSURL *zipURL = [NSURL fileURLWithPath:[tempDir stringByAppendingPathComponent:@"report.zip"]];
+    ReportZipFixture *zip = [[ReportZipFixture alloc] initWithURL:zipURL];
+    [zip addEntry:@"report/index.html" string:@"<html><body>shared</body></html>"];
+    [zip addEntry:@"report/data/layers.gpkg" string:@"SQLite format 3"];
+    XCTAssert([zip finish], @"could not write test zip");
+
+    NSError *error;
+    ReportArchive *archive = [ReportArchive archiveWithURL:zipURL error:&error];
+    XCTAssertNotNil(archive, @"%@", error);
+    ReportContentStore *store = [[ReportContentStore alloc] initWithDirectory:[tempDir stringByAppendingPathComponent:@"store"]];
+    NSString *destination = [tempDir stringByAppendingPathComponent:@"extracted"];
+    ReportExtractor *extractor = [[ReportExtractor alloc] initWithArchive:archive destination:destination];
+    extractor.contentStore = store;
+    XCTAssertTrue([extractor extract:&error], @"%@", error);
+    XCTAssertEqualObjects(extractor.entryHashes.allKeys, @[@"report/index.html"]);
+
+    struct stat info;
+    XCTAssertEqual(stat([destination stringByAppendingPathComponent:@"report/index.html"].fileSystemRepresentation, &info), 0);
+    XCTAssertEqual(info.st_nlink, 2, @"not linked to a blob");
+    XCTAssertEqual(info.st_mode & 0777, 0444, @"shared blob is writable");
+    XCTAssertEqual(stat([destination stringByAppendingPathComponent:@"report/data/layers.gpkg"].fileSystemRepresentation, &info), 0);
+    XCTAssertEqual(info.st_nlink, 1, @"GeoPackage was linked to a blob");
+    XCTAssertTrue(info.st_mode & S_IWUSR, @"GeoPackage is not writable");
+
+    // a copy of the report under another name has to extract its GeoPackage again
+    NSString *fingerprint = [ReportContentStore fingerprintForArchive:archive];
+    [store saveManifestForReport:@"report.zip" fingerprint:fingerprint entryHashes:extractor.entryHashes];
+    XCTAssertNil([store linkArchive:archive toContentOfReport:@"report.zip" inDirectory:[tempDir stringByAppendingPathComponent:@"copy"]]);
+}
+
+- (void)testStoresFilesExtractedElsewhere {
+    ReportContentStore *store = [[ReportContentStore alloc] initWithDirectory:[tempDir stringByAppendingPathComponent:@"store"]];
+    NSString *first = [tempDir stringByAppendingPathComponent:@"first.js"];
+    NSString *second = [tempDir stringByAppendingPathComponent:@"second.js"];
+    for (NSString *path in @[first, second]) {
+        XCTAssertTrue([@"L.map('map');" writeToFile:path atomically:NO encoding:NSUTF8StringEncoding error:nil]);
+    }
+
+    NSError *error;
+    NSString *firstHash = [store storeFileAtPath:first error:&error];
+    XCTAssertNotNil(firstHash, @"%@", error);
+    XCTAssertEqualObjects([store storeFileAtPath:second error:&error], firstHash);
+
+    // both are links to the one blob, which is read only
+    struct stat info;
+    XCTAssertEqual(stat(second.fileSystemRepresentation, &info), 0);
+    XCTAssertEqual(info.st_nlink, 3);
+    XCTAssertEqual(info.st_mode & 0777, 0444);
+    XCTAssertEqualObjects([NSString stringWithContentsOfFile:first encoding:NSUTF8StringEncoding error:nil], @"L.map('map');");
+}
+
+@end
@@ -0,0 +1,164 @@
+//
+//  ReportDirectoryWatcherTests.m
+//  DICE
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+
+#include <stdio.h>
+
+#import "ReportDirectoryWatcher.h"
+
+
+@interface ReportDirectoryWatcherTests : XCTestCase
+
+@end
+
+@implementation ReportDirectoryWatcherTests
+{
+    NSString *tempDir;
+    NSFileManager *fileManager;
+    dispatch_queue_t queue;
+}
+
+- (void)setUp {
+    [super setUp];
+    fileManager = [NSFileManager defaultManager];
+    tempDir = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    [fileManager createDirectoryAtPath:tempDir withIntermediateDirectories:YES attributes:nil error:nil];
+    queue = dispatch_queue_create("dice.test.watcher", DISPATCH_QUEUE_SERIAL);
+}
+
+- (void)tearDown {
+    [fileManager removeItemAtPath:tempDir error:nil];
+    [super tearDown];
+}
+
+- (void)writeFile:(NSString *)name string:(NSString *)contents {
+    [[contents dataUsingEncoding:NSUTF8StringEncoding] writeToFile:[tempDir stringByAppendingPathComponent:name] atomically:YES];
+}
+
+- (void)testReportsOnlyWhatChanged {
+    [self writeFile:@"kept.zip" string:@"kept"];
+    [self writeFile:@"changed.zip" string:@"before"];
+    [self writeFile:@"gone.pdf" string:@"gone"];
+    ReportDirectoryWatcher *watcher = [[ReportDirectoryWatcher alloc] initWithDirectory:tempDir queue:queue];
+    // pass on every change at the next scan
+    watcher.settleInterval = 0;
+    __block NSArray *added, *removed, *modified;
+    __block NSUInteger changes = 0;
+    watcher.changeHandler = ^(NSArray<NSString *> *a, NSArray<NSString *> *r, NSArray<NSString *> *m) {
+        added = a;
+        removed = r;
+        modified = m;
+        changes++;
+    };
+    dispatch_sync(queue, ^{
+        [watcher scanForChanges];
+    });
+    XCTAssertEqual(added.count, (NSUInteger)3);
+
+    [self writeFile:@"changed.zip" string:@"after the change"];
+    [self writeFile:@"new.zip" string:@"new"];
+    [self writeFile:@".hidden.zip" string:@"hidden"];
+    [fileManager createDirectoryAtPath:[tempDir stringByAppendingPathComponent:@"extracted"] withIntermediateDirectories:NO attributes:nil error:nil];
+    [fileManager removeItemAtPath:[tempDir stringByAppendingPathComponent:@"gone.pdf"] error:nil];
+    dispatch_sync(queue, ^{
+        [watcher scanForChanges];
+    });
+    XCTAssertEqualObjects(added, @[@"new.zip"]);
+    XCTAssertEqualObjects(removed, @[@"gone.pdf"]);
+    XCTAssertEqualObjects(modified, @[@"changed.zip"]);
+
+    dispatch_sync(queue, ^{
+        [watcher scanForChanges];
+    });
+    XCTAssertEqual(changes, (NSUInteger)2, @"reported changes when there were none");
+}
+
+- (void)testWatchesForChanges {
+    [self writeFile:@"existing.zip" string:@"existing"];
+    ReportDirectoryWatcher *watcher = [[ReportDirectoryWatcher alloc] initWithDirectory:tempDir queue:queue];
+    watcher.coalescingDelay = 0.05;
+    watcher.settleInterval = 0.2;
+    XCTestExpectation *changed = [self expectationWithDescription:@"directory changed"];
+    __block NSArray *added;
+    watcher.changeHandler = ^(NSArray<NSString *> *a, NSArray<NSString *> *r, NSArray<NSString *> *m) {
+        if (!added) {
+            added = a;
+            [changed fulfill];
+        }
+    };
+    __block BOOL started;
+    __block NSArray *fileNames;
+    dispatch_sync(queue, ^{
+        started = [watcher start];
+        fileNames = watcher.fileNames;
+    });
+    XCTAssertTrue(started);
+    XCTAssertEqualObjects(fileNames, @[@"existing.zip"]);
+
+    [self writeFile:@"dropped_in.zip" string:@"new report"];
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    XCTAssertEqualObjects(added, @[@"dropped_in.zip"], @"reported files that were there before it started");
+
+    dispatch_sync(queue, ^{
+        [watcher stop];
+    });
+    XCTAssertFalse(watcher.isWatching);
+}
+
+- (void)testWaitsForFilesWrittenInChunks {
+    ReportDirectoryWatcher *watcher = [[ReportDirectoryWatcher alloc] initWithDirectory:tempDir queue:queue];
+    watcher.coalescingDelay = 0.05;
+    watcher.settleInterval = 0.5;
+    NSString *path = [tempDir stringByAppendingPathComponent:@"copying.zip"];
+    XCTestExpectation *replaced = [self expectationWithDescription:@"file replaced"];
+    NSMutableArray<NSString *> *changes = [NSMutableArray array];
+    watcher.changeHandler = ^(NSArray<NSString *> *a, NSArray<NSString *> *r, NSArray<NSString *> *m) {
+        unsigned long long size = [fileManager attributesOfItemAtPath:path error:nil].fileSize;
+        for (NSString *name in a) {
+            [changes addObject:[NSString stringWithFormat:@"added %@ %llu", name, size]];
+        }
+        for (NSString *name in m) {
+            [changes addObject:[NSString stringWithFormat:@"modified %@ %llu", name, size]];
+            [replaced fulfill];
+        }
+    };
+    __block BOOL started;
+    dispatch_sync(queue, ^{
+        started = [watcher start];
+    });
+    XCTAssertTrue(started);
+
+    // written in place, with pauses shorter than the settle interval, like a slow copy
+    NSMutableData *chunk = [NSMutableData dataWithLength:64 * 1024];
+    [fileManager createFileAtPath:path contents:nil attributes:nil];
+    NSFileHandle *file = [NSFileHandle fileHandleForWritingAtPath:path];
+    for (int i = 0; i < 6; i++) {
+        [file writeData:chunk];
+        [NSThread sleepForTimeInterval:0.2];
+    }
+    [file closeFile];
+    [NSThread sleepForTimeInterval:1.5];
+
+    // a new copy written next to it, hidden, and then moved over it
+    NSString *partPath = [tempDir stringByAppendingPathComponent:@".copying.zip.part"];
+    [fileManager createFileAtPath:partPath contents:nil attributes:nil];
+    file = [NSFileHandle fileHandleForWritingAtPath:partPath];
+    for (int i = 0; i < 10; i++) {
+        [file writeData:chunk];
+        [NSThread sleepForTimeInterval:0.05];
+    }
+    [file closeFile];
+    XCTAssertEqual(rename(partPath.fileSystemRepresentation, path.fileSystemRepresentation), 0);
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    dispatch_sync(queue, ^{
+        [watcher stop];
+    });
+    XCTAssertEqualObjects(changes, (@[@"added copying.zip 393216", @"modified copying.zip 655360"]));
+}
+
+@end
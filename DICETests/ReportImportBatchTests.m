@@ -0,0 +1,61 @@
+//
+//  ReportImportBatchTests.m
+//  DICE
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+
+#import "ReportImportBatch.h"
+
+
+@interface ReportImportBatchTests : XCTestCase
+
+@end
+
+@implementation ReportImportBatchTests
+
+- (void)testPlansOnlyWhatFitsTheFreeSpace {
+    ReportImportBatch *batch = [[ReportImportBatch alloc] init];
+    batch.reserve = 100;
+
+    XCTAssertTrue([batch addReport:@"a.zip" uncompressedSize:400 availableSpace:1000]);
+    XCTAssertFalse([batch addReport:@"big.zip" uncompressedSize:600 availableSpace:1000], @"planned past the reserve");
+    XCTAssertTrue([batch addReport:@"b.zip" uncompressedSize:300 availableSpace:1000], @"a smaller report should still fit");
+
+    XCTAssertEqual(batch.reportCount, (NSUInteger)3);
+    XCTAssertEqual(batch.totalBytes, (uint64_t)700);
+    XCTAssertTrue([batch containsReport:@"big.zip"]);
+    XCTAssertFalse([batch shouldExtractReport:@"big.zip"]);
+    XCTAssertTrue([batch shouldExtractReport:@"a.zip"]);
+
+    // a.zip is extracted, so the free space reported now already reflects it
+    [batch finishReport:@"a.zip"];
+    XCTAssertTrue([batch addReport:@"c.zip" uncompressedSize:250 availableSpace:650]);
+}
+
+- (void)testAddsUpProgressAcrossReports {
+    ReportImportBatch *batch = [[ReportImportBatch alloc] init];
+    batch.reserve = 0;
+    [batch addReport:@"a.zip" uncompressedSize:1000 availableSpace:10000];
+    [batch addReport:@"b.zip" uncompressedSize:1000 availableSpace:10000];
+    XCTAssertEqual(batch.estimatedTimeRemaining, (NSTimeInterval)-1);
+
+    [NSThread sleepForTimeInterval:0.1];
+    [batch updateReport:@"a.zip" bytesExtracted:500];
+    [batch updateReport:@"b.zip" bytesExtracted:5000];
+    XCTAssertEqual(batch.bytesExtracted, (uint64_t)1500, @"counted more than a report planned");
+    XCTAssertGreaterThan(batch.bytesPerSecond, 0);
+    // a quarter of the bytes are left, so about a third of the time spent so far
+    XCTAssertGreaterThan(batch.estimatedTimeRemaining, 0.02);
+    XCTAssertLessThan(batch.estimatedTimeRemaining, 1.0);
+
+    [batch finishReport:@"a.zip"];
+    XCTAssertFalse(batch.isFinished);
+    [batch finishReport:@"b.zip"];
+    XCTAssertTrue(batch.isFinished);
+    XCTAssertEqual(batch.finishedCount, (NSUInteger)2);
+    XCTAssertEqual(batch.estimatedTimeRemaining, (NSTimeInterval)0);
+}
+
+@end
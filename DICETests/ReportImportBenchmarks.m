@@ -0,0 +1,295 @@
+//
+//  ReportImportBenchmarks.m
+//  DICE
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+#import <mach/mach.h>
+
+#import "ReportArchive.h"
+#import "ReportContentStore.h"
+#import "ReportEntryClassifier.h"
+#import "ReportExtractor.h"
+#import "ReportImportManifest.h"
+#import "ReportZipFixture.h"
+
+
+static uint64_t residentSize(void) {
+    struct mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) {
+        return 0;
+    }
+    return info.resident_size;
+}
+
+/*
+ * Bytes that vary like real tile and GeoPackage content, so neither deflate nor the content
+ * store's deduplication gets an unrealistically easy time.  runLength repeats each byte to
+ * make the data more compressible.
+ */
+static NSData *syntheticData(NSUInteger length, uint32_t seed, NSUInteger runLength) {
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    uint8_t *bytes = data.mutableBytes;
+    uint32_t state = seed * 2654435761u + 1;
+    for (NSUInteger i = 0; i < length; i++) {
+        if (i % runLength == 0) {
+            state = state * 1664525u + 1013904223u;
+        }
+        bytes[i] = (uint8_t)(state >> 24);
+    }
+    return data;
+}
+
+static double median(NSArray<NSNumber *> *values) {
+    NSArray<NSNumber *> *sorted = [values sortedArrayUsingSelector:@selector(compare:)];
+    return sorted.count ? sorted[sorted.count / 2].doubleValue : 0;
+}
+
+
+/**
+ Import throughput benchmarks over synthetic report zips of different shapes.  They
+ take minutes, so they only run when DICE_BENCHMARKS is set in the test environment:
+
+     DICE_BENCHMARKS=1 xcodebuild test -scheme DICE -destination 'platform=iOS Simulator,name=iPhone 6'
+
+ DICE_BENCHMARK_SCALE multiplies the size of every corpus (default 1) and
+ DICE_BENCHMARK_RUNS sets how many times each is imported (default 3).  Each corpus
+ prints one JSON object on a line starting with "DICE_BENCHMARK ", with the median time
+ of each import phase, and appends the same line to the file DICE_BENCHMARK_OUTPUT
+ names, if any, for tracking regressions across builds.
+ */
+@interface ReportImportBenchmarks : XCTestCase
+
+@end
+
+@implementation ReportImportBenchmarks
+{
+    NSURL *tempDir;
+    NSFileManager *fileManager;
+    NSDictionary<NSString *, NSString *> *environment;
+    double scale;
+}
+
+- (void)setUp {
+    [super setUp];
+    fileManager = [NSFileManager defaultManager];
+    environment = [NSProcessInfo processInfo].environment;
+    scale = environment[@"DICE_BENCHMARK_SCALE"] ? environment[@"DICE_BENCHMARK_SCALE"].doubleValue : 1.0;
+    tempDir = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:[NSUUID UUID].UUIDString isDirectory:YES];
+    [fileManager createDirectoryAtURL:tempDir withIntermediateDirectories:YES attributes:nil error:nil];
+}
+
+- (void)tearDown {
+    [fileManager removeItemAtURL:tempDir error:nil];
+    [super tearDown];
+}
+
+- (BOOL)benchmarksEnabled {
+    if (!environment[@"DICE_BENCHMARKS"]) {
+        NSLog(@"ReportImportBenchmarks: set DICE_BENCHMARKS to run %@", self.name);
+        return NO;
+    }
+    return YES;
+}
+
+- (NSUInteger)scaled:(NSUInteger)count {
+    return MAX((NSUInteger)1, (NSUInteger)(count * scale));
+}
+
+- (ReportZipFixture *)zipNamed:(NSString *)name {
+    ReportZipFixture *zip = [[ReportZipFixture alloc] initWithURL:[tempDir URLByAppendingPathComponent:[name stringByAppendingPathExtension:@"zip"]]];
+    [zip addDirectory:[name stringByAppendingString:@"/"]];
+    [zip addEntry:[name stringByAppendingString:@"/index.html"] string:@"<html><body>benchmark</body></html>"];
+    [zip addEntry:[name stringByAppendingString:@"/metadata.json"] string:[NSString stringWithFormat:@"{\"title\": \"%@\"}", name]];
+    return zip;
+}
+
+/*
+ * Import the corpus the way ReportAPI does, timing each phase, and log the results.
+ */
+- (void)benchmarkCorpus:(NSString *)name zip:(ReportZipFixture *)zip {
+    XCTAssert([zip finish], @"could not write %@", name);
+    NSURL *zipURL = [tempDir URLByAppendingPathComponent:[name stringByAppendingPathExtension:@"zip"]];
+    NSUInteger runs = environment[@"DICE_BENCHMARK_RUNS"] ? (NSUInteger)MAX(1, environment[@"DICE_BENCHMARK_RUNS"].integerValue) : 3;
+    NSMutableDictionary<NSString *, NSMutableArray<NSNumber *> *> *phaseTimes = [NSMutableDictionary dictionary];
+    for (NSString *phase in @[@"open", @"extract", @"manifest", @"relink"]) {
+        phaseTimes[phase] = [NSMutableArray array];
+    }
+
+    // sample resident memory while importing, since the process high-water mark covers every corpus before this one
+    __block uint64_t peakResident = residentSize();
+    dispatch_queue_t sampleQueue = dispatch_queue_create("dice.benchmark_memory", DISPATCH_QUEUE_SERIAL);
+    dispatch_source_t sampler = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, sampleQueue);
+    dispatch_source_set_timer(sampler, DISPATCH_TIME_NOW, 5 * NSEC_PER_MSEC, NSEC_PER_MSEC);
+    dispatch_source_set_event_handler(sampler, ^{
+        peakResident = MAX(peakResident, residentSize());
+    });
+    dispatch_resume(sampler);
+
+    NSUInteger entryCount = 0;
+    uint64_t byteCount = 0;
+    uint64_t compressedCount = 0;
+    NSUInteger workers = [NSProcessInfo processInfo].activeProcessorCount;
+    for (NSUInteger run = 0; run < runs; run++) {
+        @autoreleasepool {
+            NSString *runDir = [tempDir.path stringByAppendingPathComponent:[NSString stringWithFormat:@"run%lu", (unsigned long)run]];
+            ReportContentStore *store = [[ReportContentStore alloc] initWithDirectory:[runDir stringByAppendingPathComponent:@"store"]];
+            NSError *error;
+
+            CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+            ReportArchive *archive = [ReportArchive archiveWithURL:zipURL error:&error];
+            [phaseTimes[@"open"] addObject:@((CFAbsoluteTimeGetCurrent() - start) * 1000)];
+            XCTAssertNotNil(archive, @"%@", error);
+
+            start = CFAbsoluteTimeGetCurrent();
+            ReportExtractor *extractor = [[ReportExtractor alloc] initWithArchive:archive destination:[runDir stringByAppendingPathComponent:@"first"]];
+            extractor.contentStore = store;
+            extractor.entryClassifier = [[ReportContentClassifier alloc] initWithContentDirectoryName:name];
+            XCTAssert([extractor extract:&error], @"%@", error);
+            [phaseTimes[@"extract"] addObject:@((CFAbsoluteTimeGetCurrent() - start) * 1000)];
+
+            start = CFAbsoluteTimeGetCurrent();
+            NSString *fingerprint = [ReportContentStore fingerprintForArchive:archive];
+            [store saveManifestForReport:@"first" fingerprint:fingerprint entryHashes:extractor.entryHashes];
+            [ReportImportManifest manifestWithArchive:archive];
+            [phaseTimes[@"manifest"] addObject:@((CFAbsoluteTimeGetCurrent() - start) * 1000)];
+
+            // the same report imported again under another name; GeoPackages are never shared, so a
+            // corpus holding any falls back to a full extraction, as ReportAPI does, and that is timed instead
+            BOOL shareable = YES;
+            for (ReportArchiveEntry *entry in archive.entries) {
+                shareable = shareable && (entry.isDirectory || [ReportContentStore canShareEntry:entry]);
+            }
+            NSString *secondDir = [runDir stringByAppendingPathComponent:@"second"];
+            start = CFAbsoluteTimeGetCurrent();
+            NSDictionary<NSString *, NSString *> *linkedHashes = [store linkArchive:archive toContentOfReport:@"first" inDirectory:secondDir];
+            if (shareable) {
+                XCTAssertNotNil(linkedHashes);
+            }
+            else {
+                XCTAssertNil(linkedHashes);
+                ReportExtractor *fallback = [[ReportExtractor alloc] initWithArchive:archive destination:secondDir];
+                fallback.contentStore = store;
+                XCTAssert([fallback extract:&error], @"%@", error);
+            }
+            [phaseTimes[@"relink"] addObject:@((CFAbsoluteTimeGetCurrent() - start) * 1000)];
+
+            entryCount = archive.entries.count;
+            byteCount = archive.totalUncompressedSize;
+            compressedCount = 0;
+            for (ReportArchiveEntry *entry in archive.entries) {
+                compressedCount += entry.compressedSize;
+            }
+            [archive close];
+            [fileManager removeItemAtPath:runDir error:nil];
+        }
+    }
+
+    dispatch_sync(sampleQueue, ^{
+        peakResident = MAX(peakResident, residentSize());
+    });
+    dispatch_source_cancel(sampler);
+
+    double extractSeconds = median(phaseTimes[@"extract"]) / 1000;
+    NSMutableDictionary *phases = [NSMutableDictionary dictionary];
+    for (NSString *phase in phaseTimes) {
+        phases[[phase stringByAppendingString:@"_ms"]] = @(median(phaseTimes[phase]));
+    }
+    NSDictionary *result = @{
+        @"corpus": name,
+        @"scale": @(scale),
+        @"runs": @(runs),
+        @"workers": @(workers),
+        @"entries": @(entryCount),
+        @"bytes": @(byteCount),
+        @"compressed_bytes": @(compressedCount),
+        @"phases": phases,
+        @"files_per_sec": @(extractSeconds > 0 ? entryCount / extractSeconds : 0),
+        @"mb_per_sec": @(extractSeconds > 0 ? byteCount / extractSeconds / (1 << 20) : 0),
+        @"peak_rss_bytes": @(peakResident)
+    };
+    NSData *json = [NSJSONSerialization dataWithJSONObject:result options:0 error:nil];
+    NSString *line = [NSString stringWithFormat:@"DICE_BENCHMARK %@\n", [[NSString alloc] initWithData:json encoding:NSUTF8StringEncoding]];
+    printf("%s", line.UTF8String);
+
+    NSString *outputPath = environment[@"DICE_BENCHMARK_OUTPUT"];
+    if (outputPath) {
+        if (![fileManager fileExistsAtPath:outputPath]) {
+            [fileManager createFileAtPath:outputPath contents:nil attributes:nil];
+        }
+        NSFileHandle *output = [NSFileHandle fileHandleForWritingAtPath:outputPath];
+        [output seekToEndOfFile];
+        [output writeData:[line dataUsingEncoding:NSUTF8StringEncoding]];
+        [output closeFile];
+    }
+}
+
+- (void)testTinyTiles {
+    if (![self benchmarksEnabled]) {
+        return;
+    }
+    ReportZipFixture *zip = [self zipNamed:@"tiny_tiles"];
+    NSUInteger count = [self scaled:50000];
+    for (NSUInteger i = 0; i < count; i++) {
+        NSString *tile = [NSString stringWithFormat:@"tiny_tiles/tiles/%lu/%lu/%lu.png", i / 10000, (i / 100) % 100, i % 100];
+        [zip addEntry:tile data:syntheticData(64 + (i * 37) % 448, (uint32_t)i, 1) deflate:(i % 4 != 0)];
+    }
+    [self benchmarkCorpus:@"tiny_tiles" zip:zip];
+}
+
+- (void)testHugeGeoPackages {
+    if (![self benchmarksEnabled]) {
+        return;
+    }
+    ReportZipFixture *zip = [self zipNamed:@"huge_geopackages"];
+    for (NSUInteger i = 0; i < 3; i++) {
+        NSString *geoPackage = [NSString stringWithFormat:@"huge_geopackages/data/layer%lu.gpkg", i];
+        [zip addEntry:geoPackage data:syntheticData([self scaled:(48 << 20)], (uint32_t)i, 8) deflate:YES];
+    }
+    [self benchmarkCorpus:@"huge_geopackages" zip:zip];
+}
+
+- (void)testDeepTree {
+    if (![self benchmarksEnabled]) {
+        return;
+    }
+    ReportZipFixture *zip = [self zipNamed:@"deep_tree"];
+    NSUInteger count = [self scaled:5000];
+    for (NSUInteger i = 0; i < count; i++) {
+        NSMutableString *path = [NSMutableString stringWithString:@"deep_tree"];
+        for (NSUInteger level = 0; level < 12; level++) {
+            [path appendFormat:@"/d%lu", (i >> level) & 3];
+        }
+        [path appendFormat:@"/%lu.json", i];
+        [zip addEntry:path data:syntheticData(2048, (uint32_t)i, 4) deflate:YES];
+    }
+    [self benchmarkCorpus:@"deep_tree" zip:zip];
+}
+
+- (void)testStoredEntries {
+    if (![self benchmarksEnabled]) {
+        return;
+    }
+    ReportZipFixture *zip = [self zipNamed:@"stored"];
+    NSUInteger count = [self scaled:8000];
+    for (NSUInteger i = 0; i < count; i++) {
+        [zip addEntry:[NSString stringWithFormat:@"stored/files/%lu/%lu.bin", i / 500, i] data:syntheticData(16384, (uint32_t)i, 4) deflate:NO];
+    }
+    [self benchmarkCorpus:@"stored" zip:zip];
+}
+
+- (void)testDeflatedEntries {
+    if (![self benchmarksEnabled]) {
+        return;
+    }
+    ReportZipFixture *zip = [self zipNamed:@"deflated"];
+    NSUInteger count = [self scaled:8000];
+    for (NSUInteger i = 0; i < count; i++) {
+        [zip addEntry:[NSString stringWithFormat:@"deflated/files/%lu/%lu.bin", i / 500, i] data:syntheticData(16384, (uint32_t)i, 4) deflate:YES];
+    }
+    [self benchmarkCorpus:@"deflated" zip:zip];
+}
+
+@end
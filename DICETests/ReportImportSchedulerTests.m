@@ -0,0 +1,202 @@
+//
+//  ReportImportSchedulerTests.m
+//  DICE
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+
+#import "ReportImportScheduler.h"
+
+@interface ReportImportSchedulerTests : XCTestCase
+
+@end
+
+@implementation ReportImportSchedulerTests
+{
+    dispatch_queue_t queue;
+    ReportImportScheduler *scheduler;
+}
+
+- (void)setUp {
+    [super setUp];
+    queue = dispatch_queue_create("dice.test_imports", DISPATCH_QUEUE_CONCURRENT);
+    scheduler = [[ReportImportScheduler alloc] initWithQueue:queue];
+}
+
+- (void)testInteractiveImportJumpsTheQueue {
+    scheduler.maxConcurrentImports = 1;
+    dispatch_semaphore_t blocker = dispatch_semaphore_create(0);
+    NSMutableArray<NSString *> *order = [NSMutableArray array];
+    dispatch_group_t done = dispatch_group_create();
+
+    ReportImportBlock record = ^(ReportImportTask *task) {
+        @synchronized (order) {
+            [order addObject:task.report.title];
+        }
+        dispatch_group_leave(done);
+    };
+    [scheduler scheduleImportOfReport:[[Report alloc] initWithTitle:@"first"] byteCount:1 priority:ReportImportPriorityBackground block:^(ReportImportTask *task) {
+        dispatch_semaphore_wait(blocker, DISPATCH_TIME_FOREVER);
+        record(task);
+    }];
+    [scheduler scheduleImportOfReport:[[Report alloc] initWithTitle:@"second"] byteCount:1 priority:ReportImportPriorityBackground block:record];
+    [scheduler scheduleImportOfReport:[[Report alloc] initWithTitle:@"opened"] byteCount:1 priority:ReportImportPriorityUserInitiated block:record];
+    Report *tapped = [[Report alloc] initWithTitle:@"tapped"];
+    [scheduler scheduleImportOfReport:tapped byteCount:1 priority:ReportImportPriorityBackground block:record];
+
+    for (NSUInteger i = 0; i < 4; i++) {
+        dispatch_group_enter(done);
+    }
+
+    XCTAssertTrue([scheduler raiseImportOfReport:tapped toPriority:ReportImportPriorityInteractive]);
+    dispatch_semaphore_signal(blocker);
+
+    XCTAssertEqual(dispatch_group_wait(done, dispatch_time(DISPATCH_TIME_NOW, 5 * NSEC_PER_SEC)), 0);
+    XCTAssertEqualObjects(order, (@[@"first", @"tapped", @"opened", @"second"]));
+}
+
+- (void)testByteBudgetLimitsImportsInFlight {
+    scheduler.maxConcurrentImports = 4;
+    scheduler.byteBudget = 100;
+    __block NSInteger running = 0;
+    __block NSInteger mostRunning = 0;
+    dispatch_group_t done = dispatch_group_create();
+
+    for (NSUInteger i = 0; i < 6; i++) {
+        dispatch_group_enter(done);
+        [scheduler scheduleImportOfReport:[[Report alloc] initWithTitle:@"report"] byteCount:40 priority:ReportImportPriorityBackground block:^(ReportImportTask *task) {
+            @synchronized (self) {
+                running += 1;
+                mostRunning = MAX(mostRunning, running);
+            }
+            [NSThread sleepForTimeInterval:0.05];
+            @synchronized (self) {
+                running -= 1;
+            }
+            dispatch_group_leave(done);
+        }];
+    }
+
+    XCTAssertEqual(dispatch_group_wait(done, dispatch_time(DISPATCH_TIME_NOW, 5 * NSEC_PER_SEC)), 0);
+    XCTAssertEqual(mostRunning, 2);
+}
+
+- (void)testCancelledImportDoesNotRun {
+    scheduler.maxConcurrentImports = 1;
+    dispatch_semaphore_t blocker = dispatch_semaphore_create(0);
+    Report *report = [[Report alloc] initWithTitle:@"cancelled"];
+    __block BOOL ran = NO;
+    XCTestExpectation *done = [self expectationWithDescription:@"first import ran"];
+
+    [scheduler scheduleImportOfReport:[[Report alloc] initWithTitle:@"first"] byteCount:1 priority:ReportImportPriorityBackground block:^(ReportImportTask *task) {
+        dispatch_semaphore_wait(blocker, DISPATCH_TIME_FOREVER);
+        [done fulfill];
+    }];
+    ReportImportTask *cancelled = [scheduler scheduleImportOfReport:report byteCount:1 priority:ReportImportPriorityBackground block:^(ReportImportTask *task) {
+        ran = YES;
+    }];
+    [scheduler cancelImportOfReport:report];
+    dispatch_semaphore_signal(blocker);
+
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    dispatch_barrier_sync(queue, ^{});
+    XCTAssertTrue(cancelled.isCancelled);
+    XCTAssertFalse(ran);
+    XCTAssertNil([scheduler taskForReport:report]);
+}
+
+- (void)testRescheduledImportWaitsForCancelledOne {
+    scheduler.maxConcurrentImports = 2;
+    dispatch_semaphore_t blocker = dispatch_semaphore_create(0);
+    Report *report = [[Report alloc] initWithTitle:@"changed"];
+    NSMutableArray<NSString *> *order = [NSMutableArray array];
+    __block NSInteger running = 0;
+    __block NSInteger mostRunning = 0;
+    dispatch_group_t done = dispatch_group_create();
+
+    ReportImportBlock (^import)(NSString *, BOOL) = ^ReportImportBlock(NSString *name, BOOL blocks) {
+        dispatch_group_enter(done);
+        return ^(ReportImportTask *task) {
+            @synchronized (order) {
+                running += 1;
+                mostRunning = MAX(mostRunning, running);
+                [order addObject:[name stringByAppendingString:@" started"]];
+            }
+            // like an extraction that only notices it was cancelled between entries
+            if (blocks) {
+                dispatch_semaphore_wait(blocker, DISPATCH_TIME_FOREVER);
+            }
+            @synchronized (order) {
+                running -= 1;
+                [order addObject:[name stringByAppendingString:@" finished"]];
+            }
+            dispatch_group_leave(done);
+        };
+    };
+    ReportImportTask *first = [scheduler scheduleImportOfReport:report byteCount:1 priority:ReportImportPriorityBackground block:import(@"first", YES)];
+    while (scheduler.runningCount == 0) {
+        [NSThread sleepForTimeInterval:0.01];
+    }
+    [scheduler cancelImportOfReport:report];
+    ReportImportTask *second = [scheduler scheduleImportOfReport:report byteCount:1 priority:ReportImportPriorityInteractive block:import(@"second", NO)];
+    [scheduler scheduleImportOfReport:[[Report alloc] initWithTitle:@"other"] byteCount:1 priority:ReportImportPriorityBackground block:import(@"other", NO)];
+
+    // the other report's import goes past the held one
+    NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:5];
+    while (deadline.timeIntervalSinceNow > 0) {
+        @synchronized (order) {
+            if (order.count >= 3) {
+                break;
+            }
+        }
+        [NSThread sleepForTimeInterval:0.01];
+    }
+    XCTAssertEqualObjects(order, (@[@"first started", @"other started", @"other finished"]));
+    XCTAssertEqual(scheduler.queuedCount, 1);
+    XCTAssertEqual([scheduler taskForReport:report], second);
+    dispatch_semaphore_signal(blocker);
+
+    XCTAssertEqual(dispatch_group_wait(done, dispatch_time(DISPATCH_TIME_NOW, 5 * NSEC_PER_SEC)), 0);
+    XCTAssertTrue(first.isCancelled);
+    XCTAssertFalse(second.isCancelled);
+    XCTAssertEqualObjects([order subarrayWithRange:NSMakeRange(3, 3)], (@[@"first finished", @"second started", @"second finished"]));
+    XCTAssertEqual(mostRunning, 2);
+}
+
+- (void)testReschedulingQueuedImportReplacesIt {
+    scheduler.maxConcurrentImports = 1;
+    dispatch_semaphore_t blocker = dispatch_semaphore_create(0);
+    Report *report = [[Report alloc] initWithTitle:@"changed twice"];
+    NSMutableArray<NSString *> *ran = [NSMutableArray array];
+    XCTestExpectation *done = [self expectationWithDescription:@"replacement ran"];
+
+    [scheduler scheduleImportOfReport:[[Report alloc] initWithTitle:@"first"] byteCount:1 priority:ReportImportPriorityBackground block:^(ReportImportTask *task) {
+        dispatch_semaphore_wait(blocker, DISPATCH_TIME_FOREVER);
+    }];
+    ReportImportTask *replaced = [scheduler scheduleImportOfReport:report byteCount:1 priority:ReportImportPriorityInteractive block:^(ReportImportTask *task) {
+        @synchronized (ran) {
+            [ran addObject:@"replaced"];
+        }
+    }];
+    ReportImportTask *replacement = [scheduler scheduleImportOfReport:report byteCount:1 priority:ReportImportPriorityBackground block:^(ReportImportTask *task) {
+        @synchronized (ran) {
+            [ran addObject:@"replacement"];
+        }
+        [done fulfill];
+    }];
+
+    XCTAssertEqual(scheduler.queuedCount, 1);
+    XCTAssertEqual([scheduler taskForReport:report], replacement);
+    XCTAssertTrue(replaced.isCancelled);
+    XCTAssertEqual(replacement.priority, ReportImportPriorityInteractive);
+    dispatch_semaphore_signal(blocker);
+
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+    dispatch_barrier_sync(queue, ^{});
+    @synchronized (ran) {
+        XCTAssertEqualObjects(ran, @[@"replacement"]);
+    }
+}
+
+@end
@@ -0,0 +1,41 @@
+//
+//  ReportProgressChannelTests.m
+//  DICE
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+
+#import "ReportProgressChannel.h"
+
+@interface ReportProgressChannelTests : XCTestCase
+
+@end
+
+@implementation ReportProgressChannelTests
+
+- (void)testRestartedTrackingStartsOver {
+    ReportProgressChannel *channel = [[ReportProgressChannel alloc] initWithPublishBlock:^(ReportProgress *progress) {}];
+    Report *report = [[Report alloc] initWithTitle:@"reimported"];
+
+    ReportProgress *first = [channel beginTrackingReport:report];
+    [first setTotalFiles:10 totalBytes:1000];
+    [first setFilesExtracted:10 bytesExtracted:1000];
+    // still tracked, e.g., a download handing over to its extraction
+    XCTAssertEqual([channel beginTrackingReport:report], first);
+    XCTAssertEqual(first.filesExtracted, 10);
+    [channel finishTrackingReport:report];
+
+    // imported again before a tick dropped the finished counters
+    ReportProgress *second = [channel beginTrackingReport:report];
+    XCTAssertEqual(second.totalFiles, 0);
+    XCTAssertEqual(second.filesExtracted, 0);
+    XCTAssertEqual(second.bytesExtracted, 0);
+    [second setTotalFiles:4 totalBytes:400];
+    [second setFilesExtracted:1 bytesExtracted:100];
+    XCTAssertEqual(second.filesExtracted, 1);
+    XCTAssertEqual(second.bytesExtracted, 100);
+    [channel finishTrackingReport:report];
+}
+
+@end
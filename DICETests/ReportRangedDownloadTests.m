@@ -0,0 +1,166 @@
+//
+//  ReportRangedDownloadTests.m
+//  DICE
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+
+#import "ReportRangedDownload.h"
+
+
+static NSData *rangedResponseBody;
+static NSMutableArray<NSNumber *> *requestedRangeStarts;
+static NSUInteger dropFirstRequestAfterBytes;
+
+/**
+ Stands in for an HTTP server that serves byte ranges of rangedResponseBody for any request to ranges.test.
+ When dropFirstRequestAfterBytes is set, the first range request fails after that many bytes, like a dropped connection.
+ */
+@interface StubRangeServerProtocol : NSURLProtocol
+
+@end
+
+@implementation StubRangeServerProtocol
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+    return [request.URL.host isEqualToString:@"ranges.test"];
+}
+
++ (NSURLRequest *)canonicalRequestForRequest:(NSURLRequest *)request {
+    return request;
+}
+
+- (void)startLoading {
+    NSDictionary *headers = @{
+        @"Accept-Ranges": @"bytes",
+        @"ETag": @"\"v1\"",
+        @"Content-Length": [NSString stringWithFormat:@"%lu", (unsigned long)rangedResponseBody.length]
+    };
+    if ([self.request.HTTPMethod isEqualToString:@"HEAD"]) {
+        NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.request.URL statusCode:200 HTTPVersion:@"HTTP/1.1" headerFields:headers];
+        [self.client URLProtocol:self didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageNotAllowed];
+        [self.client URLProtocolDidFinishLoading:self];
+        return;
+    }
+
+    long long first = 0, last = 0;
+    NSString *range = [self.request valueForHTTPHeaderField:@"Range"];
+    sscanf(range.UTF8String, "bytes=%lld-%lld", &first, &last);
+    NSRange bytes = NSMakeRange((NSUInteger)first, (NSUInteger)(last - first + 1));
+    BOOL drop = NO;
+    @synchronized (requestedRangeStarts) {
+        drop = requestedRangeStarts.count == 0 && dropFirstRequestAfterBytes > 0;
+        [requestedRangeStarts addObject:@(first)];
+    }
+
+    NSMutableDictionary *rangeHeaders = [headers mutableCopy];
+    rangeHeaders[@"Content-Length"] = [NSString stringWithFormat:@"%lu", (unsigned long)bytes.length];
+    rangeHeaders[@"Content-Range"] = [NSString stringWithFormat:@"bytes %lld-%lld/%lu", first, last, (unsigned long)rangedResponseBody.length];
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.request.URL statusCode:206 HTTPVersion:@"HTTP/1.1" headerFields:rangeHeaders];
+    [self.client URLProtocol:self didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageNotAllowed];
+    if (drop) {
+        [self.client URLProtocol:self didLoadData:[rangedResponseBody subdataWithRange:NSMakeRange(bytes.location, dropFirstRequestAfterBytes)]];
+        [self.client URLProtocol:self didFailWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorNetworkConnectionLost userInfo:nil]];
+        return;
+    }
+    [self.client URLProtocol:self didLoadData:[rangedResponseBody subdataWithRange:bytes]];
+    [self.client URLProtocolDidFinishLoading:self];
+}
+
+- (void)stopLoading {
+}
+
+@end
+
+
+@interface ReportRangedDownloadTests : XCTestCase
+
+@end
+
+@implementation ReportRangedDownloadTests
+{
+    NSString *archivePath;
+    NSFileManager *fileManager;
+}
+
+- (void)setUp {
+    [super setUp];
+    fileManager = [NSFileManager defaultManager];
+    archivePath = [[NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString] stringByAppendingPathComponent:@"ranged_report.zip"];
+
+    NSMutableData *body = [NSMutableData dataWithLength:100000];
+    uint8_t *bytes = body.mutableBytes;
+    for (NSUInteger i = 0; i < body.length; i++) {
+        bytes[i] = (uint8_t)(i * 31 + i / 251);
+    }
+    rangedResponseBody = body;
+    requestedRangeStarts = [NSMutableArray array];
+    dropFirstRequestAfterBytes = 0;
+}
+
+- (void)tearDown {
+    [fileManager removeItemAtPath:[archivePath stringByDeletingLastPathComponent] error:nil];
+    [super tearDown];
+}
+
+- (ReportRangedDownload *)downloadWithArchivePath:(NSString *)path {
+    ReportRangedDownload *download = path ? [ReportRangedDownload savedDownloadWithArchivePath:path] :
+        [[ReportRangedDownload alloc] initWithURL:[NSURL URLWithString:@"http://ranges.test/ranged_report.zip"] archivePath:archivePath];
+    download.rangeLength = 16384;
+    download.sessionConfiguration = [NSURLSessionConfiguration ephemeralSessionConfiguration];
+    download.sessionConfiguration.protocolClasses = @[[StubRangeServerProtocol class]];
+    return download;
+}
+
+- (NSError *)runDownload:(ReportRangedDownload *)download {
+    XCTestExpectation *finished = [self expectationWithDescription:@"download finished"];
+    __block NSError *downloadError;
+    [download startWithCompletion:^(NSError *error) {
+        downloadError = error;
+        [finished fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+    return downloadError;
+}
+
+- (void)testDownloadsInRanges {
+    ReportRangedDownload *download = [self downloadWithArchivePath:nil];
+
+    XCTAssertNil([self runDownload:download]);
+    XCTAssertEqualObjects([NSData dataWithContentsOfFile:archivePath], rangedResponseBody);
+    XCTAssertEqual(requestedRangeStarts.count, (NSUInteger)7);
+    XCTAssertNil([ReportRangedDownload savedDownloadWithArchivePath:archivePath], @"finished download left its state behind");
+}
+
+- (void)testResumesAfterDroppedConnection {
+    dropFirstRequestAfterBytes = 5000;
+    ReportRangedDownload *download = [self downloadWithArchivePath:nil];
+    download.maxConnections = 1;
+    download.maxRetriesPerRange = 0;
+
+    XCTAssertNotNil([self runDownload:download]);
+    ReportRangedDownload *saved = [self downloadWithArchivePath:archivePath];
+    XCTAssertNotNil(saved);
+    XCTAssertEqual(saved.bytesReceived, (int64_t)5000);
+    XCTAssertEqual(saved.totalLength, (int64_t)rangedResponseBody.length);
+
+    dropFirstRequestAfterBytes = 0;
+    [requestedRangeStarts removeAllObjects];
+    XCTAssertNil([self runDownload:saved]);
+    XCTAssertEqualObjects([NSData dataWithContentsOfFile:archivePath], rangedResponseBody);
+    XCTAssertEqualObjects(requestedRangeStarts.firstObject, @5000, @"resumed download started the dropped range over");
+    XCTAssertEqual(requestedRangeStarts.count, (NSUInteger)7);
+}
+
+- (void)testRejectsDigestMismatch {
+    ReportRangedDownload *download = [self downloadWithArchivePath:nil];
+    download.expectedSHA256 = [NSMutableData dataWithLength:32];
+
+    NSError *error = [self runDownload:download];
+    XCTAssertEqualObjects(error.domain, ReportDownloadErrorDomain);
+    XCTAssertEqual(error.code, ReportDownloadErrorIntegrity);
+    XCTAssertFalse([fileManager fileExistsAtPath:archivePath]);
+}
+
+@end
@@ -0,0 +1,67 @@
+//
+//  ReportRegistryTests.m
+//  DICE
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+
+#import "ReportRegistry.h"
+
+@interface ReportRegistryTests : XCTestCase
+
+@end
+
+@implementation ReportRegistryTests
+
+- (Report *)reportWithID:(NSString *)reportID {
+    Report *report = [[Report alloc] initWithTitle:reportID];
+    report.reportID = reportID;
+    report.sourceFile = [NSURL fileURLWithPath:[NSString stringWithFormat:@"/Documents/%@.zip", reportID]];
+    return report;
+}
+
+- (void)testIndexesFollowAddsAndRemoves {
+    Report *first = [self reportWithID:@"first"];
+    ReportRegistry *registry = [[ReportRegistry alloc] initWithReports:@[first]];
+    Report *second = [self reportWithID:@"second"];
+    Report *third = [self reportWithID:@"third"];
+    NSArray<Report *> *before = registry.reports;
+    [registry addReports:@[second, third]];
+
+    XCTAssertEqual(before.count, (NSUInteger)1, @"a published snapshot changed");
+    XCTAssertEqual(registry.count, (NSUInteger)3);
+    XCTAssertEqual([registry indexOfReport:third], (NSUInteger)2);
+    XCTAssertEqual([registry reportForSourceFile:second.sourceFile], second);
+
+    [registry removeReport:first];
+    XCTAssertEqual([registry indexOfReport:first], (NSUInteger)NSNotFound);
+    XCTAssertNil([registry reportForID:@"first"]);
+    XCTAssertEqual([registry indexOfReport:second], (NSUInteger)0);
+    XCTAssertEqual([registry indexOfReport:third], (NSUInteger)1);
+
+    [registry filterUsingBlock:^BOOL(Report *report) {
+        return report != second;
+    }];
+    XCTAssertEqualObjects(registry.reports, @[third]);
+    XCTAssertEqual([registry indexOfReport:third], (NSUInteger)0);
+    XCTAssertNil([registry reportForSourceFile:second.sourceFile]);
+}
+
+- (void)testReindexMovesOnlyTheChangedReport {
+    Report *first = [self reportWithID:@"first"];
+    Report *second = [self reportWithID:@"second"];
+    ReportRegistry *registry = [[ReportRegistry alloc] initWithReports:@[first, second]];
+
+    // metadata.json gave the second report the first one's ID; the first report in the list still wins
+    second.reportID = @"first";
+    [registry reindexReport:second];
+    XCTAssertNil([registry reportForID:@"second"]);
+    XCTAssertEqual([registry reportForID:@"first"], first);
+
+    [registry removeReport:first];
+    XCTAssertEqual([registry reportForID:@"first"], second);
+    XCTAssertEqual([registry indexOfReport:second], (NSUInteger)0);
+}
+
+@end
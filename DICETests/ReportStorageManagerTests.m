@@ -0,0 +1,70 @@
+//
+//  ReportStorageManagerTests.m
+//  DICE
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+
+#import "ReportStorageManager.h"
+
+
+@interface ReportStorageManagerTests : XCTestCase
+
+@end
+
+@implementation ReportStorageManagerTests
+{
+    NSString *storagePath;
+}
+
+- (void)setUp {
+    [super setUp];
+    storagePath = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"%@.plist", [NSUUID UUID].UUIDString]];
+}
+
+- (void)tearDown {
+    [[NSFileManager defaultManager] removeItemAtPath:storagePath error:nil];
+    [super tearDown];
+}
+
+- (void)testEvictsLeastRecentlyOpenedUntilWithinBudget {
+    ReportStorageManager *storage = [[ReportStorageManager alloc] initWithPath:storagePath];
+    storage.minimumIdleTime = 0;
+    [storage recordContentSize:400 ofReport:@"a.zip"];
+    [storage recordContentSize:400 ofReport:@"b.zip"];
+    [storage recordContentSize:400 ofReport:@"c.zip"];
+    [storage reportOpened:@"a.zip"];
+    XCTAssertEqual(storage.extractedSize, (uint64_t)1200);
+
+    XCTAssertEqual([storage reportsToEvictSkipping:^BOOL(NSString *reportKey) { return NO; }].count, (NSUInteger)0, @"no budget evicted reports");
+
+    storage.budget = 500;
+    NSArray<NSString *> *evict = [storage reportsToEvictSkipping:^BOOL(NSString *reportKey) { return NO; }];
+    XCTAssertEqualObjects(evict, (@[@"b.zip", @"c.zip"]));
+
+    evict = [storage reportsToEvictSkipping:^BOOL(NSString *reportKey) { return [reportKey isEqualToString:@"b.zip"]; }];
+    XCTAssertEqualObjects(evict, (@[@"c.zip", @"a.zip"]));
+}
+
+- (void)testKeepsRecentlyOpenedReportsAndSavesRecords {
+    ReportStorageManager *storage = [[ReportStorageManager alloc] initWithPath:storagePath];
+    storage.budget = 100;
+    [storage recordContentSize:400 ofReport:@"a.zip"];
+    XCTAssertEqual([storage reportsToEvictSkipping:^BOOL(NSString *reportKey) { return NO; }].count, (NSUInteger)0, @"evicted a report opened just now");
+
+    [storage reportEvicted:@"a.zip"];
+    [storage recordContentSize:300 ofReport:@"b.zip"];
+
+    ReportStorageManager *reloaded = [[ReportStorageManager alloc] initWithPath:storagePath];
+    XCTAssertTrue([reloaded isReportEvicted:@"a.zip"]);
+    XCTAssertFalse([reloaded isReportEvicted:@"b.zip"]);
+    XCTAssertEqual(reloaded.extractedSize, (uint64_t)300);
+
+    [reloaded recordContentSize:400 ofReport:@"a.zip"];
+    XCTAssertFalse([reloaded isReportEvicted:@"a.zip"]);
+    [reloaded forgetReport:@"b.zip"];
+    XCTAssertEqual(reloaded.extractedSize, (uint64_t)400);
+}
+
+@end
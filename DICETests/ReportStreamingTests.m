@@ -0,0 +1,167 @@
+//
+//  ReportStreamingTests.m
+//  DICE
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+
+#import "ReportArchive.h"
+#import "ReportStreamExtractor.h"
+#import "ReportStreamingDownload.h"
+#import "ReportZipFixture.h"
+
+
+static NSData *stubResponseBody;
+static NSInteger stubResponseStatus;
+
+/**
+ Stands in for an HTTP server, serving stubResponseBody in small chunks for any request to reports.test.
+ */
+@interface StubReportServerProtocol : NSURLProtocol
+
+@end
+
+@implementation StubReportServerProtocol
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+    return [request.URL.host isEqualToString:@"reports.test"];
+}
+
++ (NSURLRequest *)canonicalRequestForRequest:(NSURLRequest *)request {
+    return request;
+}
+
+- (void)startLoading {
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.request.URL statusCode:stubResponseStatus HTTPVersion:@"HTTP/1.1"
+        headerFields:@{@"Content-Length": [NSString stringWithFormat:@"%lu", (unsigned long)stubResponseBody.length]}];
+    [self.client URLProtocol:self didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageNotAllowed];
+    for (NSUInteger offset = 0; offset < stubResponseBody.length; offset += 4096) {
+        NSRange chunk = NSMakeRange(offset, MIN((NSUInteger)4096, stubResponseBody.length - offset));
+        [self.client URLProtocol:self didLoadData:[stubResponseBody subdataWithRange:chunk]];
+    }
+    [self.client URLProtocolDidFinishLoading:self];
+}
+
+- (void)stopLoading {
+}
+
+@end
+
+
+@interface ReportStreamingTests : XCTestCase
+
+@end
+
+@implementation ReportStreamingTests
+{
+    NSURL *tempDir;
+    NSFileManager *fileManager;
+}
+
+- (void)setUp {
+    [super setUp];
+    fileManager = [NSFileManager defaultManager];
+    tempDir = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:[NSUUID UUID].UUIDString isDirectory:YES];
+    [fileManager createDirectoryAtURL:tempDir withIntermediateDirectories:YES attributes:nil error:nil];
+}
+
+- (void)tearDown {
+    [fileManager removeItemAtURL:tempDir error:nil];
+    [super tearDown];
+}
+
+- (NSURL *)writeReportZip:(NSUInteger)tileCount {
+    NSURL *zipURL = [tempDir URLByAppendingPathComponent:@"streamed_report.zip"];
+    ReportZipFixture *zip = [[ReportZipFixture alloc] initWithURL:zipURL];
+    zip.writesDataDescriptors = YES;
+    [zip addDirectory:@"streamed_report/"];
+    [zip addEntry:@"streamed_report/index.html" string:@"<html><body>streamed</body></html>"];
+    for (NSUInteger i = 0; i < tileCount; i++) {
+        NSMutableData *data = [NSMutableData dataWithLength:700 + i];
+        memset(data.mutableBytes, (int)(i & 0xff), data.length);
+        [zip addEntry:[NSString stringWithFormat:@"streamed_report/tiles/%lu.png", i] data:data deflate:(i % 2 == 0)];
+    }
+    XCTAssert([zip finish], @"could not write test zip");
+    return zipURL;
+}
+
+- (void)assertTilesExtracted:(NSUInteger)tileCount toDirectory:(NSString *)directory {
+    for (NSUInteger i = 0; i < tileCount; i++) {
+        NSString *tile = [directory stringByAppendingPathComponent:[NSString stringWithFormat:@"streamed_report/tiles/%lu.png", i]];
+        NSData *data = [NSData dataWithContentsOfFile:tile];
+        XCTAssertEqual(data.length, 700 + i);
+        XCTAssertEqual(((const uint8_t *)data.bytes)[data.length - 1], (uint8_t)(i & 0xff));
+    }
+}
+
+- (void)testExtractsEntriesAsBytesArrive {
+    NSURL *zipURL = [self writeReportZip:50];
+    NSData *zipData = [NSData dataWithContentsOfURL:zipURL];
+    NSString *destination = [tempDir.path stringByAppendingPathComponent:@"out"];
+    ReportStreamExtractor *streamExtractor = [[ReportStreamExtractor alloc] initWithDestination:destination];
+
+    NSError *error;
+    for (NSUInteger offset = 0; offset < zipData.length; offset += 777) {
+        size_t length = MIN((NSUInteger)777, zipData.length - offset);
+        XCTAssert([streamExtractor appendBytes:(const uint8_t *)zipData.bytes + offset length:length error:&error], @"%@", error);
+        if (offset < zipData.length / 2 && offset + length >= zipData.length / 2) {
+            XCTAssertGreaterThan(streamExtractor.entriesStreamed, 10);
+        }
+    }
+
+    XCTAssertTrue(streamExtractor.isStreaming);
+    ReportArchive *archive = [ReportArchive archiveWithURL:zipURL error:&error];
+    XCTAssertEqual([streamExtractor entriesToExtractFromArchive:archive].count, 0);
+    XCTAssertEqual(streamExtractor.entriesStreamed, archive.entries.count);
+    [self assertTilesExtracted:50 toDirectory:destination];
+}
+
+- (void)testDownloadsFromLocalServer {
+    stubResponseBody = [NSData dataWithContentsOfURL:[self writeReportZip:100]];
+    stubResponseStatus = 200;
+    NSString *archivePath = [tempDir.path stringByAppendingPathComponent:@"downloads/streamed_report.zip"];
+    NSString *destination = [tempDir.path stringByAppendingPathComponent:@"out"];
+    ReportStreamingDownload *download = [[ReportStreamingDownload alloc] initWithURL:[NSURL URLWithString:@"http://reports.test/streamed_report.zip"]
+        archivePath:archivePath destination:destination];
+    download.sessionConfiguration = [NSURLSessionConfiguration ephemeralSessionConfiguration];
+    download.sessionConfiguration.protocolClasses = @[[StubReportServerProtocol class]];
+
+    XCTestExpectation *finished = [self expectationWithDescription:@"download finished"];
+    __block NSError *downloadError;
+    [download startWithCompletion:^(NSError *error) {
+        downloadError = error;
+        [finished fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+
+    XCTAssertNil(downloadError);
+    XCTAssertEqualObjects([NSData dataWithContentsOfFile:archivePath], stubResponseBody);
+    XCTAssertEqual(download.entriesExtractedAfterDownload, 0);
+    [self assertTilesExtracted:100 toDirectory:destination];
+}
+
+- (void)testFailedDownloadRemovesStreamedFiles {
+    stubResponseBody = [NSData dataWithContentsOfURL:[self writeReportZip:10]];
+    stubResponseStatus = 404;
+    NSString *archivePath = [tempDir.path stringByAppendingPathComponent:@"downloads/streamed_report.zip"];
+    NSString *destination = [tempDir.path stringByAppendingPathComponent:@"out"];
+    ReportStreamingDownload *download = [[ReportStreamingDownload alloc] initWithURL:[NSURL URLWithString:@"http://reports.test/missing.zip"]
+        archivePath:archivePath destination:destination];
+    download.sessionConfiguration = [NSURLSessionConfiguration ephemeralSessionConfiguration];
+    download.sessionConfiguration.protocolClasses = @[[StubReportServerProtocol class]];
+
+    XCTestExpectation *finished = [self expectationWithDescription:@"download finished"];
+    __block NSError *downloadError;
+    [download startWithCompletion:^(NSError *error) {
+        downloadError = error;
+        [finished fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+
+    XCTAssertNotNil(downloadError);
+    XCTAssertFalse([fileManager fileExistsAtPath:archivePath]);
+    XCTAssertFalse([fileManager fileExistsAtPath:[destination stringByAppendingPathComponent:@"streamed_report"]]);
+}
+
+@end
@@ -0,0 +1,80 @@
+//
+//  ReportTrashTests.m
+//  DICE
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+
+#import "ReportTrash.h"
+
+
+@interface ReportTrashTests : XCTestCase
+
+@end
+
+@implementation ReportTrashTests
+{
+    NSString *tempDir;
+    NSString *trashDir;
+    NSFileManager *fileManager;
+}
+
+- (void)setUp {
+    [super setUp];
+    fileManager = [NSFileManager defaultManager];
+    tempDir = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    trashDir = [tempDir stringByAppendingPathComponent:@"trash"];
+    [fileManager createDirectoryAtPath:tempDir withIntermediateDirectories:YES attributes:nil error:nil];
+}
+
+- (void)tearDown {
+    [fileManager removeItemAtPath:tempDir error:nil];
+    [super tearDown];
+}
+
+- (NSString *)writeReportDirectory:(NSString *)name fileCount:(NSUInteger)fileCount {
+    NSString *reportDir = [tempDir stringByAppendingPathComponent:name];
+    NSData *data = [@"tile" dataUsingEncoding:NSUTF8StringEncoding];
+    for (NSUInteger i = 0; i < fileCount; i++) {
+        NSString *subdir = [reportDir stringByAppendingPathComponent:[NSString stringWithFormat:@"tiles/%lu", (unsigned long)(i / 100)]];
+        [fileManager createDirectoryAtPath:subdir withIntermediateDirectories:YES attributes:nil error:nil];
+        [data writeToFile:[subdir stringByAppendingPathComponent:[NSString stringWithFormat:@"%lu.png", (unsigned long)i]] atomically:NO];
+    }
+    return reportDir;
+}
+
+- (void)testMovesAwayAtOnceAndReapsInBatches {
+    NSString *reportDir = [self writeReportDirectory:@"big_report" fileCount:1000];
+    ReportTrash *trash = [[ReportTrash alloc] initWithDirectory:trashDir];
+    trash.batchSize = 64;
+
+    XCTestExpectation *reaped = [self expectationWithDescription:@"trash reaped"];
+    XCTAssertTrue([trash moveItemToTrash:reportDir completion:^{
+        [reaped fulfill];
+    }]);
+    XCTAssertFalse([fileManager fileExistsAtPath:reportDir]);
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+
+    XCTAssertEqual([fileManager contentsOfDirectoryAtPath:trashDir error:nil].count, (NSUInteger)0);
+    XCTAssertFalse([trash moveItemToTrash:reportDir completion:nil], @"moved a file that is not there");
+}
+
+- (void)testEmptiesLeftoverTrash {
+    [self writeReportDirectory:@"trash/left_over" fileCount:300];
+    ReportTrash *trash = [[ReportTrash alloc] initWithDirectory:trashDir];
+    trash.batchSize = 1000;
+    [trash empty];
+
+    // the leftovers go in one batch on the serial reaper queue, so they are gone before this is reaped
+    NSString *marker = [self writeReportDirectory:@"marker" fileCount:1];
+    XCTestExpectation *reaped = [self expectationWithDescription:@"trash reaped"];
+    [trash moveItemToTrash:marker completion:^{
+        [reaped fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+
+    XCTAssertEqual([fileManager contentsOfDirectoryAtPath:trashDir error:nil].count, (NSUInteger)0);
+}
+
+@end
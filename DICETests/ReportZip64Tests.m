@@ -0,0 +1,144 @@
+//
+//  ReportZip64Tests.m
+//  DICE
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+
+#import "ReportArchive.h"
+#import "ReportExtractor.h"
+#import "ReportStreamExtractor.h"
+#import "ReportZipFixture.h"
+
+
+/**
+ Zip64 archives, the format zip tools switch to past 65535 entries or 4 GB.  The test
+ that writes an archive past 4 GB needs about 4.5 GB of free disk and takes a while, so
+ it only runs when DICE_LARGE_ARCHIVE_TESTS is set in the test environment.
+ */
+@interface ReportZip64Tests : XCTestCase
+
+@end
+
+@implementation ReportZip64Tests
+{
+    NSURL *tempDir;
+    NSFileManager *fileManager;
+}
+
+- (void)setUp {
+    [super setUp];
+    fileManager = [NSFileManager defaultManager];
+    tempDir = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:[NSUUID UUID].UUIDString isDirectory:YES];
+    [fileManager createDirectoryAtURL:tempDir withIntermediateDirectories:YES attributes:nil error:nil];
+}
+
+- (void)tearDown {
+    [fileManager removeItemAtURL:tempDir error:nil];
+    [super tearDown];
+}
+
+- (NSURL *)writeZip64Report:(NSUInteger)tileCount descriptors:(BOOL)descriptors {
+    NSURL *zipURL = [tempDir URLByAppendingPathComponent:@"zip64_report.zip"];
+    ReportZipFixture *zip = [[ReportZipFixture alloc] initWithURL:zipURL];
+    zip.writesZip64 = YES;
+    zip.writesDataDescriptors = descriptors;
+    [zip addDirectory:@"zip64_report/"];
+    [zip addEntry:@"zip64_report/metadata.json" string:@"{\"title\": \"Zip64 Report\"}"];
+    for (NSUInteger i = 0; i < tileCount; i++) {
+        NSMutableData *data = [NSMutableData dataWithLength:300 + i];
+        memset(data.mutableBytes, (int)(i & 0xff), data.length);
+        [zip addEntry:[NSString stringWithFormat:@"zip64_report/tiles/%lu.png", i] data:data deflate:(i % 2 == 0)];
+    }
+    XCTAssert([zip finish], @"could not write test zip");
+    return zipURL;
+}
+
+- (void)testReadsZip64Directory {
+    NSError *error;
+    ReportArchive *archive = [ReportArchive archiveWithURL:[self writeZip64Report:20 descriptors:NO] error:&error];
+    XCTAssertNotNil(archive, @"%@", error);
+    XCTAssertEqual(archive.entries.count, (NSUInteger)22);
+
+    ReportArchiveEntry *tile = [archive entryNamed:@"zip64_report/tiles/19.png"];
+    XCTAssertEqual(tile.uncompressedSize, (uint64_t)319);
+    XCTAssertEqual(tile.compressedSize, (uint64_t)319);
+    XCTAssertGreaterThan(tile.localHeaderOffset, (uint64_t)0);
+
+    ReportExtractor *extractor = [[ReportExtractor alloc] initWithArchive:archive destination:tempDir.path];
+    XCTAssert([extractor extract:&error], @"%@", error);
+    NSData *data = [NSData dataWithContentsOfFile:[tempDir.path stringByAppendingPathComponent:@"zip64_report/tiles/19.png"]];
+    XCTAssertEqual(data.length, (NSUInteger)319);
+    XCTAssertEqual(((const uint8_t *)data.bytes)[data.length - 1], (uint8_t)19);
+}
+
+- (void)testReadsMoreThan65535Entries {
+    NSURL *zipURL = [tempDir URLByAppendingPathComponent:@"many_tiles.zip"];
+    ReportZipFixture *zip = [[ReportZipFixture alloc] initWithURL:zipURL];
+    NSData *tile = [@"t" dataUsingEncoding:NSUTF8StringEncoding];
+    for (NSUInteger i = 0; i < 70000; i++) {
+        [zip addEntry:[NSString stringWithFormat:@"many_tiles/%lu/%lu.png", i / 1000, i] data:tile deflate:NO];
+    }
+    XCTAssert([zip finish], @"could not write test zip");
+
+    NSError *error;
+    ReportArchive *archive = [ReportArchive archiveWithURL:zipURL error:&error];
+    XCTAssertNotNil(archive, @"%@", error);
+    XCTAssertEqual(archive.entries.count, (NSUInteger)70000);
+    XCTAssertEqual(archive.totalUncompressedSize, (uint64_t)70000);
+    XCTAssertNotNil([archive entryNamed:@"many_tiles/69/69999.png"]);
+}
+
+- (void)testStreamsZip64EntriesWithDescriptors {
+    NSURL *zipURL = [self writeZip64Report:30 descriptors:YES];
+    NSData *zipData = [NSData dataWithContentsOfURL:zipURL];
+    NSString *destination = [tempDir.path stringByAppendingPathComponent:@"out"];
+    ReportStreamExtractor *streamExtractor = [[ReportStreamExtractor alloc] initWithDestination:destination];
+
+    NSError *error;
+    for (NSUInteger offset = 0; offset < zipData.length; offset += 1000) {
+        size_t length = MIN((NSUInteger)1000, zipData.length - offset);
+        XCTAssert([streamExtractor appendBytes:(const uint8_t *)zipData.bytes + offset length:length error:&error], @"%@", error);
+    }
+
+    XCTAssertTrue(streamExtractor.isStreaming);
+    ReportArchive *archive = [ReportArchive archiveWithURL:zipURL error:&error];
+    XCTAssertEqual(streamExtractor.entriesStreamed, archive.entries.count);
+    XCTAssertEqual([streamExtractor entriesToExtractFromArchive:archive].count, (NSUInteger)0);
+    NSData *data = [NSData dataWithContentsOfFile:[destination stringByAppendingPathComponent:@"zip64_report/tiles/28.png"]];
+    XCTAssertEqual(data.length, (NSUInteger)328);
+}
+
+- (void)testReadsEntriesPast4GB {
+    if (!NSProcessInfo.processInfo.environment[@"DICE_LARGE_ARCHIVE_TESTS"]) {
+        NSLog(@"ReportZip64Tests: set DICE_LARGE_ARCHIVE_TESTS to run %@", self.name);
+        return;
+    }
+    uint64_t bigLength = (4ULL << 30) + 4096;
+    NSURL *zipURL = [tempDir URLByAppendingPathComponent:@"big_report.zip"];
+    ReportZipFixture *zip = [[ReportZipFixture alloc] initWithURL:zipURL];
+    [zip addEntry:@"big_report/layers/big.gpkg" zeroFilledLength:bigLength];
+    [zip addEntry:@"big_report/metadata.json" string:@"{\"title\": \"Big Report\"}"];
+    XCTAssert([zip finish], @"could not write test zip");
+
+    NSError *error;
+    ReportArchive *archive = [ReportArchive archiveWithURL:zipURL error:&error];
+    XCTAssertNotNil(archive, @"%@", error);
+    ReportArchiveEntry *big = [archive entryNamed:@"big_report/layers/big.gpkg"];
+    ReportArchiveEntry *metadata = [archive entryNamed:@"big_report/metadata.json"];
+    XCTAssertEqual(big.uncompressedSize, bigLength);
+    XCTAssertGreaterThan(metadata.localHeaderOffset, bigLength);
+
+    ReportArchiveReader *reader = [[ReportArchiveReader alloc] initWithArchive:archive];
+    __block uint64_t read = 0;
+    XCTAssert([reader readEntry:big toBlock:^BOOL(const void *bytes, size_t length) {
+        read += length;
+        return YES;
+    } error:&error], @"%@", error);
+    XCTAssertEqual(read, bigLength);
+    NSData *data = [reader dataForEntry:metadata error:&error];
+    XCTAssertEqualObjects([[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding], @"{\"title\": \"Big Report\"}");
+}
+
+@end
@@ -0,0 +1,39 @@
+//
+//  ReportZipFixture.h
+//  DICE
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ Writes zip archives for tests without going through the app's import code.  Entry data
+ is written to the file as it is added, so an archive can be bigger than memory.
+ */
+@interface ReportZipFixture : NSObject
+
+/**
+ Write the CRC and sizes of deflated entries in a data descriptor after their data instead of
+ in the local header, the way streaming zip tools do.
+ */
+@property (nonatomic) BOOL writesDataDescriptors;
+
+/**
+ Write Zip64 extra fields and end of central directory records even when nothing needs them.
+ Entries past 4 GB, and archives with more than 65535 entries, get them regardless.
+ */
+@property (nonatomic) BOOL writesZip64;
+
+- (instancetype)initWithURL:(NSURL *)url;
+
+- (void)addDirectory:(NSString *)name;
+- (void)addEntry:(NSString *)name data:(NSData *)data deflate:(BOOL)deflate;
+- (void)addEntry:(NSString *)name string:(NSString *)string;
+
+/**
+ Add a stored entry of the given number of zero bytes, written a chunk at a time.
+ */
+- (void)addEntry:(NSString *)name zeroFilledLength:(uint64_t)length;
+
+- (BOOL)finish;
+
+@end
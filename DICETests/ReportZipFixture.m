@@ -0,0 +1,224 @@
+//
+//  ReportZipFixture.m
+//  DICE
+//
+
+#import "ReportZipFixture.h"
+
+#import "zlib.h"
+
+static const uint32_t kZip64Limit = 0xffffffff;
+static const size_t kZeroChunkLength = 1 << 20;
+
+static void appendUInt16(NSMutableData *data, uint16_t value) {
+    uint8_t bytes[2] = { value & 0xff, (value >> 8) & 0xff };
+    [data appendBytes:bytes length:2];
+}
+
+static void appendUInt32(NSMutableData *data, uint32_t value) {
+    uint8_t bytes[4] = { value & 0xff, (value >> 8) & 0xff, (value >> 16) & 0xff, (value >> 24) & 0xff };
+    [data appendBytes:bytes length:4];
+}
+
+static void appendUInt64(NSMutableData *data, uint64_t value) {
+    appendUInt32(data, (uint32_t)value);
+    appendUInt32(data, (uint32_t)(value >> 32));
+}
+
+@implementation ReportZipFixture
+{
+    NSURL *url;
+    FILE *file;
+    BOOL failed;
+    uint64_t bodyLength;
+    NSMutableData *directory;
+    uint64_t count;
+}
+
+- (instancetype)initWithURL:(NSURL *)aUrl
+{
+    self = [super init];
+    if (self) {
+        url = aUrl;
+        directory = [NSMutableData data];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    if (file) {
+        fclose(file);
+    }
+}
+
+- (void)writeBytes:(const void *)bytes length:(size_t)length
+{
+    if (!file && !failed) {
+        file = fopen(url.path.fileSystemRepresentation, "wb");
+    }
+    if (!file || fwrite(bytes, 1, length, file) != length) {
+        failed = YES;
+    }
+    bodyLength += length;
+}
+
+- (void)addDirectory:(NSString *)name
+{
+    [self addEntry:name data:[NSData data] deflate:NO];
+}
+
+- (void)addEntry:(NSString *)name string:(NSString *)string
+{
+    [self addEntry:name data:[string dataUsingEncoding:NSUTF8StringEncoding] deflate:YES];
+}
+
+- (void)addEntry:(NSString *)name data:(NSData *)data deflate:(BOOL)deflate
+{
+    NSData *stored = data;
+    if (deflate) {
+        z_stream stream = {0};
+        deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+        NSMutableData *compressed = [NSMutableData dataWithLength:deflateBound(&stream, data.length)];
+        stream.next_in = (Bytef *)data.bytes;
+        stream.avail_in = (uInt)data.length;
+        stream.next_out = compressed.mutableBytes;
+        stream.avail_out = (uInt)compressed.length;
+        deflate(&stream, Z_FINISH);
+        compressed.length = stream.total_out;
+        deflateEnd(&stream);
+        stored = compressed;
+    }
+
+    uint32_t crc = (uint32_t)crc32(0, data.bytes, (uInt)data.length);
+    [self addEntry:name method:(deflate ? Z_DEFLATED : 0) crc:crc compressedSize:stored.length uncompressedSize:data.length
+        descriptor:(deflate && self.writesDataDescriptors) writeData:^{
+            [self writeBytes:stored.bytes length:stored.length];
+        }];
+}
+
+- (void)addEntry:(NSString *)name zeroFilledLength:(uint64_t)length
+{
+    NSMutableData *zeros = [NSMutableData dataWithLength:kZeroChunkLength];
+    uLong crc = crc32(0L, Z_NULL, 0);
+    for (uint64_t done = 0; done < length; done += kZeroChunkLength) {
+        crc = crc32(crc, zeros.bytes, (uInt)MIN((uint64_t)kZeroChunkLength, length - done));
+    }
+    [self addEntry:name method:0 crc:(uint32_t)crc compressedSize:length uncompressedSize:length descriptor:NO writeData:^{
+        for (uint64_t done = 0; done < length; done += kZeroChunkLength) {
+            [self writeBytes:zeros.bytes length:(size_t)MIN((uint64_t)kZeroChunkLength, length - done)];
+        }
+    }];
+}
+
+- (void)addEntry:(NSString *)name method:(uint16_t)method crc:(uint32_t)crc compressedSize:(uint64_t)compressedSize uncompressedSize:(uint64_t)size
+    descriptor:(BOOL)descriptor writeData:(void (^)(void))writeData
+{
+    NSData *nameData = [name dataUsingEncoding:NSUTF8StringEncoding];
+    uint64_t offset = bodyLength;
+    BOOL zip64 = self.writesZip64 || size >= kZip64Limit || compressedSize >= kZip64Limit || offset >= kZip64Limit;
+    uint16_t version = zip64 ? 45 : 20;
+    uint16_t flags = (1 << 11) | (descriptor ? (1 << 3) : 0);
+
+    NSMutableData *local = [NSMutableData data];
+    appendUInt32(local, 0x04034b50);
+    appendUInt16(local, version);
+    appendUInt16(local, flags);
+    appendUInt16(local, method);
+    appendUInt32(local, 0);
+    appendUInt32(local, descriptor ? 0 : crc);
+    appendUInt32(local, descriptor ? 0 : (zip64 ? kZip64Limit : (uint32_t)compressedSize));
+    appendUInt32(local, descriptor ? 0 : (zip64 ? kZip64Limit : (uint32_t)size));
+    appendUInt16(local, (uint16_t)nameData.length);
+    appendUInt16(local, zip64 ? 20 : 0);
+    [local appendData:nameData];
+    if (zip64) {
+        appendUInt16(local, 0x0001);
+        appendUInt16(local, 16);
+        appendUInt64(local, descriptor ? 0 : size);
+        appendUInt64(local, descriptor ? 0 : compressedSize);
+    }
+    [self writeBytes:local.bytes length:local.length];
+    writeData();
+    if (descriptor) {
+        NSMutableData *trailer = [NSMutableData data];
+        appendUInt32(trailer, 0x08074b50);
+        appendUInt32(trailer, crc);
+        if (zip64) {
+            appendUInt64(trailer, compressedSize);
+            appendUInt64(trailer, size);
+        }
+        else {
+            appendUInt32(trailer, (uint32_t)compressedSize);
+            appendUInt32(trailer, (uint32_t)size);
+        }
+        [self writeBytes:trailer.bytes length:trailer.length];
+    }
+
+    appendUInt32(directory, 0x02014b50);
+    appendUInt16(directory, version);
+    appendUInt16(directory, version);
+    appendUInt16(directory, flags);
+    appendUInt16(directory, method);
+    appendUInt32(directory, 0);
+    appendUInt32(directory, crc);
+    appendUInt32(directory, zip64 ? kZip64Limit : (uint32_t)compressedSize);
+    appendUInt32(directory, zip64 ? kZip64Limit : (uint32_t)size);
+    appendUInt16(directory, (uint16_t)nameData.length);
+    appendUInt16(directory, zip64 ? 28 : 0);
+    appendUInt16(directory, 0);
+    appendUInt16(directory, 0);
+    appendUInt16(directory, 0);
+    appendUInt32(directory, 0);
+    appendUInt32(directory, zip64 ? kZip64Limit : (uint32_t)offset);
+    [directory appendData:nameData];
+    if (zip64) {
+        appendUInt16(directory, 0x0001);
+        appendUInt16(directory, 24);
+        appendUInt64(directory, size);
+        appendUInt64(directory, compressedSize);
+        appendUInt64(directory, offset);
+    }
+
+    count++;
+}
+
+- (BOOL)finish
+{
+    uint64_t directoryOffset = bodyLength;
+    NSMutableData *end = [NSMutableData dataWithData:directory];
+    BOOL zip64 = self.writesZip64 || count > 0xffff || directoryOffset >= kZip64Limit || directory.length >= kZip64Limit;
+    if (zip64) {
+        uint64_t zip64EndOffset = directoryOffset + directory.length;
+        appendUInt32(end, 0x06064b50);
+        appendUInt64(end, 44);
+        appendUInt16(end, 45);
+        appendUInt16(end, 45);
+        appendUInt32(end, 0);
+        appendUInt32(end, 0);
+        appendUInt64(end, count);
+        appendUInt64(end, count);
+        appendUInt64(end, directory.length);
+        appendUInt64(end, directoryOffset);
+
+        appendUInt32(end, 0x07064b50);
+        appendUInt32(end, 0);
+        appendUInt64(end, zip64EndOffset);
+        appendUInt32(end, 1);
+    }
+    appendUInt32(end, 0x06054b50);
+    appendUInt16(end, 0);
+    appendUInt16(end, 0);
+    appendUInt16(end, zip64 ? 0xffff : (uint16_t)count);
+    appendUInt16(end, zip64 ? 0xffff : (uint16_t)count);
+    appendUInt32(end, zip64 ? kZip64Limit : (uint32_t)directory.length);
+    appendUInt32(end, zip64 ? kZip64Limit : (uint32_t)directoryOffset);
+    appendUInt16(end, 0);
+    [self writeBytes:end.bytes length:end.length];
+
+    BOOL closed = file && fclose(file) == 0;
+    file = NULL;
+    return closed && !failed;
+}
+
+@end